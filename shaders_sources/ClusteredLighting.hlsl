@@ -0,0 +1,270 @@
+// Clustered shading of the local lights on top of the deferred lighting. The view is split into froxels:
+// screen tiles of c_TileSize pixels times exponential depth slices. cluster_cs lists the lights whose
+// bounding sphere touches each froxel, classify_cs keeps the tiles that have geometry and at least one light
+// in the depth range of their pixels and sizes the shading dispatch, and shade_cs adds the lights of each
+// pixel's cluster to the lighting output. Sky-only and unlit tiles dispatch no shading groups at all.
+//
+// Cluster list: u_ClusterLights[cluster * c_ClusterStride] = light count, followed by the light indices.
+
+#pragma pack_matrix(row_major)
+
+#include <donut/shaders/view_cb.h>
+#include <donut/shaders/light_cb.h>
+#include <donut/shaders/scene_material.hlsli>
+#include <donut/shaders/lighting.hlsli>
+
+struct ClusteredLightingConstants
+{
+    PlanarViewConstants view;
+
+    uint2 viewOrigin;
+    uint2 viewSize;
+    uint3 clusterCount;
+    uint lightCount;
+    float clusterNear;
+    float sliceScale;
+    float skyDepth;
+    uint padding;
+};
+
+ConstantBuffer<ClusteredLightingConstants> g_Constants : register(b0);
+
+StructuredBuffer<LightConstants> t_Lights : register(t0);
+// View space center and radius of every light
+StructuredBuffer<float4> t_LightBounds : register(t1);
+Texture2D<float> t_Depth : register(t2);
+Texture2D<float4> t_GBufferDiffuse : register(t3);
+Texture2D<float4> t_GBufferSpecular : register(t4);
+Texture2D<float4> t_GBufferNormals : register(t5);
+
+RWStructuredBuffer<uint> u_ClusterLights : register(u0);
+// Lit tiles, x | y << 16
+RWStructuredBuffer<uint> u_TileList : register(u1);
+RWByteAddressBuffer u_DispatchArgs : register(u2);
+RWTexture2D<float4> u_Output : register(u3);
+
+static const uint c_TileSize = 64;
+static const uint c_MaxLightsPerCluster = 63;
+static const uint c_ClusterStride = c_MaxLightsPerCluster + 1;
+static const uint c_ClusterGroupSize = 64;
+// Shading groups are 8x8 pixels
+static const uint c_GroupsPerTile = (c_TileSize / 8) * (c_TileSize / 8);
+
+uint GetSlice(float viewDepth)
+{
+    float slice = log(max(viewDepth, g_Constants.clusterNear) / g_Constants.clusterNear) * g_Constants.sliceScale;
+    return min(uint(slice), g_Constants.clusterCount.z - 1);
+}
+
+float GetSliceDepth(uint slice)
+{
+    return g_Constants.clusterNear * exp(float(slice) / g_Constants.sliceScale);
+}
+
+uint GetClusterIndex(uint2 tile, uint slice)
+{
+    return (slice * g_Constants.clusterCount.y + tile.y) * g_Constants.clusterCount.x + tile.x;
+}
+
+// View space position at the given view depth on the ray through a pixel corner
+float3 GetViewPosition(float2 pixel, float viewDepth)
+{
+    float2 clipPosition = (float2(g_Constants.viewOrigin) + pixel) * g_Constants.view.windowToClipScale + g_Constants.view.windowToClipBias;
+    float4 viewPosition = mul(float4(clipPosition, 0.5, 1), g_Constants.view.matClipToView);
+    return viewPosition.xyz / viewPosition.z * viewDepth;
+}
+
+float GetViewDepth(uint2 pixel, float depth)
+{
+    float2 clipPosition = (float2(pixel) + 0.5) * g_Constants.view.windowToClipScale + g_Constants.view.windowToClipBias;
+    float4 viewPosition = mul(float4(clipPosition, depth, 1), g_Constants.view.matClipToView);
+    return viewPosition.z / viewPosition.w;
+}
+
+// ---- Cluster lists ----
+
+groupshared float4 s_LightBounds[c_ClusterGroupSize];
+
+[numthreads(c_ClusterGroupSize, 1, 1)]
+void cluster_cs(uint globalIdx : SV_DispatchThreadID, uint threadIndex : SV_GroupIndex)
+{
+    uint clusterCount = g_Constants.clusterCount.x * g_Constants.clusterCount.y * g_Constants.clusterCount.z;
+    bool validCluster = globalIdx < clusterCount;
+
+    uint tileCount = g_Constants.clusterCount.x * g_Constants.clusterCount.y;
+    uint slice = globalIdx / tileCount;
+    uint2 tile = uint2(globalIdx % g_Constants.clusterCount.x, (globalIdx % tileCount) / g_Constants.clusterCount.x);
+
+    // Bounds of the froxel, from the corners of the tile at the near and far depth of the slice
+    float2 pixelMin = float2(tile * c_TileSize);
+    float2 pixelMax = min(pixelMin + c_TileSize, float2(g_Constants.viewSize));
+    float sliceNear = slice == 0 ? 0 : GetSliceDepth(slice);
+    float sliceFar = slice == g_Constants.clusterCount.z - 1 ? 1e30 : GetSliceDepth(slice + 1);
+
+    float3 boundsMin = 1e30;
+    float3 boundsMax = -1e30;
+    for (uint corner = 0; corner < 8; corner++)
+    {
+        float2 pixel = float2((corner & 1) ? pixelMax.x : pixelMin.x, (corner & 2) ? pixelMax.y : pixelMin.y);
+        float3 position = GetViewPosition(pixel, (corner & 4) ? sliceFar : sliceNear);
+        boundsMin = min(boundsMin, position);
+        boundsMax = max(boundsMax, position);
+    }
+
+    uint count = 0;
+    uint listStart = globalIdx * c_ClusterStride + 1;
+
+    // The lights are tested in batches that the group loads together
+    for (uint batch = 0; batch < g_Constants.lightCount; batch += c_ClusterGroupSize)
+    {
+        uint batchSize = min(c_ClusterGroupSize, g_Constants.lightCount - batch);
+
+        GroupMemoryBarrierWithGroupSync();
+        if (threadIndex < batchSize)
+            s_LightBounds[threadIndex] = t_LightBounds[batch + threadIndex];
+        GroupMemoryBarrierWithGroupSync();
+
+        if (!validCluster)
+            continue;
+
+        for (uint i = 0; i < batchSize; i++)
+        {
+            float4 sphere = s_LightBounds[i];
+            float3 closest = clamp(sphere.xyz, boundsMin, boundsMax);
+            float3 offset = closest - sphere.xyz;
+
+            // Lights past the capacity of a cluster are dropped
+            if (dot(offset, offset) <= sphere.w * sphere.w && count < c_MaxLightsPerCluster)
+            {
+                u_ClusterLights[listStart + count] = batch + i;
+                count++;
+            }
+        }
+    }
+
+    if (validCluster)
+        u_ClusterLights[globalIdx * c_ClusterStride] = count;
+}
+
+// ---- Tile classification ----
+
+groupshared uint s_MinDepth;
+groupshared uint s_MaxDepth;
+
+// One group per tile, every thread reads 8x8 pixels
+[numthreads(8, 8, 1)]
+void classify_cs(uint2 groupIdx : SV_GroupID, uint2 threadIdx : SV_GroupThreadID, uint threadIndex : SV_GroupIndex)
+{
+    if (threadIndex == 0)
+    {
+        s_MinDepth = asuint(1e30);
+        s_MaxDepth = 0;
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    // Positive floats compare like their bit patterns
+    float minDepth = 1e30;
+    float maxDepth = 0;
+    for (uint y = 0; y < 8; y++)
+    {
+        for (uint x = 0; x < 8; x++)
+        {
+            uint2 local = groupIdx * c_TileSize + threadIdx * 8 + uint2(x, y);
+            if (any(local >= g_Constants.viewSize))
+                continue;
+
+            uint2 pixel = g_Constants.viewOrigin + local;
+            float depth = t_Depth[pixel];
+            if (depth == g_Constants.skyDepth)
+                continue;
+
+            float viewDepth = GetViewDepth(pixel, depth);
+            minDepth = min(minDepth, viewDepth);
+            maxDepth = max(maxDepth, viewDepth);
+        }
+    }
+
+    if (maxDepth > 0)
+    {
+        InterlockedMin(s_MinDepth, asuint(max(minDepth, 0)));
+        InterlockedMax(s_MaxDepth, asuint(maxDepth));
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    if (threadIndex != 0 || s_MaxDepth == 0)
+        return;
+
+    uint lastSlice = GetSlice(asfloat(s_MaxDepth));
+    for (uint slice = GetSlice(asfloat(s_MinDepth)); slice <= lastSlice; slice++)
+    {
+        if (u_ClusterLights[GetClusterIndex(groupIdx, slice) * c_ClusterStride] != 0)
+        {
+            // A row of c_GroupsPerTile groups per lit tile, so that the tile count is not bound by the
+            // dispatch limit of a single dimension
+            uint tileIndex;
+            u_DispatchArgs.InterlockedAdd(4, 1, tileIndex);
+            u_TileList[tileIndex] = groupIdx.x | (groupIdx.y << 16);
+            return;
+        }
+    }
+}
+
+// ---- Shading ----
+
+[numthreads(8, 8, 1)]
+void shade_cs(uint2 groupIdx : SV_GroupID, uint2 threadIdx : SV_GroupThreadID)
+{
+    uint packedTile = u_TileList[groupIdx.y];
+    uint2 tile = uint2(packedTile & 0xffff, packedTile >> 16);
+    uint block = groupIdx.x;
+
+    uint2 local = tile * c_TileSize + uint2(block % (c_TileSize / 8), block / (c_TileSize / 8)) * 8 + threadIdx;
+    if (any(local >= g_Constants.viewSize))
+        return;
+
+    uint2 pixel = g_Constants.viewOrigin + local;
+    float depth = t_Depth[pixel];
+    if (depth == g_Constants.skyDepth)
+        return;
+
+    uint cluster = GetClusterIndex(tile, GetSlice(GetViewDepth(pixel, depth)));
+    uint lightCount = u_ClusterLights[cluster * c_ClusterStride];
+    if (lightCount == 0)
+        return;
+
+    // Same channels as the Donut GBuffer; the diffuse and specular channels are read through sRGB views
+    float4 diffuse = t_GBufferDiffuse[pixel];
+    float4 specular = t_GBufferSpecular[pixel];
+    float4 normals = t_GBufferNormals[pixel];
+
+    MaterialSample surface = (MaterialSample)0;
+    surface.diffuseAlbedo = diffuse.rgb;
+    surface.opacity = diffuse.a;
+    surface.specularF0 = specular.rgb;
+    surface.occlusion = specular.a;
+    surface.shadingNormal = normals.xyz;
+    surface.geometryNormal = normals.xyz;
+    surface.roughness = normals.w;
+
+    float2 clipPosition = (float2(pixel) + 0.5) * g_Constants.view.windowToClipScale + g_Constants.view.windowToClipBias;
+    float4 worldPosition = mul(float4(clipPosition, depth, 1), g_Constants.view.matClipToWorld);
+    float3 surfacePosition = worldPosition.xyz / worldPosition.w;
+
+    float4 camera = g_Constants.view.cameraDirectionOrPosition;
+    float3 viewIncident = camera.w > 0 ? normalize(surfacePosition - camera.xyz) : camera.xyz;
+
+    float3 diffuseTerm = 0;
+    float3 specularTerm = 0;
+    for (uint i = 0; i < lightCount; i++)
+    {
+        LightConstants light = t_Lights[u_ClusterLights[cluster * c_ClusterStride + 1 + i]];
+
+        float3 diffuseRadiance, specularRadiance;
+        ShadeSurface(light, surface, surfacePosition, viewIncident, diffuseRadiance, specularRadiance);
+
+        diffuseTerm += diffuseRadiance * light.color;
+        specularTerm += specularRadiance * light.color;
+    }
+
+    u_Output[pixel] += float4(diffuseTerm + specularTerm, 0);
+}
@@ -1,70 +1,53 @@
 // by WzrterFX
 
-Texture2D t_ScreenTexture : register(t0);
-SamplerState s_Sampler : register(s0);
-
-//     FXAA
-void main_ps(
-    in float4 i_pos : SV_Position,
-    in float2 i_uv : UV,
-    out float4 o_color : SV_Target
-)
-{
-    float FXAA_REDUCE_MIN = 1.0 / 128.0;
-    float FXAA_REDUCE_MUL = 1.0 / 8.0;
-    float FXAA_SPAN_MAX = 8.0;
-    
-    float width = 0, height = 0;
-    t_ScreenTexture.GetDimensions(width, height);
+// Runs after tone mapping on the LDR target. t_Source is the sRGB view of the tone mapped image, so samples
+// are linear; u_Output is a UNORM view of an sRGB texture and gets the gamma-encoded result.
 
-    float2 inv_resolution = 1.0 / float2(width, height);
+#if defined(SPIRV) || defined(TARGET_VULKAN)
+#define PUSH_CONSTANT [[vk::push_constant]]
+#else
+#define PUSH_CONSTANT
+#endif
 
-    //    
-    float3 rgbNW = t_ScreenTexture.Sample(s_Sampler, i_uv + inv_resolution * float2(-1, -1)).rgb;
-    float3 rgbNE = t_ScreenTexture.Sample(s_Sampler, i_uv + inv_resolution * float2(1, -1)).rgb;
-    float3 rgbSW = t_ScreenTexture.Sample(s_Sampler, i_uv + inv_resolution * float2(-1, 1)).rgb;
-    float3 rgbSE = t_ScreenTexture.Sample(s_Sampler, i_uv + inv_resolution * float2(1, 1)).rgb;
-    float3 rgbM = t_ScreenTexture.Sample(s_Sampler, i_uv).rgb;
-
-    float3 luma = float3(0.299, 0.587, 0.114);
-    float lumaNW = dot(rgbNW, luma);
-    float lumaNE = dot(rgbNE, luma);
-    float lumaSW = dot(rgbSW, luma);
-    float lumaSE = dot(rgbSE, luma);
-    float lumaM = dot(rgbM, luma);
+struct FXAAConstants
+{
+    uint2 viewOrigin;
+    uint2 viewSize;
+    float2 invTextureSize;
+    float2 padding;
+};
+
+PUSH_CONSTANT ConstantBuffer<FXAAConstants> g_Constants : register(b0);
+Texture2D t_Source : register(t0);
+RWTexture2D<float4> u_Output : register(u0);
+SamplerState s_Sampler : register(s0);
 
-    float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
-    float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+float3 LinearToSrgb(float3 color)
+{
+    float3 low = color * 12.92;
+    float3 high = 1.055 * pow(max(color, 0.0031308), 1.0 / 2.4) - 0.055;
+    return lerp(high, low, step(color, 0.0031308));
+}
 
-    float2 dir;
-    dir.x = -((lumaNW + lumaNE) - (lumaSW + lumaSE));
-    dir.y = ((lumaNW + lumaSW) - (lumaNE + lumaSE));
+// Neighbours are clamped to the rendered area, the rest of the texture holds stale pixels
+float3 FxaaSample(float2 uv)
+{
+    float2 uvMin = (float2(g_Constants.viewOrigin) + 0.5) * g_Constants.invTextureSize;
+    float2 uvMax = (float2(g_Constants.viewOrigin + g_Constants.viewSize) - 0.5) * g_Constants.invTextureSize;
+    return t_Source.SampleLevel(s_Sampler, clamp(uv, uvMin, uvMax), 0).rgb;
+}
 
-    float dirReduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * (0.25 * FXAA_REDUCE_MUL), FXAA_REDUCE_MIN);
+#include "FXAA.hlsli"
 
-    float rcpDirMin = 1.0 / (min(abs(dir.x), abs(dir.y)) + dirReduce);
-    dir = min(
-        float2(FXAA_SPAN_MAX, FXAA_SPAN_MAX),
-        max(
-            float2(-FXAA_SPAN_MAX, -FXAA_SPAN_MAX),
-            dir * rcpDirMin
-        )
-    ) * inv_resolution;
+//     FXAA
+[numthreads(8, 8, 1)]
+void main_cs(uint2 threadId : SV_DispatchThreadID)
+{
+    if (any(threadId >= g_Constants.viewSize))
+        return;
 
-    float3 rgbA = 0.5 * (
-        t_ScreenTexture.Sample(s_Sampler, i_uv + dir * (1.0 / 3.0 - 0.5)).rgb +
-        t_ScreenTexture.Sample(s_Sampler, i_uv + dir * (2.0 / 3.0 - 0.5)).rgb);
-    float3 rgbB = rgbA * 0.5 + 0.25 * (
-        t_ScreenTexture.Sample(s_Sampler, i_uv + dir * -0.5).rgb +
-        t_ScreenTexture.Sample(s_Sampler, i_uv + dir * 0.5).rgb);
+    uint2 pixel = g_Constants.viewOrigin + threadId;
+    float2 uv = (float2(pixel) + 0.5) * g_Constants.invTextureSize;
 
-    float lumaB = dot(rgbB, luma);
-    if ((lumaB < lumaMin) || (lumaB > lumaMax))
-    {
-        o_color = float4(rgbA, 1.0);
-    }
-    else
-    {
-        o_color = float4(rgbB, 1.0);
-    }
+    u_Output[pixel] = float4(LinearToSrgb(ApplyFXAA(uv, g_Constants.invTextureSize)), 1.0);
 }
@@ -0,0 +1,55 @@
+// FXAA kernel shared by FXAA.hlsl and the fused PostProcess.hlsl. The including shader defines FxaaSample(uv),
+// which returns the linear LDR color at a texture coordinate, clamped to the area that holds valid pixels.
+
+static const float FXAA_REDUCE_MIN = 1.0 / 128.0;
+static const float FXAA_REDUCE_MUL = 1.0 / 8.0;
+static const float FXAA_SPAN_MAX = 8.0;
+static const float FXAA_EDGE_THRESHOLD = 1.0 / 8.0;
+static const float FXAA_EDGE_THRESHOLD_MIN = 1.0 / 24.0;
+
+// Perceptual luma; sqrt is close enough to the sRGB curve for edge detection
+float Luma(float3 color)
+{
+    return sqrt(dot(color, float3(0.299, 0.587, 0.114)));
+}
+
+float3 ApplyFXAA(float2 uv, float2 inv_resolution)
+{
+    float3 rgbNW = FxaaSample(uv + inv_resolution * float2(-1, -1));
+    float3 rgbNE = FxaaSample(uv + inv_resolution * float2(1, -1));
+    float3 rgbSW = FxaaSample(uv + inv_resolution * float2(-1, 1));
+    float3 rgbSE = FxaaSample(uv + inv_resolution * float2(1, 1));
+    float3 rgbM = FxaaSample(uv);
+
+    float lumaNW = Luma(rgbNW);
+    float lumaNE = Luma(rgbNE);
+    float lumaSW = Luma(rgbSW);
+    float lumaSE = Luma(rgbSE);
+    float lumaM = Luma(rgbM);
+
+    float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+    float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+
+    // Most pixels are not on an edge and are returned as they are
+    if (lumaMax - lumaMin < max(FXAA_EDGE_THRESHOLD_MIN, lumaMax * FXAA_EDGE_THRESHOLD))
+        return rgbM;
+
+    float2 dir;
+    dir.x = -((lumaNW + lumaNE) - (lumaSW + lumaSE));
+    dir.y = ((lumaNW + lumaSW) - (lumaNE + lumaSE));
+
+    float dirReduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * (0.25 * FXAA_REDUCE_MUL), FXAA_REDUCE_MIN);
+
+    float rcpDirMin = 1.0 / (min(abs(dir.x), abs(dir.y)) + dirReduce);
+    dir = clamp(dir * rcpDirMin, -FXAA_SPAN_MAX, FXAA_SPAN_MAX) * inv_resolution;
+
+    float3 rgbA = 0.5 * (
+        FxaaSample(uv + dir * (1.0 / 3.0 - 0.5)) +
+        FxaaSample(uv + dir * (2.0 / 3.0 - 0.5)));
+    float3 rgbB = rgbA * 0.5 + 0.25 * (
+        FxaaSample(uv + dir * -0.5) +
+        FxaaSample(uv + dir * 0.5));
+
+    float lumaB = Luma(rgbB);
+    return ((lumaB < lumaMin) || (lumaB > lumaMax)) ? rgbA : rgbB;
+}
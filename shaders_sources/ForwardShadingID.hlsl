@@ -0,0 +1,20 @@
+// Forward shading that also writes the material ID to the second render target, for the forward opaque pass.
+// Wraps the Donut forward pixel shader. The forward vertex shader does not pass the instance index on, so
+// the instance channel holds 0xffff, the value MaterialIDs is cleared to.
+
+#define main ForwardShadingMain
+#include "../Libraries/donut/shaders/passes/forward_ps.hlsl"
+#undef main
+
+void main_ps(
+    in float4 i_position : SV_Position,
+    in SceneVertex i_vtx,
+    in bool i_isFrontFace : SV_IsFrontFace,
+    out float4 o_color : SV_Target0,
+    out uint2 o_materialID : SV_Target1
+)
+{
+    ForwardShadingMain(i_position, i_vtx, i_isFrontFace, o_color);
+
+    o_materialID = uint2(g_Material.materialID, 0xffff);
+}
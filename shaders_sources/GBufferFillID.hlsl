@@ -0,0 +1,33 @@
+// GBuffer fill that also writes the material and instance IDs, so that filling MaterialIDs does not take a
+// separate pass over the scene. Wraps the Donut GBuffer pixel shader; the IDs go to the render target after
+// the GBuffer channels and motion vectors, as laid out by RenderTargets::GBufferFramebuffer.
+
+#define main GBufferFillMain
+#include "../Libraries/donut/shaders/passes/gbuffer_ps.hlsl"
+#undef main
+
+void main_ps(
+    in float4 i_position : SV_Position,
+    in SceneVertex i_vtx,
+    in uint i_instance : INSTANCE,
+    in bool i_isFrontFace : SV_IsFrontFace,
+    out float4 o_channel0 : SV_Target0,
+    out float4 o_channel1 : SV_Target1,
+    out float4 o_channel2 : SV_Target2,
+    out float4 o_channel3 : SV_Target3,
+#if MOTION_VECTORS
+    out float3 o_motion : SV_Target4,
+    out uint2 o_materialID : SV_Target5
+#else
+    out uint2 o_materialID : SV_Target4
+#endif
+)
+{
+    GBufferFillMain(i_position, i_vtx, i_isFrontFace, o_channel0, o_channel1, o_channel2, o_channel3
+#if MOTION_VECTORS
+        , o_motion
+#endif
+    );
+
+    o_materialID = uint2(g_Material.materialID, i_instance);
+}
@@ -0,0 +1,135 @@
+// Diffuse light probes as L2 spherical harmonics. project_cs projects an environment cubemap onto the 9 SH
+// coefficients, already convolved with the clamped cosine lobe and divided by pi, so that evaluating them
+// gives the same value as a filtered diffuse cubemap. expand_cs evaluates the coefficients into the faces of
+// a small cube, which is what the Donut lighting shaders sample for diffuse probes.
+//
+// Both entry points take the cube faces as a 2D array in the D3D cubemap face order.
+
+struct LightProbeSHConstants
+{
+    float4 coefficients[9];
+    uint faceSize;
+    uint3 padding;
+};
+
+ConstantBuffer<LightProbeSHConstants> g_Constants : register(b0);
+
+Texture2DArray<float4> t_Environment : register(t0);
+RWStructuredBuffer<float4> u_Coefficients : register(u0);
+RWTexture2DArray<float4> u_DiffuseMap : register(u1);
+
+static const uint c_CoefficientCount = 9;
+static const uint c_ProjectGroupSize = 256;
+static const float c_Pi = 3.14159265;
+
+float3 GetCubeDirection(uint face, uint2 pixel)
+{
+    float2 uv = (float2(pixel) + 0.5) / float(g_Constants.faceSize) * 2.0 - 1.0;
+
+    switch (face)
+    {
+    case 0: return float3(1.0, -uv.y, -uv.x);
+    case 1: return float3(-1.0, -uv.y, uv.x);
+    case 2: return float3(uv.x, 1.0, uv.y);
+    case 3: return float3(uv.x, -1.0, -uv.y);
+    case 4: return float3(uv.x, -uv.y, 1.0);
+    default: return float3(-uv.x, -uv.y, -1.0);
+    }
+}
+
+void EvaluateBasis(float3 n, out float basis[c_CoefficientCount])
+{
+    basis[0] = 0.282095;
+    basis[1] = 0.488603 * n.y;
+    basis[2] = 0.488603 * n.z;
+    basis[3] = 0.488603 * n.x;
+    basis[4] = 1.092548 * n.x * n.y;
+    basis[5] = 1.092548 * n.y * n.z;
+    basis[6] = 0.315392 * (3.0 * n.z * n.z - 1.0);
+    basis[7] = 1.092548 * n.x * n.z;
+    basis[8] = 0.546274 * (n.x * n.x - n.y * n.y);
+}
+
+// ---- Projection ----
+
+groupshared float3 s_Sums[c_ProjectGroupSize][c_CoefficientCount];
+groupshared float s_SolidAngles[c_ProjectGroupSize];
+
+// A single group reads the whole environment, so the environment should be a small mip
+[numthreads(c_ProjectGroupSize, 1, 1)]
+void project_cs(uint threadIndex : SV_GroupIndex)
+{
+    float3 sums[c_CoefficientCount];
+    for (uint i = 0; i < c_CoefficientCount; i++)
+        sums[i] = 0;
+    float solidAngles = 0;
+
+    uint faceTexels = g_Constants.faceSize * g_Constants.faceSize;
+    for (uint texel = threadIndex; texel < faceTexels * 6; texel += c_ProjectGroupSize)
+    {
+        uint face = texel / faceTexels;
+        uint faceTexel = texel - face * faceTexels;
+        uint2 pixel = uint2(faceTexel % g_Constants.faceSize, faceTexel / g_Constants.faceSize);
+
+        // Proportional to the solid angle of the texel; the sum is scaled to 4 pi below
+        float3 direction = GetCubeDirection(face, pixel);
+        float lengthSquared = dot(direction, direction);
+        float solidAngle = 1.0 / (lengthSquared * sqrt(lengthSquared));
+        direction *= rsqrt(lengthSquared);
+
+        float3 radiance = t_Environment.Load(int4(pixel, face, 0)).rgb;
+
+        float basis[c_CoefficientCount];
+        EvaluateBasis(direction, basis);
+        for (uint i = 0; i < c_CoefficientCount; i++)
+            sums[i] += radiance * (basis[i] * solidAngle);
+        solidAngles += solidAngle;
+    }
+
+    for (uint i = 0; i < c_CoefficientCount; i++)
+        s_Sums[threadIndex][i] = sums[i];
+    s_SolidAngles[threadIndex] = solidAngles;
+
+    for (uint stride = c_ProjectGroupSize / 2; stride > 0; stride /= 2)
+    {
+        GroupMemoryBarrierWithGroupSync();
+
+        if (threadIndex < stride)
+        {
+            for (uint i = 0; i < c_CoefficientCount; i++)
+                s_Sums[threadIndex][i] += s_Sums[threadIndex + stride][i];
+            s_SolidAngles[threadIndex] += s_SolidAngles[threadIndex + stride];
+        }
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+
+    if (threadIndex < c_CoefficientCount)
+    {
+        // Clamped cosine convolution divided by pi, per band: 1, 2/3, 1/4
+        float band = threadIndex == 0 ? 1.0 : threadIndex < 4 ? 2.0 / 3.0 : 0.25;
+        float scale = 4.0 * c_Pi / s_SolidAngles[0] * band;
+        u_Coefficients[threadIndex] = float4(s_Sums[0][threadIndex] * scale, 0);
+    }
+}
+
+// ---- Expansion ----
+
+[numthreads(8, 8, 1)]
+void expand_cs(uint3 globalIdx : SV_DispatchThreadID)
+{
+    if (any(globalIdx.xy >= g_Constants.faceSize))
+        return;
+
+    float3 direction = normalize(GetCubeDirection(globalIdx.z, globalIdx.xy));
+
+    float basis[c_CoefficientCount];
+    EvaluateBasis(direction, basis);
+
+    float3 diffuse = 0;
+    for (uint i = 0; i < c_CoefficientCount; i++)
+        diffuse += g_Constants.coefficients[i].rgb * basis[i];
+
+    // L2 rings slightly below zero around strong lights
+    u_DiffuseMap[globalIdx] = float4(max(diffuse, 0), 1);
+}
@@ -0,0 +1,85 @@
+// Fused post-processing: exposure, tone mapping and optionally FXAA in one full-screen pass that writes the
+// window framebuffer. Bloom has already been composited into t_Source at this point.
+
+#ifndef ENABLE_FXAA
+#define ENABLE_FXAA 0
+#endif
+
+#if defined(SPIRV) || defined(TARGET_VULKAN)
+#define PUSH_CONSTANT [[vk::push_constant]]
+#else
+#define PUSH_CONSTANT
+#endif
+
+struct PostProcessConstants
+{
+    float2 windowToSourceUV;
+    float2 invTextureSize;
+    float2 uvMax;
+    float exposureScale;
+    float whitePointInvSquared;
+    float minAdaptedLuminance;
+    float maxAdaptedLuminance;
+    float2 padding;
+};
+
+PUSH_CONSTANT ConstantBuffer<PostProcessConstants> g_Constants : register(b0);
+Texture2D t_Source : register(t0);
+Buffer<uint> t_Exposure : register(t1);
+SamplerState s_Sampler : register(s0);
+
+float Luminance(float3 color)
+{
+    return dot(color, float3(0.2126, 0.7152, 0.0722));
+}
+
+// Extended Reinhard on luminance, keeps the hue of bright colors
+float3 ToneMap(float3 color, float exposure)
+{
+    color *= exposure;
+    float luminance = Luminance(color);
+    if (luminance <= 0.0)
+        return 0.0;
+
+    float toneMappedLuminance = luminance * (1.0 + luminance * g_Constants.whitePointInvSquared) / (1.0 + luminance);
+    return saturate(color * (toneMappedLuminance / luminance));
+}
+
+// Tone mapped source sample; FXAA filters the tone mapped image, which is never stored
+float3 SampleLdr(float2 uv, float exposure)
+{
+    return ToneMap(t_Source.SampleLevel(s_Sampler, min(uv, g_Constants.uvMax), 0).rgb, exposure);
+}
+
+#if ENABLE_FXAA
+// Set by main_ps before ApplyFXAA, which samples through FxaaSample
+static float s_Exposure;
+
+float3 FxaaSample(float2 uv)
+{
+    return SampleLdr(uv, s_Exposure);
+}
+
+#include "FXAA.hlsli"
+#endif
+
+void main_ps(
+    in float4 i_pos : SV_Position,
+    out float4 o_color : SV_Target0
+)
+{
+    float2 uv = i_pos.xy * g_Constants.windowToSourceUV;
+
+    float adaptedLuminance = clamp(asfloat(t_Exposure[0]), g_Constants.minAdaptedLuminance, g_Constants.maxAdaptedLuminance);
+    float exposure = g_Constants.exposureScale / adaptedLuminance;
+
+#if ENABLE_FXAA
+    s_Exposure = exposure;
+    float3 color = ApplyFXAA(uv, g_Constants.invTextureSize);
+#else
+    float3 color = SampleLdr(uv, exposure);
+#endif
+
+    // The window framebuffer is sRGB and encodes the linear result
+    o_color = float4(color, 1.0);
+}
@@ -0,0 +1,94 @@
+// Single-pass cascaded shadow map rendering: every caster is drawn once, instanced over the cascades that
+// it intersects, and each instance is routed to the array slice of its cascade by the vertex shader.
+// The vertices are fetched from the bindless tables of the Donut scene.
+
+#pragma pack_matrix(row_major)
+
+#include <donut/shaders/bindless.h>
+#include <donut/shaders/material_cb.h>
+
+#ifndef ALPHA_TESTED
+#define ALPHA_TESTED 0
+#endif
+
+#if defined(SPIRV) || defined(TARGET_VULKAN)
+#define PUSH_CONSTANT [[vk::push_constant]]
+#else
+#define PUSH_CONSTANT
+#endif
+
+#define MAX_CASCADES 4
+
+struct ShadowDrawConstants
+{
+    uint instanceIndex;
+    uint geometryIndex;
+    // Bit i is set when the caster is drawn into cascade i
+    uint cascadeMask;
+    uint padding;
+};
+
+struct ShadowCascadeConstants
+{
+    float4x4 matWorldToClip[MAX_CASCADES];
+};
+
+PUSH_CONSTANT ConstantBuffer<ShadowDrawConstants> g_Draw : register(b0);
+ConstantBuffer<ShadowCascadeConstants> g_Cascades : register(b1);
+
+StructuredBuffer<InstanceData> t_InstanceData : register(t0);
+StructuredBuffer<GeometryData> t_GeometryData : register(t1);
+StructuredBuffer<MaterialConstants> t_MaterialConstants : register(t2);
+SamplerState s_MaterialSampler : register(s0);
+
+ByteAddressBuffer t_BindlessBuffers[] : register(t0, space1);
+Texture2D t_BindlessTextures[] : register(t0, space2);
+
+static const uint c_SizeOfIndex = 4;
+static const uint c_SizeOfPosition = 12;
+static const uint c_SizeOfTexcoord = 8;
+
+void main_vs(
+    in uint i_vertexID : SV_VertexID,
+    in uint i_instanceID : SV_InstanceID,
+    out float4 o_position : SV_Position,
+    out float2 o_texCoord : TEXCOORD,
+    out uint o_arraySlice : SV_RenderTargetArrayIndex)
+{
+    // Instance n goes to the cascade of the n-th set bit of the mask
+    uint cascadeMask = g_Draw.cascadeMask;
+    for (uint i = 0; i < i_instanceID; i++)
+        cascadeMask &= cascadeMask - 1;
+    uint cascade = firstbitlow(cascadeMask);
+
+    InstanceData instance = t_InstanceData[g_Draw.instanceIndex];
+    GeometryData geometry = t_GeometryData[instance.firstGeometryIndex + g_Draw.geometryIndex];
+
+    ByteAddressBuffer indexBuffer = t_BindlessBuffers[NonUniformResourceIndex(geometry.indexBufferIndex)];
+    ByteAddressBuffer vertexBuffer = t_BindlessBuffers[NonUniformResourceIndex(geometry.vertexBufferIndex)];
+
+    uint index = indexBuffer.Load((geometry.indexOffset + i_vertexID) * c_SizeOfIndex);
+    float3 position = asfloat(vertexBuffer.Load3(geometry.positionOffset + index * c_SizeOfPosition));
+    float3 worldPosition = mul(instance.transform, float4(position, 1.0)).xyz;
+
+    o_position = mul(float4(worldPosition, 1.0), g_Cascades.matWorldToClip[cascade]);
+    o_texCoord = (ALPHA_TESTED && geometry.texCoord1Offset != ~0u)
+        ? asfloat(vertexBuffer.Load2(geometry.texCoord1Offset + index * c_SizeOfTexcoord))
+        : 0.0;
+    o_arraySlice = cascade;
+}
+
+void main_ps(
+    in float4 i_position : SV_Position,
+    in float2 i_texCoord : TEXCOORD)
+{
+    InstanceData instance = t_InstanceData[g_Draw.instanceIndex];
+    GeometryData geometry = t_GeometryData[instance.firstGeometryIndex + g_Draw.geometryIndex];
+    MaterialConstants material = t_MaterialConstants[geometry.materialIndex];
+
+    float opacity = material.opacity;
+    if ((material.flags & MaterialFlags_UseBaseOrDiffuseTexture) != 0 && material.baseOrDiffuseTextureIndex >= 0)
+        opacity *= t_BindlessTextures[NonUniformResourceIndex(material.baseOrDiffuseTextureIndex)].Sample(s_MaterialSampler, i_texCoord).a;
+
+    clip(opacity - material.alphaCutoff);
+}
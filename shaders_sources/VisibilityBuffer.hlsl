@@ -0,0 +1,339 @@
+// Visibility buffer rendering: the opaque geometry is rasterized into depth and a packed instance/triangle ID
+// only, and the materials are evaluated afterwards in compute, once per visible pixel, with the pixels binned
+// by material so that every shading dispatch reads the constants and textures of a single material.
+// The scene data comes from the bindless tables of the Donut scene.
+//
+// Visibility texel: x = instance index + 1 (0 where nothing was drawn), y = geometry index << 24 | triangle index
+
+#pragma pack_matrix(row_major)
+
+#include <donut/shaders/bindless.h>
+#include <donut/shaders/view_cb.h>
+#include <donut/shaders/material_cb.h>
+#include <donut/shaders/scene_material.hlsli>
+#include <donut/shaders/packing.hlsli>
+
+#ifndef ALPHA_TESTED
+#define ALPHA_TESTED 0
+#endif
+
+#if defined(SPIRV) || defined(TARGET_VULKAN)
+#define PUSH_CONSTANT [[vk::push_constant]]
+#else
+#define PUSH_CONSTANT
+#endif
+
+// Shared by the raster and the compute entry points
+struct VisibilityConstants
+{
+    uint instanceIndex;
+    uint geometryIndex;
+    uint materialIndex;
+    uint materialCount;
+    uint2 viewOrigin;
+    uint2 viewSize;
+};
+
+struct VisibilityViewConstants
+{
+    PlanarViewConstants view;
+};
+
+PUSH_CONSTANT ConstantBuffer<VisibilityConstants> g_Constants : register(b0);
+ConstantBuffer<VisibilityViewConstants> g_View : register(b1);
+
+StructuredBuffer<InstanceData> t_InstanceData : register(t0);
+StructuredBuffer<GeometryData> t_GeometryData : register(t1);
+StructuredBuffer<MaterialConstants> t_MaterialConstants : register(t2);
+Texture2D<uint2> t_Visibility : register(t3);
+SamplerState s_MaterialSampler : register(s0);
+
+// Bin per material: x = pixel count, y = offset into the pixel list, z = pixels written by the scatter pass,
+// w = first resolve group
+RWStructuredBuffer<uint4> u_Bins : register(u0);
+RWByteAddressBuffer u_DispatchArgs : register(u1);
+RWStructuredBuffer<uint> u_PixelList : register(u2);
+RWTexture2D<float4> u_Diffuse : register(u3);
+RWTexture2D<float4> u_Specular : register(u4);
+RWTexture2D<float4> u_Normals : register(u5);
+RWTexture2D<float4> u_Emissive : register(u6);
+
+ByteAddressBuffer t_BindlessBuffers[] : register(t0, space1);
+Texture2D t_BindlessTextures[] : register(t0, space2);
+
+static const uint c_SizeOfIndex = 4;
+static const uint c_SizeOfPosition = 12;
+static const uint c_SizeOfTexcoord = 8;
+static const uint c_SizeOfNormal = 4;
+static const uint c_ResolveGroupSize = 64;
+// The resolve groups are dispatched in rows of this many, to stay under the dispatch limit on large views
+static const uint c_ResolveGroupsPerRow = 65535;
+
+// ---- Raster ----
+
+void main_vs(
+    in uint i_vertexID : SV_VertexID,
+    out float4 o_position : SV_Position,
+    out float2 o_texCoord : TEXCOORD)
+{
+    InstanceData instance = t_InstanceData[g_Constants.instanceIndex];
+    GeometryData geometry = t_GeometryData[instance.firstGeometryIndex + g_Constants.geometryIndex];
+
+    ByteAddressBuffer indexBuffer = t_BindlessBuffers[NonUniformResourceIndex(geometry.indexBufferIndex)];
+    ByteAddressBuffer vertexBuffer = t_BindlessBuffers[NonUniformResourceIndex(geometry.vertexBufferIndex)];
+
+    uint index = indexBuffer.Load((geometry.indexOffset + i_vertexID) * c_SizeOfIndex);
+    float3 position = asfloat(vertexBuffer.Load3(geometry.positionOffset + index * c_SizeOfPosition));
+    float3 worldPosition = mul(instance.transform, float4(position, 1.0)).xyz;
+
+    o_position = mul(float4(worldPosition, 1.0), g_View.view.matWorldToClip);
+    o_texCoord = geometry.texCoord1Offset != ~0u
+        ? asfloat(vertexBuffer.Load2(geometry.texCoord1Offset + index * c_SizeOfTexcoord))
+        : 0.0;
+}
+
+void main_ps(
+    in float4 i_position : SV_Position,
+    in float2 i_texCoord : TEXCOORD,
+    in uint i_primitiveID : SV_PrimitiveID,
+    out uint2 o_visibility : SV_Target0)
+{
+#if ALPHA_TESTED
+    InstanceData instance = t_InstanceData[g_Constants.instanceIndex];
+    GeometryData geometry = t_GeometryData[instance.firstGeometryIndex + g_Constants.geometryIndex];
+    MaterialConstants material = t_MaterialConstants[geometry.materialIndex];
+
+    float opacity = material.opacity;
+    if ((material.flags & MaterialFlags_UseBaseOrDiffuseTexture) != 0 && material.baseOrDiffuseTextureIndex >= 0)
+        opacity *= t_BindlessTextures[NonUniformResourceIndex(material.baseOrDiffuseTextureIndex)].Sample(s_MaterialSampler, i_texCoord).a;
+
+    clip(opacity - material.alphaCutoff);
+#endif
+
+    o_visibility = uint2(g_Constants.instanceIndex + 1, (g_Constants.geometryIndex << 24) | i_primitiveID);
+}
+
+// ---- Material binning ----
+
+bool LoadVisibility(uint2 pixel, out uint instanceIndex, out uint geometryIndex, out uint triangleIndex)
+{
+    uint2 visibility = t_Visibility[pixel];
+    instanceIndex = visibility.x - 1;
+    geometryIndex = visibility.y >> 24;
+    triangleIndex = visibility.y & 0xffffff;
+    return visibility.x != 0;
+}
+
+uint GetMaterialIndex(uint instanceIndex, uint geometryIndex)
+{
+    InstanceData instance = t_InstanceData[instanceIndex];
+    return t_GeometryData[instance.firstGeometryIndex + geometryIndex].materialIndex;
+}
+
+[numthreads(8, 8, 1)]
+void count_cs(uint2 globalIdx : SV_DispatchThreadID)
+{
+    if (any(globalIdx >= g_Constants.viewSize))
+        return;
+
+    uint instanceIndex, geometryIndex, triangleIndex;
+    if (!LoadVisibility(g_Constants.viewOrigin + globalIdx, instanceIndex, geometryIndex, triangleIndex))
+        return;
+
+    InterlockedAdd(u_Bins[GetMaterialIndex(instanceIndex, geometryIndex)].x, 1);
+}
+
+// Scenes have a few hundred materials at most, a serial prefix sum over them is cheaper than another dispatch.
+// Every material gets whole resolve groups, so that a group shades a single material, and the materials
+// that are not visible get none.
+[numthreads(1, 1, 1)]
+void offsets_cs()
+{
+    uint offset = 0;
+    uint groups = 0;
+    for (uint material = 0; material < g_Constants.materialCount; material++)
+    {
+        uint count = u_Bins[material].x;
+        u_Bins[material] = uint4(count, offset, 0, groups);
+        offset += count;
+        groups += (count + c_ResolveGroupSize - 1) / c_ResolveGroupSize;
+    }
+
+    uint rows = (groups + c_ResolveGroupsPerRow - 1) / c_ResolveGroupsPerRow;
+    u_DispatchArgs.Store3(0, uint3(min(groups, c_ResolveGroupsPerRow), rows, 1));
+}
+
+[numthreads(8, 8, 1)]
+void scatter_cs(uint2 globalIdx : SV_DispatchThreadID)
+{
+    if (any(globalIdx >= g_Constants.viewSize))
+        return;
+
+    uint2 pixel = g_Constants.viewOrigin + globalIdx;
+    uint instanceIndex, geometryIndex, triangleIndex;
+    if (!LoadVisibility(pixel, instanceIndex, geometryIndex, triangleIndex))
+        return;
+
+    uint material = GetMaterialIndex(instanceIndex, geometryIndex);
+    uint slot;
+    InterlockedAdd(u_Bins[material].z, 1, slot);
+    u_PixelList[u_Bins[material].y + slot] = pixel.x | (pixel.y << 16);
+}
+
+// ---- Material resolve ----
+
+// Barycentrics of the point where the ray crosses the plane of the triangle
+float3 GetBarycentrics(float3 rayOrigin, float3 rayDirection, float3 p0, float3 p1, float3 p2)
+{
+    float3 edge1 = p1 - p0;
+    float3 edge2 = p2 - p0;
+    float3 pv = cross(rayDirection, edge2);
+    float invDeterminant = 1.0 / dot(edge1, pv);
+    float3 tv = rayOrigin - p0;
+    float u = dot(tv, pv) * invDeterminant;
+    float v = dot(rayDirection, cross(tv, edge1)) * invDeterminant;
+    return float3(1.0 - u - v, u, v);
+}
+
+// Direction of the ray through a point of the render target, with the same jitter as the rasterization
+float3 GetRayDirection(float2 pixelPosition, float3 cameraPosition)
+{
+    float2 clipPosition = (pixelPosition - g_View.view.viewportOrigin) * g_View.view.viewportSizeInv * float2(2.0, -2.0) + float2(-1.0, 1.0);
+    float4 worldPosition = mul(float4(clipPosition, 0.5, 1.0), g_View.view.matClipToWorld);
+    return normalize(worldPosition.xyz / worldPosition.w - cameraPosition);
+}
+
+// The diffuse and specular targets are sRGB textures written through UNORM views
+float3 LinearToSrgb(float3 color)
+{
+    float3 high = 1.055 * pow(abs(color), 1.0 / 2.4) - 0.055;
+    return lerp(high, color * 12.92, step(color, 0.0031308));
+}
+
+float4 SampleMaterialTexture(int textureIndex, float2 texCoord, float2 texCoordDdx, float2 texCoordDdy)
+{
+    return t_BindlessTextures[NonUniformResourceIndex(textureIndex)].SampleGrad(s_MaterialSampler, texCoord, texCoordDdx, texCoordDdy);
+}
+
+// The last material whose first group is not after the group. Empty bins share their first group with the
+// next material, so they are never found.
+uint FindResolveMaterial(uint group)
+{
+    uint first = 0;
+    uint last = g_Constants.materialCount - 1;
+    while (first < last)
+    {
+        uint middle = (first + last + 1) / 2;
+        if (u_Bins[middle].w <= group)
+            first = middle;
+        else
+            last = middle - 1;
+    }
+    return first;
+}
+
+[numthreads(c_ResolveGroupSize, 1, 1)]
+void resolve_cs(uint2 groupIdx : SV_GroupID, uint threadIdx : SV_GroupThreadID)
+{
+    uint group = groupIdx.y * c_ResolveGroupsPerRow + groupIdx.x;
+    uint materialIndex = FindResolveMaterial(group);
+    uint4 bin = u_Bins[materialIndex];
+
+    uint binIndex = (group - bin.w) * c_ResolveGroupSize + threadIdx;
+    if (binIndex >= bin.x)
+        return;
+
+    uint packedPixel = u_PixelList[bin.y + binIndex];
+    uint2 pixel = uint2(packedPixel & 0xffff, packedPixel >> 16);
+
+    uint instanceIndex, geometryIndex, triangleIndex;
+    LoadVisibility(pixel, instanceIndex, geometryIndex, triangleIndex);
+
+    InstanceData instance = t_InstanceData[instanceIndex];
+    GeometryData geometry = t_GeometryData[instance.firstGeometryIndex + geometryIndex];
+    MaterialConstants material = t_MaterialConstants[materialIndex];
+
+    ByteAddressBuffer indexBuffer = t_BindlessBuffers[NonUniformResourceIndex(geometry.indexBufferIndex)];
+    ByteAddressBuffer vertexBuffer = t_BindlessBuffers[NonUniformResourceIndex(geometry.vertexBufferIndex)];
+
+    uint3 indices = indexBuffer.Load3((geometry.indexOffset + triangleIndex * 3) * c_SizeOfIndex);
+
+    float3 positions[3];
+    [unroll]
+    for (uint i = 0; i < 3; i++)
+    {
+        float3 position = asfloat(vertexBuffer.Load3(geometry.positionOffset + indices[i] * c_SizeOfPosition));
+        positions[i] = mul(instance.transform, float4(position, 1.0)).xyz;
+    }
+
+    // The neighbouring pixels give the screen space derivatives of the attributes for texture filtering
+    float3 cameraPosition = g_View.view.matViewToWorld[3].xyz;
+    float2 pixelCenter = float2(pixel) + 0.5;
+    float3 barycentrics = GetBarycentrics(cameraPosition, GetRayDirection(pixelCenter, cameraPosition), positions[0], positions[1], positions[2]);
+    float3 barycentricsDx = GetBarycentrics(cameraPosition, GetRayDirection(pixelCenter + float2(1, 0), cameraPosition), positions[0], positions[1], positions[2]);
+    float3 barycentricsDy = GetBarycentrics(cameraPosition, GetRayDirection(pixelCenter + float2(0, 1), cameraPosition), positions[0], positions[1], positions[2]);
+
+    float2 texCoord = 0.0;
+    float2 texCoordDdx = 0.0;
+    float2 texCoordDdy = 0.0;
+    if (geometry.texCoord1Offset != ~0u)
+    {
+        float2 texCoords[3];
+        [unroll]
+        for (uint i = 0; i < 3; i++)
+            texCoords[i] = asfloat(vertexBuffer.Load2(geometry.texCoord1Offset + indices[i] * c_SizeOfTexcoord));
+
+        texCoord = texCoords[0] * barycentrics.x + texCoords[1] * barycentrics.y + texCoords[2] * barycentrics.z;
+        texCoordDdx = texCoords[0] * barycentricsDx.x + texCoords[1] * barycentricsDx.y + texCoords[2] * barycentricsDx.z - texCoord;
+        texCoordDdy = texCoords[0] * barycentricsDy.x + texCoords[1] * barycentricsDy.y + texCoords[2] * barycentricsDy.z - texCoord;
+    }
+
+    float3 geometryNormal = normalize(cross(positions[1] - positions[0], positions[2] - positions[0]));
+    float3 normal = geometryNormal;
+    float4 tangent = 0.0;
+    if (geometry.normalOffset != ~0u)
+    {
+        float3 normals[3];
+        [unroll]
+        for (uint i = 0; i < 3; i++)
+            normals[i] = Unpack_RGB8_SNORM(vertexBuffer.Load(geometry.normalOffset + indices[i] * c_SizeOfNormal));
+
+        normal = normals[0] * barycentrics.x + normals[1] * barycentrics.y + normals[2] * barycentrics.z;
+        normal = normalize(mul(instance.transform, float4(normal, 0.0)).xyz);
+    }
+    if (geometry.tangentOffset != ~0u)
+    {
+        float4 tangents[3];
+        [unroll]
+        for (uint i = 0; i < 3; i++)
+            tangents[i] = Unpack_RGBA8_SNORM(vertexBuffer.Load(geometry.tangentOffset + indices[i] * c_SizeOfNormal));
+
+        tangent.xyz = tangents[0].xyz * barycentrics.x + tangents[1].xyz * barycentrics.y + tangents[2].xyz * barycentrics.z;
+        tangent.xyz = normalize(mul(instance.transform, float4(tangent.xyz, 0.0)).xyz);
+        tangent.w = tangents[0].w;
+    }
+
+    // Back faces of double sided materials are shaded with the normal facing the camera, like in the GBuffer fill
+    if (dot(geometryNormal, cameraPosition - positions[0]) < 0.0)
+        normal = -normal;
+
+    MaterialTextureSample textures = DefaultMaterialTextures();
+    if ((material.flags & MaterialFlags_UseBaseOrDiffuseTexture) != 0 && material.baseOrDiffuseTextureIndex >= 0)
+        textures.baseOrDiffuse = SampleMaterialTexture(material.baseOrDiffuseTextureIndex, texCoord, texCoordDdx, texCoordDdy);
+    if ((material.flags & MaterialFlags_UseMetalRoughOrSpecularTexture) != 0 && material.metalRoughOrSpecularTextureIndex >= 0)
+        textures.metalRoughOrSpecular = SampleMaterialTexture(material.metalRoughOrSpecularTextureIndex, texCoord, texCoordDdx, texCoordDdy);
+    if ((material.flags & MaterialFlags_UseNormalTexture) != 0 && material.normalTextureIndex >= 0)
+        textures.normal = SampleMaterialTexture(material.normalTextureIndex, texCoord, texCoordDdx, texCoordDdy);
+    if ((material.flags & MaterialFlags_UseEmissiveTexture) != 0 && material.emissiveTextureIndex >= 0)
+        textures.emissive = SampleMaterialTexture(material.emissiveTextureIndex, texCoord, texCoordDdx, texCoordDdy);
+    if ((material.flags & MaterialFlags_UseOcclusionTexture) != 0 && material.occlusionTextureIndex >= 0)
+        textures.occlusion = SampleMaterialTexture(material.occlusionTextureIndex, texCoord, texCoordDdx, texCoordDdy);
+
+    MaterialSample surface = EvaluateSceneMaterial(normal, tangent, material, textures);
+
+    // Same channels and encoding as the Donut GBuffer, read by DeferredLightingPass
+    u_Diffuse[pixel] = float4(LinearToSrgb(surface.diffuseAlbedo), surface.opacity);
+    u_Specular[pixel] = float4(LinearToSrgb(surface.specularF0), surface.occlusion);
+    u_Normals[pixel] = float4(surface.shadingNormal, surface.roughness);
+    u_Emissive[pixel] = float4(surface.emissiveColor, 0.0);
+}
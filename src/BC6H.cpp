@@ -0,0 +1,199 @@
+#include "BC6H.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Interpolation weights of 4-bit indices, out of 64
+static constexpr int c_Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+static constexpr int c_EndpointBits = 10;
+static constexpr int c_MaxEndpoint = (1 << c_EndpointBits) - 1;
+static constexpr int c_MaxHalf = 0x7bff;
+
+static int ClampHalf(uint16_t half)
+{
+    // Sign bit set, i.e. negative values and negative zero
+    if (half & 0x8000)
+        return 0;
+    // Infinities and NaNs
+    return std::min(int(half), c_MaxHalf);
+}
+
+// The value that the decoder produces for an endpoint before interpolation, in half bit patterns scaled
+// by 64/31 like the decoder keeps them
+static int UnquantizeEndpoint(int endpoint)
+{
+    if (endpoint == 0)
+        return 0;
+    if (endpoint == c_MaxEndpoint)
+        return 0xffff;
+    return ((endpoint << 16) + 0x8000) >> c_EndpointBits;
+}
+
+static int QuantizeEndpoint(float half)
+{
+    // Inverse of FinishUnquantize(UnquantizeEndpoint(e)) = e * 31 + 15 between the extremes
+    return std::clamp(int(std::lround((half - 15.f) / 31.f)), 0, c_MaxEndpoint);
+}
+
+static int FinishUnquantize(int value)
+{
+    return (value * 31) >> 6;
+}
+
+static int Interpolate(int a, int b, int index)
+{
+    int weight = c_Weights[index];
+    return FinishUnquantize((a * (64 - weight) + b * weight + 32) >> 6);
+}
+
+class BitWriter
+{
+public:
+    explicit BitWriter(uint8_t* block)
+        : m_Block(block)
+    {
+        memset(m_Block, 0, c_BC6HBlockSize);
+    }
+
+    void Write(uint32_t value, int bits)
+    {
+        for (int i = 0; i < bits; i++, m_Position++)
+        {
+            if (value & (1u << i))
+                m_Block[m_Position >> 3] |= uint8_t(1u << (m_Position & 7));
+        }
+    }
+
+private:
+    uint8_t* m_Block;
+    int m_Position = 0;
+};
+
+void EncodeBC6HBlock(const uint16_t texels[16][3], uint8_t* block)
+{
+    float values[16][3];
+    float mins[3] = { float(c_MaxHalf), float(c_MaxHalf), float(c_MaxHalf) };
+    float maxs[3] = { 0.f, 0.f, 0.f };
+    float means[3] = { 0.f, 0.f, 0.f };
+
+    for (int i = 0; i < 16; i++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            values[i][c] = float(ClampHalf(texels[i][c]));
+            mins[c] = std::min(mins[c], values[i][c]);
+            maxs[c] = std::max(maxs[c], values[i][c]);
+            means[c] += values[i][c] / 16.f;
+        }
+    }
+
+    // The bounding box diagonal runs from min to max in the channel with the widest range; the other
+    // channels are flipped when they fall while that channel rises
+    int mainChannel = 0;
+    for (int c = 1; c < 3; c++)
+    {
+        if (maxs[c] - mins[c] > maxs[mainChannel] - mins[mainChannel])
+            mainChannel = c;
+    }
+
+    float endpoints[2][3];
+    for (int c = 0; c < 3; c++)
+    {
+        float covariance = 0.f;
+        for (int i = 0; i < 16; i++)
+            covariance += (values[i][c] - means[c]) * (values[i][mainChannel] - means[mainChannel]);
+
+        endpoints[0][c] = covariance < 0.f ? maxs[c] : mins[c];
+        endpoints[1][c] = covariance < 0.f ? mins[c] : maxs[c];
+    }
+
+    int quantized[2][3];
+    int unquantized[2][3];
+    for (int e = 0; e < 2; e++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            quantized[e][c] = QuantizeEndpoint(endpoints[e][c]);
+            unquantized[e][c] = UnquantizeEndpoint(quantized[e][c]);
+        }
+    }
+
+    // Every texel takes the index whose decoded color is closest
+    int indices[16];
+    for (int i = 0; i < 16; i++)
+    {
+        float bestError = INFINITY;
+        for (int index = 0; index < 16; index++)
+        {
+            float error = 0.f;
+            for (int c = 0; c < 3; c++)
+            {
+                float difference = float(Interpolate(unquantized[0][c], unquantized[1][c], index)) - values[i][c];
+                error += difference * difference;
+            }
+
+            if (error < bestError)
+            {
+                bestError = error;
+                indices[i] = index;
+            }
+        }
+    }
+
+    // The most significant index bit of the first texel is implied to be zero; the weights are symmetric,
+    // so swapping the endpoints and mirroring the indices decodes to the same colors
+    if (indices[0] >= 8)
+    {
+        std::swap(quantized[0], quantized[1]);
+        for (int& index : indices)
+            index = 15 - index;
+    }
+
+    BitWriter writer(block);
+    writer.Write(0x03, 5);
+    for (int e = 0; e < 2; e++)
+    {
+        for (int c = 0; c < 3; c++)
+            writer.Write(uint32_t(quantized[e][c]), c_EndpointBits);
+    }
+
+    writer.Write(uint32_t(indices[0]), 3);
+    for (int i = 1; i < 16; i++)
+        writer.Write(uint32_t(indices[i]), 4);
+}
+
+size_t GetBC6HRowPitch(uint32_t width)
+{
+    return size_t((width + 3) / 4) * c_BC6HBlockSize;
+}
+
+size_t GetBC6HSize(uint32_t width, uint32_t height)
+{
+    return GetBC6HRowPitch(width) * ((height + 3) / 4);
+}
+
+void CompressBC6H(const void* rgbaHalf, size_t rowPitch, uint32_t width, uint32_t height, uint8_t* blocks)
+{
+    const uint8_t* source = static_cast<const uint8_t*>(rgbaHalf);
+    uint32_t blocksWide = (width + 3) / 4;
+    uint32_t blocksHigh = (height + 3) / 4;
+
+    for (uint32_t blockY = 0; blockY < blocksHigh; blockY++)
+    {
+        for (uint32_t blockX = 0; blockX < blocksWide; blockX++)
+        {
+            uint16_t texels[16][3];
+            for (uint32_t i = 0; i < 16; i++)
+            {
+                uint32_t x = std::min(blockX * 4 + i % 4, width - 1);
+                uint32_t y = std::min(blockY * 4 + i / 4, height - 1);
+                const uint8_t* texel = source + y * rowPitch + x * 4 * sizeof(uint16_t);
+                memcpy(texels[i], texel, sizeof(texels[i]));
+            }
+
+            EncodeBC6HBlock(texels, blocks + (size_t(blockY) * blocksWide + blockX) * c_BC6HBlockSize);
+        }
+    }
+}
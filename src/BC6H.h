@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// BC6H_UFLOAT block compression on the CPU, for HDR data that is rendered once and kept, like light probes.
+// Every block is written in mode 11: one region with two 10-bit endpoints and 4-bit indices. The endpoints
+// and indices are fitted in the space of the half float bit patterns, in which the BC6H interpolation is done.
+// Negative inputs are stored as zero, infinities and NaNs as the largest half.
+
+static constexpr size_t c_BC6HBlockSize = 16;
+
+// Compresses 16 texels, given as RGB halves in row-major order
+void EncodeBC6HBlock(const uint16_t texels[16][3], uint8_t* block);
+
+// Compresses an RGBA16_FLOAT image. The blocks are written row after row, GetBC6HRowPitch bytes per row;
+// blocks on the right and bottom edges of sizes that are not multiples of 4 repeat the last texels.
+void CompressBC6H(const void* rgbaHalf, size_t rowPitch, uint32_t width, uint32_t height, uint8_t* blocks);
+
+[[nodiscard]] size_t GetBC6HRowPitch(uint32_t width);
+[[nodiscard]] size_t GetBC6HSize(uint32_t width, uint32_t height);
@@ -0,0 +1,92 @@
+#include "BatchedTextureCache.h"
+#include "LoadProfiler.h"
+
+#include <donut/core/log.h>
+#include <donut/core/vfs/VFS.h>
+#include <donut/engine/CommonRenderPasses.h>
+#include <chrono>
+#include <vector>
+
+using namespace donut;
+using namespace donut::engine;
+
+BatchedTextureCache::BatchedTextureCache(nvrhi::IDevice* device,
+    std::shared_ptr<vfs::IFileSystem> fs,
+    std::shared_ptr<DescriptorTableManager> descriptorTable)
+    : TextureCache(device, std::move(fs), std::move(descriptorTable))
+{
+    // Large chunks so that a whole batch fits in a handful of staging allocations
+    m_UploadCommandList = device->createCommandList(nvrhi::CommandListParameters()
+        .setUploadChunkSize(16 * 1024 * 1024));
+}
+
+bool BatchedTextureCache::ProcessPendingUploads(CommonRenderPasses& passes, float timeLimitMilliseconds)
+{
+    using namespace std::chrono;
+    auto startTime = high_resolution_clock::now();
+    bool anyUploaded = false;
+
+    while (true)
+    {
+        std::vector<std::shared_ptr<TextureData>> batch;
+        uint64_t batchBytes = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_TexturesToFinalizeMutex);
+
+            while (!m_TexturesToFinalize.empty() && batchBytes < c_MaxBatchBytes)
+            {
+                std::shared_ptr<TextureData> texture = m_TexturesToFinalize.front();
+                m_TexturesToFinalize.pop();
+
+                if (texture->data)
+                {
+                    batchBytes += texture->data->size();
+                    batch.push_back(std::move(texture));
+                }
+            }
+        }
+
+        if (batch.empty())
+            break;
+
+        {
+            LoadProfiler::Scope batchScope(LoadProfiler::c_StageCategory, "texture upload");
+
+            m_UploadCommandList->open();
+            for (const auto& texture : batch)
+            {
+                LoadProfiler::Scope scope("upload", texture->path);
+                FinalizeTexture(texture, &passes, m_UploadCommandList);
+            }
+            m_UploadCommandList->close();
+            m_Device->executeCommandList(m_UploadCommandList);
+        }
+
+        m_UploadedTextures += uint32_t(batch.size());
+        m_UploadedBytes += batchBytes;
+        m_UploadBatches++;
+        anyUploaded = true;
+
+        if (timeLimitMilliseconds > 0.f &&
+            duration<float, std::milli>(high_resolution_clock::now() - startTime).count() > timeLimitMilliseconds)
+            break;
+    }
+
+    if (anyUploaded)
+    {
+        m_Device->runGarbageCollection();
+        m_UploadMilliseconds += duration<double, std::milli>(high_resolution_clock::now() - startTime).count();
+    }
+    else if (m_UploadedTextures != 0)
+    {
+        log::info("Texture upload: %u textures, %.1f MB in %u command lists, %.1f ms on the render thread",
+            m_UploadedTextures, double(m_UploadedBytes) / (1024.0 * 1024.0), m_UploadBatches, m_UploadMilliseconds);
+
+        m_UploadedTextures = 0;
+        m_UploadedBytes = 0;
+        m_UploadBatches = 0;
+        m_UploadMilliseconds = 0.0;
+    }
+
+    return anyUploaded;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <donut/engine/TextureCache.h>
+#include <nvrhi/nvrhi.h>
+#include <memory>
+
+namespace donut::engine
+{
+    class CommonRenderPasses;
+}
+
+// Texture cache that finalizes the textures decoded by the loading threads in a few large command lists
+// instead of one command list per texture. The same command list is reused for every batch, so its
+// upload chunks (the staging memory) are recycled once the GPU is done with them.
+class BatchedTextureCache : public donut::engine::TextureCache
+{
+public:
+    BatchedTextureCache(nvrhi::IDevice* device,
+        std::shared_ptr<donut::vfs::IFileSystem> fs,
+        std::shared_ptr<donut::engine::DescriptorTableManager> descriptorTable);
+
+    // Uploads pending textures in batches of up to c_MaxBatchBytes, until the queue is empty or the time
+    // limit is exceeded. A time limit of 0 drains the queue. Returns true if any texture was uploaded.
+    bool ProcessPendingUploads(donut::engine::CommonRenderPasses& passes, float timeLimitMilliseconds);
+
+    static constexpr uint64_t c_MaxBatchBytes = 64ull * 1024 * 1024;
+
+private:
+    nvrhi::CommandListHandle m_UploadCommandList;
+
+    // Totals for the current loading burst, logged when the queue runs empty
+    uint32_t m_UploadedTextures = 0;
+    uint32_t m_UploadBatches = 0;
+    uint64_t m_UploadedBytes = 0;
+    double m_UploadMilliseconds = 0.0;
+};
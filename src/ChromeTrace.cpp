@@ -0,0 +1,128 @@
+#include "ChromeTrace.h"
+
+#include <cstdio>
+#include <iomanip>
+#include <mutex>
+
+static std::mutex s_ThreadMutex;
+static std::vector<std::string> s_ThreadNames;
+static thread_local uint32_t t_ThreadIndex = ~0u;
+
+uint32_t ProfilerThreads::GetCurrentIndex()
+{
+    if (t_ThreadIndex == ~0u)
+    {
+        std::lock_guard lock(s_ThreadMutex);
+        t_ThreadIndex = uint32_t(s_ThreadNames.size());
+        s_ThreadNames.push_back("Thread " + std::to_string(t_ThreadIndex));
+    }
+    return t_ThreadIndex;
+}
+
+void ProfilerThreads::SetCurrentName(const char* name)
+{
+    uint32_t index = GetCurrentIndex();
+
+    std::lock_guard lock(s_ThreadMutex);
+    s_ThreadNames[index] = name;
+}
+
+std::vector<std::string> ProfilerThreads::GetNames()
+{
+    std::lock_guard lock(s_ThreadMutex);
+    return s_ThreadNames;
+}
+
+ChromeTraceWriter::ChromeTraceWriter(const std::filesystem::path& path)
+    : m_Stream(path, std::ios::trunc)
+{
+    m_Stream << std::fixed << std::setprecision(3);
+    m_Stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+}
+
+void ChromeTraceWriter::BeginEvent()
+{
+    m_Stream << (m_FirstEvent ? "\n" : ",\n");
+    m_FirstEvent = false;
+}
+
+void ChromeTraceWriter::WriteString(std::string_view s)
+{
+    m_Stream << '"';
+    for (char c : s)
+    {
+        switch (c)
+        {
+        case '"': m_Stream << "\\\""; break;
+        case '\\': m_Stream << "\\\\"; break;
+        case '\n': m_Stream << "\\n"; break;
+        case '\t': m_Stream << "\\t"; break;
+        default:
+            if (uint8_t(c) < 0x20)
+            {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                m_Stream << escaped;
+            }
+            else
+                m_Stream << c;
+        }
+    }
+    m_Stream << '"';
+}
+
+void ChromeTraceWriter::ProcessName(std::string_view name)
+{
+    BeginEvent();
+    m_Stream << "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":1,\"args\":{\"name\":";
+    WriteString(name);
+    m_Stream << "}}";
+}
+
+void ChromeTraceWriter::ThreadName(uint32_t thread, std::string_view name)
+{
+    BeginEvent();
+    m_Stream << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << thread << ",\"args\":{\"name\":";
+    WriteString(name);
+    m_Stream << "}}";
+}
+
+void ChromeTraceWriter::ProfilerThreadNames()
+{
+    std::vector<std::string> names = ProfilerThreads::GetNames();
+    for (size_t i = 0; i < names.size(); i++)
+        ThreadName(uint32_t(i), names[i]);
+}
+
+void ChromeTraceWriter::Complete(uint32_t thread, double startMicroseconds, double durationMicroseconds,
+    std::string_view name, std::string_view category, int64_t frame)
+{
+    BeginEvent();
+    m_Stream << "{\"ph\":\"X\",\"pid\":1,\"tid\":" << thread << ",\"ts\":" << startMicroseconds
+        << ",\"dur\":" << durationMicroseconds;
+    if (!category.empty())
+    {
+        m_Stream << ",\"cat\":";
+        WriteString(category);
+    }
+    m_Stream << ",\"name\":";
+    WriteString(name);
+    if (frame >= 0)
+        m_Stream << ",\"args\":{\"frame\":" << frame << "}";
+    m_Stream << "}";
+}
+
+void ChromeTraceWriter::Instant(double timeMicroseconds, std::string_view name)
+{
+    BeginEvent();
+    m_Stream << "{\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":0,\"ts\":" << timeMicroseconds << ",\"name\":";
+    WriteString(name);
+    m_Stream << "}";
+}
+
+bool ChromeTraceWriter::Close()
+{
+    m_Stream << "\n]}\n";
+    m_Stream.close();
+    return !m_Stream.fail();
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Thread indices and names shared by the profilers, so that a thread has the same tid and name in the scene
+// load trace and the CPU frame trace. A thread gets its index the first time it asks for it.
+class ProfilerThreads
+{
+public:
+    [[nodiscard]] static uint32_t GetCurrentIndex();
+    static void SetCurrentName(const char* name);
+    // Indexed by thread index
+    [[nodiscard]] static std::vector<std::string> GetNames();
+};
+
+// Writes a trace in the Chrome trace event format (chrome://tracing or ui.perfetto.dev). Times are in
+// microseconds; names are escaped, so they may come from data like file names.
+class ChromeTraceWriter
+{
+public:
+    explicit ChromeTraceWriter(const std::filesystem::path& path);
+
+    [[nodiscard]] bool IsOpen() const { return bool(m_Stream); }
+
+    void ProcessName(std::string_view name);
+    void ThreadName(uint32_t thread, std::string_view name);
+    // Names every thread known to ProfilerThreads
+    void ProfilerThreadNames();
+
+    // A scope; frame is added as an argument when it is not negative
+    void Complete(uint32_t thread, double startMicroseconds, double durationMicroseconds, std::string_view name,
+        std::string_view category = {}, int64_t frame = -1);
+    // A marker across all threads
+    void Instant(double timeMicroseconds, std::string_view name);
+
+    // Ends the event list; returns false when anything could not be written
+    bool Close();
+
+private:
+    void BeginEvent();
+    void WriteString(std::string_view s);
+
+    std::ofstream m_Stream;
+    bool m_FirstEvent = true;
+};
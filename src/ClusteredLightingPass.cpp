@@ -0,0 +1,291 @@
+#include "ClusteredLightingPass.h"
+
+#include <donut/shaders/view_cb.h>
+#include <donut/shaders/light_cb.h>
+#include <nvrhi/utils.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace donut::render;
+using namespace donut::engine;
+using namespace donut::math;
+
+// Matches ClusteredLightingConstants in ClusteredLighting.hlsl
+struct ClusteredLightingConstants
+{
+    PlanarViewConstants view;
+
+    uint2 viewOrigin;
+    uint2 viewSize;
+    uint3 clusterCount;
+    uint32_t lightCount;
+    float clusterNear;
+    float sliceScale;
+    float skyDepth;
+    uint32_t padding;
+};
+
+// Depth range of the slices; nearer pixels fall into the first slice and farther ones into the last
+static constexpr float c_ClusterNear = 0.1f;
+static constexpr float c_ClusterFar = 1000.f;
+
+static constexpr uint32_t c_ClusterStride = ClusteredLightingPass::c_MaxLightsPerCluster + 1;
+static constexpr uint32_t c_DispatchArgsSize = sizeof(uint32_t) * 3;
+// Shading groups are 8x8 pixels
+static constexpr uint32_t c_GroupsPerTile = (ClusteredLightingPass::c_TileSize / 8) * (ClusteredLightingPass::c_TileSize / 8);
+
+ClusteredLightingPass::ClusteredLightingPass(nvrhi::IDevice* device, const std::shared_ptr<ShaderFactory>& shaderFactory)
+    : m_Device(device)
+    , m_BindingCache(device)
+{
+    m_Constants = device->createBuffer(nvrhi::utils::CreateVolatileConstantBufferDesc(
+        sizeof(ClusteredLightingConstants), "ClusteredLighting Constants", 16));
+
+    nvrhi::BufferDesc bufferDesc;
+    bufferDesc.byteSize = sizeof(LightConstants) * c_MaxLights;
+    bufferDesc.structStride = sizeof(LightConstants);
+    bufferDesc.debugName = "ClusteredLighting Lights";
+    bufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+    bufferDesc.keepInitialState = true;
+    m_Lights = device->createBuffer(bufferDesc);
+
+    bufferDesc.byteSize = sizeof(float4) * c_MaxLights;
+    bufferDesc.structStride = sizeof(float4);
+    bufferDesc.debugName = "ClusteredLighting LightBounds";
+    m_LightBounds = device->createBuffer(bufferDesc);
+
+    bufferDesc = nvrhi::BufferDesc();
+    bufferDesc.byteSize = c_DispatchArgsSize;
+    bufferDesc.canHaveUAVs = true;
+    bufferDesc.canHaveRawViews = true;
+    bufferDesc.isDrawIndirectArgs = true;
+    bufferDesc.debugName = "ClusteredLighting DispatchArgs";
+    bufferDesc.initialState = nvrhi::ResourceStates::UnorderedAccess;
+    bufferDesc.keepInitialState = true;
+    m_DispatchArgs = device->createBuffer(bufferDesc);
+
+    nvrhi::BindingLayoutDesc layoutDesc;
+    layoutDesc.visibility = nvrhi::ShaderType::Compute;
+    layoutDesc.bindings = {
+        nvrhi::BindingLayoutItem::VolatileConstantBuffer(0),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(0),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(1),
+        nvrhi::BindingLayoutItem::Texture_SRV(2),
+        nvrhi::BindingLayoutItem::StructuredBuffer_UAV(0),
+        nvrhi::BindingLayoutItem::StructuredBuffer_UAV(1),
+        nvrhi::BindingLayoutItem::RawBuffer_UAV(2)
+    };
+    m_BuildBindingLayout = device->createBindingLayout(layoutDesc);
+
+    // The dispatch arguments are only bound while they are written, the shading reads them as indirect arguments
+    layoutDesc.bindings = {
+        nvrhi::BindingLayoutItem::VolatileConstantBuffer(0),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(0),
+        nvrhi::BindingLayoutItem::Texture_SRV(2),
+        nvrhi::BindingLayoutItem::Texture_SRV(3),
+        nvrhi::BindingLayoutItem::Texture_SRV(4),
+        nvrhi::BindingLayoutItem::Texture_SRV(5),
+        nvrhi::BindingLayoutItem::StructuredBuffer_UAV(0),
+        nvrhi::BindingLayoutItem::StructuredBuffer_UAV(1),
+        nvrhi::BindingLayoutItem::Texture_UAV(3)
+    };
+    m_ShadeBindingLayout = device->createBindingLayout(layoutDesc);
+
+    nvrhi::ComputePipelineDesc pipelineDesc;
+    pipelineDesc.bindingLayouts = { m_BuildBindingLayout };
+    pipelineDesc.CS = shaderFactory->CreateShader("ClusteredLighting.hlsl", "cluster_cs", nullptr, nvrhi::ShaderType::Compute);
+    m_ClusterPipeline = device->createComputePipeline(pipelineDesc);
+    pipelineDesc.CS = shaderFactory->CreateShader("ClusteredLighting.hlsl", "classify_cs", nullptr, nvrhi::ShaderType::Compute);
+    m_ClassifyPipeline = device->createComputePipeline(pipelineDesc);
+
+    pipelineDesc.bindingLayouts = { m_ShadeBindingLayout };
+    pipelineDesc.CS = shaderFactory->CreateShader("ClusteredLighting.hlsl", "shade_cs", nullptr, nvrhi::ShaderType::Compute);
+    m_ShadePipeline = device->createComputePipeline(pipelineDesc);
+}
+
+ClusteredLightingPass::~ClusteredLightingPass() = default;
+
+bool ClusteredLightingPass::IsClusteredLight(const Light& light)
+{
+    int lightType = light.GetLightType();
+    return (lightType == LightType_Point || lightType == LightType_Spot) && !light.shadowMap;
+}
+
+void ClusteredLightingPass::CullLights(const IView& view, const std::vector<std::shared_ptr<Light>>& lights,
+    std::vector<VisibleLight>& result)
+{
+    result.clear();
+
+    frustum viewFrustum = view.GetViewFrustum();
+    affine3 worldToView = view.GetViewMatrix();
+
+    for (const auto& light : lights)
+    {
+        if (!IsClusteredLight(*light))
+            continue;
+
+        float range = light->GetLightType() == LightType_Spot
+            ? static_cast<const SpotLight&>(*light).range
+            : static_cast<const PointLight&>(*light).range;
+
+        // A range of zero does not limit the light
+        float3 position = float3(light->GetPosition());
+        if (range > 0.f && !viewFrustum.intersectsWith(box3(position - range, position + range)))
+            continue;
+
+        float radius = range > 0.f ? range : std::numeric_limits<float>::max();
+        result.push_back({ light, float4(worldToView.transformPoint(position), radius) });
+    }
+
+    // Nearest first, so that the lights past a limit are the distant ones
+    std::sort(result.begin(), result.end(), [](const VisibleLight& a, const VisibleLight& b)
+    {
+        return lengthSquared(a.viewBounds.xyz()) < lengthSquared(b.viewBounds.xyz());
+    });
+}
+
+void ClusteredLightingPass::SelectForwardLights(const IView& view,
+    const std::vector<std::shared_ptr<Light>>& lights,
+    uint32_t maxLights,
+    std::vector<std::shared_ptr<Light>>& result)
+{
+    result.clear();
+    for (const auto& light : lights)
+    {
+        if (!IsClusteredLight(*light))
+            result.push_back(light);
+    }
+
+    std::vector<VisibleLight> visibleLights;
+    CullLights(view, lights, visibleLights);
+
+    for (const VisibleLight& visible : visibleLights)
+    {
+        if (result.size() >= maxLights)
+            break;
+
+        result.push_back(visible.light);
+    }
+}
+
+void ClusteredLightingPass::ReserveClusters(uint32_t tileCount)
+{
+    if (tileCount <= m_TileCapacity)
+        return;
+
+    m_TileCapacity = tileCount;
+
+    nvrhi::BufferDesc bufferDesc;
+    bufferDesc.byteSize = uint64_t(tileCount) * c_DepthSlices * c_ClusterStride * sizeof(uint32_t);
+    bufferDesc.structStride = sizeof(uint32_t);
+    bufferDesc.canHaveUAVs = true;
+    bufferDesc.debugName = "ClusteredLighting ClusterLights";
+    bufferDesc.initialState = nvrhi::ResourceStates::UnorderedAccess;
+    bufferDesc.keepInitialState = true;
+    m_ClusterLights = m_Device->createBuffer(bufferDesc);
+
+    bufferDesc.byteSize = uint64_t(tileCount) * sizeof(uint32_t);
+    bufferDesc.debugName = "ClusteredLighting TileList";
+    m_TileList = m_Device->createBuffer(bufferDesc);
+
+    m_BindingCache.Clear();
+}
+
+void ClusteredLightingPass::Render(nvrhi::ICommandList* commandList,
+    const IView& view,
+    const DeferredLightingPass::Inputs& inputs,
+    const std::vector<std::shared_ptr<Light>>& lights)
+{
+    CullLights(view, lights, m_VisibleLights);
+    if (m_VisibleLights.size() > c_MaxLights)
+        m_VisibleLights.resize(c_MaxLights);
+
+    m_Stats = Stats();
+    m_Stats.lights = uint32_t(m_VisibleLights.size());
+    if (m_VisibleLights.empty())
+        return;
+
+    commandList->beginMarker("ClusteredLighting");
+
+    m_LightConstants.resize(m_VisibleLights.size());
+    m_LightBoundsData.resize(m_VisibleLights.size());
+    for (size_t i = 0; i < m_VisibleLights.size(); i++)
+    {
+        m_LightConstants[i] = LightConstants();
+        m_VisibleLights[i].light->FillLightConstants(m_LightConstants[i]);
+        m_LightBoundsData[i] = m_VisibleLights[i].viewBounds;
+    }
+    commandList->writeBuffer(m_Lights, m_LightConstants.data(), m_LightConstants.size() * sizeof(LightConstants));
+    commandList->writeBuffer(m_LightBounds, m_LightBoundsData.data(), m_LightBoundsData.size() * sizeof(float4));
+
+    nvrhi::Rect viewExtent = view.GetViewExtent();
+
+    ClusteredLightingConstants constants = {};
+    view.FillPlanarViewConstants(constants.view);
+    constants.viewOrigin = uint2(uint(viewExtent.minX), uint(viewExtent.minY));
+    constants.viewSize = uint2(uint(viewExtent.maxX - viewExtent.minX), uint(viewExtent.maxY - viewExtent.minY));
+    constants.clusterCount = uint3((constants.viewSize + c_TileSize - 1u) / c_TileSize, c_DepthSlices);
+    constants.lightCount = m_Stats.lights;
+    constants.clusterNear = c_ClusterNear;
+    constants.sliceScale = float(c_DepthSlices) / std::log(c_ClusterFar / c_ClusterNear);
+    constants.skyDepth = view.IsReverseDepth() ? 0.f : 1.f;
+    commandList->writeBuffer(m_Constants, &constants, sizeof(constants));
+
+    uint32_t tileCount = constants.clusterCount.x * constants.clusterCount.y;
+    m_Stats.clusters = tileCount * c_DepthSlices;
+    ReserveClusters(tileCount);
+
+    // The classification adds a row of groups to y for every lit tile
+    const uint32_t emptyDispatch[3] = { c_GroupsPerTile, 0, 1 };
+    commandList->writeBuffer(m_DispatchArgs, emptyDispatch, sizeof(emptyDispatch));
+
+    nvrhi::BindingSetDesc bindingSetDesc;
+    bindingSetDesc.bindings = {
+        nvrhi::BindingSetItem::ConstantBuffer(0, m_Constants),
+        nvrhi::BindingSetItem::StructuredBuffer_SRV(0, m_Lights),
+        nvrhi::BindingSetItem::StructuredBuffer_SRV(1, m_LightBounds),
+        nvrhi::BindingSetItem::Texture_SRV(2, inputs.depth),
+        nvrhi::BindingSetItem::StructuredBuffer_UAV(0, m_ClusterLights),
+        nvrhi::BindingSetItem::StructuredBuffer_UAV(1, m_TileList),
+        nvrhi::BindingSetItem::RawBuffer_UAV(2, m_DispatchArgs)
+    };
+    nvrhi::BindingSetHandle buildSet = m_BindingCache.GetOrCreateBindingSet(bindingSetDesc, m_BuildBindingLayout);
+
+    bindingSetDesc.bindings = {
+        nvrhi::BindingSetItem::ConstantBuffer(0, m_Constants),
+        nvrhi::BindingSetItem::StructuredBuffer_SRV(0, m_Lights),
+        nvrhi::BindingSetItem::Texture_SRV(2, inputs.depth),
+        nvrhi::BindingSetItem::Texture_SRV(3, inputs.gbufferDiffuse),
+        nvrhi::BindingSetItem::Texture_SRV(4, inputs.gbufferSpecular),
+        nvrhi::BindingSetItem::Texture_SRV(5, inputs.gbufferNormals),
+        nvrhi::BindingSetItem::StructuredBuffer_UAV(0, m_ClusterLights),
+        nvrhi::BindingSetItem::StructuredBuffer_UAV(1, m_TileList),
+        nvrhi::BindingSetItem::Texture_UAV(3, inputs.output)
+    };
+    nvrhi::BindingSetHandle shadeSet = m_BindingCache.GetOrCreateBindingSet(bindingSetDesc, m_ShadeBindingLayout);
+
+    nvrhi::ComputeState state;
+    state.bindings = { buildSet };
+
+    state.pipeline = m_ClusterPipeline;
+    commandList->setComputeState(state);
+    commandList->dispatch((m_Stats.clusters + 63) / 64);
+
+    state.pipeline = m_ClassifyPipeline;
+    commandList->setComputeState(state);
+    commandList->dispatch(constants.clusterCount.x, constants.clusterCount.y);
+
+    state.pipeline = m_ShadePipeline;
+    state.bindings = { shadeSet };
+    state.indirectParams = m_DispatchArgs;
+    commandList->setComputeState(state);
+    commandList->dispatchIndirect(0);
+
+    commandList->endMarker();
+}
+
+void ClusteredLightingPass::ResetBindingCache()
+{
+    m_BindingCache.Clear();
+}
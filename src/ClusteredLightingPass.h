@@ -0,0 +1,97 @@
+#pragma once
+
+#include <donut/engine/ShaderFactory.h>
+#include <donut/engine/SceneTypes.h>
+#include <donut/engine/View.h>
+#include <donut/render/DeferredLightingPass.h>
+#include <donut/core/math/math.h>
+#include <nvrhi/nvrhi.h>
+#include <memory>
+#include <vector>
+
+#include "PassBindingCache.h"
+
+struct LightConstants;
+
+namespace donut::render
+{
+    // Clustered deferred shading of the local lights: point and spot lights without shadow maps. The lights
+    // that touch the view are listed per froxel (a screen tile of c_TileSize pixels in one of c_DepthSlices
+    // exponential depth slices), the tiles that show only sky or no lit cluster are dropped, and each pixel of
+    // the remaining tiles loops over the lights of its own cluster only. The lighting is added to the output
+    // of DeferredLightingPass, which keeps the directional and shadowed lights, the ambient and the probes.
+    class ClusteredLightingPass
+    {
+    public:
+        static constexpr uint32_t c_TileSize = 64;
+        static constexpr uint32_t c_DepthSlices = 24;
+        // Lights a cluster can list; further lights are dropped from it
+        static constexpr uint32_t c_MaxLightsPerCluster = 63;
+        // Lights shaded per frame, the nearest to the camera are kept
+        static constexpr uint32_t c_MaxLights = 1024;
+
+        ClusteredLightingPass(nvrhi::IDevice* device, const std::shared_ptr<engine::ShaderFactory>& shaderFactory);
+        ~ClusteredLightingPass();
+
+        [[nodiscard]] static bool IsClusteredLight(const engine::Light& light);
+
+        // Adds the clustered lights of the list to inputs.output, reading the GBuffer and depth of the inputs.
+        // The other lights are ignored, pass them to DeferredLightingPass.
+        void Render(nvrhi::ICommandList* commandList,
+            const engine::IView& view,
+            const DeferredLightingPass::Inputs& inputs,
+            const std::vector<std::shared_ptr<engine::Light>>& lights);
+
+        // For the Donut forward shaders, which take a fixed number of lights: every light that is not clustered,
+        // then the clustered lights that touch the view, nearest first, up to maxLights in total
+        static void SelectForwardLights(const engine::IView& view,
+            const std::vector<std::shared_ptr<engine::Light>>& lights,
+            uint32_t maxLights,
+            std::vector<std::shared_ptr<engine::Light>>& result);
+
+        struct Stats
+        {
+            // Clustered lights that touch the view
+            uint32_t lights = 0;
+            uint32_t clusters = 0;
+        };
+
+        [[nodiscard]] const Stats& GetStats() const { return m_Stats; }
+
+        void ResetBindingCache();
+
+    private:
+        struct VisibleLight
+        {
+            std::shared_ptr<engine::Light> light;
+            math::float4 viewBounds;
+        };
+
+        static void CullLights(const engine::IView& view, const std::vector<std::shared_ptr<engine::Light>>& lights,
+            std::vector<VisibleLight>& result);
+        void ReserveClusters(uint32_t tileCount);
+
+        nvrhi::DeviceHandle m_Device;
+
+        nvrhi::BufferHandle m_Constants;
+        nvrhi::BufferHandle m_Lights;
+        nvrhi::BufferHandle m_LightBounds;
+        nvrhi::BufferHandle m_ClusterLights;
+        nvrhi::BufferHandle m_TileList;
+        nvrhi::BufferHandle m_DispatchArgs;
+        uint32_t m_TileCapacity = 0;
+
+        nvrhi::BindingLayoutHandle m_BuildBindingLayout;
+        nvrhi::BindingLayoutHandle m_ShadeBindingLayout;
+        nvrhi::ComputePipelineHandle m_ClusterPipeline;
+        nvrhi::ComputePipelineHandle m_ClassifyPipeline;
+        nvrhi::ComputePipelineHandle m_ShadePipeline;
+
+        std::vector<VisibleLight> m_VisibleLights;
+        std::vector<LightConstants> m_LightConstants;
+        std::vector<math::float4> m_LightBoundsData;
+        Stats m_Stats;
+
+        PassBindingCache m_BindingCache;
+    };
+}
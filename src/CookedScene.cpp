@@ -0,0 +1,607 @@
+#include "CookedScene.h"
+#include "LoadProfiler.h"
+#include "UriUtils.h"
+
+#include <donut/core/log.h>
+#include <donut/core/vfs/VFS.h>
+#include <donut/engine/DescriptorTableManager.h>
+#include <donut/engine/SceneGraph.h>
+#include <donut/engine/TextureCache.h>
+#include <json/json.h>
+#include <chrono>
+#include <cstring>
+#include <optional>
+#include <set>
+
+using namespace donut;
+using namespace donut::math;
+using namespace donut::engine;
+
+template<typename T>
+static bool GetSection(const ymesh::FileHeader& header, const vfs::IBlob& blob, ymesh::SectionId id, const T*& records, size_t& count)
+{
+    const ymesh::Range& range = header.sections[uint32_t(id)];
+    if (range.offset > blob.size() || range.size > blob.size() - range.offset || range.size % sizeof(T) != 0)
+        return false;
+
+    records = reinterpret_cast<const T*>(static_cast<const uint8_t*>(blob.data()) + range.offset);
+    count = range.size / sizeof(T);
+    return true;
+}
+
+static box3 MakeBounds(const float* boundsMin, const float* boundsMax)
+{
+    return box3(float3(boundsMin[0], boundsMin[1], boundsMin[2]), float3(boundsMax[0], boundsMax[1], boundsMax[2]));
+}
+
+static double MillisecondsSince(std::chrono::high_resolution_clock::time_point startTime)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+}
+
+// Waits for a texture decode batch when leaving the scope, so that an early return never leaves
+// workers writing into the caller's locals
+struct TaskBatchWaiter
+{
+    std::shared_ptr<TaskBatch> batch;
+
+    ~TaskBatchWaiter()
+    {
+        if (batch)
+            batch->Wait();
+    }
+};
+
+bool CookedScene::Load(const std::filesystem::path& sceneFileName)
+{
+    std::filesystem::path cookedFileName = sceneFileName;
+    cookedFileName.replace_extension(".ymesh");
+
+    if (m_fs->fileExists(cookedFileName))
+    {
+        if (LoadCooked(cookedFileName, sceneFileName))
+            return true;
+
+        log::warning("Cannot use the cooked scene '%s', loading '%s' instead",
+            cookedFileName.generic_string().c_str(), sceneFileName.generic_string().c_str());
+    }
+
+    m_IsCooked = false;
+    m_CookedData.reset();
+    m_CookedBuffers.reset();
+    return LoadGltf(sceneFileName);
+}
+
+std::shared_ptr<TaskBatch> CookedScene::BeginTextureDecode(const std::vector<TextureRequest>& requests,
+    std::vector<std::shared_ptr<LoadedTexture>>* textures)
+{
+    textures->resize(requests.size());
+
+    // TextureCache is thread-safe: the first request for a path reads and decodes the file, later
+    // requests (including the ones made by the glTF importer) get the same cache entry
+    auto decode = [this, &requests, textures](size_t index)
+    {
+        LoadProfiler::Scope scope("decode", requests[index].path.generic_string());
+        (*textures)[index] = m_TextureCache->LoadTextureFromFileDeferred(requests[index].path, requests[index].sRGB);
+    };
+
+    if (!m_ThreadPool)
+    {
+        for (size_t i = 0; i < requests.size(); i++)
+            decode(i);
+        return nullptr;
+    }
+
+    return m_ThreadPool->ParallelForAsync(requests.size(), decode);
+}
+
+std::vector<CookedScene::TextureRequest> CookedScene::CollectGltfTextures(const std::filesystem::path& sceneFileName) const
+{
+    std::vector<TextureRequest> requests;
+
+    std::shared_ptr<vfs::IBlob> blob = m_fs->readFile(sceneFileName);
+    if (!blob)
+        return requests;
+
+    Json::Value root;
+    Json::CharReaderBuilder builder;
+    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+    const char* text = static_cast<const char*>(blob->data());
+    if (!reader->parse(text, text + blob->size(), &root, nullptr))
+        return requests;
+
+    const Json::Value& textures = root["textures"];
+    const Json::Value& images = root["images"];
+    std::filesystem::path sceneDir = sceneFileName.parent_path();
+    std::set<std::string> seen;
+
+    // Color textures are sRGB and data textures linear, the same rules as donut's glTF importer
+    auto request = [&](const Json::Value& textureInfo, bool sRGB)
+    {
+        if (!textureInfo["index"].isUInt())
+            return;
+        const Json::Value& texture = textures[textureInfo["index"].asUInt()];
+        if (!texture["source"].isUInt())
+            return;
+        std::string uri = images[texture["source"].asUInt()]["uri"].asString();
+        if (uri.empty() || uri.rfind("data:", 0) == 0)
+            return;
+
+        std::filesystem::path path = sceneDir / DecodeUri(uri);
+        if (seen.insert(path.generic_string()).second)
+            requests.push_back({ path, sRGB });
+    };
+
+    for (const Json::Value& material : root["materials"])
+    {
+        const Json::Value& specGloss = material["extensions"]["KHR_materials_pbrSpecularGlossiness"];
+        if (specGloss.isObject())
+        {
+            request(specGloss["diffuseTexture"], true);
+            request(specGloss["specularGlossinessTexture"], true);
+        }
+        else
+        {
+            request(material["pbrMetallicRoughness"]["baseColorTexture"], true);
+            request(material["pbrMetallicRoughness"]["metallicRoughnessTexture"], false);
+        }
+        request(material["normalTexture"], false);
+        request(material["occlusionTexture"], false);
+        request(material["emissiveTexture"], true);
+    }
+
+    return requests;
+}
+
+bool CookedScene::LoadGltf(const std::filesystem::path& sceneFileName)
+{
+    using namespace std::chrono;
+    auto startTime = high_resolution_clock::now();
+
+    // The importer resolves textures one at a time as it reaches the materials; decoding them up front on
+    // the pool overlaps all of them with the JSON parse and the mesh processing
+    std::vector<TextureRequest> requests = CollectGltfTextures(sceneFileName);
+    std::vector<std::shared_ptr<LoadedTexture>> textures;
+    TaskBatchWaiter decode{ BeginTextureDecode(requests, &textures) };
+
+    bool result;
+    {
+        // The importer parses the JSON and builds the scene graph in one call, so this is a single stage
+        LoadProfiler::Scope scope(LoadProfiler::c_StageCategory, "glTF import");
+        result = Scene::Load(sceneFileName);
+    }
+    double importMilliseconds = MillisecondsSince(startTime);
+
+    if (decode.batch)
+    {
+        LoadProfiler::Scope scope(LoadProfiler::c_StageCategory, "texture decode wait");
+        decode.batch->Wait();
+    }
+
+    log::info("Scene load stages (glTF): import %.1f ms, texture decode done after %.1f ms for %zu textures on %u threads",
+        importMilliseconds, MillisecondsSince(startTime), requests.size(), m_ThreadPool ? m_ThreadPool->GetThreadCount() : 1u);
+
+    return result;
+}
+
+bool CookedScene::LoadCooked(const std::filesystem::path& cookedFileName, const std::filesystem::path& sceneFileName)
+{
+    using ymesh::SectionId;
+    using namespace std::chrono;
+    auto startTime = high_resolution_clock::now();
+
+    std::shared_ptr<vfs::IBlob> blob;
+    {
+        LoadProfiler::Scope scope(LoadProfiler::c_StageCategory, "cooked scene read");
+        blob = m_fs->readFile(cookedFileName);
+    }
+    if (!blob || blob->size() < sizeof(ymesh::FileHeader))
+        return false;
+
+    double readMilliseconds = MillisecondsSince(startTime);
+
+    ymesh::FileHeader header;
+    memcpy(&header, blob->data(), sizeof(header));
+    if (header.magic != ymesh::c_Magic || header.version != ymesh::c_Version)
+    {
+        log::warning("Cooked scene '%s' has an unsupported version %u", cookedFileName.generic_string().c_str(), header.version);
+        return false;
+    }
+
+    const char* strings; size_t stringsSize;
+    const ymesh::TextureRecord* textureRecords; size_t numTextures;
+    const ymesh::MaterialRecord* materialRecords; size_t numMaterials;
+    const ymesh::MeshRecord* meshRecords; size_t numMeshes;
+    const ymesh::GeometryRecord* geometryRecords; size_t numGeometries;
+    const ymesh::NodeRecord* nodeRecords; size_t numNodes;
+    const ymesh::LightRecord* lightRecords; size_t numLights;
+    const ymesh::CameraRecord* cameraRecords; size_t numCameras;
+    const ymesh::AnimationRecord* animationRecords; size_t numAnimations;
+    const ymesh::ChannelRecord* channelRecords; size_t numChannels;
+    const ymesh::KeyframeRecord* keyframeRecords; size_t numKeyframes;
+    const uint32_t* indices; size_t numIndices;
+    const uint8_t* vertexData; size_t vertexDataSize;
+
+    if (!GetSection(header, *blob, SectionId::Strings, strings, stringsSize) ||
+        !GetSection(header, *blob, SectionId::Textures, textureRecords, numTextures) ||
+        !GetSection(header, *blob, SectionId::Materials, materialRecords, numMaterials) ||
+        !GetSection(header, *blob, SectionId::Meshes, meshRecords, numMeshes) ||
+        !GetSection(header, *blob, SectionId::Geometries, geometryRecords, numGeometries) ||
+        !GetSection(header, *blob, SectionId::Nodes, nodeRecords, numNodes) ||
+        !GetSection(header, *blob, SectionId::Lights, lightRecords, numLights) ||
+        !GetSection(header, *blob, SectionId::Cameras, cameraRecords, numCameras) ||
+        !GetSection(header, *blob, SectionId::Animations, animationRecords, numAnimations) ||
+        !GetSection(header, *blob, SectionId::Channels, channelRecords, numChannels) ||
+        !GetSection(header, *blob, SectionId::Keyframes, keyframeRecords, numKeyframes) ||
+        !GetSection(header, *blob, SectionId::IndexData, indices, numIndices) ||
+        !GetSection(header, *blob, SectionId::VertexData, vertexData, vertexDataSize))
+    {
+        log::warning("Cooked scene '%s' is truncated", cookedFileName.generic_string().c_str());
+        return false;
+    }
+
+    for (const ymesh::Range& stream : header.vertexStreams)
+    {
+        if (stream.offset > vertexDataSize || stream.size > vertexDataSize - stream.offset)
+            return false;
+    }
+
+    auto getString = [strings, stringsSize](uint32_t offset) -> std::string
+    {
+        if (offset >= stringsSize)
+            return std::string();
+        return std::string(strings + offset, strnlen(strings + offset, stringsSize - offset));
+    };
+
+    // Textures decode on the pool while the rest of the scene is built, materials get them at the end
+    std::filesystem::path sceneDir = sceneFileName.parent_path();
+    std::vector<TextureRequest> requests(numTextures);
+    for (size_t i = 0; i < numTextures; i++)
+        requests[i] = { sceneDir / getString(textureRecords[i].path), textureRecords[i].sRGB != 0 };
+
+    auto buildStartTime = high_resolution_clock::now();
+    std::optional<LoadProfiler::Scope> buildScope;
+    buildScope.emplace(LoadProfiler::c_StageCategory, "cooked scene build");
+    std::vector<std::shared_ptr<LoadedTexture>> textures;
+    TaskBatchWaiter decode{ BeginTextureDecode(requests, &textures) };
+
+    std::vector<std::shared_ptr<Material>> materials(numMaterials);
+    for (size_t i = 0; i < numMaterials; i++)
+    {
+        const ymesh::MaterialRecord& record = materialRecords[i];
+        auto material = std::make_shared<Material>();
+        material->name = getString(record.name);
+        material->materialID = int(i);
+
+        switch (record.domain)
+        {
+        case ymesh::MaterialDomain::AlphaTested: material->domain = MaterialDomain::AlphaTested; break;
+        case ymesh::MaterialDomain::AlphaBlended: material->domain = MaterialDomain::AlphaBlended; break;
+        default: material->domain = MaterialDomain::Opaque; break;
+        }
+
+        material->doubleSided = (record.flags & ymesh::MaterialFlag_DoubleSided) != 0;
+        material->useSpecularGlossModel = (record.flags & ymesh::MaterialFlag_SpecularGlossiness) != 0;
+        material->baseOrDiffuseColor = float3(record.baseOrDiffuseColor[0], record.baseOrDiffuseColor[1], record.baseOrDiffuseColor[2]);
+        material->specularColor = float3(record.specularColor[0], record.specularColor[1], record.specularColor[2]);
+        material->emissiveColor = float3(record.emissiveColor[0], record.emissiveColor[1], record.emissiveColor[2]);
+        material->emissiveIntensity = record.emissiveIntensity;
+        material->opacity = record.opacity;
+        material->metalness = record.metalness;
+        material->roughness = record.roughness;
+        material->normalTextureScale = record.normalTextureScale;
+        material->occlusionStrength = record.occlusionStrength;
+        material->alphaCutoff = record.alphaCutoff;
+        materials[i] = material;
+    }
+
+    // All meshes share one buffer group whose GPU buffers are created from the cooked data in FinishedLoading
+    auto buffers = std::make_shared<BufferGroup>();
+    const std::pair<ymesh::VertexStream, VertexAttribute> streamAttributes[] = {
+        { ymesh::VertexStream::Position, VertexAttribute::Position },
+        { ymesh::VertexStream::Normal, VertexAttribute::Normal },
+        { ymesh::VertexStream::Tangent, VertexAttribute::Tangent },
+        { ymesh::VertexStream::TexCoord1, VertexAttribute::TexCoord1 },
+        { ymesh::VertexStream::TexCoord2, VertexAttribute::TexCoord2 }
+    };
+    for (const auto& [stream, attribute] : streamAttributes)
+    {
+        const ymesh::Range& range = header.vertexStreams[uint32_t(stream)];
+        if (range.size != 0)
+            buffers->getVertexBufferRange(attribute) = nvrhi::BufferRange(range.offset, range.size);
+    }
+
+    std::vector<std::shared_ptr<MeshInfo>> meshes(numMeshes);
+    for (size_t i = 0; i < numMeshes; i++)
+    {
+        const ymesh::MeshRecord& record = meshRecords[i];
+        if (size_t(record.firstGeometry) + record.numGeometries > numGeometries ||
+            size_t(record.indexOffset) + record.totalIndices > numIndices)
+            return false;
+
+        auto mesh = std::make_shared<MeshInfo>();
+        mesh->name = getString(record.name);
+        mesh->buffers = buffers;
+        mesh->objectSpaceBounds = MakeBounds(record.boundsMin, record.boundsMax);
+        mesh->indexOffset = record.indexOffset;
+        mesh->vertexOffset = record.vertexOffset;
+        mesh->totalIndices = record.totalIndices;
+        mesh->totalVertices = record.totalVertices;
+
+        for (uint32_t g = 0; g < record.numGeometries; g++)
+        {
+            const ymesh::GeometryRecord& geometryRecord = geometryRecords[record.firstGeometry + g];
+            if (geometryRecord.material >= numMaterials)
+                return false;
+
+            auto geometry = std::make_shared<MeshGeometry>();
+            geometry->material = materials[geometryRecord.material];
+            geometry->objectSpaceBounds = MakeBounds(geometryRecord.boundsMin, geometryRecord.boundsMax);
+            geometry->indexOffsetInMesh = geometryRecord.indexOffsetInMesh;
+            geometry->vertexOffsetInMesh = geometryRecord.vertexOffsetInMesh;
+            geometry->numIndices = geometryRecord.numIndices;
+            geometry->numVertices = geometryRecord.numVertices;
+            mesh->geometries.push_back(geometry);
+        }
+
+        meshes[i] = mesh;
+    }
+
+    auto sceneGraph = std::make_shared<SceneGraph>();
+    auto rootNode = std::make_shared<SceneGraphNode>();
+    rootNode->SetName(sceneFileName.filename().generic_string());
+    sceneGraph->SetRootNode(rootNode);
+
+    std::vector<std::shared_ptr<SceneGraphNode>> nodes(numNodes);
+    for (size_t i = 0; i < numNodes; i++)
+    {
+        const ymesh::NodeRecord& record = nodeRecords[i];
+        if (record.parent != ymesh::c_InvalidIndex && record.parent >= i)
+            return false;
+
+        auto node = std::make_shared<SceneGraphNode>();
+        node->SetName(getString(record.name));
+
+        double3 translation(record.translation[0], record.translation[1], record.translation[2]);
+        dquat rotation(record.rotation[3], record.rotation[0], record.rotation[1], record.rotation[2]);
+        double3 scaling(record.scaling[0], record.scaling[1], record.scaling[2]);
+        node->SetTransform(&translation, &rotation, &scaling);
+
+        if (record.leafType == ymesh::LeafType::Mesh && record.leafIndex < numMeshes)
+        {
+            node->SetLeaf(std::make_shared<MeshInstance>(meshes[record.leafIndex]));
+        }
+        else if (record.leafType == ymesh::LeafType::Light && record.leafIndex < numLights)
+        {
+            const ymesh::LightRecord& lightRecord = lightRecords[record.leafIndex];
+            std::shared_ptr<Light> light;
+
+            switch (lightRecord.type)
+            {
+            case ymesh::LightType::Directional: {
+                auto directional = std::make_shared<DirectionalLight>();
+                directional->irradiance = lightRecord.intensity;
+                light = directional;
+                break;
+            }
+            case ymesh::LightType::Spot: {
+                auto spot = std::make_shared<SpotLight>();
+                spot->intensity = lightRecord.intensity;
+                spot->range = lightRecord.range;
+                spot->innerAngle = lightRecord.innerAngle;
+                spot->outerAngle = lightRecord.outerAngle;
+                light = spot;
+                break;
+            }
+            default: {
+                auto point = std::make_shared<PointLight>();
+                point->intensity = lightRecord.intensity;
+                point->range = lightRecord.range;
+                light = point;
+                break;
+            }
+            }
+
+            light->color = float3(lightRecord.color[0], lightRecord.color[1], lightRecord.color[2]);
+            node->SetLeaf(light);
+        }
+        else if (record.leafType == ymesh::LeafType::Camera && record.leafIndex < numCameras)
+        {
+            const ymesh::CameraRecord& cameraRecord = cameraRecords[record.leafIndex];
+            if (cameraRecord.type == ymesh::CameraType::Orthographic)
+            {
+                auto camera = std::make_shared<OrthographicCamera>();
+                camera->xMag = cameraRecord.params[0];
+                camera->yMag = cameraRecord.params[1];
+                camera->zNear = cameraRecord.zNear;
+                camera->zFar = cameraRecord.zFar;
+                node->SetLeaf(camera);
+            }
+            else
+            {
+                auto camera = std::make_shared<PerspectiveCamera>();
+                camera->verticalFov = cameraRecord.params[0];
+                camera->zNear = cameraRecord.zNear;
+                if (cameraRecord.params[1] > 0.f)
+                    camera->aspectRatio = cameraRecord.params[1];
+                if (cameraRecord.zFar > 0.f)
+                    camera->zFar = cameraRecord.zFar;
+                node->SetLeaf(camera);
+            }
+        }
+
+        sceneGraph->Attach(record.parent == ymesh::c_InvalidIndex ? rootNode : nodes[record.parent], node);
+        nodes[i] = node;
+    }
+
+    for (size_t i = 0; i < numAnimations; i++)
+    {
+        const ymesh::AnimationRecord& record = animationRecords[i];
+        if (size_t(record.firstChannel) + record.numChannels > numChannels)
+            return false;
+
+        auto animation = std::make_shared<SceneGraphAnimation>();
+
+        for (uint32_t c = 0; c < record.numChannels; c++)
+        {
+            const ymesh::ChannelRecord& channelRecord = channelRecords[record.firstChannel + c];
+            if (channelRecord.node >= numNodes || size_t(channelRecord.firstKeyframe) + channelRecord.numKeyframes > numKeyframes)
+                return false;
+
+            AnimationAttribute attribute = AnimationAttribute::Translation;
+            if (channelRecord.path == ymesh::AnimationPath::Rotation)
+                attribute = AnimationAttribute::Rotation;
+            else if (channelRecord.path == ymesh::AnimationPath::Scaling)
+                attribute = AnimationAttribute::Scaling;
+
+            auto sampler = std::make_shared<animation::Sampler>();
+            switch (channelRecord.interpolation)
+            {
+            case ymesh::Interpolation::Step:
+                sampler->SetInterpolationMode(animation::InterpolationMode::Step);
+                break;
+            case ymesh::Interpolation::CubicSpline:
+                sampler->SetInterpolationMode(animation::InterpolationMode::HermiteSpline);
+                break;
+            default:
+                sampler->SetInterpolationMode(attribute == AnimationAttribute::Rotation
+                    ? animation::InterpolationMode::Slerp
+                    : animation::InterpolationMode::Linear);
+                break;
+            }
+
+            for (uint32_t k = 0; k < channelRecord.numKeyframes; k++)
+            {
+                const ymesh::KeyframeRecord& keyframeRecord = keyframeRecords[channelRecord.firstKeyframe + k];
+                animation::Keyframe keyframe;
+                keyframe.time = keyframeRecord.time;
+                keyframe.value = float4(keyframeRecord.value[0], keyframeRecord.value[1], keyframeRecord.value[2], keyframeRecord.value[3]);
+                keyframe.inTangent = float4(keyframeRecord.inTangent[0], keyframeRecord.inTangent[1], keyframeRecord.inTangent[2], keyframeRecord.inTangent[3]);
+                keyframe.outTangent = float4(keyframeRecord.outTangent[0], keyframeRecord.outTangent[1], keyframeRecord.outTangent[2], keyframeRecord.outTangent[3]);
+                sampler->AddKeyframe(keyframe);
+            }
+
+            animation->AddChannel(std::make_shared<SceneGraphAnimationChannel>(sampler, nodes[channelRecord.node], attribute));
+        }
+
+        auto animationNode = std::make_shared<SceneGraphNode>();
+        animationNode->SetName(getString(record.name));
+        animationNode->SetLeaf(animation);
+        sceneGraph->Attach(rootNode, animationNode);
+    }
+
+    double buildMilliseconds = MillisecondsSince(buildStartTime);
+    buildScope.reset();
+
+    if (decode.batch)
+    {
+        LoadProfiler::Scope scope(LoadProfiler::c_StageCategory, "texture decode wait");
+        decode.batch->Wait();
+    }
+
+    auto getTexture = [&textures](uint32_t index) -> std::shared_ptr<LoadedTexture>
+    {
+        return index < textures.size() ? textures[index] : nullptr;
+    };
+
+    for (size_t i = 0; i < numMaterials; i++)
+    {
+        const ymesh::MaterialRecord& record = materialRecords[i];
+        Material& material = *materials[i];
+        material.baseOrDiffuseTexture = getTexture(record.baseOrDiffuseTexture);
+        material.metalRoughOrSpecularTexture = getTexture(record.metalRoughOrSpecularTexture);
+        material.normalTexture = getTexture(record.normalTexture);
+        material.occlusionTexture = getTexture(record.occlusionTexture);
+        material.emissiveTexture = getTexture(record.emissiveTexture);
+    }
+
+    log::info("Scene load stages (cooked): read %.1f ms, scene build %.1f ms, texture decode done after %.1f ms for %zu textures on %u threads",
+        readMilliseconds, buildMilliseconds, MillisecondsSince(buildStartTime), numTextures, m_ThreadPool ? m_ThreadPool->GetThreadCount() : 1u);
+
+    m_SceneGraph = sceneGraph;
+    m_CookedData = blob;
+    m_CookedBuffers = buffers;
+    m_CookedHeader = header;
+    m_IsCooked = true;
+
+    return true;
+}
+
+void CookedScene::CreateCookedBuffers()
+{
+    const ymesh::Range& indexRange = m_CookedHeader.sections[uint32_t(ymesh::SectionId::IndexData)];
+    const ymesh::Range& vertexRange = m_CookedHeader.sections[uint32_t(ymesh::SectionId::VertexData)];
+    const uint8_t* data = static_cast<const uint8_t*>(m_CookedData->data());
+
+    nvrhi::CommandListHandle commandList = m_Device->createCommandList();
+    commandList->open();
+
+    if (indexRange.size != 0)
+    {
+        nvrhi::BufferDesc bufferDesc;
+        bufferDesc.isIndexBuffer = true;
+        bufferDesc.byteSize = indexRange.size;
+        bufferDesc.debugName = "IndexBuffer";
+        bufferDesc.canHaveTypedViews = true;
+        bufferDesc.canHaveRawViews = true;
+        bufferDesc.format = nvrhi::Format::R32_UINT;
+
+        m_CookedBuffers->indexBuffer = m_Device->createBuffer(bufferDesc);
+
+        commandList->beginTrackingBufferState(m_CookedBuffers->indexBuffer, nvrhi::ResourceStates::Common);
+        commandList->writeBuffer(m_CookedBuffers->indexBuffer, data + indexRange.offset, indexRange.size);
+        commandList->setPermanentBufferState(m_CookedBuffers->indexBuffer, nvrhi::ResourceStates::IndexBuffer | nvrhi::ResourceStates::ShaderResource);
+
+        if (m_DescriptorTable)
+        {
+            m_CookedBuffers->indexBufferDescriptor = std::make_shared<DescriptorHandle>(
+                m_DescriptorTable->CreateDescriptorHandle(nvrhi::BindingSetItem::RawBuffer_SRV(0, m_CookedBuffers->indexBuffer)));
+        }
+    }
+
+    if (vertexRange.size != 0)
+    {
+        nvrhi::BufferDesc bufferDesc;
+        bufferDesc.isVertexBuffer = true;
+        bufferDesc.byteSize = vertexRange.size;
+        bufferDesc.debugName = "VertexBuffer";
+        bufferDesc.canHaveTypedViews = true;
+        bufferDesc.canHaveRawViews = true;
+
+        m_CookedBuffers->vertexBuffer = m_Device->createBuffer(bufferDesc);
+
+        // The cooked vertex data is laid out like the vertex buffer, so all attribute streams go up in one write
+        commandList->beginTrackingBufferState(m_CookedBuffers->vertexBuffer, nvrhi::ResourceStates::Common);
+        commandList->writeBuffer(m_CookedBuffers->vertexBuffer, data + vertexRange.offset, vertexRange.size);
+        commandList->setPermanentBufferState(m_CookedBuffers->vertexBuffer, nvrhi::ResourceStates::VertexBuffer | nvrhi::ResourceStates::ShaderResource);
+
+        if (m_DescriptorTable)
+        {
+            m_CookedBuffers->vertexBufferDescriptor = std::make_shared<DescriptorHandle>(
+                m_DescriptorTable->CreateDescriptorHandle(nvrhi::BindingSetItem::RawBuffer_SRV(0, m_CookedBuffers->vertexBuffer)));
+        }
+    }
+
+    commandList->close();
+    m_Device->executeCommandList(commandList);
+}
+
+void CookedScene::FinishedLoading(uint32_t frameIndex)
+{
+    using namespace std::chrono;
+    auto startTime = high_resolution_clock::now();
+
+    if (m_IsCooked && m_CookedData)
+    {
+        LoadProfiler::Scope scope(LoadProfiler::c_StageCategory, "cooked buffer upload");
+        CreateCookedBuffers();
+        m_CookedData.reset();
+    }
+
+    {
+        LoadProfiler::Scope scope(LoadProfiler::c_StageCategory, "scene finish loading");
+        Scene::FinishedLoading(frameIndex);
+    }
+
+    log::info("Scene load stages: buffer creation and upload %.1f ms", MillisecondsSince(startTime));
+}
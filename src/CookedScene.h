@@ -0,0 +1,60 @@
+#pragma once
+
+#include <donut/engine/Scene.h>
+#include <nvrhi/nvrhi.h>
+#include <filesystem>
+#include <memory>
+
+#include "YMeshFormat.h"
+#include "ThreadPool.h"
+
+namespace donut::vfs
+{
+    class IBlob;
+}
+
+namespace donut::engine
+{
+    struct BufferGroup;
+}
+
+// Scene that loads the engine-native .ymesh file cooked next to a glTF scene by YupCooker, and falls back
+// to the glTF importer when there is no cooked file or it cannot be used.
+// The cooked file is read on the loading thread; the vertex and index buffers are created from the file
+// contents in FinishedLoading, on the rendering thread, with a single upload per buffer.
+// With a thread pool set, textures are decoded on the pool while the scene graph is being built, for the
+// glTF path as well, and the time spent in every stage is logged.
+// With a descriptor table, the cooked buffers get bindless descriptors like the ones the glTF path creates.
+class CookedScene : public donut::engine::Scene
+{
+public:
+    using Scene::Scene;
+
+    bool Load(const std::filesystem::path& sceneFileName) override;
+    void FinishedLoading(uint32_t frameIndex) override;
+
+    void SetThreadPool(std::shared_ptr<ThreadPool> threadPool) { m_ThreadPool = std::move(threadPool); }
+
+    [[nodiscard]] bool IsCooked() const { return m_IsCooked; }
+
+private:
+    struct TextureRequest
+    {
+        std::filesystem::path path;
+        bool sRGB;
+    };
+
+    bool LoadCooked(const std::filesystem::path& cookedFileName, const std::filesystem::path& sceneFileName);
+    bool LoadGltf(const std::filesystem::path& sceneFileName);
+    std::vector<TextureRequest> CollectGltfTextures(const std::filesystem::path& sceneFileName) const;
+    std::shared_ptr<TaskBatch> BeginTextureDecode(const std::vector<TextureRequest>& requests,
+        std::vector<std::shared_ptr<donut::engine::LoadedTexture>>* textures);
+    void CreateCookedBuffers();
+
+    std::shared_ptr<ThreadPool> m_ThreadPool;
+
+    std::shared_ptr<donut::vfs::IBlob> m_CookedData;
+    std::shared_ptr<donut::engine::BufferGroup> m_CookedBuffers;
+    ymesh::FileHeader m_CookedHeader{};
+    bool m_IsCooked = false;
+};
@@ -0,0 +1,168 @@
+#include "CpuProfiler.h"
+#include "ChromeTrace.h"
+
+#include <donut/core/log.h>
+#include <algorithm>
+#include <string>
+
+using namespace donut;
+
+thread_local CpuProfiler::ThreadBuffer* CpuProfiler::t_Buffer = nullptr;
+
+CpuProfiler& CpuProfiler::Get()
+{
+    static CpuProfiler profiler;
+    return profiler;
+}
+
+CpuProfiler::CpuProfiler()
+    : m_StartTicks(Now())
+    , m_StartTime(std::chrono::steady_clock::now())
+{
+}
+
+CpuProfiler::ThreadBuffer* CpuProfiler::RegisterThread()
+{
+    // Buffers live as long as the profiler, so the collector can still read them after their thread exits
+    auto buffer = std::make_unique<ThreadBuffer>();
+    buffer->thread = ProfilerThreads::GetCurrentIndex();
+
+    std::lock_guard lock(m_Mutex);
+    t_Buffer = buffer.get();
+    m_Buffers.push_back(std::move(buffer));
+    return t_Buffer;
+}
+
+double CpuProfiler::TicksToMicroseconds(uint64_t ticks) const
+{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    // Calibrated over the whole run, which gets more precise the longer it runs
+    double elapsedTicks = double(Now() - m_StartTicks);
+    double elapsedMicroseconds = double(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - m_StartTime).count()) * 1e-3;
+    if (elapsedTicks <= 0.0 || elapsedMicroseconds <= 0.0)
+        return 0.0;
+    return double(ticks) * elapsedMicroseconds / elapsedTicks;
+#else
+    return double(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::duration(ticks)).count()) * 1e-3;
+#endif
+}
+
+void CpuProfiler::NextFrame(uint64_t frameIndex)
+{
+    uint64_t now = Now();
+
+    std::lock_guard lock(m_Mutex);
+
+    for (auto& [name, stats] : m_Stats)
+    {
+        stats.frameMs = 0.f;
+        stats.frameCalls = 0;
+    }
+
+    // Everything recorded since the last collection counts towards the frame that just ended
+    double microsecondsPerTick = TicksToMicroseconds(1 << 20) / double(1 << 20);
+    for (const auto& buffer : m_Buffers)
+    {
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        uint64_t first = std::max(buffer->collected, head > c_SafeEvents ? head - c_SafeEvents : 0);
+
+        for (uint64_t i = first; i < head; i++)
+        {
+            const Event& event = buffer->events[i % c_EventsPerThread];
+            Stats& stats = m_Stats[event.name];
+            stats.name = event.name;
+            stats.frameMs += float(double(event.end - event.begin) * microsecondsPerTick * 1e-3);
+            stats.frameCalls++;
+        }
+
+        buffer->collected = head;
+    }
+
+    for (auto& [name, stats] : m_Stats)
+    {
+        stats.averageMs += (stats.frameMs - stats.averageMs) * c_AverageWeight;
+        stats.averageCalls += (float(stats.frameCalls) - stats.averageCalls) * c_AverageWeight;
+        stats.maxMs = std::max(stats.maxMs * (1.f - c_AverageWeight), stats.frameMs);
+    }
+
+    m_FrameStarts[m_FrameCount % c_FrameHistory] = now;
+    m_FrameIndices[m_FrameCount % c_FrameHistory] = frameIndex;
+    m_FrameCount++;
+
+    if (m_CaptureFrames > 0)
+        WriteCapture();
+}
+
+void CpuProfiler::RequestCapture(uint32_t frameCount, std::filesystem::path traceFile)
+{
+    std::lock_guard lock(m_Mutex);
+    m_CaptureFrames = std::clamp(frameCount, 1u, c_FrameHistory - 1);
+    m_CaptureFile = std::move(traceFile);
+}
+
+void CpuProfiler::WriteCapture()
+{
+    // Called with m_Mutex held, right after the start of the current frame was stored
+    uint32_t frames = uint32_t(std::min<uint64_t>(m_CaptureFrames, m_FrameCount - 1));
+    m_CaptureFrames = 0;
+    if (frames == 0)
+        return;
+
+    uint64_t captureStart = m_FrameStarts[(m_FrameCount - 1 - frames) % c_FrameHistory];
+    uint64_t captureEnd = m_FrameStarts[(m_FrameCount - 1) % c_FrameHistory];
+
+    ChromeTraceWriter writer(m_CaptureFile);
+    if (!writer.IsOpen())
+    {
+        log::warning("Cannot write the CPU profile to %s", m_CaptureFile.generic_string().c_str());
+        return;
+    }
+
+    writer.ProcessName("CPU");
+    writer.ProfilerThreadNames();
+
+    for (uint32_t frame = 0; frame < frames; frame++)
+    {
+        uint64_t slot = (m_FrameCount - 1 - frames + frame) % c_FrameHistory;
+        writer.Instant(TicksToMicroseconds(m_FrameStarts[slot] - m_StartTicks), "Frame " + std::to_string(m_FrameIndices[slot]));
+    }
+
+    size_t eventCount = 0;
+    for (const auto& buffer : m_Buffers)
+    {
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        uint64_t first = head > c_SafeEvents ? head - c_SafeEvents : 0;
+
+        for (uint64_t i = first; i < head; i++)
+        {
+            const Event& event = buffer->events[i % c_EventsPerThread];
+            if (event.end < captureStart || event.begin > captureEnd)
+                continue;
+
+            writer.Complete(buffer->thread, TicksToMicroseconds(event.begin - m_StartTicks),
+                TicksToMicroseconds(event.end - event.begin), event.name);
+            eventCount++;
+        }
+    }
+
+    if (writer.Close())
+        log::info("CPU profile of %u frames written to %s (%zu scopes)", frames, m_CaptureFile.generic_string().c_str(), eventCount);
+    else
+        log::warning("Cannot write the CPU profile to %s", m_CaptureFile.generic_string().c_str());
+}
+
+std::vector<CpuProfiler::ScopeStats> CpuProfiler::GetSortedStats() const
+{
+    std::vector<ScopeStats> result;
+
+    {
+        std::lock_guard lock(m_Mutex);
+        result.reserve(m_Stats.size());
+        for (const auto& [name, stats] : m_Stats)
+            result.push_back(ScopeStats{ stats.name, stats.averageMs, stats.maxMs, stats.averageCalls });
+    }
+
+    std::sort(result.begin(), result.end(), [](const ScopeStats& a, const ScopeStats& b) { return a.averageMs > b.averageMs; });
+    return result;
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Frame profiler for the CPU side. Every thread writes its scopes into its own ring buffer without locks,
+// one store of the begin/end timestamps per scope, and the render thread collects them once per frame:
+// the scope totals are aggregated for the UI, and a capture writes the last frames as a Chrome trace.
+// Only the newest c_SafeEvents of a thread are read, so a thread that records more than that between two
+// collections loses its oldest scopes, and a capture only reaches back as far as the busiest thread's buffer.
+//
+// Use the CPU_PROFILE_* macros, which compile to nothing unless YUP_ENGINE_CPU_PROFILER is defined.
+// Scope names must be string literals, they are kept as pointers. Threads are named through ProfilerThreads.
+class CpuProfiler
+{
+public:
+    struct ScopeStats
+    {
+        const char* name;
+        float averageMs;    // per frame
+        float maxMs;        // largest per-frame total in the recent frames
+        float callsPerFrame;
+    };
+
+    static CpuProfiler& Get();
+
+    // Timestamp in ticks of the fastest clock available; see TicksToMicroseconds
+    static uint64_t Now()
+    {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return uint64_t(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+    }
+
+    // Called by the render thread at the start of every frame; collects the scopes of the previous frame
+    void NextFrame(uint64_t frameIndex);
+
+    // Writes the last frameCount frames at the next NextFrame
+    void RequestCapture(uint32_t frameCount, std::filesystem::path traceFile);
+
+    // Sorted by average time, slowest first
+    [[nodiscard]] std::vector<ScopeStats> GetSortedStats() const;
+
+    class Scope
+    {
+    public:
+        explicit Scope(const char* name)
+            : m_Name(name)
+            , m_Begin(Now())
+        {
+        }
+
+        ~Scope() { Get().Record(m_Name, m_Begin, Now()); }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        const char* m_Name;
+        uint64_t m_Begin;
+    };
+
+private:
+    static constexpr uint32_t c_EventsPerThread = 1 << 14;
+    static constexpr uint32_t c_FrameHistory = 256;
+    // The collector reads at most this many events behind a thread's head, so that it stays clear of the
+    // slots the thread may be overwriting at the same time
+    static constexpr uint64_t c_SafeEvents = c_EventsPerThread / 2;
+    static constexpr float c_AverageWeight = 0.05f;
+
+    struct Event
+    {
+        const char* name;
+        uint64_t begin;
+        uint64_t end;
+    };
+
+    // Written by its thread only; head is published with release so that the collector sees whole events
+    struct ThreadBuffer
+    {
+        Event events[c_EventsPerThread];
+        std::atomic<uint64_t> head = 0;
+        uint64_t collected = 0;     // collector side
+        uint32_t thread = 0;        // ProfilerThreads index
+    };
+
+    struct Stats
+    {
+        const char* name = nullptr;
+        float averageMs = 0.f;
+        float maxMs = 0.f;
+        float averageCalls = 0.f;
+        float frameMs = 0.f;
+        uint32_t frameCalls = 0;
+    };
+
+    CpuProfiler();
+
+    void Record(const char* name, uint64_t begin, uint64_t end)
+    {
+        ThreadBuffer* buffer = t_Buffer ? t_Buffer : RegisterThread();
+        uint64_t head = buffer->head.load(std::memory_order_relaxed);
+        buffer->events[head % c_EventsPerThread] = Event{ name, begin, end };
+        buffer->head.store(head + 1, std::memory_order_release);
+    }
+
+    ThreadBuffer* RegisterThread();
+    double TicksToMicroseconds(uint64_t ticks) const;
+    void WriteCapture();
+
+    static thread_local ThreadBuffer* t_Buffer;
+
+    mutable std::mutex m_Mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> m_Buffers;
+
+    // Tick rate calibration against steady_clock
+    uint64_t m_StartTicks;
+    std::chrono::steady_clock::time_point m_StartTime;
+
+    uint64_t m_FrameStarts[c_FrameHistory] = {};
+    uint64_t m_FrameIndices[c_FrameHistory] = {};
+    uint64_t m_FrameCount = 0;
+
+    std::unordered_map<std::string_view, Stats> m_Stats;
+
+    uint32_t m_CaptureFrames = 0;
+    std::filesystem::path m_CaptureFile;
+};
+
+#ifdef YUP_ENGINE_CPU_PROFILER
+#define CPU_PROFILE_CONCAT_INNER(a, b) a##b
+#define CPU_PROFILE_CONCAT(a, b) CPU_PROFILE_CONCAT_INNER(a, b)
+#define CPU_PROFILE_SCOPE(name) CpuProfiler::Scope CPU_PROFILE_CONCAT(cpuProfileScope, __LINE__)(name)
+#define CPU_PROFILE_FRAME(frameIndex) CpuProfiler::Get().NextFrame(frameIndex)
+#else
+#define CPU_PROFILE_SCOPE(name) ((void)0)
+#define CPU_PROFILE_FRAME(frameIndex) ((void)0)
+#endif
@@ -5,103 +5,106 @@ using namespace donut::render;
 using namespace donut::engine;
 using namespace donut::math;
 
+// Matches FXAAConstants in FXAA.hlsl
+struct FXAAConstants
+{
+    uint2 viewOrigin;
+    uint2 viewSize;
+    float2 invTextureSize;
+    float2 padding;
+};
+
 FXAAPass::FXAAPass(nvrhi::IDevice* device,
     const std::shared_ptr<ShaderFactory>& shaderFactory,
-    std::shared_ptr<CommonRenderPasses> commonPasses,
-    std::shared_ptr<FramebufferFactory> framebufferFactory,
-    const ICompositeView& compositeView)
+    std::shared_ptr<CommonRenderPasses> commonPasses)
     : m_CommonPasses(std::move(commonPasses))
-    , m_FramebufferFactory(std::move(framebufferFactory))
     , m_Device(device)
     , m_BindingCache(device)
 {
-    const IView* sampleView = compositeView.GetChildView(ViewType::PLANAR, 0);
-    nvrhi::IFramebuffer* sampleFramebuffer = m_FramebufferFactory->GetFramebuffer(*sampleView);
-
-    nvrhi::Rect viewExtent = sampleView->GetViewExtent();
-    int viewportWidth = viewExtent.maxX - viewExtent.minX;
-    int viewportHeight = viewExtent.maxY - viewExtent.minY;
-
     // Load FXAA shader
-    m_FXAAPixelShader = shaderFactory->CreateShader("FXAA.hlsl", "main_ps", nullptr, nvrhi::ShaderType::Pixel);
+    m_FXAAComputeShader = shaderFactory->CreateShader("FXAA.hlsl", "main_cs", nullptr, nvrhi::ShaderType::Compute);
 
     // Define FXAA binding layout
     nvrhi::BindingLayoutDesc layoutDesc;
-    layoutDesc.visibility = nvrhi::ShaderType::Pixel;
+    layoutDesc.visibility = nvrhi::ShaderType::Compute;
     layoutDesc.bindings = {
+        nvrhi::BindingLayoutItem::PushConstants(0, sizeof(FXAAConstants)),
         nvrhi::BindingLayoutItem::Sampler(0),
-        nvrhi::BindingLayoutItem::Texture_SRV(0)
+        nvrhi::BindingLayoutItem::Texture_SRV(0),
+        nvrhi::BindingLayoutItem::Texture_UAV(0)
     };
     m_FXAABindingLayout = device->createBindingLayout(layoutDesc);
 
-    // intermediate texture for fxaa
-    nvrhi::TextureDesc intermediateTextureDesc2;
-
-    intermediateTextureDesc2.format = sampleFramebuffer->getFramebufferInfo().colorFormats[0];
-    intermediateTextureDesc2.width = viewportWidth;
-    intermediateTextureDesc2.height = viewportHeight;
-    intermediateTextureDesc2.mipLevels = 1;
-    intermediateTextureDesc2.isRenderTarget = true;
-
-    intermediateTextureDesc2.debugName = "Fxaa Output Texture";
-    intermediateTextureDesc2.initialState = nvrhi::ResourceStates::ShaderResource;
-    intermediateTextureDesc2.keepInitialState = true;
-    m_TextureOutput = m_Device->createTexture(intermediateTextureDesc2);
-    m_FramebufferOutput = m_Device->createFramebuffer(nvrhi::FramebufferDesc()
-        .addColorAttachment(m_TextureOutput));
-
-    // Define graphics pipeline
-    nvrhi::GraphicsPipelineDesc pipelineDesc;
-    pipelineDesc.primType = nvrhi::PrimitiveType::TriangleStrip;
-    pipelineDesc.VS = sampleView->IsReverseDepth() ? m_CommonPasses->m_FullscreenVS : m_CommonPasses->m_FullscreenAtOneVS;
-    pipelineDesc.PS = m_FXAAPixelShader;
+    // Define compute pipeline
+    nvrhi::ComputePipelineDesc pipelineDesc;
+    pipelineDesc.CS = m_FXAAComputeShader;
     pipelineDesc.bindingLayouts = { m_FXAABindingLayout };
-    pipelineDesc.renderState.rasterState.setCullNone();
-    pipelineDesc.renderState.depthStencilState.depthTestEnable = false;
-    pipelineDesc.renderState.depthStencilState.stencilEnable = false;
-    m_FXAAPipeline = device->createGraphicsPipeline(pipelineDesc, sampleFramebuffer);
+    m_FXAAPipeline = device->createComputePipeline(pipelineDesc);
+}
 
+void FXAAPass::CreateOutput(const nvrhi::TextureDesc& sourceDesc)
+{
+    // sRGB formats cannot be written by compute shaders, so the texture is typeless: the shader writes
+    // gamma-encoded values through a UNORM view and the final blit reads it as sRGB
+    nvrhi::TextureDesc outputDesc;
+    outputDesc.format = nvrhi::Format::SRGBA8_UNORM;
+    outputDesc.width = sourceDesc.width;
+    outputDesc.height = sourceDesc.height;
+    outputDesc.mipLevels = 1;
+    outputDesc.isUAV = true;
+    outputDesc.isTypeless = true;
+
+    outputDesc.debugName = "Fxaa Output Texture";
+    outputDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+    outputDesc.keepInitialState = true;
+    m_TextureOutput = m_Device->createTexture(outputDesc);
+    m_BindingCache.Clear();
 }
 
-void FXAAPass::Render(
+nvrhi::ITexture* FXAAPass::Render(
     nvrhi::ICommandList* commandList,
-    const std::shared_ptr<engine::FramebufferFactory>& framebufferFactory,
     const engine::ICompositeView& compositeView,
-    nvrhi::ITexture* sourceDestTexture)
+    nvrhi::ITexture* ldrSource)
 {
     commandList->beginMarker("FXAA");
 
     const donut::engine::IView* view = compositeView.GetChildView(donut::engine::ViewType::PLANAR, 0);
-    nvrhi::IFramebuffer* framebuffer = framebufferFactory->GetFramebuffer(*view);
-
-    nvrhi::ViewportState viewportState = view->GetViewportState();
+    nvrhi::Rect viewExtent = view->GetViewExtent();
 
-    // Define binding set
+    // The view may only cover part of the source texture; the output matches the source so that the
+    // final blit reads the same area from either
+    const nvrhi::TextureDesc& sourceDesc = ldrSource->getDesc();
+    if (!m_TextureOutput || m_TextureOutput->getDesc().width != sourceDesc.width || m_TextureOutput->getDesc().height != sourceDesc.height)
+        CreateOutput(sourceDesc);
 
     nvrhi::BindingSetDesc bindingSetDesc;
     bindingSetDesc.bindings = {
+        nvrhi::BindingSetItem::PushConstants(0, sizeof(FXAAConstants)),
         nvrhi::BindingSetItem::Sampler(0, m_CommonPasses->m_LinearClampSampler),
-        nvrhi::BindingSetItem::Texture_SRV(0, sourceDestTexture) // Will be set dynamically
+        nvrhi::BindingSetItem::Texture_SRV(0, ldrSource),
+        nvrhi::BindingSetItem::Texture_UAV(0, m_TextureOutput, nvrhi::Format::RGBA8_UNORM)
     };
-    m_FXAABindingSet = m_Device->createBindingSet(bindingSetDesc, m_FXAABindingLayout);
+    nvrhi::BindingSetHandle bindingSet = m_BindingCache.GetOrCreateBindingSet(bindingSetDesc, m_FXAABindingLayout);
 
-    // Set up graphics state
-    nvrhi::GraphicsState state;
-    state.pipeline = m_FXAAPipeline;
-    state.framebuffer = m_FramebufferOutput;
-    state.viewport = viewportState;
-    state.bindings = { m_FXAABindingSet };
+    FXAAConstants constants = {};
+    constants.viewOrigin = uint2(uint(viewExtent.minX), uint(viewExtent.minY));
+    constants.viewSize = uint2(uint(viewExtent.maxX - viewExtent.minX), uint(viewExtent.maxY - viewExtent.minY));
+    constants.invTextureSize = float2(1.f / float(sourceDesc.width), 1.f / float(sourceDesc.height));
 
-    commandList->setGraphicsState(state);
-    nvrhi::DrawArguments args;
-    args.instanceCount = 1;
-    args.vertexCount = 4;
-    commandList->draw(args); // Fullscreen quad
+    nvrhi::ComputeState state;
+    state.pipeline = m_FXAAPipeline;
+    state.bindings = { bindingSet };
 
-    BlitParameters blitParams;
-    blitParams.targetFramebuffer = framebuffer;
-    blitParams.sourceTexture = m_TextureOutput;
-    m_CommonPasses->BlitTexture(commandList, blitParams, &m_BindingCache); // blit texture to target
+    commandList->setComputeState(state);
+    commandList->setPushConstants(&constants, sizeof(constants));
+    commandList->dispatch((constants.viewSize.x + 7) / 8, (constants.viewSize.y + 7) / 8);
 
     commandList->endMarker();
+
+    return m_TextureOutput;
+}
+
+void FXAAPass::ResetBindingCache()
+{
+    m_BindingCache.Clear();
 }
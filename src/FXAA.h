@@ -1,52 +1,52 @@
 #pragma once
 
-#include <donut/engine/FramebufferFactory.h>
 #include <donut/engine/ShaderFactory.h>
 #include <donut/engine/CommonRenderPasses.h>
-#include <donut/engine/BindingCache.h>
 #include <donut/engine/View.h>
 #include <donut/core/math/math.h>
 #include <nvrhi/nvrhi.h>
 #include <memory>
-#include <unordered_map>
+
+#include "PassBindingCache.h"
 
 namespace donut::engine
 {
     class ShaderFactory;
     class CommonRenderPasses;
-    class FramebufferFactory;
     class ICompositeView;
 }
 
 namespace donut::render
 {
+    // Compute FXAA on the tone mapped LDR image. Pixels that are not on an edge are copied without filtering.
     class FXAAPass
     {
     public:
         FXAAPass(nvrhi::IDevice* device,
             const std::shared_ptr<engine::ShaderFactory>& shaderFactory,
-            std::shared_ptr<engine::CommonRenderPasses> commonPasses,
-            std::shared_ptr<engine::FramebufferFactory> framebufferFactory,
-            const engine::ICompositeView& compositeView);
+            std::shared_ptr<engine::CommonRenderPasses> commonPasses);
 
-        void Render(
+        // Filters the view area of an SRGBA8 texture and returns the texture holding the result, which has the
+        // same size and format as the source and replaces it in the final blit
+        nvrhi::ITexture* Render(
             nvrhi::ICommandList* commandList,
-            const std::shared_ptr<engine::FramebufferFactory>& framebufferFactory,
             const engine::ICompositeView& compositeView,
-            nvrhi::ITexture* sourceDestTexture);
+            nvrhi::ITexture* ldrSource);
+
+        // Call when the source texture is replaced, so that the cached binding sets do not keep it alive
+        void ResetBindingCache();
 
     private:
-        nvrhi::ShaderHandle m_FXAAPixelShader;
+        void CreateOutput(const nvrhi::TextureDesc& sourceDesc);
+
+        nvrhi::ShaderHandle m_FXAAComputeShader;
         nvrhi::BindingLayoutHandle m_FXAABindingLayout;
-        nvrhi::BindingSetHandle m_FXAABindingSet;
-        nvrhi::GraphicsPipelineHandle m_FXAAPipeline;
+        nvrhi::ComputePipelineHandle m_FXAAPipeline;
 
         nvrhi::TextureHandle m_TextureOutput;
-        nvrhi::FramebufferHandle m_FramebufferOutput;
 
         std::shared_ptr<engine::CommonRenderPasses> m_CommonPasses;
-        std::shared_ptr<engine::FramebufferFactory> m_FramebufferFactory;
         nvrhi::DeviceHandle m_Device;
-        engine::BindingCache m_BindingCache;
+        PassBindingCache m_BindingCache;
     };
 }
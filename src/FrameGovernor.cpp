@@ -0,0 +1,133 @@
+#include "FrameGovernor.h"
+
+#include <donut/core/log.h>
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+
+using namespace donut;
+
+// Render scale steps come first; each step lowers the scale by c_ResolutionStep
+static constexpr uint32_t c_ResolutionSteps = 5;
+static constexpr float c_ResolutionStep = 0.1f;
+
+// Feature steps in the order they are given up
+static const char* const c_QualitySteps[] = {
+    "SSAO off",
+    "bloom off",
+    "shadow map 1024",
+    "2 shadow cascades",
+    "light probes off"
+};
+
+// Thresholds relative to the target: lower quality above c_OverBudget, raise it below c_UnderBudget
+static constexpr float c_OverBudget = 1.05f;
+static constexpr float c_UnderBudget = 0.8f;
+static constexpr uint32_t c_FramesToStepDown = 30;
+static constexpr uint32_t c_FramesToStepUp = 120;
+static constexpr uint32_t c_CooldownFrames = 60;
+static constexpr float c_Smoothing = 0.1f;
+
+uint32_t FrameGovernor::GetMaxLevel()
+{
+    return c_ResolutionSteps + uint32_t(std::size(c_QualitySteps));
+}
+
+FrameGovernor::Limits FrameGovernor::GetLimitsForLevel(uint32_t level)
+{
+    Limits limits;
+    limits.resolutionScale = 1.f - c_ResolutionStep * float(std::min(level, c_ResolutionSteps));
+
+    uint32_t qualityLevel = level > c_ResolutionSteps ? level - c_ResolutionSteps : 0;
+    limits.allowSsao = qualityLevel < 1;
+    limits.allowBloom = qualityLevel < 2;
+    limits.shadowMapResolution = qualityLevel < 3 ? 2048 : 1024;
+    limits.shadowCascadeCount = qualityLevel < 4 ? 4 : 2;
+    limits.allowLightProbes = qualityLevel < 5;
+    return limits;
+}
+
+std::string FrameGovernor::DescribeLevel(uint32_t level)
+{
+    if (level == 0)
+        return "full quality";
+
+    if (level <= c_ResolutionSteps)
+    {
+        char text[64];
+        snprintf(text, sizeof(text), "render scale %.2f", 1.f - c_ResolutionStep * float(level));
+        return text;
+    }
+
+    return c_QualitySteps[level - c_ResolutionSteps - 1];
+}
+
+bool FrameGovernor::Update(float gpuFrameTime, float cpuFrameTime)
+{
+    // The frame cannot go faster than the slower of the two, whichever side is bound
+    float frameTime = std::max(gpuFrameTime, cpuFrameTime);
+    if (frameTime <= 0.f)
+        return false;
+
+    m_SmoothedFrameTime = m_SmoothedFrameTime == 0.f
+        ? frameTime
+        : m_SmoothedFrameTime + (frameTime - m_SmoothedFrameTime) * c_Smoothing;
+
+    // Let the frame time settle after a change before judging it again
+    if (m_CooldownFrames > 0)
+    {
+        m_CooldownFrames--;
+        return false;
+    }
+
+    if (m_SmoothedFrameTime > m_TargetFrameTime * c_OverBudget)
+    {
+        m_FramesOverBudget++;
+        m_FramesUnderBudget = 0;
+    }
+    else if (m_SmoothedFrameTime < m_TargetFrameTime * c_UnderBudget)
+    {
+        m_FramesUnderBudget++;
+        m_FramesOverBudget = 0;
+    }
+    else
+    {
+        m_FramesOverBudget = 0;
+        m_FramesUnderBudget = 0;
+    }
+
+    uint32_t level = m_Level;
+    if (m_FramesOverBudget >= c_FramesToStepDown && m_Level < GetMaxLevel())
+        level++;
+    else if (m_FramesUnderBudget >= c_FramesToStepUp && m_Level > 0)
+        level--;
+
+    if (level == m_Level)
+        return false;
+
+    char text[160];
+    snprintf(text, sizeof(text), "%.2f ms (%s bound) against a target of %.2f ms: %s %s",
+        m_SmoothedFrameTime * 1e3f, cpuFrameTime > gpuFrameTime ? "CPU" : "GPU", m_TargetFrameTime * 1e3f,
+        level > m_Level ? "lowering quality to" : "raising quality to",
+        DescribeLevel(level).c_str());
+    m_LastDecision = text;
+    log::info("Frame governor: %s", text);
+
+    m_Level = level;
+    m_Limits = GetLimitsForLevel(level);
+    m_FramesOverBudget = 0;
+    m_FramesUnderBudget = 0;
+    m_CooldownFrames = c_CooldownFrames;
+    return true;
+}
+
+void FrameGovernor::Reset()
+{
+    m_Level = 0;
+    m_Limits = Limits();
+    m_SmoothedFrameTime = 0.f;
+    m_FramesOverBudget = 0;
+    m_FramesUnderBudget = 0;
+    m_CooldownFrames = 0;
+    m_LastDecision.clear();
+}
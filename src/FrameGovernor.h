@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Holds a target frame time by lowering the quality of the frame when the measured frame time, the larger of
+// the CPU and the GPU time, stays above it, and raising it again when there is enough headroom. The render scale goes down first, then the features
+// in the order of c_QualitySteps. Changes need the frame time to stay past a threshold for a number of
+// frames and are followed by a cooldown, so the governor does not oscillate around the target.
+class FrameGovernor
+{
+public:
+    // Upper bounds for the user settings; the defaults do not limit anything
+    struct Limits
+    {
+        float resolutionScale = 1.f;
+        bool allowSsao = true;
+        bool allowBloom = true;
+        uint32_t shadowMapResolution = 2048;
+        uint32_t shadowCascadeCount = 4;
+        bool allowLightProbes = true;
+    };
+
+    void SetTargetFrameTime(float seconds) { m_TargetFrameTime = seconds; }
+    [[nodiscard]] float GetTargetFrameTime() const { return m_TargetFrameTime; }
+
+    // Feeds the GPU time of a finished frame and the CPU time the render thread spent on its last frame.
+    // Returns true when the limits changed.
+    bool Update(float gpuFrameTime, float cpuFrameTime);
+
+    // Back to full quality, e.g. when the governor is turned off or the scene changes
+    void Reset();
+
+    [[nodiscard]] const Limits& GetLimits() const { return m_Limits; }
+    [[nodiscard]] uint32_t GetLevel() const { return m_Level; }
+    [[nodiscard]] static uint32_t GetMaxLevel();
+    [[nodiscard]] float GetSmoothedFrameTime() const { return m_SmoothedFrameTime; }
+    [[nodiscard]] const std::string& GetLastDecision() const { return m_LastDecision; }
+
+private:
+    static Limits GetLimitsForLevel(uint32_t level);
+    static std::string DescribeLevel(uint32_t level);
+
+    float m_TargetFrameTime = 1.f / 60.f;
+    float m_SmoothedFrameTime = 0.f;
+    uint32_t m_Level = 0;
+    uint32_t m_FramesOverBudget = 0;
+    uint32_t m_FramesUnderBudget = 0;
+    uint32_t m_CooldownFrames = 0;
+    Limits m_Limits;
+    std::string m_LastDecision;
+};
@@ -56,21 +56,21 @@ void FullScreenYUVPass::Render(
     nvrhi::ViewportState viewportState = view->GetViewportState();
     nvrhi::IFramebuffer* framebuffer = framebufferFactory->GetFramebuffer(*view);
 
-    // Define binding set
+    // Define binding set; the video texture is the same every frame, so the set comes from the cache
 
     nvrhi::BindingSetDesc bindingSetDesc;
     bindingSetDesc.bindings = {
         nvrhi::BindingSetItem::Sampler(0, m_CommonPasses->m_LinearClampSampler),
         nvrhi::BindingSetItem::Texture_SRV(0, sourceDestTexture) // YUV Will be set dynamically
     };
-    m_BindingSet = m_Device->createBindingSet(bindingSetDesc, m_BindingLayout);
+    nvrhi::BindingSetHandle bindingSet = m_BindingCache.GetOrCreateBindingSet(bindingSetDesc, m_BindingLayout);
 
     // Set up graphics state
     nvrhi::GraphicsState state;
     state.pipeline = m_Pipeline;
     state.framebuffer = framebuffer;
     state.viewport = viewportState;
-    state.bindings = { m_BindingSet };
+    state.bindings = { bindingSet };
 
     commandList->setGraphicsState(state);
 
@@ -81,3 +81,8 @@ void FullScreenYUVPass::Render(
 
     commandList->endMarker();
 }
+
+void FullScreenYUVPass::ResetBindingCache()
+{
+    m_BindingCache.Clear();
+}
@@ -3,13 +3,14 @@
 #include <donut/engine/FramebufferFactory.h>
 #include <donut/engine/ShaderFactory.h>
 #include <donut/engine/CommonRenderPasses.h>
-#include <donut/engine/BindingCache.h>
 #include <donut/engine/View.h>
 #include <donut/core/math/math.h>
 #include <nvrhi/nvrhi.h>
 #include <memory>
 #include <unordered_map>
 
+#include "PassBindingCache.h"
+
 namespace donut::engine
 {
     class ShaderFactory;
@@ -34,15 +35,16 @@ namespace donut::render
             const engine::ICompositeView& compositeView,
             nvrhi::ITexture* sourceDestTexture);
 
+        void ResetBindingCache();
+
     private:
         nvrhi::ShaderHandle m_FullScreenYUVPixelShader;
         nvrhi::BindingLayoutHandle m_BindingLayout;
-        nvrhi::BindingSetHandle m_BindingSet;
         nvrhi::GraphicsPipelineHandle m_Pipeline;
 
         std::shared_ptr<engine::CommonRenderPasses> m_CommonPasses;
         std::shared_ptr<engine::FramebufferFactory> m_FramebufferFactory;
         nvrhi::DeviceHandle m_Device;
-        engine::BindingCache m_BindingCache;
+        PassBindingCache m_BindingCache;
     };
 }
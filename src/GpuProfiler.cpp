@@ -0,0 +1,191 @@
+#include "GpuProfiler.h"
+#include "ChromeTrace.h"
+
+#include <donut/core/log.h>
+#include <algorithm>
+#include <fstream>
+
+using namespace donut;
+
+GpuProfiler::GpuProfiler(nvrhi::IDevice* device)
+    : m_Device(device)
+{
+}
+
+bool GpuProfiler::ReadBack(FrameSlot& slot)
+{
+    for (size_t i = 0; i < slot.passes.size(); i++)
+    {
+        if (!m_Device->pollTimerQuery(slot.queries[i]))
+            return false;
+    }
+
+    FrameRecord record;
+    record.frameIndex = slot.frameIndex;
+    record.frameMs = 0.f;
+
+    for (size_t i = 0; i < slot.passes.size(); i++)
+    {
+        PassRecord pass = slot.passes[i];
+        pass.ms = m_Device->getTimerQueryTime(slot.queries[i]) * 1e3f;
+        m_Device->resetTimerQuery(slot.queries[i]);
+
+        if (pass.depth == 0)
+            record.frameMs += pass.ms;
+
+        auto [it, inserted] = m_Timings.try_emplace(pass.name, PassTiming{ pass.name, pass.ms, pass.ms, pass.ms });
+        if (!inserted)
+        {
+            PassTiming& timing = it->second;
+            timing.lastMs = pass.ms;
+            timing.averageMs += (pass.ms - timing.averageMs) * c_AverageWeight;
+            timing.maxMs = std::max(timing.maxMs, pass.ms);
+        }
+
+        record.passes.push_back(pass);
+    }
+
+    m_LastFrameTime = record.frameMs * 1e-3f;
+
+    m_History.push_back(std::move(record));
+    if (m_History.size() > c_HistoryFrames)
+        m_History.pop_front();
+
+    slot.passes.clear();
+    slot.pending = false;
+    return true;
+}
+
+bool GpuProfiler::BeginFrame()
+{
+    if (!m_OpenPasses.empty())
+    {
+        log::warning("GpuProfiler: %zu passes were not ended", m_OpenPasses.size());
+        m_OpenPasses.clear();
+    }
+
+    m_CurrentSlot = (m_CurrentSlot + 1) % c_FrameSlots;
+    m_FrameIndex++;
+
+    FrameSlot& slot = m_Slots[m_CurrentSlot];
+    bool readBack = slot.pending;
+    if (readBack && !ReadBack(slot))
+    {
+        // The GPU is too far behind to reuse the queries of this slot
+        m_Recording = false;
+        return false;
+    }
+
+    slot.frameIndex = m_FrameIndex;
+    m_Recording = true;
+    return readBack;
+}
+
+uint32_t GpuProfiler::AddPass(const char* name)
+{
+    FrameSlot& slot = m_Slots[m_CurrentSlot];
+    uint32_t index = uint32_t(slot.passes.size());
+    if (index == slot.queries.size())
+        slot.queries.push_back(m_Device->createTimerQuery());
+
+    slot.passes.push_back(PassRecord{ name, uint32_t(m_OpenPasses.size()), 0.f });
+    slot.pending = true;
+    return index;
+}
+
+void GpuProfiler::BeginPass(nvrhi::ICommandList* commandList, const char* name)
+{
+    if (!m_Recording)
+        return;
+
+    uint32_t index = AddPass(name);
+    m_OpenPasses.push_back(index);
+
+    commandList->beginTimerQuery(m_Slots[m_CurrentSlot].queries[index]);
+}
+
+void GpuProfiler::EndPass(nvrhi::ICommandList* commandList)
+{
+    if (!m_Recording || m_OpenPasses.empty())
+        return;
+
+    FrameSlot& slot = m_Slots[m_CurrentSlot];
+    commandList->endTimerQuery(slot.queries[m_OpenPasses.back()]);
+    m_OpenPasses.pop_back();
+}
+
+nvrhi::ITimerQuery* GpuProfiler::ReservePass(const char* name)
+{
+    if (!m_Recording)
+        return nullptr;
+
+    // The handle stays valid when the vector grows during the recording
+    return m_Slots[m_CurrentSlot].queries[AddPass(name)];
+}
+
+std::vector<GpuProfiler::PassTiming> GpuProfiler::GetSortedPassTimings() const
+{
+    std::vector<PassTiming> timings;
+    timings.reserve(m_Timings.size());
+    for (const auto& [name, timing] : m_Timings)
+        timings.push_back(timing);
+
+    std::sort(timings.begin(), timings.end(), [](const PassTiming& a, const PassTiming& b) { return a.averageMs > b.averageMs; });
+    return timings;
+}
+
+std::vector<float> GpuProfiler::GetFrameHistory() const
+{
+    std::vector<float> history;
+    history.reserve(m_History.size());
+    for (const FrameRecord& record : m_History)
+        history.push_back(record.frameMs);
+    return history;
+}
+
+bool GpuProfiler::WriteCsv(const std::filesystem::path& path) const
+{
+    std::ofstream stream(path, std::ios::trunc);
+    if (!stream)
+        return false;
+
+    stream << "frame,pass,depth,ms\n";
+    for (const FrameRecord& record : m_History)
+    {
+        for (const PassRecord& pass : record.passes)
+            stream << record.frameIndex << ',' << pass.name << ',' << pass.depth << ',' << pass.ms << '\n';
+    }
+
+    return bool(stream);
+}
+
+bool GpuProfiler::WriteChromeTrace(const std::filesystem::path& path) const
+{
+    ChromeTraceWriter writer(path);
+    if (!writer.IsOpen())
+        return false;
+
+    writer.ThreadName(0, "GPU");
+
+    double frameStart = 0.0;
+    for (const FrameRecord& record : m_History)
+    {
+        // Start of the next pass at each depth; a nested pass starts where its parent or previous sibling did
+        std::vector<double> cursor(1, frameStart);
+        for (const PassRecord& pass : record.passes)
+        {
+            cursor.resize(pass.depth + 2, 0.0);
+            double start = cursor[pass.depth];
+            double duration = double(pass.ms) * 1e3;
+
+            writer.Complete(0, start, duration, pass.name, "gpu", int64_t(record.frameIndex));
+
+            cursor[pass.depth] = start + duration;
+            cursor[pass.depth + 1] = start;
+        }
+
+        frameStart += double(record.frameMs) * 1e3;
+    }
+
+    return writer.Close();
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <nvrhi/nvrhi.h>
+#include <deque>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Measures render passes with timer queries. The queries of a frame are read back when its slot in the
+// ring comes around again, so readback never waits for the GPU; when the GPU is more than c_FrameSlots
+// frames behind, the frame is not measured. Pass names must be string literals, they are kept as pointers
+// and passes with the same name are added up in the table.
+//
+// Scopes can nest. Top-level scopes add up to the frame time, nested ones show up in the table and the
+// trace with their parent's time including theirs.
+class GpuProfiler
+{
+public:
+    struct PassTiming
+    {
+        const char* name;
+        float lastMs;
+        float averageMs;
+        float maxMs;
+    };
+
+    explicit GpuProfiler(nvrhi::IDevice* device);
+
+    // Reads back the oldest frame and starts recording a new one. The scopes recorded until the next call
+    // belong to the new frame, whichever command list they are on. Returns true when a frame was read back,
+    // GetLastFrameTime then holds its time.
+    bool BeginFrame();
+
+    void BeginPass(nvrhi::ICommandList* commandList, const char* name);
+    void EndPass(nvrhi::ICommandList* commandList);
+
+    // For a pass that is recorded on another thread: adds it at the current position and nesting level and
+    // returns the query that the recording thread brackets it with (beginTimerQuery and endTimerQuery),
+    // or nullptr when the frame is not measured. Called on the thread that calls BeginPass.
+    nvrhi::ITimerQuery* ReservePass(const char* name);
+
+    class Scope
+    {
+    public:
+        Scope(GpuProfiler& profiler, nvrhi::ICommandList* commandList, const char* name)
+            : m_Profiler(profiler)
+            , m_CommandList(commandList)
+        {
+            m_Profiler.BeginPass(m_CommandList, name);
+        }
+
+        ~Scope() { m_Profiler.EndPass(m_CommandList); }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        GpuProfiler& m_Profiler;
+        nvrhi::ICommandList* m_CommandList;
+    };
+
+    // Sorted by average time, slowest first
+    [[nodiscard]] std::vector<PassTiming> GetSortedPassTimings() const;
+    // GPU time of the last frame that was read back, in seconds, or 0 when none has been yet
+    [[nodiscard]] float GetLastFrameTime() const { return m_LastFrameTime; }
+    // Frame times in milliseconds, oldest first
+    [[nodiscard]] std::vector<float> GetFrameHistory() const;
+
+    bool WriteCsv(const std::filesystem::path& path) const;
+    // The queries only measure durations, so the passes of a frame are laid out back to back
+    bool WriteChromeTrace(const std::filesystem::path& path) const;
+
+private:
+    static constexpr uint32_t c_FrameSlots = 4;
+    static constexpr size_t c_HistoryFrames = 240;
+    static constexpr float c_AverageWeight = 0.05f;
+
+    struct PassRecord
+    {
+        const char* name;
+        uint32_t depth;
+        float ms;
+    };
+
+    struct FrameSlot
+    {
+        std::vector<nvrhi::TimerQueryHandle> queries;
+        std::vector<PassRecord> passes;
+        uint64_t frameIndex = 0;
+        bool pending = false;
+    };
+
+    struct FrameRecord
+    {
+        uint64_t frameIndex;
+        float frameMs;
+        std::vector<PassRecord> passes;
+    };
+
+    bool ReadBack(FrameSlot& slot);
+    uint32_t AddPass(const char* name);
+
+    nvrhi::DeviceHandle m_Device;
+    FrameSlot m_Slots[c_FrameSlots];
+    uint32_t m_CurrentSlot = 0;
+    uint64_t m_FrameIndex = 0;
+    bool m_Recording = false;
+    std::vector<uint32_t> m_OpenPasses;
+
+    float m_LastFrameTime = 0.f;
+    std::unordered_map<std::string_view, PassTiming> m_Timings;
+    std::deque<FrameRecord> m_History;
+};
@@ -0,0 +1,303 @@
+#include "LightProbeBaker.h"
+
+#include <donut/engine/SceneTypes.h>
+#include <nvrhi/utils.h>
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+using namespace donut::math;
+using namespace donut::engine;
+using namespace donut::render;
+
+// Steps of a bake, in order: the shadow map, the six faces, the mip chain, the diffuse SH, one step per
+// specular mip, and the environment BRDF with the finished callback
+static constexpr uint32_t c_ShadowStep = 0;
+static constexpr uint32_t c_FirstFaceStep = 1;
+static constexpr uint32_t c_MipsStep = c_FirstFaceStep + 6;
+static constexpr uint32_t c_DiffuseStep = c_MipsStep + 1;
+static constexpr uint32_t c_FirstSpecularStep = c_DiffuseStep + 1;
+
+LightProbeBaker::LightProbeBaker(nvrhi::IDevice* device,
+    std::shared_ptr<ShaderFactory> shaderFactory,
+    std::shared_ptr<CommonRenderPasses> commonPasses,
+    const CreateParameters& params,
+    FinishedCallback finishedCallback)
+    : m_Params(params)
+    , m_FinishedCallback(std::move(finishedCallback))
+{
+    nvrhi::TextureDesc cubemapDesc;
+    cubemapDesc.arraySize = 6;
+    cubemapDesc.width = params.environmentMapSize;
+    cubemapDesc.height = params.environmentMapSize;
+    cubemapDesc.mipLevels = params.environmentMapMipLevels;
+    cubemapDesc.dimension = nvrhi::TextureDimension::TextureCube;
+    cubemapDesc.isRenderTarget = true;
+    cubemapDesc.format = nvrhi::Format::RGBA16_FLOAT;
+    cubemapDesc.initialState = nvrhi::ResourceStates::RenderTarget;
+    cubemapDesc.keepInitialState = true;
+    cubemapDesc.clearValue = nvrhi::Color(0.f);
+    cubemapDesc.useClearValue = true;
+    cubemapDesc.debugName = "LightProbeBaker Color";
+
+    m_ColorTexture = device->createTexture(cubemapDesc);
+
+    const nvrhi::Format depthFormats[] = {
+        nvrhi::Format::D24S8,
+        nvrhi::Format::D32,
+        nvrhi::Format::D16,
+        nvrhi::Format::D32S8 };
+
+    const nvrhi::FormatSupport depthFeatures =
+        nvrhi::FormatSupport::Texture |
+        nvrhi::FormatSupport::DepthStencil |
+        nvrhi::FormatSupport::ShaderLoad;
+
+    cubemapDesc.mipLevels = 1;
+    cubemapDesc.format = nvrhi::utils::ChooseFormat(device, depthFeatures, depthFormats, std::size(depthFormats));
+    cubemapDesc.isTypeless = true;
+    cubemapDesc.initialState = nvrhi::ResourceStates::DepthWrite;
+    cubemapDesc.debugName = "LightProbeBaker Depth";
+
+    m_DepthTexture = device->createTexture(cubemapDesc);
+
+    nvrhi::TextureDesc filteredDesc;
+    filteredDesc.arraySize = 6;
+    filteredDesc.dimension = nvrhi::TextureDimension::TextureCube;
+    filteredDesc.isRenderTarget = true;
+    filteredDesc.format = nvrhi::Format::RGBA16_FLOAT;
+    filteredDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+    filteredDesc.keepInitialState = true;
+
+    filteredDesc.width = params.specularMapSize;
+    filteredDesc.height = params.specularMapSize;
+    filteredDesc.mipLevels = params.specularMapMipLevels;
+    filteredDesc.debugName = "LightProbeBaker Specular";
+    m_SpecularMap = device->createTexture(filteredDesc);
+
+    m_DiffuseCoefficients = LightProbeSHPass::CreateCoefficientBuffer(device, "LightProbeBaker DiffuseCoefficients");
+
+    m_Framebuffer = std::make_shared<FramebufferFactory>(device);
+    m_Framebuffer->RenderTargets = { m_ColorTexture };
+    m_Framebuffer->DepthTarget = m_DepthTexture;
+
+    m_View.SetArrayViewports(params.environmentMapSize, 0);
+    m_View.SetTransform(affine3::identity(), params.nearPlane, params.cullDistance);
+    m_View.UpdateCache();
+
+    m_ShadowMap = std::make_shared<CascadedShadowMap>(device, params.shadowMapResolution, params.shadowCascadeCount, 0, params.shadowMapFormat);
+    m_ShadowMap->SetupProxyViews();
+
+    m_ShadowFramebuffer = std::make_shared<FramebufferFactory>(device);
+    m_ShadowFramebuffer->DepthTarget = m_ShadowMap->GetTexture();
+
+    m_SkyPass = std::make_shared<SkyPass>(device, shaderFactory, commonPasses, m_Framebuffer, m_View);
+
+    // The faces are drawn in separate steps, so the forward pass draws planar views
+    ForwardShadingPass::CreateParameters forwardParams;
+    forwardParams.singlePassCubemap = false;
+    m_ForwardPass = std::make_shared<ForwardShadingPass>(device, commonPasses);
+    m_ForwardPass->Init(*shaderFactory, forwardParams);
+
+    m_ShadowDepthPass = std::make_shared<DepthPass>(device, commonPasses);
+    m_ShadowDepthPass->Init(*shaderFactory, params.shadowDepthParams);
+}
+
+void LightProbeBaker::RequestBake(const std::shared_ptr<LightProbe>& probe, const float3& position)
+{
+    auto queued = std::find_if(m_Queue.begin(), m_Queue.end(), [&probe](const Request& request)
+    {
+        return request.probe == probe;
+    });
+
+    if (queued != m_Queue.end())
+        queued->position = position;
+    else
+        m_Queue.push_back({ probe, position });
+}
+
+void LightProbeBaker::Cancel()
+{
+    m_Queue.clear();
+    m_Current.reset();
+    m_NextStep = 0;
+}
+
+void LightProbeBaker::ResetBindingCaches()
+{
+    m_ForwardPass->ResetBindingCache();
+    m_ShadowDepthPass->ResetBindingCache();
+}
+
+uint32_t LightProbeBaker::GetStepCount() const
+{
+    return c_FirstSpecularStep + m_Params.specularMapMipLevels + 1;
+}
+
+float LightProbeBaker::GetProgress() const
+{
+    if (!m_Current)
+        return 0.f;
+
+    return float(m_NextStep) / float(GetStepCount());
+}
+
+void LightProbeBaker::BeginBake(const Request& request)
+{
+    m_Current = request.probe;
+    m_CurrentPosition = request.position;
+    m_NextStep = 0;
+
+    m_View.SetTransform(translation(-request.position), m_Params.nearPlane, m_Params.cullDistance);
+    m_View.UpdateCache();
+}
+
+void LightProbeBaker::Update(nvrhi::ICommandList* commandList,
+    const SceneInputs& inputs,
+    LightProbeProcessingPass& processingPass,
+    LightProbeSHPass& shPass,
+    uint32_t maxSteps)
+{
+    for (uint32_t step = 0; step < maxSteps; step++)
+    {
+        if (!m_Current)
+        {
+            if (m_Queue.empty())
+                return;
+
+            BeginBake(m_Queue.front());
+            m_Queue.pop_front();
+        }
+
+        RecordStep(commandList, inputs, processingPass, shPass);
+    }
+}
+
+void LightProbeBaker::RecordStep(nvrhi::ICommandList* commandList, const SceneInputs& inputs,
+    LightProbeProcessingPass& processingPass, LightProbeSHPass& shPass)
+{
+    uint32_t step = m_NextStep++;
+
+    if (step == c_ShadowStep)
+    {
+        RenderShadowMap(commandList, inputs);
+    }
+    else if (step < c_MipsStep)
+    {
+        RenderFace(commandList, inputs, step - c_FirstFaceStep);
+    }
+    else if (step == c_MipsStep)
+    {
+        commandList->beginMarker("LightProbe Mips");
+        processingPass.GenerateCubemapMips(commandList, m_ColorTexture, 0, 0, m_Params.environmentMapMipLevels - 1);
+        commandList->endMarker();
+    }
+    else if (step == c_DiffuseStep)
+    {
+        shPass.Project(commandList, m_ColorTexture, m_DiffuseCoefficients);
+    }
+    else if (step + 1 < GetStepCount())
+    {
+        uint32_t mipLevel = step - c_FirstSpecularStep;
+        float roughness = powf(float(mipLevel) / float(std::max(m_Params.specularMapMipLevels, 2u) - 1), 2.0f);
+
+        commandList->beginMarker("LightProbe Specular");
+        processingPass.RenderSpecularMap(commandList, roughness, m_ColorTexture, nvrhi::AllSubresources, m_SpecularMap, 0, mipLevel);
+        commandList->endMarker();
+    }
+    else
+    {
+        FinishBake(commandList, processingPass);
+    }
+}
+
+void LightProbeBaker::RenderShadowMap(nvrhi::ICommandList* commandList, const SceneInputs& inputs)
+{
+    if (!inputs.sunLight)
+        return;
+
+    commandList->beginMarker("LightProbe ShadowMap");
+
+    box3 sceneBounds = inputs.rootNode->GetGlobalBoundingBox();
+    float zRange = length(sceneBounds.diagonal()) * 0.5f;
+    m_ShadowMap->SetupForCubemapView(*inputs.sunLight, m_View.GetViewOrigin(), m_Params.cullDistance, zRange, zRange, inputs.csmExponent);
+    m_ShadowMap->Clear(commandList);
+
+    DepthPass::Context shadowContext;
+    RenderCompositeView(commandList,
+        &m_ShadowMap->GetView(), nullptr,
+        *m_ShadowFramebuffer,
+        inputs.rootNode,
+        m_OpaqueDrawStrategy,
+        *m_ShadowDepthPass,
+        shadowContext,
+        "ShadowMap");
+
+    commandList->endMarker();
+}
+
+void LightProbeBaker::RenderFace(nvrhi::ICommandList* commandList, const SceneInputs& inputs, uint32_t face)
+{
+    const IView* faceView = m_View.GetChildView(ViewType::PLANAR, face);
+    nvrhi::TextureSubresourceSet subresources = faceView->GetSubresources();
+
+    commandList->beginMarker("LightProbe Face");
+
+    commandList->clearTextureFloat(m_ColorTexture, subresources, nvrhi::Color(0.f));
+    const nvrhi::FormatInfo& depthFormatInfo = nvrhi::getFormatInfo(m_DepthTexture->getDesc().format);
+    commandList->clearDepthStencilTexture(m_DepthTexture, subresources, true, 0.f, depthFormatInfo.hasStencil, 0);
+
+    // The sun lights the probe with the bake's shadow map, the frame sets its own again before it draws
+    std::shared_ptr<IShadowMap> frameShadowMap;
+    if (inputs.sunLight)
+    {
+        frameShadowMap = inputs.sunLight->shadowMap;
+        inputs.sunLight->shadowMap = m_ShadowMap;
+    }
+
+    ForwardShadingPass::Context forwardContext;
+    std::vector<std::shared_ptr<LightProbe>> lightProbes;
+    m_ForwardPass->PrepareLights(forwardContext, commandList, *inputs.lights, inputs.ambientTop, inputs.ambientBottom, lightProbes);
+
+    if (inputs.sunLight)
+        inputs.sunLight->shadowMap = frameShadowMap;
+
+    RenderCompositeView(commandList,
+        faceView, nullptr,
+        *m_Framebuffer,
+        inputs.rootNode,
+        m_OpaqueDrawStrategy,
+        *m_ForwardPass,
+        forwardContext,
+        "ForwardOpaque");
+
+    if (inputs.sunLight && inputs.skyParams)
+        m_SkyPass->Render(commandList, *faceView, *inputs.sunLight, *inputs.skyParams);
+
+    RenderCompositeView(commandList,
+        faceView, nullptr,
+        *m_Framebuffer,
+        inputs.rootNode,
+        m_TransparentDrawStrategy,
+        *m_ForwardPass,
+        forwardContext,
+        "ForwardTransparent");
+
+    commandList->endMarker();
+}
+
+void LightProbeBaker::FinishBake(nvrhi::ICommandList* commandList, LightProbeProcessingPass& processingPass)
+{
+    if (m_EnvironmentBrdf != processingPass.GetEnvironmentBrdfTexture())
+    {
+        processingPass.RenderEnvironmentBrdfTexture(commandList);
+        m_EnvironmentBrdf = processingPass.GetEnvironmentBrdfTexture();
+    }
+
+    box3 bounds = box3(m_CurrentPosition, m_CurrentPosition).grow(m_Params.influenceRadius);
+    if (m_FinishedCallback)
+        m_FinishedCallback(commandList, m_Current, bounds);
+
+    m_Current.reset();
+    m_NextStep = 0;
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <donut/engine/CommonRenderPasses.h>
+#include <donut/engine/FramebufferFactory.h>
+#include <donut/engine/SceneGraph.h>
+#include <donut/engine/ShaderFactory.h>
+#include <donut/engine/View.h>
+#include <donut/render/CascadedShadowMap.h>
+#include <donut/render/DepthPass.h>
+#include <donut/render/DrawStrategy.h>
+#include <donut/render/ForwardShadingPass.h>
+#include <donut/render/LightProbeProcessingPass.h>
+#include <donut/render/SkyPass.h>
+#include <nvrhi/nvrhi.h>
+#include <deque>
+#include <functional>
+#include <memory>
+
+#include "LightProbeSHPass.h"
+
+// Bakes light probes in the background of the regular frames. The environment cubemap, the passes and a
+// shadow map of its own are created once; bake requests are queued, and every Update records the next few
+// steps of the current bake into the frame's command list: the shadow map, one cube face at a time, the
+// mip chain, the diffuse SH projection and one specular mip at a time. The diffuse coefficients and the
+// specular cubemap are kept by the baker and handed to the finished callback, which moves them into the
+// probe; the probe keeps its previous contents and enabled state until then, so rebaking does not switch
+// it off.
+class LightProbeBaker
+{
+public:
+    struct CreateParameters
+    {
+        uint32_t environmentMapSize = 1024;
+        uint32_t environmentMapMipLevels = 8;
+        uint32_t shadowMapResolution = 2048;
+        uint32_t shadowCascadeCount = 4;
+        nvrhi::Format shadowMapFormat = nvrhi::Format::D24S8;
+        donut::render::DepthPass::CreateParameters shadowDepthParams;
+        float nearPlane = 0.1f;
+        float cullDistance = 100.f;
+        // Half size of the box around the capture position that the probe applies to
+        float influenceRadius = 10.f;
+        uint32_t specularMapSize = 512;
+        uint32_t specularMapMipLevels = 8;
+    };
+
+    // Called from Update when a bake is complete, with the commands that filled GetDiffuseCoefficients and
+    // GetSpecularMap recorded into the command list. Both are overwritten by the next bake.
+    using FinishedCallback = std::function<void(nvrhi::ICommandList* commandList,
+        const std::shared_ptr<donut::engine::LightProbe>& probe, const donut::math::box3& bounds)>;
+
+    // What the bake steps draw; read again by every Update, so edits to the lighting reach the running bake
+    struct SceneInputs
+    {
+        std::shared_ptr<donut::engine::SceneGraphNode> rootNode;
+        const std::vector<std::shared_ptr<donut::engine::Light>>* lights = nullptr;
+        donut::engine::DirectionalLight* sunLight = nullptr;
+        const donut::render::SkyParameters* skyParams = nullptr;
+        donut::math::float3 ambientTop = 0.f;
+        donut::math::float3 ambientBottom = 0.f;
+        float csmExponent = 4.f;
+    };
+
+    LightProbeBaker(nvrhi::IDevice* device,
+        std::shared_ptr<donut::engine::ShaderFactory> shaderFactory,
+        std::shared_ptr<donut::engine::CommonRenderPasses> commonPasses,
+        const CreateParameters& params,
+        FinishedCallback finishedCallback);
+
+    // Queues a bake of the probe at the position. A probe that is already queued only moves to the new
+    // position; a probe that is being baked is queued again and baked once more after the current bake.
+    void RequestBake(const std::shared_ptr<donut::engine::LightProbe>& probe, const donut::math::float3& position);
+
+    // Records up to maxSteps steps of the pending bakes; call once per frame on the render thread, after the
+    // scene buffers were refreshed.
+    void Update(nvrhi::ICommandList* commandList,
+        const SceneInputs& inputs,
+        donut::render::LightProbeProcessingPass& processingPass,
+        donut::render::LightProbeSHPass& shPass,
+        uint32_t maxSteps);
+
+    // Drops the queue and the current bake, e.g. when the scene is unloaded
+    void Cancel();
+
+    void ResetBindingCaches();
+
+    [[nodiscard]] bool IsBaking() const { return m_Current != nullptr || !m_Queue.empty(); }
+    [[nodiscard]] const donut::engine::LightProbe* GetCurrentProbe() const { return m_Current.get(); }
+    // Progress of the current bake, from 0 to 1
+    [[nodiscard]] float GetProgress() const;
+    [[nodiscard]] uint32_t GetQueuedCount() const { return uint32_t(m_Queue.size()); }
+    // LightProbeSHPass coefficients of the diffuse lighting
+    [[nodiscard]] nvrhi::IBuffer* GetDiffuseCoefficients() const { return m_DiffuseCoefficients; }
+    [[nodiscard]] nvrhi::ITexture* GetSpecularMap() const { return m_SpecularMap; }
+
+private:
+    struct Request
+    {
+        std::shared_ptr<donut::engine::LightProbe> probe;
+        donut::math::float3 position;
+    };
+
+    [[nodiscard]] uint32_t GetStepCount() const;
+    void BeginBake(const Request& request);
+    void RecordStep(nvrhi::ICommandList* commandList, const SceneInputs& inputs,
+        donut::render::LightProbeProcessingPass& processingPass, donut::render::LightProbeSHPass& shPass);
+    void RenderShadowMap(nvrhi::ICommandList* commandList, const SceneInputs& inputs);
+    void RenderFace(nvrhi::ICommandList* commandList, const SceneInputs& inputs, uint32_t face);
+    void FinishBake(nvrhi::ICommandList* commandList, donut::render::LightProbeProcessingPass& processingPass);
+
+    CreateParameters m_Params;
+    FinishedCallback m_FinishedCallback;
+
+    nvrhi::TextureHandle m_ColorTexture;
+    nvrhi::TextureHandle m_DepthTexture;
+    nvrhi::BufferHandle m_DiffuseCoefficients;
+    nvrhi::TextureHandle m_SpecularMap;
+    // The environment BRDF does not depend on the scene, it is rendered once per processing pass texture
+    nvrhi::TextureHandle m_EnvironmentBrdf;
+    std::shared_ptr<donut::engine::FramebufferFactory> m_Framebuffer;
+    donut::engine::CubemapView m_View;
+
+    // The frame's shadow map is set up for the camera again every frame, the bake needs one that stays
+    std::shared_ptr<donut::render::CascadedShadowMap> m_ShadowMap;
+    std::shared_ptr<donut::engine::FramebufferFactory> m_ShadowFramebuffer;
+
+    std::shared_ptr<donut::render::SkyPass> m_SkyPass;
+    std::shared_ptr<donut::render::ForwardShadingPass> m_ForwardPass;
+    std::shared_ptr<donut::render::DepthPass> m_ShadowDepthPass;
+    donut::render::InstancedOpaqueDrawStrategy m_OpaqueDrawStrategy;
+    donut::render::TransparentDrawStrategy m_TransparentDrawStrategy;
+
+    std::deque<Request> m_Queue;
+    std::shared_ptr<donut::engine::LightProbe> m_Current;
+    donut::math::float3 m_CurrentPosition = 0.f;
+    uint32_t m_NextStep = 0;
+};
@@ -0,0 +1,550 @@
+#include "LightProbeCache.h"
+
+#include <donut/core/log.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <utility>
+
+#include "BC6H.h"
+
+using namespace donut;
+using namespace donut::math;
+using namespace donut::engine;
+using namespace donut::render;
+
+namespace
+{
+    constexpr uint32_t c_Magic = 0x43504c59; // "YLPC"
+    constexpr uint32_t c_Version = 2;
+
+    // Larger specular maps in a file are taken as corruption, they are well above what the baker renders
+    constexpr uint32_t c_MaxCubeSize = 4096;
+    constexpr uint32_t c_MaxCubeMipLevels = 13;
+
+    // File layout: FileHeader, the environment BRDF texels, then a ProbeRecord followed by the specular
+    // blocks for every probe
+    struct FileHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t probeCount;
+        uint32_t brdfFormat;
+        uint32_t brdfWidth;
+        uint32_t brdfHeight;
+        uint64_t brdfBytes;
+    };
+
+    struct ProbeRecord
+    {
+        uint32_t index;
+        float boundsMin[3];
+        float boundsMax[3];
+        float diffuseCoefficients[LightProbeSHPass::c_CoefficientCount][4];
+        uint32_t specularSize;
+        uint32_t specularMipLevels;
+        uint32_t reserved;
+        uint64_t specularBytes;
+    };
+
+    size_t GetCubeBlockBytes(uint32_t size, uint32_t mipLevels)
+    {
+        size_t bytes = 0;
+        for (uint32_t mipLevel = 0; mipLevel < mipLevels; mipLevel++)
+        {
+            uint32_t mipSize = std::max(size >> mipLevel, 1u);
+            bytes += GetBC6HSize(mipSize, mipSize);
+        }
+        return bytes * 6;
+    }
+
+    bool MatchesTexture(uint32_t size, uint32_t mipLevels, nvrhi::ITexture* texture)
+    {
+        const nvrhi::TextureDesc& desc = texture->getDesc();
+        return desc.format == nvrhi::Format::BC6H_UFLOAT && desc.width == size && desc.mipLevels == mipLevels;
+    }
+}
+
+LightProbeCache::LightProbeCache(nvrhi::IDevice* device, std::shared_ptr<ThreadPool> threadPool)
+    : m_Device(device)
+    , m_ThreadPool(std::move(threadPool))
+{
+}
+
+LightProbeCache::~LightProbeCache()
+{
+    Close();
+}
+
+uint32_t LightProbeCache::GetCachedProbeCount() const
+{
+    return uint32_t(std::count_if(m_Probes.begin(), m_Probes.end(), [](const auto& probe) { return probe != nullptr; }));
+}
+
+bool LightProbeCache::Load(const std::filesystem::path& cacheFile, const std::vector<std::shared_ptr<LightProbe>>& probes,
+    nvrhi::ITexture* environmentBrdf)
+{
+    Close();
+
+    m_CacheFile = cacheFile;
+    m_ProbeObjects = probes;
+    m_Probes.resize(probes.size());
+
+    std::ifstream stream(cacheFile, std::ios::binary);
+    if (!stream)
+        return false;
+
+    FileHeader header;
+    if (!stream.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != c_Magic)
+    {
+        log::warning("Light probe cache '%s' is not valid", cacheFile.generic_string().c_str());
+        return false;
+    }
+
+    if (header.version != c_Version)
+    {
+        log::warning("Light probe cache '%s' has an unsupported version %u", cacheFile.generic_string().c_str(), header.version);
+        return false;
+    }
+
+    // The BRDF is uploaded as one texture, so its size has to match the texels exactly. A file that was written
+    // without one has no texels.
+    const nvrhi::TextureDesc& brdfDesc = environmentBrdf->getDesc();
+    uint64_t brdfBytes = uint64_t(brdfDesc.width) * brdfDesc.height * nvrhi::getFormatInfo(brdfDesc.format).bytesPerBlock;
+    if (header.brdfBytes != 0 && (header.brdfFormat != uint32_t(brdfDesc.format) ||
+        header.brdfWidth != brdfDesc.width || header.brdfHeight != brdfDesc.height || header.brdfBytes != brdfBytes))
+    {
+        log::warning("Light probe cache '%s' has an environment BRDF of another format", cacheFile.generic_string().c_str());
+        return false;
+    }
+
+    auto brdf = std::make_shared<BrdfData>();
+    brdf->format = brdfDesc.format;
+    brdf->width = brdfDesc.width;
+    brdf->height = brdfDesc.height;
+    brdf->texels.resize(size_t(header.brdfBytes));
+    if (!stream.read(reinterpret_cast<char*>(brdf->texels.data()), std::streamsize(brdf->texels.size())))
+    {
+        log::warning("Light probe cache '%s' is truncated", cacheFile.generic_string().c_str());
+        return false;
+    }
+
+    std::vector<std::shared_ptr<const ProbeData>> loaded(probes.size());
+
+    for (uint32_t i = 0; i < header.probeCount; i++)
+    {
+        ProbeRecord record;
+        if (!stream.read(reinterpret_cast<char*>(&record), sizeof(record)))
+        {
+            log::warning("Light probe cache '%s' is truncated", cacheFile.generic_string().c_str());
+            return false;
+        }
+
+        // The next record is found through the size of the blocks, so a record that is not consistent
+        // cannot be skipped
+        if (record.specularSize == 0 || record.specularSize > c_MaxCubeSize ||
+            record.specularMipLevels == 0 || record.specularMipLevels > c_MaxCubeMipLevels ||
+            record.specularBytes != GetCubeBlockBytes(record.specularSize, record.specularMipLevels))
+        {
+            log::warning("Light probe cache '%s' is corrupt", cacheFile.generic_string().c_str());
+            return false;
+        }
+
+        // Probes that were baked with other map sizes are baked again
+        if (record.index >= probes.size() ||
+            !MatchesTexture(record.specularSize, record.specularMipLevels, probes[record.index]->specularMap))
+        {
+            stream.seekg(std::streamoff(record.specularBytes), std::ios::cur);
+            continue;
+        }
+
+        auto data = std::make_shared<ProbeData>();
+        data->bounds = box3(float3(record.boundsMin), float3(record.boundsMax));
+        memcpy(data->diffuseCoefficients, record.diffuseCoefficients, sizeof(data->diffuseCoefficients));
+        data->specular.size = record.specularSize;
+        data->specular.mipLevels = record.specularMipLevels;
+        data->specular.blocks.resize(size_t(record.specularBytes));
+
+        if (!stream.read(reinterpret_cast<char*>(data->specular.blocks.data()), std::streamsize(record.specularBytes)))
+        {
+            log::warning("Light probe cache '%s' is truncated", cacheFile.generic_string().c_str());
+            return false;
+        }
+
+        loaded[record.index] = std::move(data);
+    }
+
+    m_Probes = std::move(loaded);
+    for (uint32_t index = 0; index < uint32_t(m_Probes.size()); index++)
+    {
+        if (m_Probes[index])
+            m_PendingUploads.push_back(index);
+    }
+
+    if (!brdf->texels.empty())
+    {
+        m_Brdf = std::move(brdf);
+        m_BrdfUploadPending = true;
+    }
+
+    log::info("Loaded %u light probes from '%s'", uint32_t(m_PendingUploads.size()), cacheFile.generic_string().c_str());
+    return !m_PendingUploads.empty();
+}
+
+void LightProbeCache::Close()
+{
+    for (PendingCapture& capture : m_Captures)
+    {
+        if (capture.compression)
+            capture.compression->Wait();
+    }
+    m_Captures.clear();
+
+    if (m_SaveTask)
+        m_SaveTask->Wait();
+    m_SaveTask.reset();
+
+    // The last bakes are kept even when the scene goes away right after them
+    if (m_SaveRequested)
+        Write(m_CacheFile, m_Probes, m_Brdf);
+    m_SaveRequested = false;
+
+    m_ProbeObjects.clear();
+    m_Probes.clear();
+    m_PendingUploads.clear();
+    m_Brdf.reset();
+    m_EnvironmentBrdf = nullptr;
+    m_BrdfUploadPending = false;
+}
+
+nvrhi::StagingTextureHandle LightProbeCache::CreateReadback(nvrhi::ITexture* texture)
+{
+    nvrhi::TextureDesc desc = texture->getDesc();
+    desc.dimension = desc.arraySize > 1 ? nvrhi::TextureDimension::Texture2DArray : nvrhi::TextureDimension::Texture2D;
+    desc.isRenderTarget = false;
+    desc.isUAV = false;
+    desc.isTypeless = false;
+    desc.useClearValue = false;
+    desc.initialState = nvrhi::ResourceStates::CopyDest;
+    desc.keepInitialState = true;
+    desc.debugName = "LightProbeCache Readback";
+    return m_Device->createStagingTexture(desc, nvrhi::CpuAccessMode::Read);
+}
+
+nvrhi::BufferHandle LightProbeCache::CreateCoefficientReadback()
+{
+    nvrhi::BufferDesc desc;
+    desc.byteSize = sizeof(float4) * LightProbeSHPass::c_CoefficientCount;
+    desc.cpuAccess = nvrhi::CpuAccessMode::Read;
+    desc.initialState = nvrhi::ResourceStates::CopyDest;
+    desc.keepInitialState = true;
+    desc.debugName = "LightProbeCache CoefficientReadback";
+    return m_Device->createBuffer(desc);
+}
+
+void LightProbeCache::Capture(nvrhi::ICommandList* commandList,
+    const std::shared_ptr<LightProbe>& probe,
+    const box3& bounds,
+    nvrhi::IBuffer* diffuseCoefficients,
+    nvrhi::ITexture* specularCube,
+    nvrhi::ITexture* environmentBrdf)
+{
+    // Another capture of the same probe that is still waiting is replaced
+    m_Captures.erase(std::remove_if(m_Captures.begin(), m_Captures.end(), [&probe](const PendingCapture& capture)
+    {
+        return capture.probe == probe && !capture.compression;
+    }), m_Captures.end());
+
+    PendingCapture capture;
+    capture.probe = probe;
+    capture.bounds = bounds;
+    capture.diffuse = CreateCoefficientReadback();
+    capture.specular = CreateReadback(specularCube);
+    capture.captureFrame = m_FrameIndex;
+
+    auto copySubresources = [commandList](nvrhi::IStagingTexture* staging, nvrhi::ITexture* texture)
+    {
+        const nvrhi::TextureDesc& desc = texture->getDesc();
+        for (uint32_t arraySlice = 0; arraySlice < desc.arraySize; arraySlice++)
+        {
+            for (uint32_t mipLevel = 0; mipLevel < desc.mipLevels; mipLevel++)
+            {
+                nvrhi::TextureSlice slice;
+                slice.arraySlice = arraySlice;
+                slice.mipLevel = mipLevel;
+                commandList->copyTexture(staging, slice, texture, slice);
+            }
+        }
+    };
+
+    commandList->copyBuffer(capture.diffuse, 0, diffuseCoefficients, 0, capture.diffuse->getDesc().byteSize);
+    copySubresources(capture.specular, specularCube);
+
+    if (!m_EnvironmentBrdf)
+        m_EnvironmentBrdf = environmentBrdf;
+
+    if (!m_Brdf && environmentBrdf)
+    {
+        capture.brdf = CreateReadback(environmentBrdf);
+        copySubresources(capture.brdf, environmentBrdf);
+    }
+
+    m_Captures.push_back(std::move(capture));
+}
+
+void LightProbeCache::StartCompression(PendingCapture& capture)
+{
+    auto result = std::make_shared<ProbeData>();
+    result->bounds = capture.bounds;
+    capture.result = result;
+
+    std::shared_ptr<BrdfData> brdfResult;
+    if (capture.brdf)
+    {
+        brdfResult = std::make_shared<BrdfData>();
+        capture.brdfResult = brdfResult;
+    }
+
+    // One work item per readback texture, the subresources of a staging texture can only be mapped one at a
+    // time; the coefficients are copied along with the specular map
+    nvrhi::DeviceHandle device = m_Device;
+    nvrhi::BufferHandle diffuse = capture.diffuse;
+    nvrhi::StagingTextureHandle readbacks[2] = { capture.specular, capture.brdf };
+
+    capture.compression = m_ThreadPool->ParallelForAsync(readbacks[1] ? 2 : 1, [device, diffuse, readbacks, result, brdfResult](size_t item)
+    {
+        nvrhi::IStagingTexture* staging = readbacks[item];
+        const nvrhi::TextureDesc& desc = staging->getDesc();
+
+        if (item == 1)
+        {
+            // The BRDF texels are stored as they are
+            const nvrhi::FormatInfo& formatInfo = nvrhi::getFormatInfo(desc.format);
+            size_t bytesPerRow = size_t(desc.width) * formatInfo.bytesPerBlock;
+            brdfResult->format = desc.format;
+            brdfResult->width = desc.width;
+            brdfResult->height = desc.height;
+            brdfResult->texels.resize(bytesPerRow * desc.height);
+
+            size_t rowPitch = 0;
+            const uint8_t* texels = static_cast<const uint8_t*>(device->mapStagingTexture(staging, nvrhi::TextureSlice(), nvrhi::CpuAccessMode::Read, &rowPitch));
+            if (texels)
+            {
+                for (uint32_t y = 0; y < desc.height; y++)
+                    memcpy(brdfResult->texels.data() + y * bytesPerRow, texels + y * rowPitch, bytesPerRow);
+                device->unmapStagingTexture(staging);
+            }
+            return;
+        }
+
+        if (const void* coefficients = device->mapBuffer(diffuse, nvrhi::CpuAccessMode::Read))
+        {
+            memcpy(result->diffuseCoefficients, coefficients, sizeof(result->diffuseCoefficients));
+            device->unmapBuffer(diffuse);
+        }
+
+        CubeData& cube = result->specular;
+        cube.size = desc.width;
+        cube.mipLevels = desc.mipLevels;
+        cube.blocks.resize(GetCubeBlockBytes(desc.width, desc.mipLevels));
+
+        uint8_t* blocks = cube.blocks.data();
+        for (uint32_t face = 0; face < 6; face++)
+        {
+            for (uint32_t mipLevel = 0; mipLevel < desc.mipLevels; mipLevel++)
+            {
+                uint32_t mipSize = std::max(desc.width >> mipLevel, 1u);
+
+                nvrhi::TextureSlice slice;
+                slice.arraySlice = face;
+                slice.mipLevel = mipLevel;
+
+                size_t rowPitch = 0;
+                const void* texels = device->mapStagingTexture(staging, slice, nvrhi::CpuAccessMode::Read, &rowPitch);
+                if (texels)
+                {
+                    CompressBC6H(texels, rowPitch, mipSize, mipSize, blocks);
+                    device->unmapStagingTexture(staging);
+                }
+                blocks += GetBC6HSize(mipSize, mipSize);
+            }
+        }
+    });
+}
+
+void LightProbeCache::Upload(nvrhi::ICommandList* commandList, LightProbeSHPass& shPass, LightProbe& probe, const ProbeData& data)
+{
+    auto uploadCube = [commandList](nvrhi::ITexture* texture, uint32_t firstSlice, const CubeData& cube)
+    {
+        const uint8_t* blocks = cube.blocks.data();
+        for (uint32_t face = 0; face < 6; face++)
+        {
+            for (uint32_t mipLevel = 0; mipLevel < cube.mipLevels; mipLevel++)
+            {
+                uint32_t mipSize = std::max(cube.size >> mipLevel, 1u);
+                commandList->writeTexture(texture, firstSlice + face, mipLevel, blocks, GetBC6HRowPitch(mipSize));
+                blocks += GetBC6HSize(mipSize, mipSize);
+            }
+        }
+    };
+
+    shPass.RenderDiffuseMap(commandList, data.diffuseCoefficients, probe.diffuseMap, probe.diffuseArrayIndex * 6);
+    uploadCube(probe.specularMap, probe.specularArrayIndex * 6, data.specular);
+
+    probe.environmentBrdf = m_EnvironmentBrdf;
+    probe.bounds = frustum::fromBox(data.bounds);
+    probe.enabled = true;
+}
+
+void LightProbeCache::CreateEnvironmentBrdf(nvrhi::ICommandList* commandList)
+{
+    nvrhi::TextureDesc desc;
+    desc.width = m_Brdf->width;
+    desc.height = m_Brdf->height;
+    desc.format = m_Brdf->format;
+    desc.debugName = "LightProbeCache EnvironmentBrdf";
+    desc.initialState = nvrhi::ResourceStates::ShaderResource;
+    desc.keepInitialState = true;
+    m_EnvironmentBrdf = m_Device->createTexture(desc);
+
+    size_t rowPitch = size_t(m_Brdf->width) * nvrhi::getFormatInfo(m_Brdf->format).bytesPerBlock;
+    commandList->writeTexture(m_EnvironmentBrdf, 0, 0, m_Brdf->texels.data(), rowPitch);
+}
+
+void LightProbeCache::Update(nvrhi::ICommandList* commandList, uint32_t frameIndex, LightProbeSHPass& shPass)
+{
+    m_FrameIndex = frameIndex;
+
+    if (m_BrdfUploadPending)
+    {
+        CreateEnvironmentBrdf(commandList);
+        m_BrdfUploadPending = false;
+    }
+
+    for (uint32_t index : m_PendingUploads)
+        Upload(commandList, shPass, *m_ProbeObjects[index], *m_Probes[index]);
+    m_PendingUploads.clear();
+
+    for (auto it = m_Captures.begin(); it != m_Captures.end(); )
+    {
+        PendingCapture& capture = *it;
+
+        if (!capture.compression)
+        {
+            if (m_FrameIndex - capture.captureFrame >= c_ReadbackLatency)
+                StartCompression(capture);
+            ++it;
+            continue;
+        }
+
+        if (!capture.compression->IsDone())
+        {
+            ++it;
+            continue;
+        }
+
+        if (capture.brdfResult && !m_Brdf)
+            m_Brdf = capture.brdfResult;
+
+        uint32_t index = capture.probe->diffuseArrayIndex;
+        if (index >= m_Probes.size())
+            m_Probes.resize(index + 1);
+        m_Probes[index] = capture.result;
+
+        Upload(commandList, shPass, *capture.probe, *capture.result);
+        m_SaveRequested = true;
+
+        it = m_Captures.erase(it);
+    }
+
+    if (m_SaveRequested && !m_CacheFile.empty() && (!m_SaveTask || m_SaveTask->IsDone()))
+        StartSave();
+}
+
+void LightProbeCache::StartSave()
+{
+    m_SaveRequested = false;
+
+    // The probe data is immutable, the task writes a snapshot of the pointers
+    std::filesystem::path cacheFile = m_CacheFile;
+    std::vector<std::shared_ptr<const ProbeData>> probes = m_Probes;
+    std::shared_ptr<const BrdfData> brdf = m_Brdf;
+
+    m_SaveTask = m_ThreadPool->ParallelForAsync(1, [cacheFile, probes, brdf](size_t)
+    {
+        Write(cacheFile, probes, brdf);
+    });
+}
+
+bool LightProbeCache::Write(const std::filesystem::path& cacheFile, const std::vector<std::shared_ptr<const ProbeData>>& probes,
+    const std::shared_ptr<const BrdfData>& brdf)
+{
+    if (cacheFile.empty())
+        return false;
+
+    std::error_code error;
+    std::filesystem::create_directories(cacheFile.parent_path(), error);
+
+    // Written next to the cache and renamed, so that an interrupted write leaves the previous file
+    std::filesystem::path temporaryFile = cacheFile;
+    temporaryFile += ".tmp";
+
+    {
+        std::ofstream stream(temporaryFile, std::ios::binary | std::ios::trunc);
+        if (!stream)
+        {
+            log::warning("Cannot write the light probe cache '%s'", cacheFile.generic_string().c_str());
+            return false;
+        }
+
+        FileHeader header = {};
+        header.magic = c_Magic;
+        header.version = c_Version;
+        header.probeCount = uint32_t(std::count_if(probes.begin(), probes.end(), [](const auto& probe) { return probe != nullptr; }));
+        if (brdf)
+        {
+            header.brdfFormat = uint32_t(brdf->format);
+            header.brdfWidth = brdf->width;
+            header.brdfHeight = brdf->height;
+            header.brdfBytes = brdf->texels.size();
+        }
+
+        stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        if (brdf)
+            stream.write(reinterpret_cast<const char*>(brdf->texels.data()), std::streamsize(brdf->texels.size()));
+
+        for (uint32_t index = 0; index < uint32_t(probes.size()); index++)
+        {
+            const ProbeData* data = probes[index].get();
+            if (!data)
+                continue;
+
+            ProbeRecord record = {};
+            record.index = index;
+            memcpy(record.boundsMin, &data->bounds.m_mins, sizeof(record.boundsMin));
+            memcpy(record.boundsMax, &data->bounds.m_maxs, sizeof(record.boundsMax));
+            memcpy(record.diffuseCoefficients, data->diffuseCoefficients, sizeof(record.diffuseCoefficients));
+            record.specularSize = data->specular.size;
+            record.specularMipLevels = data->specular.mipLevels;
+            record.specularBytes = data->specular.blocks.size();
+
+            stream.write(reinterpret_cast<const char*>(&record), sizeof(record));
+            stream.write(reinterpret_cast<const char*>(data->specular.blocks.data()), std::streamsize(record.specularBytes));
+        }
+
+        if (!stream)
+        {
+            log::warning("Cannot write the light probe cache '%s'", cacheFile.generic_string().c_str());
+            return false;
+        }
+    }
+
+    std::filesystem::rename(temporaryFile, cacheFile, error);
+    if (error)
+    {
+        log::warning("Cannot replace the light probe cache '%s': %s", cacheFile.generic_string().c_str(), error.message().c_str());
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <donut/engine/SceneTypes.h>
+#include <donut/core/math/math.h>
+#include <nvrhi/nvrhi.h>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+#include "LightProbeSHPass.h"
+#include "ThreadPool.h"
+
+// Keeps the baked light probes of a scene in a cache file, so that a scene starts with its probes and the
+// environment BRDF without baking anything. The specular maps are sampled from a BC6H cube array, which
+// cannot be rendered to: a finished bake is read back from the baker's RGBA16_FLOAT cubemap and its diffuse
+// SH coefficients, compressed on the thread pool, then uploaded into the probe's slices and written to the
+// file. The diffuse maps are expanded from the coefficients on upload. Probes are identified by their index
+// in the probe arrays.
+class LightProbeCache
+{
+public:
+    LightProbeCache(nvrhi::IDevice* device, std::shared_ptr<ThreadPool> threadPool);
+    ~LightProbeCache();
+
+    // Reads the cache file of a scene and queues the upload of its probes for the next Update. The probes'
+    // specular maps have to be BC6H cube arrays with the size the file was written with, and the stored
+    // environment BRDF has to have the format and size of environmentBrdf. Returns false when there is no
+    // usable file; new bakes are written to it either way.
+    bool Load(const std::filesystem::path& cacheFile, const std::vector<std::shared_ptr<donut::engine::LightProbe>>& probes,
+        nvrhi::ITexture* environmentBrdf);
+
+    // Waits for pending writes and forgets the scene's probes, e.g. when the scene is unloaded
+    void Close();
+
+    // Reads back a finished bake; call after Update in the same frame. The environment BRDF is only read
+    // when the cache does not hold one yet.
+    void Capture(nvrhi::ICommandList* commandList,
+        const std::shared_ptr<donut::engine::LightProbe>& probe,
+        const donut::math::box3& bounds,
+        nvrhi::IBuffer* diffuseCoefficients,
+        nvrhi::ITexture* specularCube,
+        nvrhi::ITexture* environmentBrdf);
+
+    // Compresses the readbacks of earlier frames on the thread pool, uploads the compressed probes and
+    // updates them, and saves the file in the background. Call once per frame on the render thread, before
+    // the passes that read the probes.
+    void Update(nvrhi::ICommandList* commandList, uint32_t frameIndex, donut::render::LightProbeSHPass& shPass);
+
+    // Captures that are not uploaded yet
+    [[nodiscard]] uint32_t GetPendingCount() const { return uint32_t(m_Captures.size()); }
+    [[nodiscard]] uint32_t GetCachedProbeCount() const;
+
+private:
+    // Frames between a readback copy and its mapping, so that the copy has finished on the GPU
+    static constexpr uint32_t c_ReadbackLatency = 3;
+
+    struct CubeData
+    {
+        uint32_t size = 0;
+        uint32_t mipLevels = 0;
+        // BC6H blocks of every face, face by face and mip by mip within a face
+        std::vector<uint8_t> blocks;
+    };
+
+    struct ProbeData
+    {
+        donut::math::box3 bounds;
+        donut::math::float4 diffuseCoefficients[donut::render::LightProbeSHPass::c_CoefficientCount];
+        CubeData specular;
+    };
+
+    struct BrdfData
+    {
+        nvrhi::Format format = nvrhi::Format::UNKNOWN;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<uint8_t> texels;
+    };
+
+    struct PendingCapture
+    {
+        std::shared_ptr<donut::engine::LightProbe> probe;
+        donut::math::box3 bounds;
+        nvrhi::BufferHandle diffuse;
+        nvrhi::StagingTextureHandle specular;
+        nvrhi::StagingTextureHandle brdf;
+        uint32_t captureFrame = 0;
+        std::shared_ptr<TaskBatch> compression;
+        std::shared_ptr<ProbeData> result;
+        std::shared_ptr<BrdfData> brdfResult;
+    };
+
+    nvrhi::StagingTextureHandle CreateReadback(nvrhi::ITexture* texture);
+    nvrhi::BufferHandle CreateCoefficientReadback();
+    void StartCompression(PendingCapture& capture);
+    void Upload(nvrhi::ICommandList* commandList, donut::render::LightProbeSHPass& shPass,
+        donut::engine::LightProbe& probe, const ProbeData& data);
+    void CreateEnvironmentBrdf(nvrhi::ICommandList* commandList);
+    void StartSave();
+    static bool Write(const std::filesystem::path& cacheFile, const std::vector<std::shared_ptr<const ProbeData>>& probes,
+        const std::shared_ptr<const BrdfData>& brdf);
+
+    nvrhi::DeviceHandle m_Device;
+    std::shared_ptr<ThreadPool> m_ThreadPool;
+
+    std::filesystem::path m_CacheFile;
+    std::vector<std::shared_ptr<donut::engine::LightProbe>> m_ProbeObjects;
+    // By probe index; null for probes that were never baked
+    std::vector<std::shared_ptr<const ProbeData>> m_Probes;
+    std::vector<uint32_t> m_PendingUploads;
+
+    std::shared_ptr<const BrdfData> m_Brdf;
+    nvrhi::TextureHandle m_EnvironmentBrdf;
+    bool m_BrdfUploadPending = false;
+
+    std::vector<PendingCapture> m_Captures;
+    uint32_t m_FrameIndex = 0;
+    std::shared_ptr<TaskBatch> m_SaveTask;
+    bool m_SaveRequested = false;
+};
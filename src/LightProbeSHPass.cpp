@@ -0,0 +1,127 @@
+#include "LightProbeSHPass.h"
+
+#include <nvrhi/utils.h>
+#include <algorithm>
+#include <cstring>
+
+using namespace donut::math;
+using namespace donut::engine;
+using namespace donut::render;
+
+// Matches LightProbeSHConstants in LightProbeSH.hlsl
+struct LightProbeSHConstants
+{
+    float4 coefficients[LightProbeSHPass::c_CoefficientCount];
+    uint32_t faceSize;
+    uint32_t padding[3];
+};
+
+LightProbeSHPass::LightProbeSHPass(nvrhi::IDevice* device, const std::shared_ptr<ShaderFactory>& shaderFactory)
+    : m_BindingCache(device)
+{
+    nvrhi::ShaderHandle projectShader = shaderFactory->CreateShader("LightProbeSH.hlsl", "project_cs", nullptr, nvrhi::ShaderType::Compute);
+    nvrhi::ShaderHandle expandShader = shaderFactory->CreateShader("LightProbeSH.hlsl", "expand_cs", nullptr, nvrhi::ShaderType::Compute);
+
+    m_Constants = device->createBuffer(nvrhi::utils::CreateVolatileConstantBufferDesc(
+        sizeof(LightProbeSHConstants), "LightProbeSH Constants", 16));
+
+    nvrhi::BindingLayoutDesc layoutDesc;
+    layoutDesc.visibility = nvrhi::ShaderType::Compute;
+    layoutDesc.bindings = {
+        nvrhi::BindingLayoutItem::VolatileConstantBuffer(0),
+        nvrhi::BindingLayoutItem::Texture_SRV(0),
+        nvrhi::BindingLayoutItem::StructuredBuffer_UAV(0)
+    };
+    m_ProjectBindingLayout = device->createBindingLayout(layoutDesc);
+
+    layoutDesc.bindings = {
+        nvrhi::BindingLayoutItem::VolatileConstantBuffer(0),
+        nvrhi::BindingLayoutItem::Texture_UAV(1)
+    };
+    m_ExpandBindingLayout = device->createBindingLayout(layoutDesc);
+
+    nvrhi::ComputePipelineDesc pipelineDesc;
+    pipelineDesc.CS = projectShader;
+    pipelineDesc.bindingLayouts = { m_ProjectBindingLayout };
+    m_ProjectPipeline = device->createComputePipeline(pipelineDesc);
+
+    pipelineDesc.CS = expandShader;
+    pipelineDesc.bindingLayouts = { m_ExpandBindingLayout };
+    m_ExpandPipeline = device->createComputePipeline(pipelineDesc);
+}
+
+nvrhi::BufferHandle LightProbeSHPass::CreateCoefficientBuffer(nvrhi::IDevice* device, const char* debugName)
+{
+    nvrhi::BufferDesc bufferDesc;
+    bufferDesc.byteSize = sizeof(float4) * c_CoefficientCount;
+    bufferDesc.structStride = sizeof(float4);
+    bufferDesc.canHaveUAVs = true;
+    bufferDesc.initialState = nvrhi::ResourceStates::UnorderedAccess;
+    bufferDesc.keepInitialState = true;
+    bufferDesc.debugName = debugName;
+    return device->createBuffer(bufferDesc);
+}
+
+void LightProbeSHPass::Project(nvrhi::ICommandList* commandList, nvrhi::ITexture* environmentMap, nvrhi::IBuffer* coefficients)
+{
+    const nvrhi::TextureDesc& environmentDesc = environmentMap->getDesc();
+
+    uint32_t mipLevel = 0;
+    while (mipLevel + 1 < environmentDesc.mipLevels && (environmentDesc.width >> mipLevel) > c_ProjectionFaceSize)
+        mipLevel++;
+
+    nvrhi::BindingSetDesc bindingSetDesc;
+    bindingSetDesc.bindings = {
+        nvrhi::BindingSetItem::ConstantBuffer(0, m_Constants),
+        nvrhi::BindingSetItem::Texture_SRV(0, environmentMap, nvrhi::Format::UNKNOWN,
+            nvrhi::TextureSubresourceSet(mipLevel, 1, 0, 6), nvrhi::TextureDimension::Texture2DArray),
+        nvrhi::BindingSetItem::StructuredBuffer_UAV(0, coefficients)
+    };
+    nvrhi::BindingSetHandle bindingSet = m_BindingCache.GetOrCreateBindingSet(bindingSetDesc, m_ProjectBindingLayout);
+
+    LightProbeSHConstants constants = {};
+    constants.faceSize = std::max(environmentDesc.width >> mipLevel, 1u);
+    commandList->writeBuffer(m_Constants, &constants, sizeof(constants));
+
+    nvrhi::ComputeState state;
+    state.pipeline = m_ProjectPipeline;
+    state.bindings = { bindingSet };
+
+    commandList->beginMarker("LightProbe SH Projection");
+    commandList->setComputeState(state);
+    commandList->dispatch(1);
+    commandList->endMarker();
+}
+
+void LightProbeSHPass::RenderDiffuseMap(nvrhi::ICommandList* commandList,
+    const float4 coefficients[c_CoefficientCount],
+    nvrhi::ITexture* diffuseMap,
+    uint32_t firstArraySlice)
+{
+    nvrhi::BindingSetDesc bindingSetDesc;
+    bindingSetDesc.bindings = {
+        nvrhi::BindingSetItem::ConstantBuffer(0, m_Constants),
+        nvrhi::BindingSetItem::Texture_UAV(1, diffuseMap, nvrhi::Format::UNKNOWN,
+            nvrhi::TextureSubresourceSet(0, 1, firstArraySlice, 6), nvrhi::TextureDimension::Texture2DArray)
+    };
+    nvrhi::BindingSetHandle bindingSet = m_BindingCache.GetOrCreateBindingSet(bindingSetDesc, m_ExpandBindingLayout);
+
+    LightProbeSHConstants constants = {};
+    memcpy(constants.coefficients, coefficients, sizeof(constants.coefficients));
+    constants.faceSize = diffuseMap->getDesc().width;
+    commandList->writeBuffer(m_Constants, &constants, sizeof(constants));
+
+    nvrhi::ComputeState state;
+    state.pipeline = m_ExpandPipeline;
+    state.bindings = { bindingSet };
+
+    commandList->beginMarker("LightProbe SH Diffuse");
+    commandList->setComputeState(state);
+    commandList->dispatch((constants.faceSize + 7) / 8, (constants.faceSize + 7) / 8, 6);
+    commandList->endMarker();
+}
+
+void LightProbeSHPass::ResetBindingCache()
+{
+    m_BindingCache.Clear();
+}
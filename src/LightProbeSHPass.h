@@ -0,0 +1,48 @@
+#pragma once
+
+#include <donut/engine/ShaderFactory.h>
+#include <donut/core/math/math.h>
+#include <nvrhi/nvrhi.h>
+#include <memory>
+
+#include "PassBindingCache.h"
+
+namespace donut::render
+{
+    // Diffuse light probes as L2 spherical harmonics, 9 RGB coefficients instead of a filtered cubemap. The
+    // coefficients are projected from an environment cubemap on the GPU and expanded into a small diffuse
+    // cube per probe, because the Donut lighting shaders sample diffuse probes as a cube array.
+    class LightProbeSHPass
+    {
+    public:
+        static constexpr uint32_t c_CoefficientCount = 9;
+        // Environment maps are projected from the first mip that is at most this size
+        static constexpr uint32_t c_ProjectionFaceSize = 32;
+
+        LightProbeSHPass(nvrhi::IDevice* device, const std::shared_ptr<engine::ShaderFactory>& shaderFactory);
+
+        // A buffer for the coefficients of one probe, c_CoefficientCount float4s with RGB in xyz
+        [[nodiscard]] static nvrhi::BufferHandle CreateCoefficientBuffer(nvrhi::IDevice* device, const char* debugName);
+
+        // Projects the radiance of an RGBA16_FLOAT cubemap; the coefficients are convolved for diffuse
+        // lighting, like the maps of LightProbeProcessingPass::RenderDiffuseMap
+        void Project(nvrhi::ICommandList* commandList, nvrhi::ITexture* environmentMap, nvrhi::IBuffer* coefficients);
+
+        // Fills mip 0 of the six faces that start at firstArraySlice; the diffuse map needs UAV support
+        void RenderDiffuseMap(nvrhi::ICommandList* commandList,
+            const math::float4 coefficients[c_CoefficientCount],
+            nvrhi::ITexture* diffuseMap,
+            uint32_t firstArraySlice);
+
+        void ResetBindingCache();
+
+    private:
+        nvrhi::BufferHandle m_Constants;
+        nvrhi::BindingLayoutHandle m_ProjectBindingLayout;
+        nvrhi::BindingLayoutHandle m_ExpandBindingLayout;
+        nvrhi::ComputePipelineHandle m_ProjectPipeline;
+        nvrhi::ComputePipelineHandle m_ExpandPipeline;
+
+        PassBindingCache m_BindingCache;
+    };
+}
@@ -0,0 +1,198 @@
+#include "LoadProfiler.h"
+#include "ChromeTrace.h"
+
+#include <donut/core/log.h>
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <set>
+
+using namespace donut;
+using namespace std::chrono;
+
+// Depth of the asset scopes currently open on this thread
+static thread_local uint32_t t_AssetScopeDepth = 0;
+
+LoadProfiler& LoadProfiler::Get()
+{
+    static LoadProfiler profiler;
+    return profiler;
+}
+
+void LoadProfiler::BeginSession()
+{
+    std::lock_guard lock(m_Mutex);
+    m_Events.clear();
+    m_SessionStart = high_resolution_clock::now();
+    m_Active = true;
+}
+
+void LoadProfiler::EndSession(const std::filesystem::path& traceFile, size_t topAssets)
+{
+    if (!m_Active.exchange(false))
+        return;
+
+    std::lock_guard lock(m_Mutex);
+
+    if (WriteTrace(traceFile))
+        log::info("Scene load trace written to %s (%zu events)", traceFile.generic_string().c_str(), m_Events.size());
+    else
+        log::warning("Cannot write the scene load trace to %s", traceFile.generic_string().c_str());
+
+    LogSummary(topAssets);
+}
+
+void LoadProfiler::AddEvent(const char* category, std::string name, high_resolution_clock::time_point start,
+    high_resolution_clock::time_point end, bool nested)
+{
+    std::lock_guard lock(m_Mutex);
+    if (!m_Active)
+        return;
+
+    Event event;
+    event.name = std::move(name);
+    event.category = category;
+    event.thread = ProfilerThreads::GetCurrentIndex();
+    event.startMicroseconds = duration_cast<microseconds>(start - m_SessionStart).count();
+    event.durationMicroseconds = duration_cast<microseconds>(end - start).count();
+    event.nested = nested;
+    m_Events.push_back(std::move(event));
+}
+
+bool LoadProfiler::WriteTrace(const std::filesystem::path& traceFile) const
+{
+    ChromeTraceWriter writer(traceFile);
+    if (!writer.IsOpen())
+        return false;
+
+    writer.ProfilerThreadNames();
+    for (const Event& event : m_Events)
+        writer.Complete(event.thread, double(event.startMicroseconds), double(event.durationMicroseconds), event.name, event.category);
+
+    return writer.Close();
+}
+
+void LoadProfiler::LogSummary(size_t topAssets) const
+{
+    struct AssetTotals
+    {
+        int64_t total = 0;
+        std::map<std::string, int64_t> categories;
+    };
+
+    std::map<std::string, int64_t> stages;
+    std::map<std::string, AssetTotals> assets;
+    std::set<uint32_t> threads;
+    int64_t sessionEnd = 0;
+
+    for (const Event& event : m_Events)
+    {
+        sessionEnd = std::max(sessionEnd, event.startMicroseconds + event.durationMicroseconds);
+        threads.insert(event.thread);
+
+        if (strcmp(event.category, c_StageCategory) == 0)
+        {
+            stages[event.name] += event.durationMicroseconds;
+            continue;
+        }
+
+        AssetTotals& totals = assets[event.name];
+        totals.categories[event.category] += event.durationMicroseconds;
+        if (!event.nested)
+            totals.total += event.durationMicroseconds;
+    }
+
+    log::info("Scene load profile: %.1f ms wall time, %zu threads", double(sessionEnd) / 1000.0, threads.size());
+
+    for (const auto& [name, duration] : stages)
+        log::info("  stage %-32s %9.1f ms", name.c_str(), double(duration) / 1000.0);
+
+    std::vector<std::pair<std::string, const AssetTotals*>> sorted;
+    for (const auto& [name, totals] : assets)
+        sorted.emplace_back(name, &totals);
+    std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.second->total > b.second->total; });
+
+    if (sorted.size() > topAssets)
+        sorted.resize(topAssets);
+
+    log::info("Slowest %zu assets:", sorted.size());
+    for (const auto& [name, totals] : sorted)
+    {
+        std::string breakdown;
+        for (const auto& [category, duration] : totals->categories)
+        {
+            char item[64];
+            snprintf(item, sizeof(item), "%s%s %.1f ms", breakdown.empty() ? "" : ", ", category.c_str(), double(duration) / 1000.0);
+            breakdown += item;
+        }
+        log::info("  %9.1f ms  %s (%s)", double(totals->total) / 1000.0, name.c_str(), breakdown.c_str());
+    }
+}
+
+LoadProfiler::Scope::Scope(const char* category, std::string name)
+    : m_Category(category)
+    , m_Name(std::move(name))
+    , m_Active(LoadProfiler::Get().IsActive())
+{
+    if (!m_Active)
+        return;
+
+    if (strcmp(category, c_StageCategory) != 0)
+    {
+        m_Nested = t_AssetScopeDepth > 0;
+        t_AssetScopeDepth++;
+    }
+
+    m_Start = high_resolution_clock::now();
+}
+
+LoadProfiler::Scope::~Scope()
+{
+    if (!m_Active)
+        return;
+
+    auto end = high_resolution_clock::now();
+
+    if (strcmp(m_Category, c_StageCategory) != 0)
+        t_AssetScopeDepth--;
+
+    LoadProfiler::Get().AddEvent(m_Category, std::move(m_Name), m_Start, end, m_Nested);
+}
+
+ProfilingFileSystem::ProfilingFileSystem(std::shared_ptr<vfs::IFileSystem> fs)
+    : m_fs(std::move(fs))
+{
+}
+
+bool ProfilingFileSystem::folderExists(const std::filesystem::path& name)
+{
+    return m_fs->folderExists(name);
+}
+
+bool ProfilingFileSystem::fileExists(const std::filesystem::path& name)
+{
+    return m_fs->fileExists(name);
+}
+
+std::shared_ptr<vfs::IBlob> ProfilingFileSystem::readFile(const std::filesystem::path& name)
+{
+    LoadProfiler::Scope scope("read", name.generic_string());
+    return m_fs->readFile(name);
+}
+
+bool ProfilingFileSystem::writeFile(const std::filesystem::path& name, const void* data, size_t size)
+{
+    return m_fs->writeFile(name, data, size);
+}
+
+int ProfilingFileSystem::enumerateFiles(const std::filesystem::path& path, const std::vector<std::string>& extensions,
+    vfs::enumerate_callback_t callback, bool allowDuplicates)
+{
+    return m_fs->enumerateFiles(path, extensions, callback, allowDuplicates);
+}
+
+int ProfilingFileSystem::enumerateDirectories(const std::filesystem::path& path, vfs::enumerate_callback_t callback,
+    bool allowDuplicates)
+{
+    return m_fs->enumerateDirectories(path, callback, allowDuplicates);
+}
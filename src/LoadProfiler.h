@@ -0,0 +1,87 @@
+#pragma once
+
+#include <donut/core/vfs/VFS.h>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Collects timed scopes from every thread during a scene load and writes them out as a Chrome trace
+// (chrome://tracing or ui.perfetto.dev), plus a log summary of the stages and the slowest assets. Threads
+// are named through ProfilerThreads.
+//
+// Stage scopes cover whole loading steps. Asset scopes are named after the file they work on, and all
+// asset scopes with the same name are added up in the slowest-assets report. Nested asset scopes on
+// the same thread, like the read inside a texture decode, show up in the trace but are not counted twice.
+class LoadProfiler
+{
+public:
+    static constexpr const char* c_StageCategory = "stage";
+
+    static LoadProfiler& Get();
+
+    void BeginSession();
+    // Writes the trace and logs the summary; topAssets limits the slowest-assets report
+    void EndSession(const std::filesystem::path& traceFile, size_t topAssets);
+    [[nodiscard]] bool IsActive() const { return m_Active.load(std::memory_order_relaxed); }
+
+    class Scope
+    {
+    public:
+        Scope(const char* category, std::string name);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        const char* m_Category;
+        std::string m_Name;
+        std::chrono::high_resolution_clock::time_point m_Start;
+        bool m_Active;
+        bool m_Nested = false;
+    };
+
+private:
+    struct Event
+    {
+        std::string name;
+        const char* category;
+        uint32_t thread;
+        int64_t startMicroseconds;
+        int64_t durationMicroseconds;
+        bool nested;
+    };
+
+    void AddEvent(const char* category, std::string name, std::chrono::high_resolution_clock::time_point start,
+        std::chrono::high_resolution_clock::time_point end, bool nested);
+    bool WriteTrace(const std::filesystem::path& traceFile) const;
+    void LogSummary(size_t topAssets) const;
+
+    std::atomic<bool> m_Active = false;
+    std::chrono::high_resolution_clock::time_point m_SessionStart;
+    std::mutex m_Mutex;
+    std::vector<Event> m_Events;
+};
+
+// File system wrapper that records every file read as an asset scope. For archives the scope covers
+// both the read and the decompression of the entry.
+class ProfilingFileSystem : public donut::vfs::IFileSystem
+{
+public:
+    explicit ProfilingFileSystem(std::shared_ptr<donut::vfs::IFileSystem> fs);
+
+    bool folderExists(const std::filesystem::path& name) override;
+    bool fileExists(const std::filesystem::path& name) override;
+    std::shared_ptr<donut::vfs::IBlob> readFile(const std::filesystem::path& name) override;
+    bool writeFile(const std::filesystem::path& name, const void* data, size_t size) override;
+    int enumerateFiles(const std::filesystem::path& path, const std::vector<std::string>& extensions,
+        donut::vfs::enumerate_callback_t callback, bool allowDuplicates = false) override;
+    int enumerateDirectories(const std::filesystem::path& path, donut::vfs::enumerate_callback_t callback,
+        bool allowDuplicates = false) override;
+
+private:
+    std::shared_ptr<donut::vfs::IFileSystem> m_fs;
+};
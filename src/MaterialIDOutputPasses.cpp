@@ -0,0 +1,30 @@
+#include "MaterialIDOutputPasses.h"
+
+#include <donut/core/log.h>
+
+using namespace donut::render;
+using namespace donut::engine;
+
+nvrhi::ShaderHandle GBufferFillIDPass::CreatePixelShader(ShaderFactory& shaderFactory, const CreateParameters& params, bool alphaTested)
+{
+    // Same permutations as the Donut GBuffer pixel shader
+    std::vector<ShaderMacro> macros;
+    macros.push_back(ShaderMacro("MOTION_VECTORS", params.enableMotionVectors ? "1" : "0"));
+    macros.push_back(ShaderMacro("ALPHA_TESTED", alphaTested ? "1" : "0"));
+
+    return shaderFactory.CreateShader("GBufferFillID.hlsl", "main_ps", &macros, nvrhi::ShaderType::Pixel);
+}
+
+nvrhi::ShaderHandle ForwardShadingIDPass::CreatePixelShader(ShaderFactory& shaderFactory, const CreateParameters& params, bool transmissiveMaterial)
+{
+    if (transmissiveMaterial)
+    {
+        log::warning("ForwardShadingIDPass does not support transmissive materials");
+        return ForwardShadingPass::CreatePixelShader(shaderFactory, params, transmissiveMaterial);
+    }
+
+    std::vector<ShaderMacro> macros;
+    macros.push_back(ShaderMacro("TRANSMISSIVE_MATERIAL", "0"));
+
+    return shaderFactory.CreateShader("ForwardShadingID.hlsl", "main_ps", &macros, nvrhi::ShaderType::Pixel);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <donut/render/GBufferFillPass.h>
+#include <donut/render/ForwardShadingPass.h>
+#include <donut/engine/ShaderFactory.h>
+#include <nvrhi/nvrhi.h>
+
+namespace donut::render
+{
+    // GBuffer fill that writes MaterialIDs as one more render target after the GBuffer channels, so the
+    // standalone MaterialIDPass only has to run when its output is needed on its own. Use it with
+    // RenderTargets::GBufferFramebuffer, which has the MaterialIDs target attached.
+    class GBufferFillIDPass : public GBufferFillPass
+    {
+    public:
+        using GBufferFillPass::GBufferFillPass;
+
+    protected:
+        nvrhi::ShaderHandle CreatePixelShader(engine::ShaderFactory& shaderFactory, const CreateParameters& params, bool alphaTested) override;
+    };
+
+    // Forward shading that writes the material IDs of the opaque geometry as a second render target. Use it
+    // with RenderTargets::ForwardIDFramebuffer; transmissive materials are not supported, they are drawn by
+    // the transparent pass.
+    class ForwardShadingIDPass : public ForwardShadingPass
+    {
+    public:
+        using ForwardShadingPass::ForwardShadingPass;
+
+    protected:
+        nvrhi::ShaderHandle CreatePixelShader(engine::ShaderFactory& shaderFactory, const CreateParameters& params, bool transmissiveMaterial) override;
+    };
+}
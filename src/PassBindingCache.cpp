@@ -0,0 +1,28 @@
+#include "PassBindingCache.h"
+
+std::atomic<uint32_t> PassBindingCache::s_CreatedThisFrame = 0;
+
+PassBindingCache::PassBindingCache(nvrhi::IDevice* device)
+    : m_Cache(device)
+{
+}
+
+nvrhi::BindingSetHandle PassBindingCache::GetOrCreateBindingSet(const nvrhi::BindingSetDesc& desc, nvrhi::IBindingLayout* layout)
+{
+    nvrhi::BindingSetHandle bindingSet = m_Cache.GetCachedBindingSet(desc, layout);
+    if (bindingSet)
+        return bindingSet;
+
+    s_CreatedThisFrame.fetch_add(1, std::memory_order_relaxed);
+    return m_Cache.GetOrCreateBindingSet(desc, layout);
+}
+
+void PassBindingCache::Clear()
+{
+    m_Cache.Clear();
+}
+
+uint32_t PassBindingCache::EndFrame()
+{
+    return s_CreatedThisFrame.exchange(0, std::memory_order_relaxed);
+}
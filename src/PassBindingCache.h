@@ -0,0 +1,27 @@
+#pragma once
+
+#include <donut/engine/BindingCache.h>
+#include <nvrhi/nvrhi.h>
+#include <atomic>
+
+// Binding set cache for the custom render passes. Sets are keyed by their description, i.e. by the identity
+// of the bound resources, so a pass that binds the same resources every frame only creates its set once.
+// Creations are counted so that a pass which still creates sets in steady state shows up in the UI.
+class PassBindingCache
+{
+public:
+    explicit PassBindingCache(nvrhi::IDevice* device);
+
+    nvrhi::BindingSetHandle GetOrCreateBindingSet(const nvrhi::BindingSetDesc& desc, nvrhi::IBindingLayout* layout);
+
+    // Drops the cached sets, which also releases the resources they reference
+    void Clear();
+
+    // Returns the number of sets created by all caches since the previous call; call once per frame
+    static uint32_t EndFrame();
+
+private:
+    donut::engine::BindingCache m_Cache;
+
+    static std::atomic<uint32_t> s_CreatedThisFrame;
+};
@@ -0,0 +1,119 @@
+#include "PostProcessPass.h"
+#include <utility>
+
+using namespace donut::render;
+using namespace donut::engine;
+using namespace donut::math;
+
+// Matches PostProcessConstants in PostProcess.hlsl
+struct PostProcessConstants
+{
+    float2 windowToSourceUV;
+    float2 invTextureSize;
+    float2 uvMax;
+    float exposureScale;
+    float whitePointInvSquared;
+    float minAdaptedLuminance;
+    float maxAdaptedLuminance;
+    float2 padding;
+};
+
+PostProcessPass::PostProcessPass(nvrhi::IDevice* device,
+    const std::shared_ptr<ShaderFactory>& shaderFactory,
+    std::shared_ptr<CommonRenderPasses> commonPasses)
+    : m_CommonPasses(std::move(commonPasses))
+    , m_Device(device)
+    , m_BindingCache(device)
+{
+    for (int permutation = 0; permutation < Permutation_Count; permutation++)
+    {
+        std::vector<ShaderMacro> macros = {
+            ShaderMacro("ENABLE_FXAA", permutation == Permutation_FXAA ? "1" : "0")
+        };
+        m_PixelShaders[permutation] = shaderFactory->CreateShader("PostProcess.hlsl", "main_ps", &macros, nvrhi::ShaderType::Pixel);
+    }
+
+    nvrhi::BindingLayoutDesc layoutDesc;
+    layoutDesc.visibility = nvrhi::ShaderType::Pixel;
+    layoutDesc.bindings = {
+        nvrhi::BindingLayoutItem::PushConstants(0, sizeof(PostProcessConstants)),
+        nvrhi::BindingLayoutItem::Sampler(0),
+        nvrhi::BindingLayoutItem::Texture_SRV(0),
+        nvrhi::BindingLayoutItem::TypedBuffer_SRV(1)
+    };
+    m_BindingLayout = device->createBindingLayout(layoutDesc);
+}
+
+void PostProcessPass::Render(
+    nvrhi::ICommandList* commandList,
+    nvrhi::IFramebuffer* framebuffer,
+    nvrhi::ITexture* hdrSource,
+    uint2 renderSize,
+    nvrhi::IBuffer* exposureBuffer,
+    const ToneMappingParameters& params,
+    bool enableFXAA)
+{
+    commandList->beginMarker("PostProcess");
+
+    // The pipelines depend on the framebuffer format, which only changes with the swap chain
+    const nvrhi::FramebufferInfoEx& framebufferInfo = framebuffer->getFramebufferInfo();
+    if (!m_Pipelines[0] || !(framebufferInfo == m_PipelineFramebufferInfo))
+    {
+        for (int permutation = 0; permutation < Permutation_Count; permutation++)
+        {
+            nvrhi::GraphicsPipelineDesc pipelineDesc;
+            pipelineDesc.primType = nvrhi::PrimitiveType::TriangleStrip;
+            pipelineDesc.VS = m_CommonPasses->m_FullscreenVS;
+            pipelineDesc.PS = m_PixelShaders[permutation];
+            pipelineDesc.bindingLayouts = { m_BindingLayout };
+            pipelineDesc.renderState.rasterState.setCullNone();
+            pipelineDesc.renderState.depthStencilState.depthTestEnable = false;
+            pipelineDesc.renderState.depthStencilState.stencilEnable = false;
+            m_Pipelines[permutation] = m_Device->createGraphicsPipeline(pipelineDesc, framebuffer);
+        }
+        m_PipelineFramebufferInfo = framebufferInfo;
+    }
+
+    nvrhi::BindingSetDesc bindingSetDesc;
+    bindingSetDesc.bindings = {
+        nvrhi::BindingSetItem::PushConstants(0, sizeof(PostProcessConstants)),
+        nvrhi::BindingSetItem::Sampler(0, m_CommonPasses->m_LinearClampSampler),
+        nvrhi::BindingSetItem::Texture_SRV(0, hdrSource),
+        nvrhi::BindingSetItem::TypedBuffer_SRV(1, exposureBuffer, nvrhi::Format::R32_UINT)
+    };
+    nvrhi::BindingSetHandle bindingSet = m_BindingCache.GetOrCreateBindingSet(bindingSetDesc, m_BindingLayout);
+
+    const nvrhi::TextureDesc& sourceDesc = hdrSource->getDesc();
+    float2 textureSize = float2(float(sourceDesc.width), float(sourceDesc.height));
+    float2 windowSize = float2(float(framebufferInfo.width), float(framebufferInfo.height));
+
+    PostProcessConstants constants = {};
+    constants.windowToSourceUV = float2(renderSize) / textureSize / windowSize;
+    constants.invTextureSize = 1.f / textureSize;
+    constants.uvMax = (float2(renderSize) - 0.5f) / textureSize;
+    constants.exposureScale = 0.18f * exp2f(params.exposureBias);
+    constants.whitePointInvSquared = 1.f / (params.whitePoint * params.whitePoint);
+    constants.minAdaptedLuminance = params.minAdaptedLuminance;
+    constants.maxAdaptedLuminance = params.maxAdaptedLuminance;
+
+    nvrhi::GraphicsState state;
+    state.pipeline = m_Pipelines[enableFXAA ? Permutation_FXAA : Permutation_None];
+    state.framebuffer = framebuffer;
+    state.viewport.addViewportAndScissorRect(framebufferInfo.getViewport());
+    state.bindings = { bindingSet };
+
+    commandList->setGraphicsState(state);
+    commandList->setPushConstants(&constants, sizeof(constants));
+
+    nvrhi::DrawArguments args;
+    args.instanceCount = 1;
+    args.vertexCount = 4;
+    commandList->draw(args); // Fullscreen quad
+
+    commandList->endMarker();
+}
+
+void PostProcessPass::ResetBindingCache()
+{
+    m_BindingCache.Clear();
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <donut/engine/ShaderFactory.h>
+#include <donut/engine/CommonRenderPasses.h>
+#include <donut/render/ToneMappingPasses.h>
+#include <donut/core/math/math.h>
+#include <nvrhi/nvrhi.h>
+#include <memory>
+
+#include "PassBindingCache.h"
+
+namespace donut::render
+{
+    // Tone mapping and FXAA fused into one full-screen pass that reads the HDR color and writes the window
+    // framebuffer, replacing the tone mapping draw into LdrColor, the FXAA dispatch and the final blit.
+    // The exposure comes from the histogram of ToneMappingPass, which has to be computed before Render.
+    // ToneMappingParameters::colorLUT is not applied; images that use one have to go through ToneMappingPass.
+    class PostProcessPass
+    {
+    public:
+        PostProcessPass(nvrhi::IDevice* device,
+            const std::shared_ptr<engine::ShaderFactory>& shaderFactory,
+            std::shared_ptr<engine::CommonRenderPasses> commonPasses);
+
+        // hdrSource holds renderSize pixels in its top left corner, which are stretched over the framebuffer
+        void Render(nvrhi::ICommandList* commandList,
+            nvrhi::IFramebuffer* framebuffer,
+            nvrhi::ITexture* hdrSource,
+            math::uint2 renderSize,
+            nvrhi::IBuffer* exposureBuffer,
+            const ToneMappingParameters& params,
+            bool enableFXAA);
+
+        void ResetBindingCache();
+
+    private:
+        // One shader permutation per combination of the optional features
+        enum Permutation
+        {
+            Permutation_None,
+            Permutation_FXAA,
+            Permutation_Count
+        };
+
+        nvrhi::ShaderHandle m_PixelShaders[Permutation_Count];
+        nvrhi::GraphicsPipelineHandle m_Pipelines[Permutation_Count];
+        nvrhi::FramebufferInfo m_PipelineFramebufferInfo;
+        nvrhi::BindingLayoutHandle m_BindingLayout;
+
+        std::shared_ptr<engine::CommonRenderPasses> m_CommonPasses;
+        nvrhi::DeviceHandle m_Device;
+        PassBindingCache m_BindingCache;
+    };
+}
@@ -0,0 +1,75 @@
+#include "RenderTargetPool.h"
+
+#include <donut/core/log.h>
+#include <algorithm>
+
+RenderTargetPool::RenderTargetPool(nvrhi::IDevice* device)
+    : m_Device(device)
+{
+}
+
+std::shared_ptr<RenderTargets> RenderTargetPool::Acquire(uint2 displaySize, uint sampleCount)
+{
+    {
+        std::lock_guard lock(m_Mutex);
+
+        // The smallest retired set that fits
+        auto best = m_Entries.end();
+        for (auto it = m_Entries.begin(); it != m_Entries.end(); ++it)
+        {
+            if (it->renderTargets->IsUpdateRequired(displaySize, sampleCount) || !m_Device->pollEventQuery(it->retired))
+                continue;
+
+            uint2 size = it->renderTargets->GetSize();
+            if (best == m_Entries.end() || size.x * size.y < best->renderTargets->GetSize().x * best->renderTargets->GetSize().y)
+                best = it;
+        }
+
+        if (best != m_Entries.end())
+        {
+            std::shared_ptr<RenderTargets> renderTargets = std::move(best->renderTargets);
+            m_Entries.erase(best);
+            renderTargets->SetRenderSize(displaySize);
+            renderTargets->SetDisplaySize(displaySize);
+            return renderTargets;
+        }
+    }
+
+    uint2 allocationSize = RenderTargets::GetAllocationSize(displaySize);
+    log::info("Allocating render targets: %ux%u for displaying at %ux%u", allocationSize.x, allocationSize.y, displaySize.x, displaySize.y);
+
+    auto renderTargets = std::make_shared<RenderTargets>();
+    renderTargets->Init(m_Device, allocationSize, sampleCount, true, true);
+    renderTargets->SetRenderSize(displaySize);
+    renderTargets->SetDisplaySize(displaySize);
+    return renderTargets;
+}
+
+void RenderTargetPool::Release(std::shared_ptr<RenderTargets> renderTargets)
+{
+    if (!renderTargets)
+        return;
+
+    Entry entry;
+    entry.renderTargets = std::move(renderTargets);
+    entry.retired = m_Device->createEventQuery();
+    m_Device->setEventQuery(entry.retired, nvrhi::CommandQueue::Graphics);
+
+    std::lock_guard lock(m_Mutex);
+    m_Entries.push_back(std::move(entry));
+
+    // The oldest sets go first
+    if (m_Entries.size() > c_MaxPooledSets)
+        m_Entries.erase(m_Entries.begin(), m_Entries.end() - c_MaxPooledSets);
+}
+
+void RenderTargetPool::Update()
+{
+    std::lock_guard lock(m_Mutex);
+
+    for (Entry& entry : m_Entries)
+        entry.idleFrames++;
+
+    m_Entries.erase(std::remove_if(m_Entries.begin(), m_Entries.end(),
+        [](const Entry& entry) { return entry.idleFrames > c_MaxIdleFrames; }), m_Entries.end());
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <nvrhi/nvrhi.h>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "RenderTargets.h"
+
+// Hands out render target sets allocated with headroom, and keeps the sets that were replaced around for
+// a while so that resizing back and forth, or changing the render resolution, reuses them instead of
+// allocating again. A released set is only handed out again once the GPU has finished the work that was
+// submitted before its release.
+class RenderTargetPool
+{
+public:
+    explicit RenderTargetPool(nvrhi::IDevice* device);
+
+    // Returns a set that can display at displaySize, with its render and display sizes set to it. Thread-safe.
+    std::shared_ptr<RenderTargets> Acquire(uint2 displaySize, uint sampleCount);
+
+    // Takes back a set that the render thread no longer uses
+    void Release(std::shared_ptr<RenderTargets> renderTargets);
+
+    // Frees the sets that have not been reused for a while; call once per frame
+    void Update();
+
+private:
+    static constexpr uint32_t c_MaxIdleFrames = 300;
+    static constexpr size_t c_MaxPooledSets = 2;
+
+    struct Entry
+    {
+        std::shared_ptr<RenderTargets> renderTargets;
+        nvrhi::EventQueryHandle retired;
+        uint32_t idleFrames = 0;
+    };
+
+    nvrhi::DeviceHandle m_Device;
+    std::mutex m_Mutex;
+    std::vector<Entry> m_Entries;
+};
@@ -1,9 +1,18 @@
 #include "RenderTargets.h"
 
+// Headroom added on each axis when allocating, and the fraction of the allocated area below which the
+// textures are reallocated to a smaller size
+static constexpr float c_AllocationHeadroom = 1.25f;
+static constexpr float c_MinUsedArea = 0.35f;
+static constexpr uint c_AllocationGranularity = 64;
+static constexpr uint c_MaxTextureSize = 16384;
+
 void RenderTargets::Init(nvrhi::IDevice* device, dm::uint2 size, dm::uint sampleCount, bool enableMotionVectors, bool useReverseProjection)
 {
     {
         GBufferRenderTargets::Init(device, size, sampleCount, enableMotionVectors, useReverseProjection);
+        m_RenderSize = size;
+        m_DisplaySize = size;
 
         nvrhi::TextureDesc desc;
         desc.width = size.x;
@@ -49,6 +58,15 @@ void RenderTargets::Init(nvrhi::IDevice* device, dm::uint2 size, dm::uint sample
         desc.debugName = "AmbientOcclusion";
         AmbientOcclusion = device->createTexture(desc);
 
+        desc.format = nvrhi::Format::RGBA16_SNORM;
+        desc.mipLevels = 1;
+        desc.isRenderTarget = false;
+        desc.initialState = nvrhi::ResourceStates::ShaderResource;
+        desc.debugName = "TemporalFeedback1";
+        TemporalFeedback1 = device->createTexture(desc);
+        desc.debugName = "TemporalFeedback2";
+        TemporalFeedback2 = device->createTexture(desc);
+
         if (desc.isVirtual)
         {
             uint64_t heapSize = 0;
@@ -57,7 +75,9 @@ void RenderTargets::Init(nvrhi::IDevice* device, dm::uint2 size, dm::uint sample
                 MaterialIDs,
                 ResolvedColor,
                 LdrColor,
-                AmbientOcclusion
+                AmbientOcclusion,
+                TemporalFeedback1,
+                TemporalFeedback2
             };
 
             for (auto texture : textures)
@@ -90,6 +110,14 @@ void RenderTargets::Init(nvrhi::IDevice* device, dm::uint2 size, dm::uint sample
         ForwardFramebuffer->RenderTargets = { HdrColor };
         ForwardFramebuffer->DepthTarget = Depth;
 
+        // The GBuffer fill and the forward opaque pass write the material IDs next to their regular output,
+        // see MaterialIDOutputPasses.h
+        GBufferFramebuffer->RenderTargets.push_back(MaterialIDs);
+
+        ForwardIDFramebuffer = std::make_shared<FramebufferFactory>(device);
+        ForwardIDFramebuffer->RenderTargets = { HdrColor, MaterialIDs };
+        ForwardIDFramebuffer->DepthTarget = Depth;
+
         HdrFramebuffer = std::make_shared<FramebufferFactory>(device);
         HdrFramebuffer->RenderTargets = { HdrColor };
 
@@ -105,14 +133,30 @@ void RenderTargets::Init(nvrhi::IDevice* device, dm::uint2 size, dm::uint sample
     }
 }
 
-bool RenderTargets::IsUpdateRequired(uint2 size, uint sampleCount) const
+bool RenderTargets::IsUpdateRequired(uint2 displaySize, uint sampleCount) const
 {
-    if (any(m_Size != size) || m_SampleCount != sampleCount)
+    if (any(displaySize > m_Size) || m_SampleCount != sampleCount)
+        return true;
+
+    float usedArea = float(displaySize.x) * float(displaySize.y) / (float(m_Size.x) * float(m_Size.y));
+    if (usedArea < c_MinUsedArea)
         return true;
 
     return false;
 }
 
+uint2 RenderTargets::GetAllocationSize(uint2 renderSize)
+{
+    uint2 size;
+    for (int axis = 0; axis < 2; axis++)
+    {
+        uint padded = uint(float(renderSize[axis]) * c_AllocationHeadroom);
+        padded = (padded + c_AllocationGranularity - 1) / c_AllocationGranularity * c_AllocationGranularity;
+        size[axis] = std::max(renderSize[axis], std::min(padded, c_MaxTextureSize));
+    }
+    return size;
+}
+
 void RenderTargets::Clear(nvrhi::ICommandList* commandList)
 {
     GBufferRenderTargets::Clear(commandList);
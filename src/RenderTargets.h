@@ -20,10 +20,13 @@ public:
     nvrhi::TextureHandle MaterialIDs;
     nvrhi::TextureHandle ResolvedColor;
     nvrhi::TextureHandle AmbientOcclusion;
+    nvrhi::TextureHandle TemporalFeedback1;
+    nvrhi::TextureHandle TemporalFeedback2;
 
     nvrhi::HeapHandle Heap;
 
     std::shared_ptr<FramebufferFactory> ForwardFramebuffer;
+    std::shared_ptr<FramebufferFactory> ForwardIDFramebuffer;
     std::shared_ptr<FramebufferFactory> HdrFramebuffer;
     std::shared_ptr<FramebufferFactory> LdrFramebuffer;
     std::shared_ptr<FramebufferFactory> ResolvedFramebuffer;
@@ -36,7 +39,25 @@ public:
         bool enableMotionVectors,
         bool useReverseProjection) override;
 
-    [[nodiscard]] bool IsUpdateRequired(uint2 size, uint sampleCount) const;
+    // The textures are allocated with headroom (see GetAllocationSize) and rendering happens in the
+    // renderSize area at their top left corner, so small size changes do not reallocate anything.
+    // With temporal upscaling the scene renders at a fraction of the display size and the targets written
+    // after the upscale (ResolvedColor, the feedback textures and LdrColor) use the displaySize area.
+    // An update is required when displaySize no longer fits, or uses so little of the textures that
+    // keeping them would waste memory.
+    [[nodiscard]] bool IsUpdateRequired(uint2 displaySize, uint sampleCount) const;
+
+    void SetRenderSize(uint2 renderSize) { m_RenderSize = renderSize; }
+    [[nodiscard]] uint2 GetRenderSize() const { return m_RenderSize; }
+
+    void SetDisplaySize(uint2 displaySize) { m_DisplaySize = displaySize; }
+    [[nodiscard]] uint2 GetDisplaySize() const { return m_DisplaySize; }
+
+    static uint2 GetAllocationSize(uint2 renderSize);
 
     void Clear(nvrhi::ICommandList* commandList) override;
+
+private:
+    uint2 m_RenderSize = 0;
+    uint2 m_DisplaySize = 0;
 };
\ No newline at end of file
@@ -0,0 +1,342 @@
+#include "SceneBVH.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cfloat>
+#include <cstddef>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define YUP_BVH_SSE 1
+#include <xmmintrin.h>
+#endif
+
+using namespace donut::math;
+using namespace donut::engine;
+
+static bool BoundsEqual(const box3& a, const box3& b)
+{
+    return all(a.m_mins == b.m_mins) && all(a.m_maxs == b.m_maxs);
+}
+
+static box3 GetInstanceBounds(const MeshInstance& instance)
+{
+    const SceneGraphNode* node = instance.GetNode();
+    return node ? node->GetGlobalBoundingBox() : box3::empty();
+}
+
+static float GetCentroid(const box3& bounds, int axis)
+{
+    float3 center = bounds.center();
+    return axis == 0 ? center.x : (axis == 1 ? center.y : center.z);
+}
+
+// Partitions the leaves so that the first `split` have the smaller centroids along the longest axis
+static void SplitAtMedian(uint32_t* leaves, uint32_t count, uint32_t split, const std::vector<SceneBVH::Leaf>& leafData)
+{
+    float3 centroidMin = float3(FLT_MAX);
+    float3 centroidMax = float3(-FLT_MAX);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        float3 center = leafData[leaves[i]].bounds.center();
+        centroidMin = min(centroidMin, center);
+        centroidMax = max(centroidMax, center);
+    }
+
+    float3 extent = centroidMax - centroidMin;
+    int axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : (extent.y >= extent.z ? 1 : 2);
+
+    std::nth_element(leaves, leaves + split, leaves + count, [&leafData, axis](uint32_t a, uint32_t b)
+    {
+        return GetCentroid(leafData[a].bounds, axis) < GetCentroid(leafData[b].bounds, axis);
+    });
+}
+
+void SceneBVH::Update(const SceneGraph& sceneGraph)
+{
+    const auto& instances = sceneGraph.GetMeshInstances();
+
+    bool rebuild = &sceneGraph != m_SceneGraph || instances.size() != m_Leaves.size();
+    for (size_t i = 0; !rebuild && i < instances.size(); i++)
+        rebuild = instances[i].get() != m_Leaves[i].instance;
+
+    if (rebuild)
+    {
+        Rebuild(sceneGraph);
+        return;
+    }
+
+    m_UpdatedLeaves = 0;
+    for (size_t i = 0; i < instances.size(); i++)
+    {
+        box3 bounds = GetInstanceBounds(*instances[i]);
+        if (BoundsEqual(bounds, m_Leaves[i].bounds))
+            continue;
+
+        m_Leaves[i].bounds = bounds;
+        SetSlot(m_LeafSlots[i], bounds);
+        m_DirtyNodes[m_LeafSlots[i] / 4] = 1;
+        m_UpdatedLeaves++;
+    }
+
+    if (m_UpdatedLeaves != 0)
+        Refit();
+}
+
+void SceneBVH::Rebuild(const SceneGraph& sceneGraph)
+{
+    const auto& instances = sceneGraph.GetMeshInstances();
+
+    m_SceneGraph = &sceneGraph;
+    m_Leaves.resize(instances.size());
+    m_LeafSlots.assign(instances.size(), c_EmptySlot);
+    m_Nodes.clear();
+
+    std::vector<uint32_t> leaves(instances.size());
+    for (size_t i = 0; i < instances.size(); i++)
+    {
+        m_Leaves[i].instance = instances[i].get();
+        m_Leaves[i].bounds = GetInstanceBounds(*instances[i]);
+        leaves[i] = uint32_t(i);
+    }
+
+    if (!leaves.empty())
+        BuildNode(leaves.data(), uint32_t(leaves.size()), c_EmptySlot);
+
+    m_DirtyNodes.assign(m_Nodes.size(), 0);
+    m_UpdatedLeaves = uint32_t(m_Leaves.size());
+}
+
+uint32_t SceneBVH::BuildNode(uint32_t* leaves, uint32_t count, uint32_t parentSlot)
+{
+    uint32_t nodeIndex = uint32_t(m_Nodes.size());
+    m_Nodes.emplace_back();
+    m_Nodes[nodeIndex].parentSlot = parentSlot;
+    for (uint32_t slot = 0; slot < 4; slot++)
+    {
+        m_Nodes[nodeIndex].children[slot] = c_EmptySlot;
+        SetSlot(nodeIndex * 4 + slot, box3::empty());
+    }
+
+    // Up to four leaves go into the slots directly, more are halved along the longest axis and the halves again
+    uint32_t groupBegin[5];
+    uint32_t groupCount;
+    if (count <= 4)
+    {
+        for (uint32_t i = 0; i <= count; i++)
+            groupBegin[i] = i;
+        groupCount = count;
+    }
+    else
+    {
+        uint32_t half = count / 2;
+        SplitAtMedian(leaves, count, half, m_Leaves);
+        SplitAtMedian(leaves, half, half / 2, m_Leaves);
+        SplitAtMedian(leaves + half, count - half, (count - half) / 2, m_Leaves);
+
+        groupBegin[0] = 0;
+        groupBegin[1] = half / 2;
+        groupBegin[2] = half;
+        groupBegin[3] = half + (count - half) / 2;
+        groupBegin[4] = count;
+        groupCount = 4;
+    }
+
+    for (uint32_t group = 0; group < groupCount; group++)
+    {
+        uint32_t slot = nodeIndex * 4 + group;
+        uint32_t groupSize = groupBegin[group + 1] - groupBegin[group];
+
+        if (groupSize == 1)
+        {
+            uint32_t leaf = leaves[groupBegin[group]];
+            m_Nodes[nodeIndex].children[group] = leaf | c_LeafBit;
+            m_LeafSlots[leaf] = slot;
+            SetSlot(slot, m_Leaves[leaf].bounds);
+        }
+        else
+        {
+            // The children are created after their parent, which is what Refit relies on
+            uint32_t child = BuildNode(leaves + groupBegin[group], groupSize, slot);
+            m_Nodes[nodeIndex].children[group] = child;
+            SetSlot(slot, GetNodeBounds(child));
+        }
+    }
+
+    return nodeIndex;
+}
+
+void SceneBVH::SetSlot(uint32_t slot, const box3& bounds)
+{
+    Node& node = m_Nodes[slot / 4];
+    uint32_t lane = slot % 4;
+    node.minX[lane] = bounds.m_mins.x;
+    node.minY[lane] = bounds.m_mins.y;
+    node.minZ[lane] = bounds.m_mins.z;
+    node.maxX[lane] = bounds.m_maxs.x;
+    node.maxY[lane] = bounds.m_maxs.y;
+    node.maxZ[lane] = bounds.m_maxs.z;
+}
+
+box3 SceneBVH::GetNodeBounds(uint32_t nodeIndex) const
+{
+    const Node& node = m_Nodes[nodeIndex];
+    box3 bounds = box3::empty();
+    for (uint32_t lane = 0; lane < 4; lane++)
+    {
+        bounds.m_mins = min(bounds.m_mins, float3(node.minX[lane], node.minY[lane], node.minZ[lane]));
+        bounds.m_maxs = max(bounds.m_maxs, float3(node.maxX[lane], node.maxY[lane], node.maxZ[lane]));
+    }
+    return bounds;
+}
+
+void SceneBVH::Refit()
+{
+    // Children have larger indices than their parents, so one pass from the back reaches the root last
+    for (size_t nodeIndex = m_Nodes.size(); nodeIndex-- > 1; )
+    {
+        if (!m_DirtyNodes[nodeIndex])
+            continue;
+
+        uint32_t parentSlot = m_Nodes[nodeIndex].parentSlot;
+        SetSlot(parentSlot, GetNodeBounds(uint32_t(nodeIndex)));
+        m_DirtyNodes[parentSlot / 4] = 1;
+        m_DirtyNodes[nodeIndex] = 0;
+    }
+
+    m_DirtyNodes[0] = 0;
+}
+
+void SceneBVH::SetupPlaneTests(const frustum& viewFrustum, PlaneTest* tests)
+{
+    // Same test as frustum::intersectsWith: a box is outside when the corner that is furthest inside a plane
+    // is still in front of it. The corner takes the minimum where the plane normal is positive.
+    for (int i = 0; i < frustum::PLANES_COUNT; i++)
+    {
+        const plane& p = viewFrustum.planes[i];
+        tests[i].offsetX = p.normal.x > 0.f ? offsetof(Node, minX) : offsetof(Node, maxX);
+        tests[i].offsetY = p.normal.y > 0.f ? offsetof(Node, minY) : offsetof(Node, maxY);
+        tests[i].offsetZ = p.normal.z > 0.f ? offsetof(Node, minZ) : offsetof(Node, maxZ);
+        tests[i].normalX = p.normal.x;
+        tests[i].normalY = p.normal.y;
+        tests[i].normalZ = p.normal.z;
+        tests[i].distance = p.distance;
+    }
+}
+
+int SceneBVH::GetOutsideMask(const Node& node, const PlaneTest* tests)
+{
+    auto lanes = [&node](size_t offset)
+    {
+        return reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(&node) + offset);
+    };
+
+    int outsideMask = 0;
+    for (int i = 0; i < frustum::PLANES_COUNT; i++)
+    {
+        const PlaneTest& test = tests[i];
+#if YUP_BVH_SSE
+        __m128 distance = _mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(_mm_load_ps(lanes(test.offsetX)), _mm_set1_ps(test.normalX)),
+            _mm_mul_ps(_mm_load_ps(lanes(test.offsetY)), _mm_set1_ps(test.normalY))),
+            _mm_mul_ps(_mm_load_ps(lanes(test.offsetZ)), _mm_set1_ps(test.normalZ)));
+        outsideMask |= _mm_movemask_ps(_mm_cmpgt_ps(distance, _mm_set1_ps(test.distance)));
+#else
+        const float* x = lanes(test.offsetX);
+        const float* y = lanes(test.offsetY);
+        const float* z = lanes(test.offsetZ);
+        for (int lane = 0; lane < 4; lane++)
+        {
+            if (x[lane] * test.normalX + y[lane] * test.normalY + z[lane] * test.normalZ > test.distance)
+                outsideMask |= 1 << lane;
+        }
+#endif
+        if (outsideMask == 0xf)
+            break;
+    }
+    return outsideMask;
+}
+
+void SceneBVH::CullFrustum(const frustum& viewFrustum, std::vector<uint32_t>& visibleLeaves) const
+{
+    if (m_Nodes.empty())
+        return;
+
+    PlaneTest tests[frustum::PLANES_COUNT];
+    SetupPlaneTests(viewFrustum, tests);
+
+    // The tree is balanced, 64 entries cover far more instances than a scene can hold
+    uint32_t stack[64];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize != 0)
+    {
+        const Node& node = m_Nodes[stack[--stackSize]];
+        int outsideMask = GetOutsideMask(node, tests);
+
+        for (int lane = 0; lane < 4; lane++)
+        {
+            uint32_t child = node.children[lane];
+            if ((outsideMask & (1 << lane)) || child == c_EmptySlot)
+                continue;
+
+            if (child & c_LeafBit)
+                visibleLeaves.push_back(child & ~c_LeafBit);
+            else
+                stack[stackSize++] = child;
+        }
+    }
+}
+
+void SceneBVH::CullFrusta(const frustum* frusta, uint32_t count, std::vector<MaskedLeaf>& visibleLeaves) const
+{
+    assert(count <= c_MaxFrusta);
+    if (m_Nodes.empty() || count == 0)
+        return;
+
+    PlaneTest tests[c_MaxFrusta][frustum::PLANES_COUNT];
+    for (uint32_t i = 0; i < count; i++)
+        SetupPlaneTests(frusta[i], tests[i]);
+
+    // Every entry carries the frusta that its node intersects; the children are only tested against those
+    struct StackEntry
+    {
+        uint32_t node;
+        uint32_t frustumMask;
+    };
+
+    StackEntry stack[64];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = { 0, (1u << count) - 1 };
+
+    while (stackSize != 0)
+    {
+        StackEntry entry = stack[--stackSize];
+        const Node& node = m_Nodes[entry.node];
+
+        uint32_t laneMasks[4] = {};
+        for (uint32_t frustumMask = entry.frustumMask; frustumMask != 0; frustumMask &= frustumMask - 1)
+        {
+            uint32_t frustumIndex = uint32_t(std::countr_zero(frustumMask));
+            int outsideMask = GetOutsideMask(node, tests[frustumIndex]);
+            for (int lane = 0; lane < 4; lane++)
+            {
+                if (!(outsideMask & (1 << lane)))
+                    laneMasks[lane] |= 1u << frustumIndex;
+            }
+        }
+
+        for (int lane = 0; lane < 4; lane++)
+        {
+            uint32_t child = node.children[lane];
+            if (laneMasks[lane] == 0 || child == c_EmptySlot)
+                continue;
+
+            if (child & c_LeafBit)
+                visibleLeaves.push_back({ child & ~c_LeafBit, laneMasks[lane] });
+            else
+                stack[stackSize++] = { child, laneMasks[lane] };
+        }
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <donut/engine/SceneGraph.h>
+#include <donut/core/math/math.h>
+#include <cstdint>
+#include <vector>
+
+// Four-wide bounding volume hierarchy over the mesh instances of a scene graph, for frustum culling.
+// Every node keeps the bounds of its four children as structure of arrays, so that one SSE test against
+// a plane covers all of them. Update rebuilds the tree when the set of instances changes; otherwise only
+// the instances whose bounds changed are written and their ancestors refitted.
+class SceneBVH
+{
+public:
+    struct Leaf
+    {
+        const donut::engine::MeshInstance* instance = nullptr;
+        donut::math::box3 bounds;
+    };
+
+    // Call after the scene graph was refreshed, i.e. when the global bounding boxes are current
+    void Update(const donut::engine::SceneGraph& sceneGraph);
+
+    // Appends the indices of the leaves whose bounds intersect the frustum
+    void CullFrustum(const donut::math::frustum& viewFrustum, std::vector<uint32_t>& visibleLeaves) const;
+
+    static constexpr uint32_t c_MaxFrusta = 8;
+
+    struct MaskedLeaf
+    {
+        uint32_t leaf;
+        // Bit i is set when the leaf intersects frusta[i]
+        uint32_t frustumMask;
+    };
+
+    // Culls against several frusta in one traversal, e.g. the cascades of a shadow map, and appends the
+    // leaves that intersect at least one of them. Subtrees are only tested against the frusta of their parent.
+    void CullFrusta(const donut::math::frustum* frusta, uint32_t count, std::vector<MaskedLeaf>& visibleLeaves) const;
+
+    [[nodiscard]] const Leaf& GetLeaf(uint32_t index) const { return m_Leaves[index]; }
+    [[nodiscard]] uint32_t GetLeafCount() const { return uint32_t(m_Leaves.size()); }
+    [[nodiscard]] uint32_t GetNodeCount() const { return uint32_t(m_Nodes.size()); }
+
+    // Leaves whose bounds changed in the last Update, or all of them when it rebuilt the tree
+    [[nodiscard]] uint32_t GetUpdatedLeafCount() const { return m_UpdatedLeaves; }
+
+private:
+    static constexpr uint32_t c_LeafBit = 0x80000000u;
+    static constexpr uint32_t c_EmptySlot = 0xffffffffu;
+
+    struct alignas(16) Node
+    {
+        float minX[4];
+        float minY[4];
+        float minZ[4];
+        float maxX[4];
+        float maxY[4];
+        float maxZ[4];
+        // Node index, leaf index with c_LeafBit set, or c_EmptySlot. Empty slots have inverted bounds.
+        uint32_t children[4];
+        // Node index * 4 + slot that holds the bounds of this node, or c_EmptySlot for the root
+        uint32_t parentSlot;
+    };
+
+    struct PlaneTest
+    {
+        size_t offsetX, offsetY, offsetZ;
+        float normalX, normalY, normalZ, distance;
+    };
+
+    static void SetupPlaneTests(const donut::math::frustum& viewFrustum, PlaneTest* tests);
+    // Bit i is set when child slot i is outside of the frustum
+    static int GetOutsideMask(const Node& node, const PlaneTest* tests);
+
+    void Rebuild(const donut::engine::SceneGraph& sceneGraph);
+    uint32_t BuildNode(uint32_t* leaves, uint32_t count, uint32_t parentSlot);
+    void SetSlot(uint32_t slot, const donut::math::box3& bounds);
+    [[nodiscard]] donut::math::box3 GetNodeBounds(uint32_t node) const;
+    void Refit();
+
+    const donut::engine::SceneGraph* m_SceneGraph = nullptr;
+    std::vector<Leaf> m_Leaves;
+    std::vector<uint32_t> m_LeafSlots;
+    std::vector<Node> m_Nodes;
+    std::vector<uint8_t> m_DirtyNodes;
+    uint32_t m_UpdatedLeaves = 0;
+};
@@ -0,0 +1,152 @@
+#include "SceneVisibility.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace donut::math;
+using namespace donut::engine;
+using namespace donut::render;
+
+static bool IsOpaqueDomain(const Material* material)
+{
+    return !material || material->domain == MaterialDomain::Opaque || material->domain == MaterialDomain::AlphaTested;
+}
+
+void SceneVisibility::BeginFrame(const SceneGraph& sceneGraph)
+{
+    m_Bvh.Update(sceneGraph);
+
+    m_Stats.instances = m_Bvh.GetLeafCount();
+    m_Stats.updatedInstances = m_Bvh.GetUpdatedLeafCount();
+    m_Stats.culledViews = m_CulledViews.exchange(0);
+    m_Stats.requests = m_Requests.exchange(0);
+
+    std::lock_guard lock(m_Mutex);
+
+    // Views that were not drawn in the last frame are dropped, the others keep their allocations
+    for (auto it = m_Entries.begin(); it != m_Entries.end(); )
+    {
+        if (!it->second->used)
+        {
+            it = m_Entries.erase(it);
+            continue;
+        }
+
+        it->second->used = false;
+        it->second->valid = false;
+        ++it;
+    }
+}
+
+const VisibleSet& SceneVisibility::GetVisibleSet(const IView& view)
+{
+    m_Requests++;
+
+    Entry* entry;
+    {
+        std::lock_guard lock(m_Mutex);
+        std::unique_ptr<Entry>& slot = m_Entries[&view];
+        if (!slot)
+            slot = std::make_unique<Entry>();
+        entry = slot.get();
+    }
+
+    // Passes that draw the same view at the same time wait for the first one to cull it
+    std::lock_guard lock(entry->mutex);
+    entry->used = true;
+
+    float4x4 viewProjection = view.GetViewProjectionMatrix();
+    if (!entry->valid || memcmp(&viewProjection, &entry->viewProjection, sizeof(viewProjection)) != 0)
+    {
+        entry->viewProjection = viewProjection;
+        Cull(view, *entry);
+        entry->valid = true;
+        m_CulledViews++;
+    }
+
+    return entry->set;
+}
+
+void SceneVisibility::Cull(const IView& view, Entry& entry)
+{
+    entry.visibleLeaves.clear();
+    m_Bvh.CullFrustum(view.GetViewFrustum(), entry.visibleLeaves);
+
+    VisibleSet& set = entry.set;
+    set.opaqueItems.clear();
+    set.transparentItems.clear();
+
+    float3 viewOrigin = view.GetViewOrigin();
+
+    for (uint32_t leafIndex : entry.visibleLeaves)
+    {
+        const SceneBVH::Leaf& leaf = m_Bvh.GetLeaf(leafIndex);
+        const MeshInfo* mesh = leaf.instance->GetMesh().get();
+        if (!mesh)
+            continue;
+
+        float distanceToCamera = length(leaf.bounds.center() - viewOrigin);
+
+        for (const auto& geometry : mesh->geometries)
+        {
+            DrawItem item;
+            item.instance = leaf.instance;
+            item.mesh = mesh;
+            item.geometry = geometry.get();
+            item.material = geometry->material.get();
+            item.buffers = mesh->buffers.get();
+            item.distanceToCamera = distanceToCamera;
+            item.cullMode = (item.material && item.material->doubleSided) ? nvrhi::RasterCullMode::None : nvrhi::RasterCullMode::Back;
+
+            if (IsOpaqueDomain(item.material))
+                set.opaqueItems.push_back(item);
+            else if (item.material->doubleSided)
+            {
+                item.cullMode = nvrhi::RasterCullMode::Front;
+                set.transparentItems.push_back(item);
+                item.cullMode = nvrhi::RasterCullMode::Back;
+                set.transparentItems.push_back(item);
+            }
+            else
+                set.transparentItems.push_back(item);
+        }
+    }
+
+    std::sort(set.opaqueItems.begin(), set.opaqueItems.end(), [](const DrawItem& a, const DrawItem& b)
+    {
+        if (a.material != b.material)
+            return a.material < b.material;
+        if (a.buffers != b.buffers)
+            return a.buffers < b.buffers;
+        if (a.mesh != b.mesh)
+            return a.mesh < b.mesh;
+        return a.instance < b.instance;
+    });
+
+    // Stable, so that the back faces of a double sided item stay ahead of its front faces
+    std::stable_sort(set.transparentItems.begin(), set.transparentItems.end(), [](const DrawItem& a, const DrawItem& b)
+    {
+        return a.distanceToCamera > b.distanceToCamera;
+    });
+}
+
+CachedDrawStrategy::CachedDrawStrategy(std::shared_ptr<SceneVisibility> visibility, bool transparent)
+    : m_Visibility(std::move(visibility))
+    , m_Transparent(transparent)
+{
+}
+
+void CachedDrawStrategy::PrepareForView(const std::shared_ptr<SceneGraphNode>& rootNode, const IView& view)
+{
+    const VisibleSet& set = m_Visibility->GetVisibleSet(view);
+    m_Items = m_Transparent ? &set.transparentItems : &set.opaqueItems;
+    m_NextItem = 0;
+}
+
+const DrawItem* CachedDrawStrategy::GetNextItem()
+{
+    if (!m_Items || m_NextItem >= m_Items->size())
+        return nullptr;
+
+    return &(*m_Items)[m_NextItem++];
+}
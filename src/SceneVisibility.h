@@ -0,0 +1,89 @@
+#pragma once
+
+#include <donut/render/DrawStrategy.h>
+#include <donut/engine/View.h>
+#include <donut/engine/SceneGraph.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "SceneBVH.h"
+
+// The draw items that are visible from one view, sorted like the donut draw strategies sort them
+struct VisibleSet
+{
+    // Opaque and alpha tested geometry, grouped by material, buffers and mesh so that instances can be batched
+    std::vector<donut::render::DrawItem> opaqueItems;
+    // All other material domains, back to front. Double sided materials are drawn twice, back faces first,
+    // like TransparentDrawStrategy does with DrawDoubleSidedMaterialsSeparately.
+    std::vector<donut::render::DrawItem> transparentItems;
+};
+
+// Culls the scene once per frame and view, against a SceneBVH, and hands the result to every pass that
+// draws the same view. Views are identified by their address and view-projection matrix, so a view that
+// is set up again during the frame (e.g. the shadow map rendering a light probe) is culled again.
+class SceneVisibility
+{
+public:
+    // Updates the BVH and forgets the sets of the previous frame. Call on the render thread after the scene
+    // graph was refreshed and before any pass draws.
+    void BeginFrame(const donut::engine::SceneGraph& sceneGraph);
+
+    // Returns the set of the view, culling it on the first request in the frame. Thread-safe; the set stays
+    // valid until the next BeginFrame, or until the view is requested again with other matrices.
+    const VisibleSet& GetVisibleSet(const donut::engine::IView& view);
+
+    struct Stats
+    {
+        uint32_t instances = 0;
+        uint32_t updatedInstances = 0;
+        uint32_t culledViews = 0;
+        uint32_t requests = 0;
+    };
+
+    // Counters of the previous frame
+    [[nodiscard]] const Stats& GetStats() const { return m_Stats; }
+
+    // The BVH of the current frame, for passes that cull on their own, e.g. against several frusta at once
+    [[nodiscard]] const SceneBVH& GetBVH() const { return m_Bvh; }
+
+private:
+    struct Entry
+    {
+        std::mutex mutex;
+        donut::math::float4x4 viewProjection;
+        bool valid = false;
+        bool used = false;
+        VisibleSet set;
+        std::vector<uint32_t> visibleLeaves;
+    };
+
+    void Cull(const donut::engine::IView& view, Entry& entry);
+
+    SceneBVH m_Bvh;
+    std::mutex m_Mutex;
+    std::unordered_map<const donut::engine::IView*, std::unique_ptr<Entry>> m_Entries;
+    std::atomic<uint32_t> m_CulledViews = 0;
+    std::atomic<uint32_t> m_Requests = 0;
+    Stats m_Stats;
+};
+
+// Draw strategy that replays the visible set of the view from a SceneVisibility instead of walking the
+// scene graph. The root node passed to PrepareForView is ignored, the set always covers the whole scene.
+// Use one instance per command list that is recorded concurrently.
+class CachedDrawStrategy : public donut::render::IDrawStrategy
+{
+public:
+    CachedDrawStrategy(std::shared_ptr<SceneVisibility> visibility, bool transparent);
+
+    void PrepareForView(const std::shared_ptr<donut::engine::SceneGraphNode>& rootNode, const donut::engine::IView& view) override;
+    const donut::render::DrawItem* GetNextItem() override;
+
+private:
+    std::shared_ptr<SceneVisibility> m_Visibility;
+    bool m_Transparent;
+    const std::vector<donut::render::DrawItem>* m_Items = nullptr;
+    size_t m_NextItem = 0;
+};
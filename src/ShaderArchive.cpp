@@ -0,0 +1,351 @@
+#include "ShaderArchive.h"
+
+#include <donut/core/log.h>
+#include <algorithm>
+#include <cstring>
+#include <set>
+
+#ifdef WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace donut;
+
+static thread_local ShaderBlobHashes* t_RecordedBlobs = nullptr;
+
+class ShaderArchive::Mapping
+{
+public:
+    ~Mapping()
+    {
+#ifdef WIN32
+        if (m_Data)
+            UnmapViewOfFile(m_Data);
+        if (m_MappingHandle)
+            CloseHandle(m_MappingHandle);
+        if (m_FileHandle != INVALID_HANDLE_VALUE)
+            CloseHandle(m_FileHandle);
+#else
+        if (m_Data)
+            munmap(m_Data, m_Size);
+#endif
+    }
+
+    bool Map(const std::filesystem::path& path)
+    {
+#ifdef WIN32
+        m_FileHandle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (m_FileHandle == INVALID_HANDLE_VALUE)
+            return false;
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(m_FileHandle, &size) || size.QuadPart == 0)
+            return false;
+
+        m_MappingHandle = CreateFileMappingW(m_FileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!m_MappingHandle)
+            return false;
+
+        m_Data = MapViewOfFile(m_MappingHandle, FILE_MAP_READ, 0, 0, 0);
+        m_Size = size_t(size.QuadPart);
+#else
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0)
+        {
+            close(fd);
+            return false;
+        }
+
+        // The mapping stays valid after the descriptor is closed
+        void* data = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+
+        if (data == MAP_FAILED)
+            return false;
+
+        m_Data = data;
+        m_Size = size_t(st.st_size);
+#endif
+        return m_Data != nullptr;
+    }
+
+    [[nodiscard]] const uint8_t* GetData() const { return static_cast<const uint8_t*>(m_Data); }
+    [[nodiscard]] size_t GetSize() const { return m_Size; }
+
+private:
+#ifdef WIN32
+    HANDLE m_FileHandle = INVALID_HANDLE_VALUE;
+    HANDLE m_MappingHandle = nullptr;
+#endif
+    void* m_Data = nullptr;
+    size_t m_Size = 0;
+};
+
+// Blob that points into the archive mapping and keeps it mapped for as long as the blob is alive
+class MappedBlob : public vfs::IBlob
+{
+public:
+    MappedBlob(std::shared_ptr<const void> mapping, const void* data, size_t size)
+        : m_Mapping(std::move(mapping))
+        , m_Data(data)
+        , m_Size(size)
+    {
+    }
+
+    [[nodiscard]] const void* data() const override { return m_Data; }
+    [[nodiscard]] size_t size() const override { return m_Size; }
+
+private:
+    std::shared_ptr<const void> m_Mapping;
+    const void* m_Data;
+    size_t m_Size;
+};
+
+std::shared_ptr<ShaderArchive> ShaderArchive::Open(const std::filesystem::path& archivePath)
+{
+    std::error_code ec;
+    if (!std::filesystem::exists(archivePath, ec))
+        return nullptr;
+
+    auto mapping = std::make_shared<Mapping>();
+    if (!mapping->Map(archivePath))
+    {
+        log::warning("Cannot map the shader archive '%s'", archivePath.generic_string().c_str());
+        return nullptr;
+    }
+
+    const uint8_t* data = mapping->GetData();
+    size_t size = mapping->GetSize();
+
+    shaderpak::FileHeader header;
+    if (size < sizeof(header))
+        return nullptr;
+    memcpy(&header, data, sizeof(header));
+
+    auto rangeValid = [size](uint64_t offset, uint64_t rangeSize)
+    {
+        return offset <= size && rangeSize <= size - offset;
+    };
+
+    if (header.magic != shaderpak::c_Magic || header.version != shaderpak::c_Version ||
+        header.entriesOffset % alignof(shaderpak::Entry) != 0 ||
+        !rangeValid(header.entriesOffset, uint64_t(header.numEntries) * sizeof(shaderpak::Entry)) ||
+        !rangeValid(header.stringsOffset, header.stringsSize))
+    {
+        log::warning("Shader archive '%s' is invalid or has an unsupported version", archivePath.generic_string().c_str());
+        return nullptr;
+    }
+
+    auto archive = std::shared_ptr<ShaderArchive>(new ShaderArchive());
+    archive->m_Path = archivePath;
+    archive->m_Header = header;
+    archive->m_Entries = reinterpret_cast<const shaderpak::Entry*>(data + header.entriesOffset);
+    archive->m_Strings = reinterpret_cast<const char*>(data + header.stringsOffset);
+
+    for (uint32_t i = 0; i < header.numEntries; i++)
+    {
+        const shaderpak::Entry& entry = archive->m_Entries[i];
+        if (!rangeValid(entry.nameOffset, entry.nameSize) || entry.nameOffset + entry.nameSize > header.stringsSize ||
+            !rangeValid(entry.dataOffset, entry.dataSize))
+        {
+            log::warning("Shader archive '%s' has an invalid entry", archivePath.generic_string().c_str());
+            return nullptr;
+        }
+    }
+
+    archive->m_Mapping = std::move(mapping);
+    return archive;
+}
+
+bool ShaderArchive::IsUpToDate(const std::filesystem::path& archivePath, const std::filesystem::path& shaderDir)
+{
+    std::error_code ec;
+    auto archiveTime = std::filesystem::last_write_time(archivePath, ec);
+    if (ec)
+        return false;
+
+    // Without the loose shader files (e.g. a packaged build) the archive is all there is
+    for (const auto& item : std::filesystem::recursive_directory_iterator(shaderDir, ec))
+    {
+        if (item.is_regular_file(ec) && item.last_write_time(ec) > archiveTime)
+            return false;
+    }
+
+    return true;
+}
+
+std::string ShaderArchive::NormalizePath(const std::filesystem::path& name)
+{
+    std::string path = name.lexically_normal().generic_string();
+
+    // Mount points pass the path below them with a leading slash
+    path.erase(0, path.find_first_not_of('/'));
+    if (!path.empty() && path.back() == '/')
+        path.pop_back();
+    if (path == ".")
+        path.clear();
+
+    return path;
+}
+
+std::string_view ShaderArchive::GetName(const shaderpak::Entry& entry) const
+{
+    return std::string_view(m_Strings + entry.nameOffset, entry.nameSize);
+}
+
+const shaderpak::Entry* ShaderArchive::FindEntry(std::string_view name) const
+{
+    const shaderpak::Entry* end = m_Entries + m_Header.numEntries;
+    const shaderpak::Entry* entry = std::lower_bound(m_Entries, end, name,
+        [this](const shaderpak::Entry& a, std::string_view b) { return GetName(a) < b; });
+
+    return (entry != end && GetName(*entry) == name) ? entry : nullptr;
+}
+
+bool ShaderArchive::folderExists(const std::filesystem::path& name)
+{
+    std::string folder = NormalizePath(name);
+    if (folder.empty())
+        return true;
+
+    folder += '/';
+    const shaderpak::Entry* end = m_Entries + m_Header.numEntries;
+    const shaderpak::Entry* entry = std::lower_bound(m_Entries, end, std::string_view(folder),
+        [this](const shaderpak::Entry& a, std::string_view b) { return GetName(a) < b; });
+
+    return entry != end && GetName(*entry).substr(0, folder.size()) == folder;
+}
+
+bool ShaderArchive::fileExists(const std::filesystem::path& name)
+{
+    return FindEntry(NormalizePath(name)) != nullptr;
+}
+
+std::shared_ptr<vfs::IBlob> ShaderArchive::readFile(const std::filesystem::path& name)
+{
+    const shaderpak::Entry* entry = FindEntry(NormalizePath(name));
+    if (!entry)
+        return nullptr;
+
+    if (t_RecordedBlobs)
+        (*t_RecordedBlobs)[std::string(GetName(*entry))] = entry->hash;
+
+    return std::make_shared<MappedBlob>(m_Mapping, m_Mapping->GetData() + entry->dataOffset, size_t(entry->dataSize));
+}
+
+bool ShaderArchive::writeFile(const std::filesystem::path& name, const void* data, size_t size)
+{
+    return false;
+}
+
+int ShaderArchive::enumerateFiles(const std::filesystem::path& path, const std::vector<std::string>& extensions,
+    vfs::enumerate_callback_t callback, bool allowDuplicates)
+{
+    std::string folder = NormalizePath(path);
+    if (!folder.empty())
+        folder += '/';
+
+    int count = 0;
+    for (uint32_t i = 0; i < m_Header.numEntries; i++)
+    {
+        std::string_view name = GetName(m_Entries[i]);
+        if (name.substr(0, folder.size()) != folder)
+            continue;
+
+        std::string_view fileName = name.substr(folder.size());
+        if (fileName.find('/') != std::string_view::npos)
+            continue;
+
+        bool extensionMatches = extensions.empty();
+        for (const std::string& extension : extensions)
+        {
+            if (fileName.size() >= extension.size() && fileName.substr(fileName.size() - extension.size()) == extension)
+            {
+                extensionMatches = true;
+                break;
+            }
+        }
+
+        if (extensionMatches)
+        {
+            callback(fileName);
+            count++;
+        }
+    }
+
+    return count;
+}
+
+int ShaderArchive::enumerateDirectories(const std::filesystem::path& path, vfs::enumerate_callback_t callback,
+    bool allowDuplicates)
+{
+    std::string folder = NormalizePath(path);
+    if (!folder.empty())
+        folder += '/';
+
+    std::set<std::string_view> directories;
+    for (uint32_t i = 0; i < m_Header.numEntries; i++)
+    {
+        std::string_view name = GetName(m_Entries[i]);
+        if (name.substr(0, folder.size()) != folder)
+            continue;
+
+        std::string_view rest = name.substr(folder.size());
+        size_t slash = rest.find('/');
+        if (slash != std::string_view::npos)
+            directories.insert(rest.substr(0, slash));
+    }
+
+    for (std::string_view directory : directories)
+        callback(directory);
+
+    return int(directories.size());
+}
+
+uint32_t ShaderArchive::CountChangedEntries(const ShaderArchive& other) const
+{
+    uint32_t changed = 0;
+    for (uint32_t i = 0; i < m_Header.numEntries; i++)
+    {
+        const shaderpak::Entry* otherEntry = other.FindEntry(GetName(m_Entries[i]));
+        if (!otherEntry || otherEntry->hash != m_Entries[i].hash || otherEntry->dataSize != m_Entries[i].dataSize)
+            changed++;
+    }
+
+    return changed;
+}
+
+bool ShaderArchive::ContainsBlobs(const ShaderBlobHashes& blobs) const
+{
+    for (const auto& [name, hash] : blobs)
+    {
+        const shaderpak::Entry* entry = FindEntry(name);
+        if (!entry || entry->hash != hash)
+            return false;
+    }
+
+    return true;
+}
+
+ShaderReadRecorder::ShaderReadRecorder(ShaderBlobHashes& blobs)
+    : m_Previous(t_RecordedBlobs)
+{
+    t_RecordedBlobs = &blobs;
+}
+
+ShaderReadRecorder::~ShaderReadRecorder()
+{
+    t_RecordedBlobs = m_Previous;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <donut/core/vfs/VFS.h>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ShaderArchiveFormat.h"
+
+// Names and content hashes of archive blobs, e.g. the ones a render pass was created from
+using ShaderBlobHashes = std::unordered_map<std::string, uint64_t>;
+
+// Read-only file system over a memory-mapped shader archive written by YupCooker (see ShaderArchiveFormat.h).
+// Blobs returned by readFile point into the mapping and keep it alive, so ShaderFactory can cache them
+// without copying and the archive can be replaced by a newer one while the old blobs are still in use.
+class ShaderArchive : public donut::vfs::IFileSystem
+{
+public:
+    // Returns nullptr when the file does not exist or is not a valid archive
+    static std::shared_ptr<ShaderArchive> Open(const std::filesystem::path& archivePath);
+
+    // True when no file in shaderDir was written after the archive, i.e. the archive holds the current shaders
+    static bool IsUpToDate(const std::filesystem::path& archivePath, const std::filesystem::path& shaderDir);
+
+    bool folderExists(const std::filesystem::path& name) override;
+    bool fileExists(const std::filesystem::path& name) override;
+    std::shared_ptr<donut::vfs::IBlob> readFile(const std::filesystem::path& name) override;
+    bool writeFile(const std::filesystem::path& name, const void* data, size_t size) override;
+    int enumerateFiles(const std::filesystem::path& path, const std::vector<std::string>& extensions,
+        donut::vfs::enumerate_callback_t callback, bool allowDuplicates = false) override;
+    int enumerateDirectories(const std::filesystem::path& path, donut::vfs::enumerate_callback_t callback,
+        bool allowDuplicates = false) override;
+
+    // Number of entries that are new or have different contents than in the other archive
+    [[nodiscard]] uint32_t CountChangedEntries(const ShaderArchive& other) const;
+    // True when every blob is in this archive with the same hash
+    [[nodiscard]] bool ContainsBlobs(const ShaderBlobHashes& blobs) const;
+    [[nodiscard]] uint32_t GetEntryCount() const { return m_Header.numEntries; }
+    [[nodiscard]] const std::filesystem::path& GetPath() const { return m_Path; }
+
+private:
+    class Mapping;
+
+    ShaderArchive() = default;
+
+    [[nodiscard]] std::string_view GetName(const shaderpak::Entry& entry) const;
+    [[nodiscard]] const shaderpak::Entry* FindEntry(std::string_view name) const;
+    static std::string NormalizePath(const std::filesystem::path& name);
+
+    std::filesystem::path m_Path;
+    std::shared_ptr<Mapping> m_Mapping;
+    shaderpak::FileHeader m_Header{};
+    const shaderpak::Entry* m_Entries = nullptr;
+    const char* m_Strings = nullptr;
+};
+
+// Records the blobs that are read from any ShaderArchive on the current thread while it is alive
+class ShaderReadRecorder
+{
+public:
+    explicit ShaderReadRecorder(ShaderBlobHashes& blobs);
+    ~ShaderReadRecorder();
+
+    ShaderReadRecorder(const ShaderReadRecorder&) = delete;
+    ShaderReadRecorder& operator=(const ShaderReadRecorder&) = delete;
+
+private:
+    ShaderBlobHashes* m_Previous;
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+
+// Shader blob archive (.pak), written by YupCooker from one compiled shader directory (Shaders/dxil,
+// Shaders/spirv, ...) and memory-mapped by ShaderArchive.
+//
+// The file starts with a FileHeader, followed by the entry table sorted by name, the string table with
+// the entry names (relative paths with forward slashes, not null-terminated) and the shader blobs.
+// Every blob starts at a c_DataAlignment boundary and is used in place from the mapping.
+// All values are little-endian.
+
+namespace shaderpak
+{
+    constexpr uint32_t c_Magic = 0x44485359;    // "YSHD"
+    constexpr uint32_t c_Version = 1;
+    constexpr uint32_t c_DataAlignment = 16;
+
+    struct FileHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t numEntries;
+        uint32_t stringsSize;
+        uint64_t entriesOffset;
+        uint64_t stringsOffset;
+    };
+
+    struct Entry
+    {
+        uint32_t nameOffset;
+        uint32_t nameSize;
+        uint64_t dataOffset;
+        uint64_t dataSize;
+        uint64_t hash;          // XXHash64 of the blob, compared on reload to find the shaders that changed
+    };
+
+    static_assert(sizeof(FileHeader) == 32);
+    static_assert(sizeof(Entry) == 32);
+}
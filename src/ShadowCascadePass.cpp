@@ -0,0 +1,242 @@
+#include "ShadowCascadePass.h"
+
+#include <donut/engine/SceneGraph.h>
+#include <donut/engine/View.h>
+#include <nvrhi/utils.h>
+#include <algorithm>
+#include <bit>
+#include <utility>
+
+using namespace donut::render;
+using namespace donut::engine;
+using namespace donut::math;
+
+// Matches ShadowDrawConstants in ShadowCascades.hlsl
+struct ShadowDrawConstants
+{
+    uint instanceIndex;
+    uint geometryIndex;
+    uint cascadeMask;
+    uint padding;
+};
+
+// Matches ShadowCascadeConstants in ShadowCascades.hlsl
+struct ShadowCascadeConstants
+{
+    float4x4 matWorldToClip[ShadowCascadePass::c_MaxCascades];
+};
+
+ShadowCascadePass::ShadowCascadePass(nvrhi::IDevice* device,
+    const std::shared_ptr<ShaderFactory>& shaderFactory,
+    std::shared_ptr<CommonRenderPasses> commonPasses,
+    nvrhi::IBindingLayout* bindlessLayout,
+    const DepthPass::CreateParameters& params)
+    : m_BindlessLayout(bindlessLayout)
+    , m_Params(params)
+    , m_CommonPasses(std::move(commonPasses))
+    , m_Device(device)
+    , m_BindingCache(device)
+{
+    nvrhi::BindingLayoutDesc layoutDesc;
+    layoutDesc.visibility = nvrhi::ShaderType::Vertex | nvrhi::ShaderType::Pixel;
+    layoutDesc.bindings = {
+        nvrhi::BindingLayoutItem::PushConstants(0, sizeof(ShadowDrawConstants)),
+        nvrhi::BindingLayoutItem::VolatileConstantBuffer(1),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(0),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(1),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(2),
+        nvrhi::BindingLayoutItem::Sampler(0)
+    };
+    m_BindingLayout = device->createBindingLayout(layoutDesc);
+
+    for (int alphaTested = 0; alphaTested < 2; alphaTested++)
+    {
+        std::vector<ShaderMacro> macros = {
+            ShaderMacro("ALPHA_TESTED", alphaTested ? "1" : "0")
+        };
+        m_VertexShaders[alphaTested] = shaderFactory->CreateShader("ShadowCascades.hlsl", "main_vs", &macros, nvrhi::ShaderType::Vertex);
+    }
+    m_AlphaTestShader = shaderFactory->CreateShader("ShadowCascades.hlsl", "main_ps", nullptr, nvrhi::ShaderType::Pixel);
+
+    m_CascadeConstants = device->createBuffer(nvrhi::utils::CreateVolatileConstantBufferDesc(
+        sizeof(ShadowCascadeConstants), "ShadowCascades Constants", 16));
+}
+
+nvrhi::IFramebuffer* ShadowCascadePass::GetFramebuffer(nvrhi::ITexture* target)
+{
+    nvrhi::FramebufferHandle& framebuffer = m_Framebuffers[target];
+
+    if (!framebuffer)
+    {
+        // All slices are bound at once, the vertex shader selects one per instance
+        nvrhi::FramebufferDesc framebufferDesc;
+        framebufferDesc.setDepthAttachment(nvrhi::FramebufferAttachment()
+            .setTexture(target)
+            .setSubresources(nvrhi::TextureSubresourceSet(0, 1, 0, target->getDesc().arraySize)));
+        framebuffer = m_Device->createFramebuffer(framebufferDesc);
+    }
+
+    return framebuffer;
+}
+
+nvrhi::IGraphicsPipeline* ShadowCascadePass::GetPipeline(bool alphaTested, bool doubleSided, bool frontCounterClockwise,
+    bool reverseDepth, nvrhi::IFramebuffer* framebuffer)
+{
+    uint32_t index = (alphaTested ? 1 : 0) | (doubleSided ? 2 : 0) | (frontCounterClockwise ? 4 : 0) | (reverseDepth ? 8 : 0);
+    nvrhi::GraphicsPipelineHandle& pipeline = m_Pipelines[index];
+
+    if (!pipeline)
+    {
+        nvrhi::GraphicsPipelineDesc pipelineDesc;
+        pipelineDesc.primType = nvrhi::PrimitiveType::TriangleList;
+        pipelineDesc.VS = m_VertexShaders[alphaTested ? 1 : 0];
+        pipelineDesc.PS = alphaTested ? m_AlphaTestShader : nullptr;
+        pipelineDesc.bindingLayouts = { m_BindingLayout, m_BindlessLayout };
+        pipelineDesc.renderState.rasterState.frontCounterClockwise = frontCounterClockwise;
+        pipelineDesc.renderState.rasterState.cullMode = doubleSided ? nvrhi::RasterCullMode::None : nvrhi::RasterCullMode::Back;
+        pipelineDesc.renderState.rasterState.depthBias = m_Params.depthBias;
+        pipelineDesc.renderState.rasterState.depthBiasClamp = m_Params.depthBiasClamp;
+        pipelineDesc.renderState.rasterState.slopeScaledDepthBias = m_Params.slopeScaledDepthBias;
+        pipelineDesc.renderState.depthStencilState.depthFunc = reverseDepth
+            ? nvrhi::ComparisonFunc::GreaterOrEqual
+            : nvrhi::ComparisonFunc::LessOrEqual;
+        pipeline = m_Device->createGraphicsPipeline(pipelineDesc, framebuffer);
+    }
+
+    return pipeline;
+}
+
+void ShadowCascadePass::Render(
+    nvrhi::ICommandList* commandList,
+    CascadedShadowMap& shadowMap,
+    nvrhi::ITexture* target,
+    uint32_t cascadeMask,
+    const Scene& scene,
+    const SceneBVH& bvh,
+    nvrhi::IDescriptorTable* descriptorTable,
+    const CasterFilter& filter)
+{
+    uint32_t cascadeCount = std::min(uint32_t(shadowMap.GetNumberOfCascades()), c_MaxCascades);
+    cascadeMask &= (1u << cascadeCount) - 1;
+    if (cascadeMask == 0)
+        return;
+
+    commandList->beginMarker("ShadowCascades");
+
+    // The BVH reports the frusta it was given by position, which are only the cascades of the mask
+    ShadowCascadeConstants cascadeConstants = {};
+    frustum frusta[c_MaxCascades];
+    uint32_t frustumCascades[c_MaxCascades];
+    uint32_t frustumCount = 0;
+    std::shared_ptr<PlanarView> firstView;
+
+    for (uint32_t cascade = 0; cascade < cascadeCount; cascade++)
+    {
+        std::shared_ptr<PlanarView> view = shadowMap.GetCascadeView(cascade);
+        cascadeConstants.matWorldToClip[cascade] = view->GetViewProjectionMatrix();
+
+        if (!(cascadeMask & (1u << cascade)))
+            continue;
+
+        if (!firstView)
+            firstView = view;
+        frusta[frustumCount] = view->GetViewFrustum();
+        frustumCascades[frustumCount] = cascade;
+        frustumCount++;
+    }
+
+    commandList->writeBuffer(m_CascadeConstants, &cascadeConstants, sizeof(cascadeConstants));
+
+    m_VisibleLeaves.clear();
+    bvh.CullFrusta(frusta, frustumCount, m_VisibleLeaves);
+
+    // Draws are grouped by pipeline, indexed by alpha testing and face culling
+    for (std::vector<ShadowDraw>& draws : m_Draws)
+        draws.clear();
+
+    for (const SceneBVH::MaskedLeaf& visibleLeaf : m_VisibleLeaves)
+    {
+        const MeshInstance* instance = bvh.GetLeaf(visibleLeaf.leaf).instance;
+        const MeshInfo* mesh = instance->GetMesh().get();
+        if (!mesh || mesh->geometries.empty() || (filter && !filter(instance)))
+            continue;
+
+        uint32_t instanceCascades = 0;
+        for (uint32_t frustumMask = visibleLeaf.frustumMask; frustumMask != 0; frustumMask &= frustumMask - 1)
+            instanceCascades |= 1u << frustumCascades[std::countr_zero(frustumMask)];
+
+        for (const auto& geometry : mesh->geometries)
+        {
+            const Material* material = geometry->material.get();
+
+            // Same casters as the opaque draw strategy of the per-cascade pass
+            if (material && material->domain != MaterialDomain::Opaque && material->domain != MaterialDomain::AlphaTested)
+                continue;
+
+            bool alphaTested = material && material->domain == MaterialDomain::AlphaTested;
+            bool doubleSided = material && material->doubleSided;
+
+            ShadowDraw draw;
+            draw.instanceIndex = uint32_t(instance->GetInstanceIndex());
+            draw.geometryIndex = uint32_t(geometry->globalGeometryIndex - mesh->geometries[0]->globalGeometryIndex);
+            draw.cascadeMask = instanceCascades;
+            draw.vertexCount = geometry->numIndices;
+            m_Draws[(alphaTested ? 1 : 0) | (doubleSided ? 2 : 0)].push_back(draw);
+        }
+    }
+
+    nvrhi::BindingSetDesc bindingSetDesc;
+    bindingSetDesc.bindings = {
+        nvrhi::BindingSetItem::PushConstants(0, sizeof(ShadowDrawConstants)),
+        nvrhi::BindingSetItem::ConstantBuffer(1, m_CascadeConstants),
+        nvrhi::BindingSetItem::StructuredBuffer_SRV(0, scene.GetInstanceBuffer()),
+        nvrhi::BindingSetItem::StructuredBuffer_SRV(1, scene.GetGeometryBuffer()),
+        nvrhi::BindingSetItem::StructuredBuffer_SRV(2, scene.GetMaterialBuffer()),
+        nvrhi::BindingSetItem::Sampler(0, m_CommonPasses->m_AnisotropicWrapSampler)
+    };
+    nvrhi::BindingSetHandle bindingSet = m_BindingCache.GetOrCreateBindingSet(bindingSetDesc, m_BindingLayout);
+
+    // The cascades share the resolution of the shadow map, so one viewport covers every slice
+    nvrhi::GraphicsState state;
+    state.framebuffer = GetFramebuffer(target);
+    state.viewport = firstView->GetViewportState();
+    state.bindings = { bindingSet, descriptorTable };
+
+    const bool frontCounterClockwise = firstView->IsMirrored();
+    const bool reverseDepth = firstView->IsReverseDepth();
+
+    for (uint32_t group = 0; group < 4; group++)
+    {
+        if (m_Draws[group].empty())
+            continue;
+
+        state.pipeline = GetPipeline((group & 1) != 0, (group & 2) != 0, frontCounterClockwise, reverseDepth, state.framebuffer);
+        commandList->setGraphicsState(state);
+
+        for (const ShadowDraw& draw : m_Draws[group])
+        {
+            ShadowDrawConstants constants = {};
+            constants.instanceIndex = draw.instanceIndex;
+            constants.geometryIndex = draw.geometryIndex;
+            constants.cascadeMask = draw.cascadeMask;
+            commandList->setPushConstants(&constants, sizeof(constants));
+
+            // The vertex shader fetches the indices itself, so the draw has no index or vertex buffers
+            nvrhi::DrawArguments args;
+            args.vertexCount = draw.vertexCount;
+            args.instanceCount = uint32_t(std::popcount(draw.cascadeMask));
+            commandList->draw(args);
+
+            m_Stats.draws++;
+            m_Stats.cascadeDraws += args.instanceCount;
+        }
+    }
+
+    commandList->endMarker();
+}
+
+void ShadowCascadePass::ResetBindingCache()
+{
+    m_BindingCache.Clear();
+    m_Framebuffers.clear();
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <donut/engine/ShaderFactory.h>
+#include <donut/engine/CommonRenderPasses.h>
+#include <donut/engine/Scene.h>
+#include <donut/render/CascadedShadowMap.h>
+#include <donut/render/DepthPass.h>
+#include <nvrhi/nvrhi.h>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "PassBindingCache.h"
+#include "SceneBVH.h"
+
+namespace donut::render
+{
+    // Draws the casters of all cascades of a CascadedShadowMap in one pass. The scene is culled once against
+    // every cascade frustum, which gives each instance a mask of the cascades it touches, and each geometry is
+    // drawn once, instanced over the bits of its mask; the vertex shader writes the array slice of the cascade.
+    // The vertices are read through the scene's bindless tables like in VisibilityBufferPass, and the device
+    // has to support SV_RenderTargetArrayIndex outside of geometry shaders.
+    class ShadowCascadePass
+    {
+    public:
+        static constexpr uint32_t c_MaxCascades = 4;
+
+        // The depth bias settings of the parameters are used, the rest is ignored
+        ShadowCascadePass(nvrhi::IDevice* device,
+            const std::shared_ptr<engine::ShaderFactory>& shaderFactory,
+            std::shared_ptr<engine::CommonRenderPasses> commonPasses,
+            nvrhi::IBindingLayout* bindlessLayout,
+            const DepthPass::CreateParameters& params);
+
+        // Returns false when a geometry was not drawn
+        using CasterFilter = std::function<bool(const engine::MeshInstance* instance)>;
+
+        // Draws the opaque and alpha tested casters that pass the filter into the cascades of cascadeMask.
+        // The target is the shadow map texture or one with the same layout, and is not cleared. The BVH has to
+        // be updated for the current scene graph.
+        void Render(nvrhi::ICommandList* commandList,
+            CascadedShadowMap& shadowMap,
+            nvrhi::ITexture* target,
+            uint32_t cascadeMask,
+            const engine::Scene& scene,
+            const SceneBVH& bvh,
+            nvrhi::IDescriptorTable* descriptorTable,
+            const CasterFilter& filter = nullptr);
+
+        struct Stats
+        {
+            // Instanced draws recorded
+            uint32_t draws = 0;
+            // Draws that one pass per cascade would have recorded for the same casters
+            uint32_t cascadeDraws = 0;
+        };
+
+        // Counters since the last ResetStats
+        [[nodiscard]] const Stats& GetStats() const { return m_Stats; }
+        void ResetStats() { m_Stats = Stats(); }
+
+        void ResetBindingCache();
+
+    private:
+        struct ShadowDraw
+        {
+            uint32_t instanceIndex;
+            uint32_t geometryIndex;
+            uint32_t cascadeMask;
+            uint32_t vertexCount;
+        };
+
+        nvrhi::IFramebuffer* GetFramebuffer(nvrhi::ITexture* target);
+        nvrhi::IGraphicsPipeline* GetPipeline(bool alphaTested, bool doubleSided, bool frontCounterClockwise,
+            bool reverseDepth, nvrhi::IFramebuffer* framebuffer);
+
+        // Pipelines by alpha testing, face culling, winding and depth direction
+        static constexpr uint32_t c_PipelineCount = 16;
+        nvrhi::ShaderHandle m_VertexShaders[2];
+        nvrhi::ShaderHandle m_AlphaTestShader;
+        nvrhi::GraphicsPipelineHandle m_Pipelines[c_PipelineCount];
+        nvrhi::BindingLayoutHandle m_BindingLayout;
+        nvrhi::BindingLayoutHandle m_BindlessLayout;
+        nvrhi::BufferHandle m_CascadeConstants;
+        DepthPass::CreateParameters m_Params;
+
+        std::unordered_map<nvrhi::ITexture*, nvrhi::FramebufferHandle> m_Framebuffers;
+
+        // Scratch storage, kept between frames to avoid allocations
+        std::vector<SceneBVH::MaskedLeaf> m_VisibleLeaves;
+        std::vector<ShadowDraw> m_Draws[4];
+
+        Stats m_Stats;
+
+        std::shared_ptr<engine::CommonRenderPasses> m_CommonPasses;
+        nvrhi::DeviceHandle m_Device;
+        PassBindingCache m_BindingCache;
+    };
+}
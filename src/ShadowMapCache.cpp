@@ -0,0 +1,215 @@
+#include "ShadowMapCache.h"
+
+#include <donut/engine/View.h>
+#include <cstring>
+#include <utility>
+
+using namespace donut::math;
+using namespace donut::engine;
+using namespace donut::render;
+
+// Passes on the items of another strategy whose instance is static, or dynamic
+class ShadowCasterDrawStrategy : public IDrawStrategy
+{
+public:
+    ShadowCasterDrawStrategy(IDrawStrategy& inner, const ShadowMapCache& cache, bool dynamic)
+        : m_Inner(inner)
+        , m_Cache(cache)
+        , m_Dynamic(dynamic)
+    {
+    }
+
+    void PrepareForView(const std::shared_ptr<SceneGraphNode>& rootNode, const IView& view) override
+    {
+        m_Inner.PrepareForView(rootNode, view);
+    }
+
+    const DrawItem* GetNextItem() override
+    {
+        while (const DrawItem* item = m_Inner.GetNextItem())
+        {
+            if (m_Cache.IsDynamic(item->instance) == m_Dynamic)
+                return item;
+        }
+        return nullptr;
+    }
+
+private:
+    IDrawStrategy& m_Inner;
+    const ShadowMapCache& m_Cache;
+    bool m_Dynamic;
+};
+
+ShadowMapCache::ShadowMapCache(nvrhi::IDevice* device, std::shared_ptr<CascadedShadowMap> shadowMap)
+    : m_ShadowMap(std::move(shadowMap))
+{
+    nvrhi::TextureDesc textureDesc = m_ShadowMap->GetTexture()->getDesc();
+    textureDesc.debugName = "ShadowMapCache";
+    m_CacheTexture = device->createTexture(textureDesc);
+
+    m_CacheFramebuffer = std::make_shared<FramebufferFactory>(device);
+    m_CacheFramebuffer->DepthTarget = m_CacheTexture;
+
+    m_ShadowFramebuffer = std::make_shared<FramebufferFactory>(device);
+    m_ShadowFramebuffer->DepthTarget = m_ShadowMap->GetTexture();
+
+    m_Cascades.resize(m_ShadowMap->GetNumberOfCascades());
+}
+
+void ShadowMapCache::UpdateInstances(const SceneGraph& sceneGraph, uint32_t frameIndex)
+{
+    if (&sceneGraph != m_SceneGraph)
+    {
+        m_SceneGraph = &sceneGraph;
+        m_Instances.clear();
+        m_StaticCastersChanged = true;
+    }
+
+    m_DynamicInstances = 0;
+    for (const auto& instance : sceneGraph.GetMeshInstances())
+    {
+        const SceneGraphNode* node = instance->GetNode();
+        box3 bounds = node ? node->GetGlobalBoundingBox() : box3::empty();
+
+        auto [it, inserted] = m_Instances.try_emplace(instance.get());
+        InstanceState& state = it->second;
+        state.lastSeenFrame = frameIndex;
+
+        if (inserted)
+        {
+            // New instances start out static, the cache has to include them
+            state.bounds = bounds;
+            m_StaticCastersChanged = true;
+        }
+        else if (!all(bounds.m_mins == state.bounds.m_mins) || !all(bounds.m_maxs == state.bounds.m_maxs))
+        {
+            state.bounds = bounds;
+            state.lastMovedFrame = frameIndex;
+            if (!state.dynamic)
+            {
+                state.dynamic = true;
+                m_StaticCastersChanged = true;
+            }
+        }
+        else if (state.dynamic && frameIndex - state.lastMovedFrame > c_SettleFrames)
+        {
+            state.dynamic = false;
+            m_StaticCastersChanged = true;
+        }
+
+        if (state.dynamic)
+            m_DynamicInstances++;
+    }
+
+    // Removed instances are still in the cached cascades
+    for (auto it = m_Instances.begin(); it != m_Instances.end(); )
+    {
+        if (it->second.lastSeenFrame != frameIndex)
+        {
+            if (!it->second.dynamic)
+                m_StaticCastersChanged = true;
+            it = m_Instances.erase(it);
+        }
+        else
+            ++it;
+    }
+}
+
+void ShadowMapCache::Invalidate()
+{
+    m_StaticCastersChanged = true;
+}
+
+bool ShadowMapCache::IsDynamic(const MeshInstance* instance) const
+{
+    auto it = m_Instances.find(instance);
+    return it != m_Instances.end() && it->second.dynamic;
+}
+
+uint32_t ShadowMapCache::BeginStaticCascades(nvrhi::ICommandList* commandList)
+{
+    uint32_t staleCascades = 0;
+    m_RenderedCascades = 0;
+
+    for (uint32_t cascade = 0; cascade < uint32_t(m_Cascades.size()); cascade++)
+    {
+        std::shared_ptr<PlanarView> view = m_ShadowMap->GetCascadeView(cascade);
+
+        Cascade& cached = m_Cascades[cascade];
+        float4x4 viewProjection = view->GetViewProjectionMatrix();
+
+        if (m_StaticCastersChanged || !cached.valid || memcmp(&viewProjection, &cached.viewProjection, sizeof(viewProjection)) != 0)
+        {
+            commandList->clearDepthStencilTexture(m_CacheTexture, view->GetSubresources(), true, view->IsReverseDepth() ? 0.f : 1.f, false, 0);
+
+            cached.viewProjection = viewProjection;
+            cached.valid = true;
+            staleCascades |= 1u << cascade;
+            m_RenderedCascades++;
+        }
+    }
+
+    m_StaticCastersChanged = false;
+    return staleCascades;
+}
+
+void ShadowMapCache::CopyStaticCascades(nvrhi::ICommandList* commandList)
+{
+    for (uint32_t cascade = 0; cascade < uint32_t(m_Cascades.size()); cascade++)
+    {
+        nvrhi::TextureSlice slice;
+        slice.arraySlice = m_ShadowMap->GetCascadeView(cascade)->GetSubresources().baseArraySlice;
+        commandList->copyTexture(m_ShadowMap->GetTexture(), slice, m_CacheTexture, slice);
+    }
+}
+
+void ShadowMapCache::Render(nvrhi::ICommandList* commandList,
+    const std::shared_ptr<SceneGraphNode>& rootNode,
+    IDrawStrategy& drawStrategy,
+    IGeometryPass& depthPass,
+    GeometryPassContext& passContext)
+{
+    ShadowCasterDrawStrategy staticCasters(drawStrategy, *this, false);
+    ShadowCasterDrawStrategy dynamicCasters(drawStrategy, *this, true);
+
+    uint32_t staleCascades = BeginStaticCascades(commandList);
+    for (uint32_t cascade = 0; cascade < uint32_t(m_Cascades.size()); cascade++)
+    {
+        if (staleCascades & (1u << cascade))
+        {
+            RenderCompositeView(commandList, m_ShadowMap->GetCascadeView(cascade).get(), nullptr, *m_CacheFramebuffer, rootNode,
+                staticCasters, depthPass, passContext, "ShadowMapCache");
+        }
+    }
+
+    CopyStaticCascades(commandList);
+
+    if (m_DynamicInstances != 0)
+    {
+        RenderCompositeView(commandList, &m_ShadowMap->GetView(), nullptr, *m_ShadowFramebuffer, rootNode,
+            dynamicCasters, depthPass, passContext, "ShadowMap Dynamic");
+    }
+}
+
+void ShadowMapCache::Render(nvrhi::ICommandList* commandList,
+    ShadowCascadePass& cascadePass,
+    const Scene& scene,
+    const SceneBVH& bvh,
+    nvrhi::IDescriptorTable* descriptorTable)
+{
+    uint32_t staleCascades = BeginStaticCascades(commandList);
+    if (staleCascades != 0)
+    {
+        cascadePass.Render(commandList, *m_ShadowMap, m_CacheTexture, staleCascades, scene, bvh, descriptorTable,
+            [this](const MeshInstance* instance) { return !IsDynamic(instance); });
+    }
+
+    CopyStaticCascades(commandList);
+
+    if (m_DynamicInstances != 0)
+    {
+        uint32_t allCascades = (1u << m_Cascades.size()) - 1;
+        cascadePass.Render(commandList, *m_ShadowMap, m_ShadowMap->GetTexture(), allCascades, scene, bvh, descriptorTable,
+            [this](const MeshInstance* instance) { return IsDynamic(instance); });
+    }
+}
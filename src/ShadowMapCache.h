@@ -0,0 +1,87 @@
+#pragma once
+
+#include <donut/render/CascadedShadowMap.h>
+#include <donut/render/DrawStrategy.h>
+#include <donut/render/GeometryPasses.h>
+#include <donut/engine/FramebufferFactory.h>
+#include <donut/engine/SceneGraph.h>
+#include <nvrhi/nvrhi.h>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "ShadowCascadePass.h"
+#include "SceneBVH.h"
+
+// Keeps the static shadow casters of every cascade of a CascadedShadowMap in a depth array of its own, so
+// that a frame only has to copy the cached cascades into the shadow map and draw the dynamic casters on top.
+// A cascade is drawn into the cache again when its view-projection changes, i.e. when the sun turns or the
+// stabilized cascade snaps to another texel, and all of them when the set of static casters changes.
+// Instances count as dynamic from the frame their bounds change until they have not moved for a while.
+class ShadowMapCache
+{
+public:
+    ShadowMapCache(nvrhi::IDevice* device, std::shared_ptr<donut::render::CascadedShadowMap> shadowMap);
+
+    // Classifies the mesh instances into static and dynamic casters; call once per frame after the scene
+    // graph was refreshed
+    void UpdateInstances(const donut::engine::SceneGraph& sceneGraph, uint32_t frameIndex);
+
+    // Draws every cascade again on the next Render, e.g. after a scene was unloaded
+    void Invalidate();
+
+    // Records the whole shadow map, which does not have to be cleared before. The draw strategy is used for
+    // the static and the dynamic casters of every cascade view.
+    void Render(nvrhi::ICommandList* commandList,
+        const std::shared_ptr<donut::engine::SceneGraphNode>& rootNode,
+        donut::render::IDrawStrategy& drawStrategy,
+        donut::render::IGeometryPass& depthPass,
+        donut::render::GeometryPassContext& passContext);
+
+    // Same, with the static and the dynamic casters drawn into all of their cascades by one single-pass draw each
+    void Render(nvrhi::ICommandList* commandList,
+        donut::render::ShadowCascadePass& cascadePass,
+        const donut::engine::Scene& scene,
+        const SceneBVH& bvh,
+        nvrhi::IDescriptorTable* descriptorTable);
+
+    [[nodiscard]] bool IsDynamic(const donut::engine::MeshInstance* instance) const;
+
+    // Cascades drawn into the cache by the last Render
+    [[nodiscard]] uint32_t GetRenderedCascades() const { return m_RenderedCascades; }
+    [[nodiscard]] uint32_t GetDynamicInstanceCount() const { return m_DynamicInstances; }
+
+private:
+    // Frames without movement before a dynamic instance is drawn into the cache again
+    static constexpr uint32_t c_SettleFrames = 30;
+
+    // Clears the cached cascades that have to be drawn again and returns their mask
+    uint32_t BeginStaticCascades(nvrhi::ICommandList* commandList);
+    void CopyStaticCascades(nvrhi::ICommandList* commandList);
+
+    struct InstanceState
+    {
+        donut::math::box3 bounds;
+        uint32_t lastMovedFrame = 0;
+        uint32_t lastSeenFrame = 0;
+        bool dynamic = false;
+    };
+
+    struct Cascade
+    {
+        donut::math::float4x4 viewProjection;
+        bool valid = false;
+    };
+
+    std::shared_ptr<donut::render::CascadedShadowMap> m_ShadowMap;
+    nvrhi::TextureHandle m_CacheTexture;
+    std::shared_ptr<donut::engine::FramebufferFactory> m_CacheFramebuffer;
+    std::shared_ptr<donut::engine::FramebufferFactory> m_ShadowFramebuffer;
+    std::vector<Cascade> m_Cascades;
+
+    const donut::engine::SceneGraph* m_SceneGraph = nullptr;
+    std::unordered_map<const donut::engine::MeshInstance*, InstanceState> m_Instances;
+    bool m_StaticCastersChanged = true;
+    uint32_t m_DynamicInstances = 0;
+    uint32_t m_RenderedCascades = 0;
+};
@@ -0,0 +1,108 @@
+#include "ThreadPool.h"
+#include "ChromeTrace.h"
+#include "CpuProfiler.h"
+
+#include <algorithm>
+
+void TaskBatch::Wait()
+{
+    // Help with the remaining items instead of blocking, so nested batches cannot starve the pool
+    while (RunNext())
+        ;
+
+    std::unique_lock lock(m_Mutex);
+    m_Done.wait(lock, [this] { return m_Remaining.load() == 0; });
+}
+
+bool TaskBatch::RunNext()
+{
+    size_t index = m_Next++;
+    if (index >= m_Count)
+        return false;
+
+    m_Func(index);
+
+    if (--m_Remaining == 0)
+    {
+        std::lock_guard lock(m_Mutex);
+        m_Done.notify_all();
+    }
+    return true;
+}
+
+ThreadPool::ThreadPool(unsigned numThreads)
+{
+    if (numThreads == 0)
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (unsigned i = 0; i < numThreads; i++)
+        m_Threads.emplace_back(&ThreadPool::WorkerThread, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard lock(m_Mutex);
+        m_Stopping = true;
+    }
+    m_TaskAvailable.notify_all();
+
+    for (auto& thread : m_Threads)
+        thread.join();
+}
+
+void ThreadPool::Enqueue(std::function<void()> task)
+{
+    {
+        std::lock_guard lock(m_Mutex);
+        m_Tasks.push(std::move(task));
+    }
+    m_TaskAvailable.notify_one();
+}
+
+std::shared_ptr<TaskBatch> ThreadPool::ParallelForAsync(size_t count, std::function<void(size_t)> func)
+{
+    auto batch = std::make_shared<TaskBatch>();
+    batch->m_Func = std::move(func);
+    batch->m_Count = count;
+    batch->m_Remaining = count;
+
+    size_t numWorkers = std::min<size_t>(count, m_Threads.size());
+    for (size_t i = 0; i < numWorkers; i++)
+    {
+        Enqueue([batch]()
+        {
+            while (batch->RunNext())
+                ;
+        });
+    }
+
+    return batch;
+}
+
+void ThreadPool::ParallelFor(size_t count, std::function<void(size_t)> func)
+{
+    ParallelForAsync(count, std::move(func))->Wait();
+}
+
+void ThreadPool::WorkerThread()
+{
+    ProfilerThreads::SetCurrentName("Worker");
+
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock lock(m_Mutex);
+            m_TaskAvailable.wait(lock, [this] { return m_Stopping || !m_Tasks.empty(); });
+
+            if (m_Stopping && m_Tasks.empty())
+                return;
+
+            task = std::move(m_Tasks.front());
+            m_Tasks.pop();
+        }
+
+        task();
+    }
+}
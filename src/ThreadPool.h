@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// A set of indexed work items running on a ThreadPool, see ThreadPool::ParallelForAsync.
+class TaskBatch
+{
+public:
+    void Wait();
+    [[nodiscard]] bool IsDone() const { return m_Remaining.load() == 0; }
+
+private:
+    friend class ThreadPool;
+
+    bool RunNext();
+
+    std::function<void(size_t)> m_Func;
+    size_t m_Count = 0;
+    std::atomic<size_t> m_Next = 0;
+    std::atomic<size_t> m_Remaining = 0;
+    std::mutex m_Mutex;
+    std::condition_variable m_Done;
+};
+
+// Fixed-size worker pool shared by the loading code paths.
+class ThreadPool
+{
+public:
+    // numThreads = 0 uses one worker per hardware thread
+    explicit ThreadPool(unsigned numThreads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void Enqueue(std::function<void()> task);
+
+    // Runs func(index) for every index in [0, count) on the workers and returns immediately.
+    std::shared_ptr<TaskBatch> ParallelForAsync(size_t count, std::function<void(size_t)> func);
+
+    // Same as ParallelForAsync, but the calling thread helps and the call returns when all items are done.
+    void ParallelFor(size_t count, std::function<void(size_t)> func);
+
+    [[nodiscard]] unsigned GetThreadCount() const { return unsigned(m_Threads.size()); }
+
+private:
+    void WorkerThread();
+
+    std::vector<std::thread> m_Threads;
+    std::queue<std::function<void()>> m_Tasks;
+    std::mutex m_Mutex;
+    std::condition_variable m_TaskAvailable;
+    bool m_Stopping = false;
+};
@@ -25,6 +25,83 @@ void UIRenderer::buildUI(void)
     double frameTime = GetDeviceManager()->GetAverageFrameTimeSeconds();
     if (frameTime > 0.0)
         ImGui::Text("%.3f ms/frame (%.1f FPS)", frameTime * 1e3, 1.0 / frameTime);
+    ImGui::Text("Binding sets created: %u", m_ui.BindingSetsCreated);
+    ImGui::Text("GPU: %.3f ms, CPU: %.3f ms", m_ui.GpuFrameTimeMs, m_ui.CpuFrameTimeMs);
+    if (ImGui::CollapsingHeader("GPU Profiler"))
+    {
+        if (!m_ui.GpuFrameHistory.empty())
+        {
+            ImGui::PlotLines("GPU ms", m_ui.GpuFrameHistory.data(), int(m_ui.GpuFrameHistory.size()), 0, nullptr,
+                0.f, FLT_MAX, ImVec2(0.f, 60.f));
+        }
+
+        if (ImGui::BeginTable("GpuPasses", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+        {
+            ImGui::TableSetupColumn("Pass");
+            ImGui::TableSetupColumn("Last ms");
+            ImGui::TableSetupColumn("Avg ms");
+            ImGui::TableSetupColumn("Max ms");
+            ImGui::TableHeadersRow();
+
+            for (const GpuProfiler::PassTiming& timing : m_ui.GpuPassTimings)
+            {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(timing.name);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", timing.lastMs);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", timing.averageMs);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", timing.maxMs);
+            }
+            ImGui::EndTable();
+        }
+
+        if (ImGui::Button("Export CSV and Trace"))
+            m_ui.GpuProfileExportRequested = true;
+    }
+
+#ifdef YUP_ENGINE_CPU_PROFILER
+    if (ImGui::CollapsingHeader("CPU Profiler"))
+    {
+        if (ImGui::BeginTable("CpuScopes", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+        {
+            ImGui::TableSetupColumn("Scope");
+            ImGui::TableSetupColumn("Avg ms");
+            ImGui::TableSetupColumn("Max ms");
+            ImGui::TableSetupColumn("Calls");
+            ImGui::TableHeadersRow();
+
+            for (const CpuProfiler::ScopeStats& stats : m_ui.CpuScopeStats)
+            {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(stats.name);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", stats.averageMs);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", stats.maxMs);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.1f", stats.callsPerFrame);
+            }
+            ImGui::EndTable();
+        }
+
+        ImGui::SliderInt("Capture Frames", &m_ui.CpuCaptureFrames, 1, 240);
+        if (ImGui::Button("Capture Trace"))
+            m_ui.CpuCaptureRequested = true;
+    }
+#endif
+
+    ImGui::Checkbox("Frame Governor", &m_ui.EnableFrameGovernor);
+    if (m_ui.EnableFrameGovernor && ImGui::CollapsingHeader("Frame Governor"))
+    {
+        ImGui::DragFloat("Target Frame Time (ms)", &m_ui.TargetFrameTimeMs, 0.1f, 4.f, 50.f);
+        ImGui::Text("Level: %u", m_ui.GovernorLevel);
+        if (!m_ui.GovernorDecision.empty())
+            ImGui::TextWrapped("%s", m_ui.GovernorDecision.c_str());
+    }
 
     if (ImGui::Button("Reload Shaders"))
         m_ui.ShaderReloadRequested = true;
@@ -48,9 +125,39 @@ void UIRenderer::buildUI(void)
         ImGui::SliderFloat("Horizon Size", &m_ui.SkyParams.horizonSize, 0.f, 90.f);
     }
     ImGui::Checkbox("Enable DefferedShading", &m_ui.UseDeferredShading);
+    if (m_ui.UseDeferredShading)
+    {
+        ImGui::Checkbox("Visibility Buffer", &m_ui.EnableVisibilityBuffer);
+        ImGui::Checkbox("Clustered Lighting", &m_ui.EnableClusteredLighting);
+        if (m_ui.EnableClusteredLighting)
+            ImGui::Text("Clustered lights: %u", m_ui.ClusteredLights);
+    }
     ImGui::Checkbox("Enable SSAO", &m_ui.EnableSsao);
     ImGui::Checkbox("Enable FXAA", &m_ui.EnableFXAA);
+    ImGui::Checkbox("Fused Post-Processing", &m_ui.EnableFusedPostProcess);
+    ImGui::Checkbox("Parallel Command Recording", &m_ui.EnableParallelRecording);
+    ImGui::Checkbox("Shared Visibility Culling", &m_ui.EnableVisibilityCache);
+    if (m_ui.EnableVisibilityCache)
+        ImGui::Text("Views culled: %u for %u requests", m_ui.VisibilityCacheViews, m_ui.VisibilityCacheRequests);
+    ImGui::Checkbox("Standalone Material ID Pass", &m_ui.EnableMaterialIDPass);
+    ImGui::SliderFloat("Resolution Scale", &m_ui.ResolutionScale, 0.5f, 1.f);
+    ImGui::Checkbox("Enable TAA", &m_ui.EnableTAA);
+    if (m_ui.EnableTAA && ImGui::CollapsingHeader("TAA"))
+    {
+        ImGui::SliderFloat("New Frame Weight", &m_ui.TemporalAntiAliasingParams.newFrameWeight, 0.001f, 1.f);
+        ImGui::SliderFloat("Clamping Factor", &m_ui.TemporalAntiAliasingParams.clampingFactor, 0.f, 2.f);
+        ImGui::Checkbox("History Clamping", &m_ui.TemporalAntiAliasingParams.enableHistoryClamping);
+    }
     ImGui::Checkbox("Enable Shadows", &m_ui.EnableShadows);
+    if (m_ui.EnableShadows)
+    {
+        ImGui::Checkbox("Cache Static Shadows", &m_ui.EnableShadowCache);
+        if (m_ui.EnableShadowCache)
+            ImGui::Text("Cascades redrawn: %u, dynamic casters: %u", m_ui.ShadowCascadesRendered, m_ui.DynamicShadowCasters);
+        ImGui::Checkbox("Single-Pass Cascades", &m_ui.EnableSinglePassShadows);
+        if (m_ui.EnableSinglePassShadows)
+            ImGui::Text("Shadow draws: %u for %u cascade draws", m_ui.ShadowDraws, m_ui.ShadowCascadeDraws);
+    }
     ImGui::Checkbox("Enable Translucency", &m_ui.EnableTranslucency);
 
     ImGui::Separator();
@@ -98,9 +205,17 @@ void UIRenderer::buildUI(void)
         ImGui::SameLine();
         if (ImGui::Button(probe->name.c_str()))
         {
-            m_ui.m_RenderCallback(*probe);
+            m_ui.m_RenderCallback(probe);
         }
     }
+    ImGui::SliderInt("Bake Steps per Frame", &m_ui.LightProbeBakeSteps, 1, 18);
+    if (m_ui.LightProbeBakesQueued != 0)
+    {
+        ImGui::ProgressBar(m_ui.LightProbeBakeProgress);
+        ImGui::SameLine();
+        ImGui::Text("%u queued", m_ui.LightProbeBakesQueued);
+    }
+    ImGui::Text("Cached: %u, compressing: %u", m_ui.LightProbesCached, m_ui.LightProbesCompressing);
 
     ImGui::Separator();
     ImGui::Checkbox("Display Shadow Map", &m_ui.DisplayShadowMap);
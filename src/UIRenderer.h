@@ -6,6 +6,10 @@
 #include <donut/render/SsaoPass.h>
 #include <donut/engine/SceneGraph.h>
 #include <donut/render/ToneMappingPasses.h>
+#include <donut/render/TemporalAntiAliasingPass.h>
+
+#include "GpuProfiler.h"
+#include "CpuProfiler.h"
 
 using namespace donut;
 using namespace donut::math;
@@ -20,28 +24,64 @@ struct UIData
     SkyParameters                       SkyParams;
     bool                                EnableSsao = true;
     bool                                EnableFXAA = true;
+    bool                                EnableFusedPostProcess = true;
+    bool                                EnableParallelRecording = true;
+    bool                                EnableMaterialIDPass = false;
+    bool                                EnableVisibilityBuffer = false;
+    bool                                EnableVisibilityCache = true;
+    uint32_t                            VisibilityCacheViews = 0;
+    uint32_t                            VisibilityCacheRequests = 0;
+    bool                                EnableTAA = false;
+    float                               ResolutionScale = 1.f;
+    TemporalAntiAliasingParameters      TemporalAntiAliasingParams;
     bool                                UseDeferredShading = true;
+    bool                                EnableClusteredLighting = true;
+    uint32_t                            ClusteredLights = 0;
     SsaoParameters                      SsaoParams;
     ToneMappingParameters               ToneMappingParams;
     bool                                EnableVsync = true;
     bool                                EnableProceduralSky = true;
     bool                                EnableTranslucency = true;
     bool                                EnableShadows = true;
+    bool                                EnableShadowCache = true;
+    uint32_t                            ShadowCascadesRendered = 0;
+    uint32_t                            DynamicShadowCasters = 0;
+    bool                                EnableSinglePassShadows = true;
+    uint32_t                            ShadowDraws = 0;
+    uint32_t                            ShadowCascadeDraws = 0;
     bool                                ShaderReloadRequested = false;
     float                               AmbientIntensity = 1.0f;
     bool                                EnableLightProbe = true;
     float                               LightProbeDiffuseScale = 1.f;
     float                               LightProbeSpecularScale = 1.f;
+    int                                 LightProbeBakeSteps = 1;
+    float                               LightProbeBakeProgress = 0.f;
+    uint32_t                            LightProbeBakesQueued = 0;
+    uint32_t                            LightProbesCompressing = 0;
+    uint32_t                            LightProbesCached = 0;
     float                               CsmExponent = 4.f;
     bool                                DisplayShadowMap = false;
     bool                                EnableBloom = true;
     float                               BloomSigma = 32.f;
     float                               BloomAlpha = 0.05f;
+    uint32_t                            BindingSetsCreated = 0;
+    bool                                EnableFrameGovernor = false;
+    float                               TargetFrameTimeMs = 16.6f;
+    float                               GpuFrameTimeMs = 0.f;
+    float                               CpuFrameTimeMs = 0.f;
+    uint32_t                            GovernorLevel = 0;
+    std::string                         GovernorDecision;
+    std::vector<GpuProfiler::PassTiming> GpuPassTimings;
+    std::vector<float>                  GpuFrameHistory;
+    bool                                GpuProfileExportRequested = false;
+    std::vector<CpuProfiler::ScopeStats> CpuScopeStats;
+    int                                 CpuCaptureFrames = 60;
+    bool                                CpuCaptureRequested = false;
 
     bool SceneLoadedStatus = false;
     std::vector<std::shared_ptr<engine::Light>> lights;
     std::vector<std::shared_ptr<engine::LightProbe>> LightProbes;
-    std::function<void(LightProbe& probe)> m_RenderCallback;
+    std::function<void(const std::shared_ptr<engine::LightProbe>& probe)> m_RenderCallback;
 
 };
 
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+
+// Shared by the engine and YupCooker, so that the cooker and the runtime resolve glTF URIs to the same files.
+
+// Decodes the percent escapes of a relative glTF URI. An escape that is not followed by two hex digits is
+// kept as a literal '%', like browsers do.
+inline std::string DecodeUri(const std::string& uri)
+{
+    auto hexDigit = [](char c) -> int
+    {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    };
+
+    std::string result;
+    result.reserve(uri.size());
+    for (size_t i = 0; i < uri.size(); i++)
+    {
+        if (uri[i] == '%' && i + 2 < uri.size())
+        {
+            int high = hexDigit(uri[i + 1]);
+            int low = hexDigit(uri[i + 2]);
+            if (high >= 0 && low >= 0)
+            {
+                result += char(high * 16 + low);
+                i += 2;
+                continue;
+            }
+        }
+
+        result += uri[i];
+    }
+    return result;
+}
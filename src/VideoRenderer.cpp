@@ -1,4 +1,5 @@
 #include "VideoRenderer.h"
+#include "CpuProfiler.h"
 #include <iostream>
 #include <stdexcept>
 #include <string>
@@ -161,6 +162,7 @@ void VideoRenderer::RenderThisFrameToScreen(AVFrame* videoFrame, const std::shar
 }
 
 void decodeVideoFrame(AVPacket* packet, AVCodecContext* videoCodecCtx) {
+    CPU_PROFILE_SCOPE("Video decode");
     AVFrame* frame = av_frame_alloc();
     if (avcodec_send_packet(videoCodecCtx, packet) == 0) {
         while (avcodec_receive_frame(videoCodecCtx, frame) == 0) {
@@ -195,6 +197,7 @@ void decodeVideoFrame(AVPacket* packet, AVCodecContext* videoCodecCtx) {
 }
 
 void decodeAudioFrame(AVPacket* packet, AVCodecContext* audioCodecCtx, SwrContext* swrCtx, int outChannels, int outSampleRate) {
+    CPU_PROFILE_SCOPE("Audio decode");
     AVFrame* frame = av_frame_alloc();
 
     if (avcodec_send_packet(audioCodecCtx, packet) == 0) {
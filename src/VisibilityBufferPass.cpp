@@ -0,0 +1,409 @@
+#include "VisibilityBufferPass.h"
+
+#include <donut/engine/SceneGraph.h>
+#include <donut/shaders/view_cb.h>
+#include <nvrhi/utils.h>
+#include <algorithm>
+#include <utility>
+
+using namespace donut::render;
+using namespace donut::engine;
+using namespace donut::math;
+
+// Matches VisibilityConstants in VisibilityBuffer.hlsl
+struct VisibilityConstants
+{
+    uint instanceIndex;
+    uint geometryIndex;
+    uint materialIndex;
+    uint materialCount;
+    uint2 viewOrigin;
+    uint2 viewSize;
+};
+
+// Matches VisibilityViewConstants in VisibilityBuffer.hlsl
+struct VisibilityViewConstants
+{
+    PlanarViewConstants view;
+};
+
+static constexpr uint32_t c_DispatchArgsSize = sizeof(uint32_t) * 3;
+
+// The visibility texel packs the geometry index into 8 bits and the triangle index into 24
+static constexpr size_t c_MaxGeometriesPerMesh = 256;
+
+VisibilityBufferPass::VisibilityBufferPass(nvrhi::IDevice* device,
+    const std::shared_ptr<ShaderFactory>& shaderFactory,
+    std::shared_ptr<CommonRenderPasses> commonPasses,
+    nvrhi::IBindingLayout* bindlessLayout,
+    nvrhi::ITexture* depth,
+    nvrhi::Format normalsFormat)
+    : m_BindlessLayout(bindlessLayout)
+    , m_Depth(depth)
+    , m_CommonPasses(std::move(commonPasses))
+    , m_Device(device)
+    , m_BindingCache(device)
+{
+    const nvrhi::TextureDesc& depthDesc = depth->getDesc();
+
+    nvrhi::TextureDesc textureDesc;
+    textureDesc.width = depthDesc.width;
+    textureDesc.height = depthDesc.height;
+    textureDesc.format = nvrhi::Format::RG32_UINT;
+    textureDesc.isRenderTarget = true;
+    textureDesc.debugName = "VisibilityBuffer";
+    textureDesc.initialState = nvrhi::ResourceStates::RenderTarget;
+    textureDesc.keepInitialState = true;
+    m_Visibility = device->createTexture(textureDesc);
+
+    nvrhi::FramebufferDesc framebufferDesc;
+    framebufferDesc.addColorAttachment(m_Visibility);
+    framebufferDesc.setDepthAttachment(depth);
+    m_Framebuffer = device->createFramebuffer(framebufferDesc);
+
+    // Diffuse and specular are sRGB like in the GBuffer, so they are typeless and written through UNORM views.
+    // The outputs stay render targets to be cleared through their sRGB format.
+    textureDesc.isUAV = true;
+    textureDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+
+    textureDesc.format = nvrhi::Format::SRGBA8_UNORM;
+    textureDesc.isTypeless = true;
+    textureDesc.debugName = "VisibilityBuffer Diffuse";
+    m_Diffuse = device->createTexture(textureDesc);
+    textureDesc.debugName = "VisibilityBuffer Specular";
+    m_Specular = device->createTexture(textureDesc);
+
+    textureDesc.isTypeless = false;
+    textureDesc.format = normalsFormat;
+    textureDesc.debugName = "VisibilityBuffer Normals";
+    m_Normals = device->createTexture(textureDesc);
+
+    textureDesc.format = nvrhi::Format::RGBA16_FLOAT;
+    textureDesc.debugName = "VisibilityBuffer Emissive";
+    m_Emissive = device->createTexture(textureDesc);
+
+    // One packed pixel position per pixel, ordered by material after the scatter
+    nvrhi::BufferDesc bufferDesc;
+    bufferDesc.byteSize = uint64_t(depthDesc.width) * depthDesc.height * sizeof(uint32_t);
+    bufferDesc.structStride = sizeof(uint32_t);
+    bufferDesc.canHaveUAVs = true;
+    bufferDesc.debugName = "VisibilityBuffer PixelList";
+    bufferDesc.initialState = nvrhi::ResourceStates::UnorderedAccess;
+    bufferDesc.keepInitialState = true;
+    m_PixelList = device->createBuffer(bufferDesc);
+
+    // Written by the material binning for the single resolve dispatch
+    bufferDesc.byteSize = c_DispatchArgsSize;
+    bufferDesc.structStride = 0;
+    bufferDesc.canHaveRawViews = true;
+    bufferDesc.isDrawIndirectArgs = true;
+    bufferDesc.debugName = "VisibilityBuffer DispatchArgs";
+    m_DispatchArgs = device->createBuffer(bufferDesc);
+
+    m_ViewConstants = device->createBuffer(nvrhi::utils::CreateVolatileConstantBufferDesc(
+        sizeof(VisibilityViewConstants), "VisibilityBuffer ViewConstants", 16));
+
+    CreatePipelines(device, *shaderFactory);
+}
+
+bool VisibilityBufferPass::SupportsScene(const Scene& scene)
+{
+    for (const auto& mesh : scene.GetSceneGraph()->GetMeshes())
+    {
+        if (mesh && mesh->geometries.size() > c_MaxGeometriesPerMesh)
+            return false;
+    }
+    return true;
+}
+
+void VisibilityBufferPass::CreatePipelines(nvrhi::IDevice* device, ShaderFactory& shaderFactory)
+{
+    nvrhi::BindingLayoutDesc layoutDesc;
+    layoutDesc.visibility = nvrhi::ShaderType::Vertex | nvrhi::ShaderType::Pixel;
+    layoutDesc.bindings = {
+        nvrhi::BindingLayoutItem::PushConstants(0, sizeof(VisibilityConstants)),
+        nvrhi::BindingLayoutItem::VolatileConstantBuffer(1),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(0),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(1),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(2),
+        nvrhi::BindingLayoutItem::Sampler(0)
+    };
+    m_RasterBindingLayout = device->createBindingLayout(layoutDesc);
+
+    // The dispatch arguments are only bound while they are written, the resolve reads them as indirect arguments
+    layoutDesc.visibility = nvrhi::ShaderType::Compute;
+    layoutDesc.bindings = {
+        nvrhi::BindingLayoutItem::PushConstants(0, sizeof(VisibilityConstants)),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(0),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(1),
+        nvrhi::BindingLayoutItem::Texture_SRV(3),
+        nvrhi::BindingLayoutItem::StructuredBuffer_UAV(0),
+        nvrhi::BindingLayoutItem::RawBuffer_UAV(1),
+        nvrhi::BindingLayoutItem::StructuredBuffer_UAV(2)
+    };
+    m_BinningBindingLayout = device->createBindingLayout(layoutDesc);
+
+    layoutDesc.bindings = {
+        nvrhi::BindingLayoutItem::PushConstants(0, sizeof(VisibilityConstants)),
+        nvrhi::BindingLayoutItem::VolatileConstantBuffer(1),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(0),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(1),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(2),
+        nvrhi::BindingLayoutItem::Texture_SRV(3),
+        nvrhi::BindingLayoutItem::Sampler(0),
+        nvrhi::BindingLayoutItem::StructuredBuffer_UAV(0),
+        nvrhi::BindingLayoutItem::StructuredBuffer_UAV(2),
+        nvrhi::BindingLayoutItem::Texture_UAV(3),
+        nvrhi::BindingLayoutItem::Texture_UAV(4),
+        nvrhi::BindingLayoutItem::Texture_UAV(5),
+        nvrhi::BindingLayoutItem::Texture_UAV(6)
+    };
+    m_ResolveBindingLayout = device->createBindingLayout(layoutDesc);
+
+    m_VertexShader = shaderFactory.CreateShader("VisibilityBuffer.hlsl", "main_vs", nullptr, nvrhi::ShaderType::Vertex);
+    for (int alphaTested = 0; alphaTested < 2; alphaTested++)
+    {
+        std::vector<ShaderMacro> macros = {
+            ShaderMacro("ALPHA_TESTED", alphaTested ? "1" : "0")
+        };
+        m_PixelShaders[alphaTested] = shaderFactory.CreateShader("VisibilityBuffer.hlsl", "main_ps", &macros, nvrhi::ShaderType::Pixel);
+    }
+
+    nvrhi::ComputePipelineDesc pipelineDesc;
+    pipelineDesc.bindingLayouts = { m_BinningBindingLayout };
+    pipelineDesc.CS = shaderFactory.CreateShader("VisibilityBuffer.hlsl", "count_cs", nullptr, nvrhi::ShaderType::Compute);
+    m_CountPipeline = device->createComputePipeline(pipelineDesc);
+    pipelineDesc.CS = shaderFactory.CreateShader("VisibilityBuffer.hlsl", "offsets_cs", nullptr, nvrhi::ShaderType::Compute);
+    m_OffsetsPipeline = device->createComputePipeline(pipelineDesc);
+    pipelineDesc.CS = shaderFactory.CreateShader("VisibilityBuffer.hlsl", "scatter_cs", nullptr, nvrhi::ShaderType::Compute);
+    m_ScatterPipeline = device->createComputePipeline(pipelineDesc);
+
+    pipelineDesc.bindingLayouts = { m_ResolveBindingLayout, m_BindlessLayout };
+    pipelineDesc.CS = shaderFactory.CreateShader("VisibilityBuffer.hlsl", "resolve_cs", nullptr, nvrhi::ShaderType::Compute);
+    m_ResolvePipeline = device->createComputePipeline(pipelineDesc);
+}
+
+nvrhi::IGraphicsPipeline* VisibilityBufferPass::GetRasterPipeline(bool alphaTested, bool doubleSided, bool frontCounterClockwise, bool reverseDepth)
+{
+    uint32_t index = (alphaTested ? 1 : 0) | (doubleSided ? 2 : 0) | (frontCounterClockwise ? 4 : 0) | (reverseDepth ? 8 : 0);
+    nvrhi::GraphicsPipelineHandle& pipeline = m_RasterPipelines[index];
+
+    if (!pipeline)
+    {
+        nvrhi::GraphicsPipelineDesc pipelineDesc;
+        pipelineDesc.primType = nvrhi::PrimitiveType::TriangleList;
+        pipelineDesc.VS = m_VertexShader;
+        pipelineDesc.PS = m_PixelShaders[alphaTested ? 1 : 0];
+        pipelineDesc.bindingLayouts = { m_RasterBindingLayout, m_BindlessLayout };
+        pipelineDesc.renderState.rasterState.frontCounterClockwise = frontCounterClockwise;
+        pipelineDesc.renderState.rasterState.cullMode = doubleSided ? nvrhi::RasterCullMode::None : nvrhi::RasterCullMode::Back;
+        pipelineDesc.renderState.depthStencilState.depthFunc = reverseDepth
+            ? nvrhi::ComparisonFunc::GreaterOrEqual
+            : nvrhi::ComparisonFunc::LessOrEqual;
+        pipeline = m_Device->createGraphicsPipeline(pipelineDesc, m_Framebuffer);
+    }
+
+    return pipeline;
+}
+
+void VisibilityBufferPass::ReserveMaterials(uint32_t materialCount)
+{
+    if (materialCount <= m_MaterialCapacity)
+        return;
+
+    // Grows in steps, scenes that stream in their materials do not reallocate for every one
+    m_MaterialCapacity = std::max(materialCount, m_MaterialCapacity * 2);
+    m_MaterialCapacity = std::max(m_MaterialCapacity, 64u);
+
+    nvrhi::BufferDesc bufferDesc;
+    bufferDesc.byteSize = uint64_t(m_MaterialCapacity) * sizeof(uint4);
+    bufferDesc.structStride = sizeof(uint4);
+    bufferDesc.canHaveUAVs = true;
+    bufferDesc.debugName = "VisibilityBuffer MaterialBins";
+    bufferDesc.initialState = nvrhi::ResourceStates::UnorderedAccess;
+    bufferDesc.keepInitialState = true;
+    m_Bins = m_Device->createBuffer(bufferDesc);
+
+    m_BindingCache.Clear();
+}
+
+void VisibilityBufferPass::Render(
+    nvrhi::ICommandList* commandList,
+    const IView& view,
+    const Scene& scene,
+    IDrawStrategy& drawStrategy,
+    nvrhi::IDescriptorTable* descriptorTable)
+{
+    commandList->beginMarker("VisibilityBuffer");
+
+    VisibilityViewConstants viewConstants = {};
+    view.FillPlanarViewConstants(viewConstants.view);
+    commandList->writeBuffer(m_ViewConstants, &viewConstants, sizeof(viewConstants));
+
+    RenderVisibility(commandList, view, scene, drawStrategy, descriptorTable);
+    ResolveMaterials(commandList, view, scene, descriptorTable);
+
+    commandList->endMarker();
+}
+
+void VisibilityBufferPass::RenderVisibility(nvrhi::ICommandList* commandList, const IView& view, const Scene& scene,
+    IDrawStrategy& drawStrategy, nvrhi::IDescriptorTable* descriptorTable)
+{
+    commandList->clearTextureUInt(m_Visibility, nvrhi::AllSubresources, 0);
+
+    nvrhi::BindingSetDesc bindingSetDesc;
+    bindingSetDesc.bindings = {
+        nvrhi::BindingSetItem::PushConstants(0, sizeof(VisibilityConstants)),
+        nvrhi::BindingSetItem::ConstantBuffer(1, m_ViewConstants),
+        nvrhi::BindingSetItem::StructuredBuffer_SRV(0, scene.GetInstanceBuffer()),
+        nvrhi::BindingSetItem::StructuredBuffer_SRV(1, scene.GetGeometryBuffer()),
+        nvrhi::BindingSetItem::StructuredBuffer_SRV(2, scene.GetMaterialBuffer()),
+        nvrhi::BindingSetItem::Sampler(0, m_CommonPasses->m_AnisotropicWrapSampler)
+    };
+    nvrhi::BindingSetHandle bindingSet = m_BindingCache.GetOrCreateBindingSet(bindingSetDesc, m_RasterBindingLayout);
+
+    nvrhi::GraphicsState state;
+    state.framebuffer = m_Framebuffer;
+    state.viewport = view.GetViewportState();
+    state.bindings = { bindingSet, descriptorTable };
+
+    const bool frontCounterClockwise = view.IsMirrored();
+    const bool reverseDepth = view.IsReverseDepth();
+
+    nvrhi::IGraphicsPipeline* currentPipeline = nullptr;
+
+    drawStrategy.PrepareForView(scene.GetSceneGraph()->GetRootNode(), view);
+
+    while (const DrawItem* item = drawStrategy.GetNextItem())
+    {
+        const Material* material = item->material;
+
+        // Blended and transmissive materials are drawn by the forward transparent pass
+        if (!material || (material->domain != MaterialDomain::Opaque && material->domain != MaterialDomain::AlphaTested))
+            continue;
+
+        // Geometries of a mesh have consecutive global indices, the instance data points at the first one.
+        // Meshes past the limit are only drawn here when SupportsScene was not checked.
+        size_t geometryIndex = item->geometry->globalGeometryIndex - item->mesh->geometries[0]->globalGeometryIndex;
+        if (geometryIndex >= c_MaxGeometriesPerMesh)
+            continue;
+
+        nvrhi::IGraphicsPipeline* pipeline = GetRasterPipeline(material->domain == MaterialDomain::AlphaTested,
+            material->doubleSided, frontCounterClockwise, reverseDepth);
+        if (pipeline != currentPipeline)
+        {
+            state.pipeline = pipeline;
+            commandList->setGraphicsState(state);
+            currentPipeline = pipeline;
+        }
+
+        VisibilityConstants constants = {};
+        constants.instanceIndex = uint(item->instance->GetInstanceIndex());
+        constants.geometryIndex = uint(geometryIndex);
+        constants.materialIndex = uint(material->materialID);
+        commandList->setPushConstants(&constants, sizeof(constants));
+
+        // The vertex shader fetches the indices itself, so the draw has no index or vertex buffers
+        nvrhi::DrawArguments args;
+        args.vertexCount = item->geometry->numIndices;
+        args.instanceCount = 1;
+        commandList->draw(args);
+    }
+}
+
+void VisibilityBufferPass::ResolveMaterials(nvrhi::ICommandList* commandList, const IView& view, const Scene& scene,
+    nvrhi::IDescriptorTable* descriptorTable)
+{
+    uint32_t materialCount = uint32_t(scene.GetSceneGraph()->GetMaterials().size());
+    if (materialCount == 0)
+        return;
+
+    ReserveMaterials(materialCount);
+
+    nvrhi::Rect viewExtent = view.GetViewExtent();
+
+    VisibilityConstants constants = {};
+    constants.materialCount = materialCount;
+    constants.viewOrigin = uint2(uint(viewExtent.minX), uint(viewExtent.minY));
+    constants.viewSize = uint2(uint(viewExtent.maxX - viewExtent.minX), uint(viewExtent.maxY - viewExtent.minY));
+
+    nvrhi::BindingSetDesc bindingSetDesc;
+    bindingSetDesc.bindings = {
+        nvrhi::BindingSetItem::PushConstants(0, sizeof(VisibilityConstants)),
+        nvrhi::BindingSetItem::StructuredBuffer_SRV(0, scene.GetInstanceBuffer()),
+        nvrhi::BindingSetItem::StructuredBuffer_SRV(1, scene.GetGeometryBuffer()),
+        nvrhi::BindingSetItem::Texture_SRV(3, m_Visibility),
+        nvrhi::BindingSetItem::StructuredBuffer_UAV(0, m_Bins),
+        nvrhi::BindingSetItem::RawBuffer_UAV(1, m_DispatchArgs),
+        nvrhi::BindingSetItem::StructuredBuffer_UAV(2, m_PixelList)
+    };
+    nvrhi::BindingSetHandle binningSet = m_BindingCache.GetOrCreateBindingSet(bindingSetDesc, m_BinningBindingLayout);
+
+    bindingSetDesc.bindings = {
+        nvrhi::BindingSetItem::PushConstants(0, sizeof(VisibilityConstants)),
+        nvrhi::BindingSetItem::ConstantBuffer(1, m_ViewConstants),
+        nvrhi::BindingSetItem::StructuredBuffer_SRV(0, scene.GetInstanceBuffer()),
+        nvrhi::BindingSetItem::StructuredBuffer_SRV(1, scene.GetGeometryBuffer()),
+        nvrhi::BindingSetItem::StructuredBuffer_SRV(2, scene.GetMaterialBuffer()),
+        nvrhi::BindingSetItem::Texture_SRV(3, m_Visibility),
+        nvrhi::BindingSetItem::Sampler(0, m_CommonPasses->m_AnisotropicWrapSampler),
+        nvrhi::BindingSetItem::StructuredBuffer_UAV(0, m_Bins),
+        nvrhi::BindingSetItem::StructuredBuffer_UAV(2, m_PixelList),
+        nvrhi::BindingSetItem::Texture_UAV(3, m_Diffuse, nvrhi::Format::RGBA8_UNORM),
+        nvrhi::BindingSetItem::Texture_UAV(4, m_Specular, nvrhi::Format::RGBA8_UNORM),
+        nvrhi::BindingSetItem::Texture_UAV(5, m_Normals),
+        nvrhi::BindingSetItem::Texture_UAV(6, m_Emissive)
+    };
+    nvrhi::BindingSetHandle resolveSet = m_BindingCache.GetOrCreateBindingSet(bindingSetDesc, m_ResolveBindingLayout);
+
+    uint2 groups = (constants.viewSize + 7u) / 8u;
+
+    commandList->clearBufferUInt(m_Bins, 0);
+
+    nvrhi::ComputeState state;
+    state.bindings = { binningSet };
+
+    state.pipeline = m_CountPipeline;
+    commandList->setComputeState(state);
+    commandList->setPushConstants(&constants, sizeof(constants));
+    commandList->dispatch(groups.x, groups.y);
+
+    state.pipeline = m_OffsetsPipeline;
+    commandList->setComputeState(state);
+    commandList->setPushConstants(&constants, sizeof(constants));
+    commandList->dispatch(1);
+
+    state.pipeline = m_ScatterPipeline;
+    commandList->setComputeState(state);
+    commandList->setPushConstants(&constants, sizeof(constants));
+    commandList->dispatch(groups.x, groups.y);
+
+    // The pixels without geometry are left at zero, like in a cleared GBuffer
+    commandList->clearTextureFloat(m_Diffuse, nvrhi::AllSubresources, nvrhi::Color(0.f));
+    commandList->clearTextureFloat(m_Specular, nvrhi::AllSubresources, nvrhi::Color(0.f));
+    commandList->clearTextureFloat(m_Normals, nvrhi::AllSubresources, nvrhi::Color(0.f));
+    commandList->clearTextureFloat(m_Emissive, nvrhi::AllSubresources, nvrhi::Color(0.f));
+
+    // A single dispatch sized on the GPU by the pixel counts of the bins; every group shades the pixels of
+    // one material and the materials that are not visible get no groups
+    state.pipeline = m_ResolvePipeline;
+    state.bindings = { resolveSet, descriptorTable };
+    state.indirectParams = m_DispatchArgs;
+    commandList->setComputeState(state);
+    commandList->setPushConstants(&constants, sizeof(constants));
+    commandList->dispatchIndirect(0);
+}
+
+void VisibilityBufferPass::FillDeferredInputs(DeferredLightingPass::Inputs& inputs) const
+{
+    inputs.depth = m_Depth;
+    inputs.gbufferDiffuse = m_Diffuse;
+    inputs.gbufferSpecular = m_Specular;
+    inputs.gbufferNormals = m_Normals;
+    inputs.gbufferEmissive = m_Emissive;
+}
+
+void VisibilityBufferPass::ResetBindingCache()
+{
+    m_BindingCache.Clear();
+}
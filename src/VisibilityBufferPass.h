@@ -0,0 +1,97 @@
+#pragma once
+
+#include <donut/engine/ShaderFactory.h>
+#include <donut/engine/CommonRenderPasses.h>
+#include <donut/engine/View.h>
+#include <donut/engine/Scene.h>
+#include <donut/render/DeferredLightingPass.h>
+#include <donut/render/DrawStrategy.h>
+#include <donut/core/math/math.h>
+#include <nvrhi/nvrhi.h>
+#include <memory>
+
+#include "PassBindingCache.h"
+
+namespace donut::render
+{
+    // Replaces the GBuffer fill in deferred mode: the opaque geometry is drawn once into the depth buffer
+    // and a visibility texture that holds the instance and triangle of every pixel, then the visible pixels
+    // are binned by material and evaluated by one indirect compute dispatch whose thread groups each shade the
+    // pixels of a single material. The vertex attributes, materials and textures are read through the scene's
+    // bindless tables, so the scene has to be created with a descriptor table that uses bindlessLayout.
+    // The resolve writes its own GBuffer textures, with the channels and formats of the donut GBuffer as
+    // compute shaders cannot write the render targets; FillDeferredInputs points the deferred lighting at them.
+    // Object motion vectors are not written, TAA uses the camera motion for every pixel.
+    class VisibilityBufferPass
+    {
+    public:
+        VisibilityBufferPass(nvrhi::IDevice* device,
+            const std::shared_ptr<engine::ShaderFactory>& shaderFactory,
+            std::shared_ptr<engine::CommonRenderPasses> commonPasses,
+            nvrhi::IBindingLayout* bindlessLayout,
+            nvrhi::ITexture* depth,
+            nvrhi::Format normalsFormat);
+
+        // Draws the opaque and alpha tested items of the draw strategy and resolves their materials.
+        // The depth buffer has to be cleared before.
+        void Render(nvrhi::ICommandList* commandList,
+            const engine::IView& view,
+            const engine::Scene& scene,
+            IDrawStrategy& drawStrategy,
+            nvrhi::IDescriptorTable* descriptorTable);
+
+        // Replaces the GBuffer textures of the inputs with the ones written by Render
+        void FillDeferredInputs(DeferredLightingPass::Inputs& inputs) const;
+
+        [[nodiscard]] nvrhi::ITexture* GetNormals() const { return m_Normals; }
+
+        // The visibility texel has room for 256 geometries per mesh; scenes with larger meshes have to be
+        // drawn through the GBuffer fill
+        [[nodiscard]] static bool SupportsScene(const engine::Scene& scene);
+
+        void ResetBindingCache();
+
+    private:
+        void CreatePipelines(nvrhi::IDevice* device, engine::ShaderFactory& shaderFactory);
+        nvrhi::IGraphicsPipeline* GetRasterPipeline(bool alphaTested, bool doubleSided, bool frontCounterClockwise, bool reverseDepth);
+        void ReserveMaterials(uint32_t materialCount);
+        void RenderVisibility(nvrhi::ICommandList* commandList, const engine::IView& view, const engine::Scene& scene,
+            IDrawStrategy& drawStrategy, nvrhi::IDescriptorTable* descriptorTable);
+        void ResolveMaterials(nvrhi::ICommandList* commandList, const engine::IView& view, const engine::Scene& scene,
+            nvrhi::IDescriptorTable* descriptorTable);
+
+        // Raster pipelines by alpha testing, face culling, winding and depth direction
+        static constexpr uint32_t c_RasterPipelineCount = 16;
+        nvrhi::ShaderHandle m_VertexShader;
+        nvrhi::ShaderHandle m_PixelShaders[2];
+        nvrhi::GraphicsPipelineHandle m_RasterPipelines[c_RasterPipelineCount];
+
+        nvrhi::ComputePipelineHandle m_CountPipeline;
+        nvrhi::ComputePipelineHandle m_OffsetsPipeline;
+        nvrhi::ComputePipelineHandle m_ScatterPipeline;
+        nvrhi::ComputePipelineHandle m_ResolvePipeline;
+
+        nvrhi::BindingLayoutHandle m_RasterBindingLayout;
+        nvrhi::BindingLayoutHandle m_BinningBindingLayout;
+        nvrhi::BindingLayoutHandle m_ResolveBindingLayout;
+        nvrhi::BindingLayoutHandle m_BindlessLayout;
+
+        nvrhi::TextureHandle m_Visibility;
+        nvrhi::FramebufferHandle m_Framebuffer;
+        nvrhi::TextureHandle m_Diffuse;
+        nvrhi::TextureHandle m_Specular;
+        nvrhi::TextureHandle m_Normals;
+        nvrhi::TextureHandle m_Emissive;
+        nvrhi::TextureHandle m_Depth;
+
+        nvrhi::BufferHandle m_ViewConstants;
+        nvrhi::BufferHandle m_PixelList;
+        nvrhi::BufferHandle m_Bins;
+        nvrhi::BufferHandle m_DispatchArgs;
+        uint32_t m_MaterialCapacity = 0;
+
+        std::shared_ptr<engine::CommonRenderPasses> m_CommonPasses;
+        nvrhi::DeviceHandle m_Device;
+        PassBindingCache m_BindingCache;
+    };
+}
@@ -0,0 +1,219 @@
+#pragma once
+
+#include <cstdint>
+
+// Engine-native binary scene format (.ymesh), written by YupCooker from glTF and loaded by CookedScene.
+//
+// The file starts with a FileHeader followed by the sections listed in its section table. Every section
+// is a tightly packed array of the records below, except for the string table (null-terminated UTF-8
+// strings referenced by byte offset) and the geometry data. Geometry data is laid out exactly like the
+// vertex and index buffers that donut::engine::Scene creates for a BufferGroup: one uint32 index stream
+// and one stream per vertex attribute, so the runtime uploads both buffers with a single write each.
+// All values are little-endian.
+
+namespace ymesh
+{
+    constexpr uint32_t c_Magic = 0x48534D59;    // "YMSH"
+    constexpr uint32_t c_Version = 1;
+    constexpr uint32_t c_InvalidIndex = ~0u;
+    constexpr uint32_t c_SectionAlignment = 16;
+
+    enum class SectionId : uint32_t
+    {
+        Strings,
+        Textures,
+        Materials,
+        Meshes,
+        Geometries,
+        Nodes,
+        Lights,
+        Cameras,
+        Animations,
+        Channels,
+        Keyframes,
+        IndexData,
+        VertexData,
+
+        Count
+    };
+
+    enum class VertexStream : uint32_t
+    {
+        Position,   // float3
+        Normal,     // snorm8x4 packed in a uint
+        Tangent,    // snorm8x4 packed in a uint, w = handedness
+        TexCoord1,  // float2
+        TexCoord2,  // float2
+
+        Count
+    };
+
+    struct Range
+    {
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    struct FileHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t sourceHash;                                // hash of the glTF and its buffers, used by the cooker to skip up-to-date scenes
+        Range sections[uint32_t(SectionId::Count)];         // absolute file ranges
+        Range vertexStreams[uint32_t(VertexStream::Count)]; // ranges within the VertexData section, size 0 if the attribute is absent
+    };
+
+    struct TextureRecord
+    {
+        uint32_t path;      // string, relative to the directory of the scene file
+        uint32_t sRGB;
+    };
+
+    enum class MaterialDomain : uint32_t
+    {
+        Opaque,
+        AlphaTested,
+        AlphaBlended
+    };
+
+    enum MaterialFlags : uint32_t
+    {
+        MaterialFlag_DoubleSided = 0x01,
+        MaterialFlag_SpecularGlossiness = 0x02
+    };
+
+    struct MaterialRecord
+    {
+        uint32_t name;
+        MaterialDomain domain;
+        uint32_t flags;
+        float baseOrDiffuseColor[3];
+        float opacity;
+        float specularColor[3];
+        float metalness;
+        float roughness;
+        float emissiveColor[3];
+        float emissiveIntensity;
+        float normalTextureScale;
+        float occlusionStrength;
+        float alphaCutoff;
+        uint32_t baseOrDiffuseTexture;      // texture indices or c_InvalidIndex
+        uint32_t metalRoughOrSpecularTexture;
+        uint32_t normalTexture;
+        uint32_t occlusionTexture;
+        uint32_t emissiveTexture;
+    };
+
+    struct MeshRecord
+    {
+        uint32_t name;
+        uint32_t firstGeometry;
+        uint32_t numGeometries;
+        uint32_t indexOffset;       // in indices, relative to the start of the index stream
+        uint32_t vertexOffset;      // in vertices, relative to the start of each vertex stream
+        uint32_t totalIndices;
+        uint32_t totalVertices;
+        float boundsMin[3];
+        float boundsMax[3];
+    };
+
+    struct GeometryRecord
+    {
+        uint32_t material;
+        uint32_t indexOffsetInMesh;
+        uint32_t vertexOffsetInMesh;
+        uint32_t numIndices;
+        uint32_t numVertices;
+        float boundsMin[3];
+        float boundsMax[3];
+    };
+
+    enum class LeafType : uint32_t
+    {
+        None,
+        Mesh,
+        Light,
+        Camera
+    };
+
+    // Nodes are stored parents first, so every parent index is smaller than the index of its children.
+    struct NodeRecord
+    {
+        uint32_t name;
+        uint32_t parent;            // c_InvalidIndex for children of the scene root
+        LeafType leafType;
+        uint32_t leafIndex;
+        double translation[3];
+        double rotation[4];         // quaternion x, y, z, w
+        double scaling[3];
+    };
+
+    enum class LightType : uint32_t
+    {
+        Directional,
+        Point,
+        Spot
+    };
+
+    struct LightRecord
+    {
+        LightType type;
+        float color[3];
+        float intensity;            // irradiance for directional lights
+        float range;
+        float innerAngle;           // degrees
+        float outerAngle;           // degrees
+    };
+
+    enum class CameraType : uint32_t
+    {
+        Perspective,
+        Orthographic
+    };
+
+    struct CameraRecord
+    {
+        CameraType type;
+        float params[2];            // vertical fov (radians) and aspect ratio (0 if unset), or xmag and ymag
+        float zNear;
+        float zFar;                 // 0 for an infinite projection
+    };
+
+    struct AnimationRecord
+    {
+        uint32_t name;
+        uint32_t firstChannel;
+        uint32_t numChannels;
+    };
+
+    enum class AnimationPath : uint32_t
+    {
+        Translation,
+        Rotation,
+        Scaling
+    };
+
+    enum class Interpolation : uint32_t
+    {
+        Step,
+        Linear,
+        CubicSpline
+    };
+
+    struct ChannelRecord
+    {
+        uint32_t node;
+        AnimationPath path;
+        Interpolation interpolation;
+        uint32_t firstKeyframe;
+        uint32_t numKeyframes;
+    };
+
+    struct KeyframeRecord
+    {
+        float time;
+        float value[4];
+        float inTangent[4];
+        float outTangent[4];
+    };
+}
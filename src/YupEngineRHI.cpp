@@ -6,12 +6,34 @@
 
 #include "FXAA.h"
 #include "FullScreenYUV.h"
+#include "PostProcessPass.h"
+#include "MaterialIDOutputPasses.h"
+#include "VisibilityBufferPass.h"
+#include "SceneVisibility.h"
+#include "ShadowMapCache.h"
+#include "ShadowCascadePass.h"
+#include "LightProbeBaker.h"
+#include "LightProbeCache.h"
+#include "LightProbeSHPass.h"
+#include "ClusteredLightingPass.h"
 #include "UIRenderer.h"
 #include "RenderTargets.h"
+#include "RenderTargetPool.h"
+#include "PassBindingCache.h"
 #include "AudioSource.h"
 #include "VideoRenderer.h"
+#include "CookedScene.h"
+#include "BatchedTextureCache.h"
+#include "ThreadPool.h"
+#include "LoadProfiler.h"
+#include "ShaderArchive.h"
+#include "FrameGovernor.h"
+#include "GpuProfiler.h"
+#include "CpuProfiler.h"
+#include "ChromeTrace.h"
 
 #include <donut/engine/CommonRenderPasses.h>
+#include <donut/engine/DescriptorTableManager.h>
 #include <donut/engine/SceneGraph.h>
 #include <donut/engine/FramebufferFactory.h>
 #include <donut/engine/ShaderFactory.h>
@@ -19,18 +41,21 @@
 #include <donut/render/DeferredLightingPass.h>
 #include <donut/render/DrawStrategy.h>
 #include <donut/render/SkyPass.h>
+#include <donut/render/TemporalAntiAliasingPass.h>
 #include <donut/render/ForwardShadingPass.h>
 #include <donut/render/SsaoPass.h>
 #include <donut/render/CascadedShadowMap.h>
 #include <donut/render/BloomPass.h>
 #include <donut/shaders/material_cb.h>
 #include <donut/shaders/bindless.h>
+#include <donut/shaders/forward_cb.h>
 #include <donut/app/Camera.h>
 #include <nvrhi/utils.h>
 #include <nvrhi/common/misc.h>
 #include <donut/render/DepthPass.h>
 #include <donut/engine/Scene.h>
 #include <bitset>
+#include <mutex>
 
 #ifdef DONUT_WITH_TASKFLOW
 #include <taskflow/taskflow.hpp>
@@ -53,17 +78,21 @@ private:
     typedef ApplicationBase Super;
 
     std::shared_ptr<ShaderFactory>          m_ShaderFactory;
+    // ShaderFactory is not thread-safe; held by everything that uses it after startup: the scene loading thread,
+    // the render pass builds on the pool and shader reloads
+    std::mutex                              m_ShaderFactoryMutex;
     //std::unique_ptr<engine::BindingCache> m_Popugay_Cache; // Настюша Гаражик спс за идею
     std::unique_ptr<engine::BindingCache>   m_BindingCache;
-    std::shared_ptr<InstancedOpaqueDrawStrategy> m_OpaqueDrawStrategy;
-    std::shared_ptr<TransparentDrawStrategy> m_TransparentDrawStrategy;
 
     std::shared_ptr<RenderTargets>          m_RenderTargets;
+    std::unique_ptr<RenderTargetPool>       m_RenderTargetPool;
 
     // Пасы
     std::unique_ptr<GBufferFillPass>        m_GBufferPass;
     std::unique_ptr<ForwardShadingPass>     m_ForwardPass;
+    std::unique_ptr<ForwardShadingIDPass>   m_ForwardIDPass;
     std::unique_ptr<DeferredLightingPass>   m_DeferredLightingPass;
+    std::unique_ptr<ClusteredLightingPass>  m_ClusteredLightingPass;
     std::unique_ptr<SkyPass>                m_SkyPass;
     std::unique_ptr<BloomPass>              m_BloomPass;
     std::unique_ptr<SsaoPass>               m_SsaoPass;
@@ -72,17 +101,37 @@ private:
     std::unique_ptr<MaterialIDPass>         m_MaterialIDPass;
     std::unique_ptr<LightProbeProcessingPass> m_LightProbePass;
     std::shared_ptr<FullScreenYUVPass>      m_YUVPass;
+    std::unique_ptr<PostProcessPass>        m_PostProcessPass;
+    std::unique_ptr<TemporalAntiAliasingPass> m_TemporalAntiAliasingPass;
+    std::unique_ptr<VisibilityBufferPass>   m_VisibilityBufferPass;
     std::unique_ptr<VideoRenderer>          m_VideoRenderer;
 
+    // Bindless tables of the scene buffers and textures, for the visibility buffer; not available on D3D11
+    nvrhi::BindingLayoutHandle              m_BindlessLayout;
+    std::shared_ptr<DescriptorTableManager> m_DescriptorTable;
+
     // Свет и тени
     std::shared_ptr<DirectionalLight>       m_SunLight;
     std::shared_ptr<CascadedShadowMap>      m_ShadowMap;
     std::shared_ptr<FramebufferFactory>     m_ShadowFramebuffer;
+    std::unique_ptr<ShadowMapCache>         m_ShadowCache;
     std::shared_ptr<DepthPass>              m_ShadowDepthPass;
+    // Draws all cascades in one pass; needs the bindless tables and the array slice output of vertex shaders
+    std::unique_ptr<ShadowCascadePass>      m_ShadowCascadePass;
+    nvrhi::Format                           m_ShadowMapFormat = nvrhi::Format::UNKNOWN;
+    uint32_t                                m_ShadowMapResolution = 0;
+    uint32_t                                m_ShadowCascadeCount = 0;
+
+    std::unique_ptr<GpuProfiler>            m_GpuProfiler;
+    FrameGovernor                           m_FrameGovernor;
+    // Render thread time of Animate and RenderScene, without the waits for the swap chain in between
+    float                                   m_AnimateCpuTime = 0.f;
+    float                                   m_CpuFrameTime = 0.f;
 
     // чета
     std::shared_ptr<PlanarView>             m_View;
     std::shared_ptr<PlanarView>             m_ViewPrevious;
+    std::shared_ptr<PlanarView>             m_UpscaledView;
 
     std::vector<std::string>                m_SceneFilesAvailable;
     std::string                             m_CurrentSceneName;
@@ -92,11 +141,41 @@ private:
 
     donut::app::FirstPersonCamera           m_Camera;
     nvrhi::CommandListHandle                m_CommandList;
+
+    // The command lists of RenderScene after m_CommandList, in submission order. The geometry passes are
+    // recorded into theirs on the thread pool, the render thread records the others at the same time.
+    enum SceneList
+    {
+        SceneList_Shadow,
+        SceneList_Opaque,
+        SceneList_Lighting,
+        SceneList_MaterialID,
+        SceneList_Sky,
+        SceneList_Transparent,
+        SceneList_Post,
+        SceneList_Count
+    };
+
+    struct SceneCommandList
+    {
+        nvrhi::CommandListHandle commandList;
+        // Draw strategies keep their traversal state, so lists recorded at the same time cannot share them
+        std::shared_ptr<InstancedOpaqueDrawStrategy> opaqueDrawStrategy;
+        std::shared_ptr<TransparentDrawStrategy> transparentDrawStrategy;
+        std::shared_ptr<CachedDrawStrategy> cachedOpaqueDrawStrategy;
+        std::shared_ptr<CachedDrawStrategy> cachedTransparentDrawStrategy;
+    };
+    SceneCommandList                        m_SceneCommandLists[SceneList_Count];
+
+    // Culls every view of RenderScene once for all the passes that draw it
+    std::shared_ptr<SceneVisibility>        m_SceneVisibility;
+
     GLFWwindow*                             window;
     float                                   m_CameraVerticalFov = 60.f;
     float3                                  m_AmbientTop = 0.f;
     float3                                  m_AmbientBottom = 0.f;
     bool                                    m_PreviousViewsValid = false;
+    bool                                    m_SceneSupportsVisibilityBuffer = true;
     std::shared_ptr<vfs::RootFileSystem>    rootFS;
     std::shared_ptr<vfs::ZipFile>           m_ZipFS;
     float                                   m_WallclockTime = 0.f;
@@ -104,6 +183,49 @@ private:
     std::vector<std::shared_ptr<LightProbe>> m_LightProbes;
     nvrhi::TextureHandle                    m_LightProbeDiffuseTexture;
     nvrhi::TextureHandle                    m_LightProbeSpecularTexture;
+    std::unique_ptr<LightProbeBaker>        m_LightProbeBaker;
+    std::unique_ptr<LightProbeCache>        m_LightProbeCache;
+    std::unique_ptr<LightProbeSHPass>       m_LightProbeSHPass;
+
+    std::shared_ptr<ThreadPool>             m_ThreadPool;
+    std::shared_ptr<BatchedTextureCache>    m_BatchedTextureCache;
+    std::shared_ptr<ShaderArchive>          m_ShaderArchive;
+    std::filesystem::path                   m_ShaderDir;
+
+    // Passes built together by BuildRenderPasses. The format-dependent passes are only built on a full rebuild;
+    // the empty ones keep their current instance when the set is applied. A shader reload that keeps the render
+    // targets leaves out every pass whose shaders did not change, so the pass keeps its pipelines.
+    struct RenderPassSet
+    {
+        std::shared_ptr<RenderTargets>              renderTargets;
+        // Archive blobs that the passes in the set were created from, by pass name
+        std::unordered_map<std::string, ShaderBlobHashes> passShaders;
+
+        // Only depend on the render target formats
+        std::unique_ptr<ForwardShadingPass>         forwardPass;
+        std::unique_ptr<ForwardShadingIDPass>       forwardIdPass;
+        std::unique_ptr<GBufferFillPass>            gbufferPass;
+        std::unique_ptr<MaterialIDPass>             materialIdPass;
+        std::unique_ptr<DeferredLightingPass>       deferredLightingPass;
+        std::unique_ptr<LightProbeProcessingPass>   lightProbePass;
+        std::unique_ptr<FXAAPass>                   fxaaPass;
+        std::shared_ptr<FullScreenYUVPass>          yuvPass;
+        std::unique_ptr<PostProcessPass>            postProcessPass;
+
+        // Hold on to the render targets or textures sized after them
+        std::unique_ptr<SkyPass>                    skyPass;
+        std::unique_ptr<SsaoPass>                   ssaoPass;
+        std::unique_ptr<ToneMappingPass>            toneMappingPass;
+        std::unique_ptr<BloomPass>                  bloomPass;
+        std::unique_ptr<TemporalAntiAliasingPass>   temporalAntiAliasingPass;
+        std::unique_ptr<VisibilityBufferPass>       visibilityBufferPass;
+    };
+
+    std::shared_ptr<TaskBatch>              m_RenderPassBuild;
+    std::unique_ptr<RenderPassSet>          m_BuiltRenderPasses;
+    bool                                    m_AllPassesRebuildRequested = false;
+    // Archive blobs that the current passes were created from; empty for passes built from loose files
+    std::unordered_map<std::string, ShaderBlobHashes> m_PassShaders;
 
     UIData&                                 m_ui;
     std::shared_ptr<AudioSource>            m_source3D;
@@ -119,22 +241,35 @@ public:
 
         m_ZipFS = std::make_shared<vfs::ZipFile>(app::GetDirectoryWithExecutable() / "Assets.zip");
 
-        std::filesystem::path frameworkShaderPath = app::GetDirectoryWithExecutable() / "Shaders" / app::GetShaderTypeName(GetDevice()->getGraphicsAPI());
+        m_ShaderDir = app::GetDirectoryWithExecutable() / "Shaders" / app::GetShaderTypeName(GetDevice()->getGraphicsAPI());
 
         rootFS = std::make_shared<vfs::RootFileSystem>();
-        rootFS->mount("/shaders", frameworkShaderPath);
-        rootFS->mount("/", m_ZipFS);
+        MountShaders();
         m_ShaderFactory = std::make_shared<ShaderFactory>(GetDevice(), rootFS, "/shaders");
         m_CommonPasses = std::make_shared<CommonRenderPasses>(GetDevice(), m_ShaderFactory);
         m_BindingCache = std::make_unique<engine::BindingCache>(GetDevice());
 
-        m_OpaqueDrawStrategy = std::make_shared<InstancedOpaqueDrawStrategy>();
-        m_TransparentDrawStrategy = std::make_shared<TransparentDrawStrategy>();
-
         m_DeferredLightingPass = std::make_unique<DeferredLightingPass>(GetDevice(), m_CommonPasses);
         m_DeferredLightingPass->Init(m_ShaderFactory);
+        m_ClusteredLightingPass = std::make_unique<ClusteredLightingPass>(GetDevice(), m_ShaderFactory);
+
+        if (GetDevice()->getGraphicsAPI() != nvrhi::GraphicsAPI::D3D11)
+        {
+            nvrhi::BindlessLayoutDesc bindlessLayoutDesc;
+            bindlessLayoutDesc.visibility = nvrhi::ShaderType::All;
+            bindlessLayoutDesc.firstSlot = 0;
+            bindlessLayoutDesc.maxCapacity = 1024;
+            bindlessLayoutDesc.registerSpaces = {
+                nvrhi::BindingLayoutItem::RawBuffer_SRV(1),
+                nvrhi::BindingLayoutItem::Texture_SRV(2)
+            };
+            m_BindlessLayout = GetDevice()->createBindlessLayout(bindlessLayoutDesc);
+            m_DescriptorTable = std::make_shared<DescriptorTableManager>(GetDevice(), m_BindlessLayout);
+        }
 
-        m_TextureCache = std::make_shared<TextureCache>(GetDevice(), m_ZipFS, nullptr);
+        m_ThreadPool = std::make_shared<ThreadPool>();
+        m_BatchedTextureCache = std::make_shared<BatchedTextureCache>(GetDevice(), std::make_shared<ProfilingFileSystem>(m_ZipFS), m_DescriptorTable);
+        m_TextureCache = m_BatchedTextureCache;
 
         const nvrhi::Format shadowMapFormats[] = {
            nvrhi::Format::D24S8,
@@ -148,13 +283,11 @@ public:
             nvrhi::FormatSupport::DepthStencil  |
             nvrhi::FormatSupport::ShaderLoad;
 
-        nvrhi::Format shadowMapFormat = nvrhi::utils::ChooseFormat(GetDevice(), shadowMapFeatures, shadowMapFormats, std::size(shadowMapFormats));
+        m_ShadowMapFormat = nvrhi::utils::ChooseFormat(GetDevice(), shadowMapFeatures, shadowMapFormats, std::size(shadowMapFormats));
 
-        m_ShadowMap = std::make_shared<CascadedShadowMap>(GetDevice(), 2048, 4, 0, shadowMapFormat);
-        m_ShadowMap->SetupProxyViews();
+        CreateShadowMap(2048, 4);
 
-        m_ShadowFramebuffer = std::make_shared<FramebufferFactory>(GetDevice());
-        m_ShadowFramebuffer->DepthTarget = m_ShadowMap->GetTexture();
+        m_GpuProfiler = std::make_unique<GpuProfiler>(GetDevice());
 
         DepthPass::CreateParameters shadowDepthParams;
         shadowDepthParams.slopeScaledDepthBias = 4.f;
@@ -162,8 +295,39 @@ public:
         m_ShadowDepthPass = std::make_shared<DepthPass>(GetDevice(), m_CommonPasses);
         m_ShadowDepthPass->Init(*m_ShaderFactory, shadowDepthParams);
 
+        bool vertexLayerOutput = GetDevice()->getGraphicsAPI() != nvrhi::GraphicsAPI::VULKAN
+            || GetDeviceManager()->IsVulkanDeviceExtensionEnabled("VK_EXT_shader_viewport_index_layer");
+        if (m_BindlessLayout && vertexLayerOutput)
+        {
+            m_ShadowCascadePass = std::make_unique<ShadowCascadePass>(GetDevice(), m_ShaderFactory, m_CommonPasses,
+                m_BindlessLayout, shadowDepthParams);
+        }
+
+        LightProbeBaker::CreateParameters bakerParams;
+        bakerParams.shadowMapFormat = m_ShadowMapFormat;
+        bakerParams.shadowDepthParams = shadowDepthParams;
+        m_LightProbeSHPass = std::make_unique<LightProbeSHPass>(GetDevice(), m_ShaderFactory);
+        m_LightProbeCache = std::make_unique<LightProbeCache>(GetDevice(), m_ThreadPool);
+        m_LightProbeBaker = std::make_unique<LightProbeBaker>(GetDevice(), m_ShaderFactory, m_CommonPasses, bakerParams,
+            [this](nvrhi::ICommandList* commandList, const std::shared_ptr<LightProbe>& probe, const box3& bounds)
+            {
+                m_LightProbeCache->Capture(commandList, probe, bounds, m_LightProbeBaker->GetDiffuseCoefficients(),
+                    m_LightProbeBaker->GetSpecularMap(), m_LightProbePass->GetEnvironmentBrdfTexture());
+            });
+
         m_CommandList = GetDevice()->createCommandList();
 
+        m_SceneVisibility = std::make_shared<SceneVisibility>();
+
+        for (SceneCommandList& list : m_SceneCommandLists)
+        {
+            list.commandList = GetDevice()->createCommandList();
+            list.opaqueDrawStrategy = std::make_shared<InstancedOpaqueDrawStrategy>();
+            list.transparentDrawStrategy = std::make_shared<TransparentDrawStrategy>();
+            list.cachedOpaqueDrawStrategy = std::make_shared<CachedDrawStrategy>(m_SceneVisibility, false);
+            list.cachedTransparentDrawStrategy = std::make_shared<CachedDrawStrategy>(m_SceneVisibility, true);
+        }
+
         window = GetDeviceManager()->GetWindow();
 
         m_Camera.SetMoveSpeed(3.0f);
@@ -187,12 +351,13 @@ public:
 
         bool needNewPasses = false;
 
+        m_RenderTargetPool = std::make_unique<RenderTargetPool>(GetDevice());
+
         if (!m_RenderTargets || m_RenderTargets->IsUpdateRequired(uint2(windowWidth, windowHeight), sampleCount))
         {
             m_RenderTargets = nullptr;
             m_BindingCache->Clear();
-            m_RenderTargets = std::make_unique<RenderTargets>();
-            m_RenderTargets->Init(GetDevice(), uint2(windowWidth, windowHeight), sampleCount, true, true);
+            m_RenderTargets = m_RenderTargetPool->Acquire(uint2(windowWidth, windowHeight), sampleCount);
 
             needNewPasses = true;
         }
@@ -212,6 +377,13 @@ public:
 
     }
 
+    ~YupEngine()
+    {
+        // The pass build reads and writes this object
+        if (m_RenderPassBuild)
+            m_RenderPassBuild->Wait();
+    }
+
     std::filesystem::path const& GetSceneDir() const
     {
         return m_SceneDir;
@@ -232,9 +404,92 @@ public:
         BeginLoadingScene(m_ZipFS, m_CurrentSceneName);
     }
 
+    void CreateShadowMap(uint32_t resolution, uint32_t cascadeCount)
+    {
+        m_ShadowMap = std::make_shared<CascadedShadowMap>(GetDevice(), resolution, cascadeCount, 0, m_ShadowMapFormat);
+        m_ShadowMap->SetupProxyViews();
+
+        m_ShadowFramebuffer = std::make_shared<FramebufferFactory>(GetDevice());
+        m_ShadowFramebuffer->DepthTarget = m_ShadowMap->GetTexture();
+
+        m_ShadowCache = std::make_unique<ShadowMapCache>(GetDevice(), m_ShadowMap);
+
+        m_ShadowMapResolution = resolution;
+        m_ShadowCascadeCount = cascadeCount;
+
+        // The cached binding sets reference the previous shadow map
+        if (m_ForwardPass) m_ForwardPass->ResetBindingCache();
+        if (m_ForwardIDPass) m_ForwardIDPass->ResetBindingCache();
+        if (m_ShadowCascadePass) m_ShadowCascadePass->ResetBindingCache();
+        if (m_DeferredLightingPass) m_DeferredLightingPass->ResetBindingCache();
+    }
+
+    // Publishes the CPU scope statistics and writes the trace the UI asked for
+    void UpdateCpuProfiler()
+    {
+#ifdef YUP_ENGINE_CPU_PROFILER
+        m_ui.CpuScopeStats = CpuProfiler::Get().GetSortedStats();
+
+        if (m_ui.CpuCaptureRequested)
+        {
+            // Written by the next frame boundary, once the current frame is complete as well
+            CpuProfiler::Get().RequestCapture(uint32_t(m_ui.CpuCaptureFrames), app::GetDirectoryWithExecutable() / "CpuProfile.trace.json");
+            m_ui.CpuCaptureRequested = false;
+        }
+#endif
+    }
+
+    // Starts the GPU profiler frame, publishes its results and lets the governor adjust its limits.
+    // Called before anything that depends on the limits is set up for the frame.
+    void UpdateFrameGovernor()
+    {
+        CPU_PROFILE_SCOPE("UpdateFrameGovernor");
+
+        bool newFrameTime = m_GpuProfiler->BeginFrame();
+
+        float gpuFrameTime = m_GpuProfiler->GetLastFrameTime();
+        m_ui.GpuFrameTimeMs = gpuFrameTime * 1e3f;
+        m_ui.CpuFrameTimeMs = m_CpuFrameTime * 1e3f;
+        m_ui.GpuPassTimings = m_GpuProfiler->GetSortedPassTimings();
+        m_ui.GpuFrameHistory = m_GpuProfiler->GetFrameHistory();
+
+        if (m_ui.GpuProfileExportRequested)
+        {
+            std::filesystem::path directory = app::GetDirectoryWithExecutable();
+            if (m_GpuProfiler->WriteCsv(directory / "GpuProfile.csv") && m_GpuProfiler->WriteChromeTrace(directory / "GpuProfile.trace.json"))
+                log::info("GPU profile written to %s", (directory / "GpuProfile.csv").generic_string().c_str());
+            else
+                log::warning("Cannot write the GPU profile to %s", directory.generic_string().c_str());
+            m_ui.GpuProfileExportRequested = false;
+        }
+
+        if (m_ui.EnableFrameGovernor)
+        {
+            // A frame that was not read back would count the previous sample twice
+            m_FrameGovernor.SetTargetFrameTime(m_ui.TargetFrameTimeMs * 1e-3f);
+            if (newFrameTime)
+                m_FrameGovernor.Update(gpuFrameTime, m_CpuFrameTime);
+        }
+        else if (m_FrameGovernor.GetLevel() != 0)
+        {
+            m_FrameGovernor.Reset();
+        }
+
+        m_ui.GovernorLevel = m_FrameGovernor.GetLevel();
+        m_ui.GovernorDecision = m_FrameGovernor.GetLastDecision();
+
+        const FrameGovernor::Limits& limits = m_FrameGovernor.GetLimits();
+        if (limits.shadowMapResolution != m_ShadowMapResolution || limits.shadowCascadeCount != m_ShadowCascadeCount)
+            CreateShadowMap(limits.shadowMapResolution, limits.shadowCascadeCount);
+    }
+
+    // m_View covers the render size and is jittered when TAA is on; m_UpscaledView covers the display size
+    // and is used by everything after the temporal resolve
     bool SetupView()
     {
-        float2 renderTargetSize = float2(m_RenderTargets->GetSize());
+        uint2 renderSize = m_RenderTargets->GetRenderSize();
+        float2 renderTargetSize = float2(renderSize);
+        float2 displaySize = float2(m_RenderTargets->GetDisplaySize());
 
         affine3 viewMatrix = m_Camera.GetWorldToViewMatrix();
 
@@ -244,26 +499,89 @@ public:
         {
             m_View = std::make_shared<PlanarView>();
             m_ViewPrevious = std::make_shared<PlanarView>();
+            m_UpscaledView = std::make_shared<PlanarView>();
             topologyChanged = true;
         }
 
         float verticalFov = dm::radians(m_CameraVerticalFov);
-        float4x4 projection = perspProjD3DStyleReverse(verticalFov, renderTargetSize.x / renderTargetSize.y, 0.01f);
+        float4x4 projection = perspProjD3DStyleReverse(verticalFov, displaySize.x / displaySize.y, 0.01f);
+
+        float2 pixelOffset = (m_ui.EnableTAA && m_TemporalAntiAliasingPass) ? m_TemporalAntiAliasingPass->GetCurrentPixelOffset() : float2(0.f);
 
         m_View->SetViewport(nvrhi::Viewport(renderTargetSize.x, renderTargetSize.y));
+        m_View->SetPixelOffset(pixelOffset);
         m_View->SetMatrices(viewMatrix, projection);
 
+        m_UpscaledView->SetViewport(nvrhi::Viewport(displaySize.x, displaySize.y));
+        m_UpscaledView->SetMatrices(viewMatrix, projection);
+
         if (topologyChanged)
         {
-            m_ViewPrevious = m_View;
+            *m_ViewPrevious = *m_View;
+            m_PreviousViewsValid = false;
         }
 
+        // Reprojection needs the previous frame at the same render size
+        nvrhi::Rect previousExtent = m_ViewPrevious->GetViewExtent();
+        if (uint(previousExtent.maxX - previousExtent.minX) != renderSize.x || uint(previousExtent.maxY - previousExtent.minY) != renderSize.y)
+            m_PreviousViewsValid = false;
+
         m_View->UpdateCache();
         m_ViewPrevious->UpdateCache();
-        m_PreviousViewsValid = false;
+        m_UpscaledView->UpdateCache();
         return topologyChanged;
     }
 
+    // Render size for a display size, from the user's resolution scale and the frame governor's limit
+    uint2 GetScaledRenderSize(uint2 displaySize) const
+    {
+        float scale = m_ui.ResolutionScale * m_FrameGovernor.GetLimits().resolutionScale;
+        if (scale >= 1.f)
+            return displaySize;
+
+        uint2 scaled = uint2(float2(displaySize) * scale + 0.5f);
+        return max(scaled, uint2(1u));
+    }
+
+    // Mounts the shader archive packed by YupCooker when it holds the current shaders, and the loose shader
+    // files otherwise. Returns false when a reload finds an archive with the same contents as the mounted one.
+    bool MountShaders()
+    {
+        std::filesystem::path archivePath = m_ShaderDir;
+        archivePath += ".pak";
+
+        std::shared_ptr<ShaderArchive> archive;
+        if (ShaderArchive::IsUpToDate(archivePath, m_ShaderDir))
+            archive = ShaderArchive::Open(archivePath);
+
+        if (archive && m_ShaderArchive)
+        {
+            uint32_t changedShaders = archive->CountChangedEntries(*m_ShaderArchive);
+            if (changedShaders == 0)
+            {
+                log::info("Shader reload: no shader changed, keeping the current passes");
+                return false;
+            }
+            log::info("Shader reload: %u of %u shaders changed", changedShaders, archive->GetEntryCount());
+        }
+
+        // Remounted in order so that "/shaders" is matched before the root mount
+        rootFS->unmount("/shaders");
+        rootFS->unmount("/");
+
+        if (archive)
+        {
+            rootFS->mount("/shaders", archive);
+            log::info("Shaders mapped from %s (%u blobs)", archivePath.generic_string().c_str(), archive->GetEntryCount());
+        }
+        else
+            rootFS->mount("/shaders", m_ShaderDir);
+
+        rootFS->mount("/", m_ZipFS);
+        m_ShaderArchive = archive;
+        return true;
+    }
+
     std::shared_ptr<vfs::RootFileSystem> GetRootFS()
     {
         return rootFS;
@@ -278,10 +596,22 @@ public:
         }
 
         if (m_ForwardPass) m_ForwardPass->ResetBindingCache();
+        if (m_ForwardIDPass) m_ForwardIDPass->ResetBindingCache();
         if (m_DeferredLightingPass) m_DeferredLightingPass->ResetBindingCache();
+        if (m_ClusteredLightingPass) m_ClusteredLightingPass->ResetBindingCache();
         if (m_GBufferPass) m_GBufferPass->ResetBindingCache();
         if (m_LightProbePass) m_LightProbePass->ResetCaches();
         if (m_ShadowDepthPass) m_ShadowDepthPass->ResetBindingCache();
+        if (m_VisibilityBufferPass) m_VisibilityBufferPass->ResetBindingCache();
+        if (m_ShadowCascadePass) m_ShadowCascadePass->ResetBindingCache();
+        if (m_ShadowCache) m_ShadowCache->Invalidate();
+        if (m_LightProbeBaker)
+        {
+            m_LightProbeBaker->Cancel();
+            m_LightProbeBaker->ResetBindingCaches();
+        }
+        if (m_LightProbeCache) m_LightProbeCache->Close();
+        if (m_LightProbeSHPass) m_LightProbeSHPass->ResetBindingCache();
         m_BindingCache->Clear();
         m_SunLight.reset();
         m_ui.SceneLoadedStatus = false;
@@ -297,22 +627,34 @@ public:
     {
         using namespace std::chrono;
 
-        std::unique_ptr<engine::Scene> scene = std::make_unique<engine::Scene>(GetDevice(),
-            *m_ShaderFactory, fs, m_TextureCache, nullptr, nullptr);
+        // Profiled until SceneLoaded, which runs after the last texture upload
+        LoadProfiler::Get().BeginSession();
+        ProfilerThreads::SetCurrentName("Scene loading");
+        CPU_PROFILE_SCOPE("LoadScene");
+
+        std::unique_ptr<CookedScene> scene;
+        {
+            std::lock_guard lock(m_ShaderFactoryMutex);
+            scene = std::make_unique<CookedScene>(GetDevice(),
+                *m_ShaderFactory, std::make_shared<ProfilingFileSystem>(fs), m_TextureCache, m_DescriptorTable, nullptr);
+        }
+        scene->SetThreadPool(m_ThreadPool);
 
         auto startTime = high_resolution_clock::now();
 
         if (scene->Load(fileName))
         {
+            bool cooked = scene->IsCooked();
             m_Scene = std::move(scene);
 
             auto endTime = high_resolution_clock::now();
             auto duration = duration_cast<milliseconds>(endTime - startTime).count();
-            log::info("Scene loading time: %llu ms", duration);
+            log::info("Scene loading time: %llu ms (%s)", duration, cooked ? "cooked" : "glTF");
 
             return true;
         }
 
+        LoadProfiler::Get().EndSession(app::GetDirectoryWithExecutable() / "SceneLoad.trace.json", 10);
         return false;
     }
 
@@ -350,6 +692,12 @@ public:
         }
 
         CreateLightProbes(4);
+        m_LightProbeCache->Load(GetLightProbeCacheFile(), m_LightProbes, m_LightProbePass->GetEnvironmentBrdfTexture());
+
+        m_SceneSupportsVisibilityBuffer = VisibilityBufferPass::SupportsScene(*m_Scene);
+        if (!m_SceneSupportsVisibilityBuffer)
+            log::warning("The scene has meshes with more geometries than the visibility buffer can address, "
+                "it is drawn through the GBuffer fill");
 
         auto audioSourceNode = std::make_shared<SceneGraphNode>();
         audioSourceNode->SetName("AudioSource2D");
@@ -362,19 +710,31 @@ public:
 
         m_ui.lights = GetScene()->GetSceneGraph()->GetLights();
         m_ui.LightProbes = GetLightProbes();
-        m_ui.m_RenderCallback = [this](LightProbe& probe) { RenderLightProbe(probe); };
+        m_ui.m_RenderCallback = [this](const std::shared_ptr<LightProbe>& probe) { RenderLightProbe(probe); };
 
         PrintSceneGraph(m_Scene->GetSceneGraph()->GetRootNode());
+
+        ProfilerThreads::SetCurrentName("Render");
+        LoadProfiler::Get().EndSession(app::GetDirectoryWithExecutable() / "SceneLoad.trace.json", 10);
     }
 
     void Animate(float seconds) override
     {
+        // Frame boundary for the CPU profiler: everything recorded since the last call belongs to the previous frame
+        CPU_PROFILE_FRAME(GetFrameIndex());
+        CPU_PROFILE_SCOPE("Animate");
+        auto animateStart = std::chrono::steady_clock::now();
+
+        UpdateCpuProfiler();
+
         m_Camera.Animate(seconds);
         GetDeviceManager()->SetInformativeWindowTitle(g_WindowTitle);
 
         if (m_ToneMappingPass)
             m_ToneMappingPass->AdvanceFrame(seconds);
 
+        m_ui.BindingSetsCreated = PassBindingCache::EndFrame();
+
         if (m_ui.SceneLoadedStatus)
         {
             m_WallclockTime += seconds;
@@ -400,8 +760,12 @@ public:
             // Update the position of m_Source2D
             m_source3D->GetNodeSharedPtr()->SetTranslation(double3(x, 0.0, z));
             m_source3D->Update3DAttributes();
+
+            CPU_PROFILE_SCOPE("Audio update");
             AudioEngine::m_system->update();
         }
+
+        m_AnimateCpuTime = std::chrono::duration<float>(std::chrono::steady_clock::now() - animateStart).count();
     }
 
     void BackBufferResizing() override
@@ -409,68 +773,316 @@ public:
 
     }
 
-    void CreateRenderPasses(bool& exposureResetRequired)
+    // Creates the render targets when none are given, and the passes that render into them.
+    // Runs on a pool thread for resizes and shader reloads, so it only reads the device, the shader factory,
+    // the common passes and its arguments.
+    // keepUnchangedPasses leaves out the passes whose shader blobs all have the same hash in the mounted archive
+    // as when they were created; it needs the render targets of the current passes.
+    std::unique_ptr<RenderPassSet> BuildRenderPasses(std::shared_ptr<RenderTargets> renderTargets, uint2 size,
+        bool allPasses, bool keepUnchangedPasses, PlanarView view, nvrhi::BufferHandle exposureBuffer)
     {
+        std::lock_guard lock(m_ShaderFactoryMutex);
+
+        auto passes = std::make_unique<RenderPassSet>();
+        uint32_t keptPasses = 0;
+
+        // Records the blobs each pass reads. The bytecode cache of the factory is cleared before every pass,
+        // so that blobs shared with earlier passes are read and recorded again; they stay mapped, so this is cheap.
+        auto buildPass = [&](const char* name, auto&& create)
+        {
+            if (keepUnchangedPasses && m_ShaderArchive)
+            {
+                auto current = m_PassShaders.find(name);
+                if (current != m_PassShaders.end() && !current->second.empty() && m_ShaderArchive->ContainsBlobs(current->second))
+                {
+                    keptPasses++;
+                    return;
+                }
+            }
+
+            ShaderBlobHashes& blobs = passes->passShaders[name];
+            if (m_ShaderArchive)
+            {
+                m_ShaderFactory->ClearCache();
+                ShaderReadRecorder recorder(blobs);
+                create();
+            }
+            else
+                create();
+        };
+
+        if (!renderTargets)
+            renderTargets = m_RenderTargetPool->Acquire(size, 1);
+        passes->renderTargets = renderTargets;
+
+        // Passes that size their own textures after the view get the whole allocation, so they keep working
+        // while the render size changes within it
+        view.SetViewport(nvrhi::Viewport(float(renderTargets->GetSize().x), float(renderTargets->GetSize().y)));
+        view.UpdateCache();
+
+        // Set by the GBuffer fill on the pixels that have object motion vectors; TAA fills in camera motion elsewhere
         uint32_t motionVectorStencilMask = 0x01;
 
-        ForwardShadingPass::CreateParameters ForwardParams;
-        ForwardParams.trackLiveness = false;
-        m_ForwardPass = std::make_unique<ForwardShadingPass>(GetDevice(), m_CommonPasses);
-        m_ForwardPass->Init(*m_ShaderFactory, ForwardParams);
+        if (allPasses)
+        {
+            ForwardShadingPass::CreateParameters ForwardParams;
+            ForwardParams.trackLiveness = false;
+            buildPass("Forward", [&]
+            {
+                passes->forwardPass = std::make_unique<ForwardShadingPass>(GetDevice(), m_CommonPasses);
+                passes->forwardPass->Init(*m_ShaderFactory, ForwardParams);
+            });
+            buildPass("ForwardID", [&]
+            {
+                passes->forwardIdPass = std::make_unique<ForwardShadingIDPass>(GetDevice(), m_CommonPasses);
+                passes->forwardIdPass->Init(*m_ShaderFactory, ForwardParams);
+            });
+
+            GBufferFillPass::CreateParameters GBufferParams;
+            GBufferParams.enableMotionVectors = true;
+            GBufferParams.stencilWriteMask = motionVectorStencilMask;
+            buildPass("GBufferFill", [&]
+            {
+                passes->gbufferPass = std::make_unique<GBufferFillIDPass>(GetDevice(), m_CommonPasses);
+                passes->gbufferPass->Init(*m_ShaderFactory, GBufferParams);
+            });
+            GBufferParams.enableMotionVectors = false;
 
-        GBufferFillPass::CreateParameters GBufferParams;
-        GBufferParams.enableMotionVectors = true;
-        GBufferParams.stencilWriteMask = motionVectorStencilMask;
-        m_GBufferPass = std::make_unique<GBufferFillPass>(GetDevice(), m_CommonPasses);
-        m_GBufferPass->Init(*m_ShaderFactory, GBufferParams);
-        GBufferParams.enableMotionVectors = false;
+            buildPass("MaterialID", [&]
+            {
+                passes->materialIdPass = std::make_unique<MaterialIDPass>(GetDevice(), m_CommonPasses);
+                passes->materialIdPass->Init(*m_ShaderFactory, GBufferParams);
+            });
 
-        m_MaterialIDPass = std::make_unique<MaterialIDPass>(GetDevice(), m_CommonPasses);
-        m_MaterialIDPass->Init(*m_ShaderFactory, GBufferParams);
+            buildPass("DeferredLighting", [&]
+            {
+                passes->deferredLightingPass = std::make_unique<DeferredLightingPass>(GetDevice(), m_CommonPasses);
+                passes->deferredLightingPass->Init(m_ShaderFactory);
+            });
 
-        m_DeferredLightingPass = std::make_unique<DeferredLightingPass>(GetDevice(), m_CommonPasses);
-        m_DeferredLightingPass->Init(m_ShaderFactory);
+            buildPass("LightProbeProcessing", [&]
+            {
+                passes->lightProbePass = std::make_unique<LightProbeProcessingPass>(GetDevice(), m_ShaderFactory, m_CommonPasses);
+            });
 
-        m_SkyPass = std::make_unique<SkyPass>(GetDevice(), m_ShaderFactory, m_CommonPasses, m_RenderTargets->ForwardFramebuffer, *m_View);
+            buildPass("FXAA", [&]
+            {
+                passes->fxaaPass = std::make_unique<FXAAPass>(GetDevice(), m_ShaderFactory, m_CommonPasses);
+            });
+            buildPass("YUV", [&]
+            {
+                passes->yuvPass = std::make_shared<FullScreenYUVPass>(
+                    GetDevice(),
+                    m_ShaderFactory,
+                    m_CommonPasses,
+                    renderTargets->HdrFramebuffer,
+                    view
+                );
+            });
+            buildPass("PostProcess", [&]
+            {
+                passes->postProcessPass = std::make_unique<PostProcessPass>(GetDevice(), m_ShaderFactory, m_CommonPasses);
+            });
+        }
 
-        if (m_RenderTargets->GetSampleCount() == 1)
+        buildPass("Sky", [&]
         {
-            m_SsaoPass = std::make_unique<SsaoPass>(GetDevice(), m_ShaderFactory, m_CommonPasses, m_RenderTargets->Depth, m_RenderTargets->GBufferNormals, m_RenderTargets->AmbientOcclusion);
+            passes->skyPass = std::make_unique<SkyPass>(GetDevice(), m_ShaderFactory, m_CommonPasses, renderTargets->ForwardFramebuffer, view);
+        });
+
+        if (renderTargets->GetSampleCount() == 1)
+        {
+            buildPass("SSAO", [&]
+            {
+                passes->ssaoPass = std::make_unique<SsaoPass>(GetDevice(), m_ShaderFactory, m_CommonPasses, renderTargets->Depth, renderTargets->GBufferNormals, renderTargets->AmbientOcclusion);
+            });
         }
 
-        m_LightProbePass = std::make_unique<LightProbeProcessingPass>(GetDevice(), m_ShaderFactory, m_CommonPasses);
+        buildPass("ToneMapping", [&]
+        {
+            ToneMappingPass::CreateParameters toneMappingParams;
+            toneMappingParams.exposureBufferOverride = exposureBuffer;
+            passes->toneMappingPass = std::make_unique<ToneMappingPass>(GetDevice(), m_ShaderFactory, m_CommonPasses, renderTargets->LdrFramebuffer, view, toneMappingParams);
+        });
 
-        nvrhi::BufferHandle exposureBuffer = nullptr;
-        if (m_ToneMappingPass)
-            exposureBuffer = m_ToneMappingPass->GetExposureBuffer();
-        else
+        buildPass("Bloom", [&]
+        {
+            passes->bloomPass = std::make_unique<BloomPass>(GetDevice(), m_ShaderFactory, m_CommonPasses, renderTargets->ResolvedFramebuffer, view);
+        });
+
+        if (renderTargets->GetSampleCount() == 1)
+        {
+            buildPass("TAA", [&]
+            {
+                TemporalAntiAliasingPass::CreateParameters taaParams;
+                taaParams.sourceDepth = renderTargets->Depth;
+                taaParams.motionVectors = renderTargets->MotionVectors;
+                taaParams.unresolvedColor = renderTargets->HdrColor;
+                taaParams.resolvedColor = renderTargets->ResolvedColor;
+                taaParams.feedback1 = renderTargets->TemporalFeedback1;
+                taaParams.feedback2 = renderTargets->TemporalFeedback2;
+                taaParams.motionVectorStencilMask = motionVectorStencilMask;
+                taaParams.useCatmullRomFilter = true;
+                passes->temporalAntiAliasingPass = std::make_unique<TemporalAntiAliasingPass>(GetDevice(), m_ShaderFactory, m_CommonPasses, view, taaParams);
+            });
+        }
+
+        if (m_BindlessLayout && renderTargets->GetSampleCount() == 1)
+        {
+            buildPass("VisibilityBuffer", [&]
+            {
+                passes->visibilityBufferPass = std::make_unique<VisibilityBufferPass>(GetDevice(), m_ShaderFactory, m_CommonPasses,
+                    m_BindlessLayout, renderTargets->Depth, renderTargets->GBufferNormals->getDesc().format);
+            });
+        }
+
+        if (keepUnchangedPasses)
+            log::info("Shader reload: %u passes rebuilt, %u kept", uint32_t(passes->passShaders.size()), keptPasses);
+
+        return passes;
+    }
+
+    // Swaps a built set in between two frames
+    void ApplyRenderPasses(std::unique_ptr<RenderPassSet> passes, bool& exposureResetRequired)
+    {
+        bool renderTargetsChanged = m_RenderTargets != passes->renderTargets;
+        if (renderTargetsChanged)
+        {
+            m_RenderTargetPool->Release(std::move(m_RenderTargets));
+            m_RenderTargets = passes->renderTargets;
+            m_BindingCache->Clear();
+            if (m_DeferredLightingPass) m_DeferredLightingPass->ResetBindingCache();
+            if (m_ClusteredLightingPass) m_ClusteredLightingPass->ResetBindingCache();
+            if (m_FXAAPass) m_FXAAPass->ResetBindingCache();
+            if (m_YUVPass) m_YUVPass->ResetBindingCache();
+            if (m_PostProcessPass) m_PostProcessPass->ResetBindingCache();
+        }
+
+        if (passes->forwardPass) m_ForwardPass = std::move(passes->forwardPass);
+        if (passes->forwardIdPass) m_ForwardIDPass = std::move(passes->forwardIdPass);
+        if (passes->gbufferPass) m_GBufferPass = std::move(passes->gbufferPass);
+        if (passes->materialIdPass) m_MaterialIDPass = std::move(passes->materialIdPass);
+        if (passes->deferredLightingPass) m_DeferredLightingPass = std::move(passes->deferredLightingPass);
+        if (passes->lightProbePass) m_LightProbePass = std::move(passes->lightProbePass);
+        if (passes->fxaaPass) m_FXAAPass = std::move(passes->fxaaPass);
+        if (passes->yuvPass) m_YUVPass = std::move(passes->yuvPass);
+        if (passes->postProcessPass) m_PostProcessPass = std::move(passes->postProcessPass);
+
+        if (!m_ToneMappingPass)
             exposureResetRequired = true;
 
-        ToneMappingPass::CreateParameters toneMappingParams;
-        toneMappingParams.exposureBufferOverride = exposureBuffer;
-        m_ToneMappingPass = std::make_unique<ToneMappingPass>(GetDevice(), m_ShaderFactory, m_CommonPasses, m_RenderTargets->LdrFramebuffer, *m_View, toneMappingParams);
-
-        m_BloomPass = std::make_unique<BloomPass>(GetDevice(), m_ShaderFactory, m_CommonPasses, m_RenderTargets->ResolvedFramebuffer, *m_View);
-        m_FXAAPass = std::make_unique<FXAAPass>(
-            GetDevice(),
-            m_ShaderFactory,
-            m_CommonPasses,
-            m_RenderTargets->HdrFramebuffer,
-            *m_View
-        );
-        m_YUVPass = std::make_shared<FullScreenYUVPass>(
-            GetDevice(),
-            m_ShaderFactory,
-            m_CommonPasses,
-            m_RenderTargets->HdrFramebuffer,
-            *m_View
-        );
+        // The passes sized after the render targets are only left out of a set that keeps the targets
+        auto applyPass = [renderTargetsChanged](auto& current, auto& built)
+        {
+            if (built || renderTargetsChanged)
+                current = std::move(built);
+        };
+        applyPass(m_SkyPass, passes->skyPass);
+        applyPass(m_SsaoPass, passes->ssaoPass);
+        applyPass(m_ToneMappingPass, passes->toneMappingPass);
+        applyPass(m_BloomPass, passes->bloomPass);
+        applyPass(m_TemporalAntiAliasingPass, passes->temporalAntiAliasingPass);
+        applyPass(m_VisibilityBufferPass, passes->visibilityBufferPass);
+
+        for (auto& [name, blobs] : passes->passShaders)
+            m_PassShaders[name] = std::move(blobs);
 
         m_PreviousViewsValid = false;
     }
 
+    // Synchronous build of every pass for the current render targets, used at startup
+    void CreateRenderPasses(bool& exposureResetRequired)
+    {
+        nvrhi::BufferHandle exposureBuffer = m_ToneMappingPass ? m_ToneMappingPass->GetExposureBuffer() : nullptr;
+        ApplyRenderPasses(BuildRenderPasses(m_RenderTargets, m_RenderTargets->GetRenderSize(), true, false, *m_View, exposureBuffer), exposureResetRequired);
+    }
+
+    // Called at the start of every frame. Window resizes and shader reloads build new render targets and
+    // passes on the thread pool while the current ones keep rendering, and the finished set is swapped in
+    // at the start of a later frame. Only one build runs at a time, and it holds m_ShaderFactoryMutex so that it
+    // does not create shaders at the same time as the scene loading thread.
+    void UpdateRenderPasses(uint2 windowSize, bool& exposureResetRequired)
+    {
+        CPU_PROFILE_SCOPE("UpdateRenderPasses");
+
+        m_RenderTargetPool->Update();
+
+        if (m_RenderPassBuild && m_RenderPassBuild->IsDone())
+        {
+            m_RenderPassBuild = nullptr;
+            ApplyRenderPasses(std::move(m_BuiltRenderPasses), exposureResetRequired);
+        }
+
+        // Sizes that fit the current targets only move the viewport
+        if (!m_RenderTargets->IsUpdateRequired(windowSize, 1))
+        {
+            m_RenderTargets->SetDisplaySize(windowSize);
+            m_RenderTargets->SetRenderSize(GetScaledRenderSize(windowSize));
+        }
+
+        if (m_RenderPassBuild)
+            return;
+
+        if (m_ui.ShaderReloadRequested)
+        {
+            if (MountShaders())
+            {
+                std::lock_guard lock(m_ShaderFactoryMutex);
+                m_ShaderFactory->ClearCache();
+                m_AllPassesRebuildRequested = true;
+            }
+            m_ui.ShaderReloadRequested = false;
+        }
+
+        bool resized = m_RenderTargets->IsUpdateRequired(windowSize, 1);
+        if (!resized && !m_AllPassesRebuildRequested)
+            return;
+
+        bool allPasses = m_AllPassesRebuildRequested;
+        m_AllPassesRebuildRequested = false;
+
+        // A shader reload without a resize keeps the render targets, and with them every pass whose shaders
+        // did not change
+        std::shared_ptr<RenderTargets> renderTargets = resized ? nullptr : m_RenderTargets;
+        bool keepUnchangedPasses = !resized;
+
+        // The build gets its own copy of the view and of everything else it reads from this object
+        auto view = std::make_shared<PlanarView>(*m_View);
+        nvrhi::BufferHandle exposureBuffer = m_ToneMappingPass ? m_ToneMappingPass->GetExposureBuffer() : nullptr;
+
+        m_RenderPassBuild = m_ThreadPool->ParallelForAsync(1,
+            [this, renderTargets, windowSize, allPasses, keepUnchangedPasses, view, exposureBuffer](size_t)
+        {
+            CPU_PROFILE_SCOPE("BuildRenderPasses");
+            m_BuiltRenderPasses = BuildRenderPasses(renderTargets, windowSize, allPasses, keepUnchangedPasses, *view, exposureBuffer);
+        });
+    }
+
+    // Scales the sourceSize area at the top left corner of a render target to the whole window
+    void BlitToWindow(nvrhi::ICommandList* commandList, nvrhi::IFramebuffer* framebuffer, nvrhi::ITexture* texture, uint2 sourceSize)
+    {
+        engine::BlitParameters blitParams;
+        blitParams.targetFramebuffer = framebuffer;
+        blitParams.sourceTexture = texture;
+        blitParams.sourceBox.m_maxs = float2(sourceSize) / float2(m_RenderTargets->GetSize());
+        m_CommonPasses->BlitTexture(commandList, blitParams, m_BindingCache.get());
+    }
+
+    virtual void Render(nvrhi::IFramebuffer* framebuffer) override
+    {
+        // Textures decoded by the loading threads go up in a few large command lists before ApplicationBase
+        // looks at the queue; once the loading thread is done the rest is drained without a time limit
+        bool drain = IsSceneLoaded() && !m_ui.SceneLoadedStatus;
+        CPU_PROFILE_SCOPE("Render");
+        m_BatchedTextureCache->ProcessPendingUploads(*m_CommonPasses, drain ? 0.f : 20.f);
+
+        Super::Render(framebuffer);
+    }
+
     virtual void RenderSplashScreen(nvrhi::IFramebuffer* framebuffer) override
     {
+        CPU_PROFILE_SCOPE("RenderSplashScreen");
+
         if (!(IsSceneLoaded() && m_skipSplash))
         {
             int windowWidth, windowHeight;
@@ -478,34 +1090,13 @@ public:
 
             bool exposureResetRequired = false;
 
-            {
-                uint sampleCount = 1;
-                bool needNewPasses = false;
-
-                if (!m_RenderTargets || m_RenderTargets->IsUpdateRequired(uint2(windowWidth, windowHeight), sampleCount))
-                {
-                    m_RenderTargets = nullptr;
-                    m_BindingCache->Clear();
-                    m_RenderTargets = std::make_unique<RenderTargets>();
-                    m_RenderTargets->Init(GetDevice(), uint2(windowWidth, windowHeight), sampleCount, true, true);
-
-                    needNewPasses = true;
-                }
-
-                if (SetupView())
-                {
-                    needNewPasses = true;
-                }
-                if (needNewPasses)
-                {
-                    CreateRenderPasses(exposureResetRequired);
-                }
-            }
+            UpdateRenderPasses(uint2(windowWidth, windowHeight), exposureResetRequired);
+            SetupView();
 
             m_CommandList->open();
             m_VideoRenderer->PresentFrame(m_RenderTargets->HdrFramebuffer, m_CommandList);
             m_YUVPass->Render(m_CommandList, m_RenderTargets->HdrFramebuffer, *m_View, m_VideoRenderer->m_dynamicYUVSource);
-            m_CommonPasses->BlitTexture(m_CommandList, framebuffer, m_RenderTargets->HdrColor, m_BindingCache.get());
+            BlitToWindow(m_CommandList, framebuffer, m_RenderTargets->HdrColor, m_RenderTargets->GetRenderSize());
             m_CommandList->close();
 
             GetDevice()->executeCommandList(m_CommandList);
@@ -520,8 +1111,26 @@ public:
     }
 
 
+    IDrawStrategy& GetDrawStrategy(SceneList list, bool transparent)
+    {
+        SceneCommandList& sceneList = m_SceneCommandLists[list];
+        if (m_ui.EnableVisibilityCache)
+        {
+            return transparent
+                ? static_cast<IDrawStrategy&>(*sceneList.cachedTransparentDrawStrategy)
+                : static_cast<IDrawStrategy&>(*sceneList.cachedOpaqueDrawStrategy);
+        }
+
+        return transparent
+            ? static_cast<IDrawStrategy&>(*sceneList.transparentDrawStrategy)
+            : static_cast<IDrawStrategy&>(*sceneList.opaqueDrawStrategy);
+    }
+
     void RenderScene(nvrhi::IFramebuffer* framebuffer) override
     {
+        CPU_PROFILE_SCOPE("RenderScene");
+        auto renderStart = std::chrono::steady_clock::now();
+
         int windowWidth, windowHeight;
         GetDeviceManager()->GetWindowDimensions(windowWidth, windowHeight);
         nvrhi::Viewport windowViewport = nvrhi::Viewport(float(windowWidth), float(windowHeight));
@@ -529,46 +1138,33 @@ public:
 
         m_Scene->RefreshSceneGraph(GetFrameIndex());
 
-        bool exposureResetRequired = false;
+        // The single-pass shadows cull against the BVH of the visibility cache
+        bool singlePassShadows = m_ui.EnableShadows && m_ui.EnableSinglePassShadows && m_ShadowCascadePass;
 
+        if (m_ui.EnableVisibilityCache || singlePassShadows)
         {
-            uint width = windowWidth;
-            uint height = windowHeight;
-
-            uint sampleCount = 1;
-
-            bool needNewPasses = false;
-
-            if (!m_RenderTargets || m_RenderTargets->IsUpdateRequired(uint2(width, height), sampleCount))
-            {
-                m_RenderTargets = nullptr;
-                m_BindingCache->Clear();
-                m_RenderTargets = std::make_unique<RenderTargets>();
-                m_RenderTargets->Init(GetDevice(), uint2(width, height), sampleCount, true, true);
-
-                needNewPasses = true;
-            }
+            CPU_PROFILE_SCOPE("SceneVisibility");
+            m_SceneVisibility->BeginFrame(*m_Scene->GetSceneGraph());
 
-            if (SetupView())
-            {
-                needNewPasses = true;
-            }
+            const SceneVisibility::Stats& visibilityStats = m_SceneVisibility->GetStats();
+            m_ui.VisibilityCacheViews = visibilityStats.culledViews;
+            m_ui.VisibilityCacheRequests = visibilityStats.requests;
+        }
 
-            if (m_ui.ShaderReloadRequested)
-            {
-                m_ShaderFactory->ClearCache();
-                needNewPasses = true;
-            }
+        bool exposureResetRequired = false;
 
-            if (needNewPasses)
-            {
-                CreateRenderPasses(exposureResetRequired);
-            }
+        UpdateFrameGovernor();
+        const FrameGovernor::Limits& limits = m_FrameGovernor.GetLimits();
+        bool enableSsao = m_ui.EnableSsao && limits.allowSsao;
+        bool enableBloom = m_ui.EnableBloom && limits.allowBloom;
+        bool enableLightProbe = m_ui.EnableLightProbe && limits.allowLightProbes;
 
-            m_ui.ShaderReloadRequested = false;
-        }
+        UpdateRenderPasses(uint2(windowWidth, windowHeight), exposureResetRequired);
+        SetupView();
 
         m_CommandList->open();
+        // Starts on the first list and ends on the post-processing list, so it is not a GpuProfiler::Scope
+        m_GpuProfiler->BeginPass(m_CommandList, "Frame");
 
         m_Scene->RefreshBuffers(m_CommandList, GetFrameIndex());
 
@@ -577,6 +1173,32 @@ public:
 
         m_AmbientTop = m_ui.AmbientIntensity * m_ui.SkyParams.skyColor * m_ui.SkyParams.brightness;
         m_AmbientBottom = m_ui.AmbientIntensity * m_ui.SkyParams.groundColor * m_ui.SkyParams.brightness;
+
+        // Cached and newly compressed probes are uploaded ahead of the passes that read the probes
+        m_LightProbeCache->Update(m_CommandList, GetFrameIndex(), *m_LightProbeSHPass);
+
+        // Pending probe bakes advance by a few steps per frame, ahead of the passes that read the probes
+        if (m_LightProbeBaker->IsBaking() && m_LightProbePass)
+        {
+            CPU_PROFILE_SCOPE("LightProbeBaker");
+
+            LightProbeBaker::SceneInputs bakeInputs;
+            bakeInputs.rootNode = m_Scene->GetSceneGraph()->GetRootNode();
+            bakeInputs.lights = &m_Scene->GetSceneGraph()->GetLights();
+            bakeInputs.sunLight = m_SunLight.get();
+            bakeInputs.skyParams = &m_ui.SkyParams;
+            bakeInputs.ambientTop = m_AmbientTop;
+            bakeInputs.ambientBottom = m_AmbientBottom;
+            bakeInputs.csmExponent = m_ui.CsmExponent;
+
+            GpuProfiler::Scope gpuScope(*m_GpuProfiler, m_CommandList, "LightProbe");
+            m_LightProbeBaker->Update(m_CommandList, bakeInputs, *m_LightProbePass, *m_LightProbeSHPass, uint32_t(m_ui.LightProbeBakeSteps));
+        }
+        m_ui.LightProbeBakeProgress = m_LightProbeBaker->GetProgress();
+        m_ui.LightProbeBakesQueued = m_LightProbeBaker->GetQueuedCount() + (m_LightProbeBaker->GetCurrentProbe() ? 1 : 0);
+        m_ui.LightProbesCompressing = m_LightProbeCache->GetPendingCount();
+        m_ui.LightProbesCached = m_LightProbeCache->GetCachedProbeCount();
+
         if (m_ui.EnableShadows)
         {
             m_SunLight->shadowMap = m_ShadowMap;
@@ -590,18 +1212,25 @@ public:
             float zRange = length(sceneBounds.diagonal()) * 0.5f;
             m_ShadowMap->SetupForPlanarViewStable(*m_SunLight, projectionFrustum, viewMatrixInv, maxShadowDistance, zRange, zRange, m_ui.CsmExponent);
 
-            m_ShadowMap->Clear(m_CommandList);
-
-            DepthPass::Context context;
+            if (m_ShadowCascadePass)
+            {
+                const ShadowCascadePass::Stats& cascadeStats = m_ShadowCascadePass->GetStats();
+                m_ui.ShadowDraws = cascadeStats.draws;
+                m_ui.ShadowCascadeDraws = cascadeStats.cascadeDraws;
+                m_ShadowCascadePass->ResetStats();
+            }
 
-            RenderCompositeView(m_CommandList,
-                &m_ShadowMap->GetView(), nullptr,
-                *m_ShadowFramebuffer,
-                m_Scene->GetSceneGraph()->GetRootNode(),
-                *m_OpaqueDrawStrategy,
-                *m_ShadowDepthPass,
-                context,
-                "ShadowMap");
+            // The cache overwrites every cascade
+            if (m_ui.EnableShadowCache)
+            {
+                m_ShadowCache->UpdateInstances(*m_Scene->GetSceneGraph(), GetFrameIndex());
+                m_ui.ShadowCascadesRendered = m_ShadowCache->GetRenderedCascades();
+                m_ui.DynamicShadowCasters = m_ShadowCache->GetDynamicInstanceCount();
+            }
+            else
+            {
+                m_ShadowMap->Clear(m_CommandList);
+            }
         }
         else
         {
@@ -609,7 +1238,7 @@ public:
         }
 
         std::vector<std::shared_ptr<LightProbe>> lightProbes;
-        if (m_ui.EnableLightProbe)
+        if (enableLightProbe)
         {
             for (auto probe : m_LightProbes)
             {
@@ -622,101 +1251,249 @@ public:
             }
         }
 
+        // The clustered pass shades the local lights on top of the deferred lighting, which keeps the rest.
+        // The forward shaders take a fixed number of lights, so they get the nearest ones that touch the view.
+        const auto& sceneLights = m_Scene->GetSceneGraph()->GetLights();
+        bool clusteredLighting = m_ui.UseDeferredShading && m_ui.EnableClusteredLighting;
+
+        std::vector<std::shared_ptr<Light>> forwardLights;
+        ClusteredLightingPass::SelectForwardLights(*m_View, sceneLights, FORWARD_MAX_LIGHTS, forwardLights);
+
+        std::vector<std::shared_ptr<Light>> deferredLights;
+        if (clusteredLighting)
+        {
+            for (const auto& light : sceneLights)
+            {
+                if (!ClusteredLightingPass::IsClusteredLight(*light))
+                    deferredLights.push_back(light);
+            }
+        }
+
         m_RenderTargets->Clear(m_CommandList);
+        m_CommandList->clearTextureUInt(m_RenderTargets->MaterialIDs, nvrhi::AllSubresources, 0xffff);
 
         if (exposureResetRequired)
             m_ToneMappingPass->ResetExposure(m_CommandList, 0.5f);
 
-        ForwardShadingPass::Context forwardContext;
+        // Buffer updates and clears go first, in their own list
+        m_CommandList->close();
+
+        for (SceneCommandList& list : m_SceneCommandLists)
+            list.commandList->open();
 
-        if (!m_ui.UseDeferredShading || m_ui.EnableTranslucency)
+        nvrhi::ICommandList* opaqueList = m_SceneCommandLists[SceneList_Opaque].commandList;
+        nvrhi::ICommandList* lightingList = m_SceneCommandLists[SceneList_Lighting].commandList;
+        nvrhi::ICommandList* skyList = m_SceneCommandLists[SceneList_Sky].commandList;
+        nvrhi::ICommandList* transparentList = m_SceneCommandLists[SceneList_Transparent].commandList;
+        nvrhi::ICommandList* postList = m_SceneCommandLists[SceneList_Post].commandList;
+
+        // The geometry passes are recorded by pool tasks, each into its own list with its own context. Passes
+        // that share a pass object have to be recorded by the same task, as the passes cache binding sets
+        // without locking. The profiler queries are reserved here, in submission order, and written by the tasks.
+        std::vector<std::shared_ptr<TaskBatch>> recordings;
+        auto recordAsync = [this, &recordings](std::function<void()> record)
         {
-            m_ForwardPass->PrepareLights(forwardContext, m_CommandList, m_Scene->GetSceneGraph()->GetLights(), m_AmbientTop, m_AmbientBottom, lightProbes);
+            if (m_ui.EnableParallelRecording)
+                recordings.push_back(m_ThreadPool->ParallelForAsync(1, [record = std::move(record)](size_t) { record(); }));
+            else
+                record();
+        };
+
+        auto recordView = [this](SceneList list, nvrhi::ITimerQuery* query, const ICompositeView* view,
+            const ICompositeView* viewPrevious, FramebufferFactory& framebuffer, bool transparent,
+            IGeometryPass& pass, GeometryPassContext& context, const char* name)
+        {
+            CPU_PROFILE_SCOPE(name);
+
+            SceneCommandList& sceneList = m_SceneCommandLists[list];
+            IDrawStrategy& drawStrategy = GetDrawStrategy(list, transparent);
+
+            if (query)
+                sceneList.commandList->beginTimerQuery(query);
+
+            RenderCompositeView(sceneList.commandList,
+                view, viewPrevious,
+                framebuffer,
+                m_Scene->GetSceneGraph()->GetRootNode(),
+                drawStrategy,
+                pass,
+                context,
+                name);
+
+            if (query)
+                sceneList.commandList->endTimerQuery(query);
+        };
+
+        DepthPass::Context shadowContext;
+        GBufferFillPass::Context gbufferContext;
+        ForwardShadingPass::Context forwardOpaqueContext;
+        ForwardShadingPass::Context forwardTransparentContext;
+        MaterialIDPass::Context materialIdContext;
+
+        if (m_ui.EnableShadows)
+        {
+            nvrhi::ITimerQuery* shadowQuery = m_GpuProfiler->ReservePass("ShadowMap");
+            nvrhi::IDescriptorTable* descriptorTable = m_DescriptorTable ? m_DescriptorTable->GetDescriptorTable() : nullptr;
+            if (m_ui.EnableShadowCache || singlePassShadows)
+            {
+                recordAsync([&, shadowQuery, singlePassShadows, descriptorTable]
+                {
+                    CPU_PROFILE_SCOPE("ShadowMap");
+
+                    nvrhi::ICommandList* shadowList = m_SceneCommandLists[SceneList_Shadow].commandList;
+                    if (shadowQuery)
+                        shadowList->beginTimerQuery(shadowQuery);
+
+                    if (m_ui.EnableShadowCache && singlePassShadows)
+                    {
+                        m_ShadowCache->Render(shadowList, *m_ShadowCascadePass, *m_Scene, m_SceneVisibility->GetBVH(), descriptorTable);
+                    }
+                    else if (m_ui.EnableShadowCache)
+                    {
+                        m_ShadowCache->Render(shadowList, m_Scene->GetSceneGraph()->GetRootNode(),
+                            GetDrawStrategy(SceneList_Shadow, false), *m_ShadowDepthPass, shadowContext);
+                    }
+                    else
+                    {
+                        uint32_t allCascades = (1u << m_ShadowMap->GetNumberOfCascades()) - 1;
+                        m_ShadowCascadePass->Render(shadowList, *m_ShadowMap, m_ShadowMap->GetTexture(), allCascades,
+                            *m_Scene, m_SceneVisibility->GetBVH(), descriptorTable);
+                    }
+
+                    if (shadowQuery)
+                        shadowList->endTimerQuery(shadowQuery);
+                });
+            }
+            else
+            {
+                recordAsync([&, shadowQuery]
+                {
+                    recordView(SceneList_Shadow, shadowQuery, &m_ShadowMap->GetView(), nullptr, *m_ShadowFramebuffer,
+                        false, *m_ShadowDepthPass, shadowContext, "ShadowMap");
+                });
+            }
         }
 
+        // Volatile constant buffers have to be written in every list that uses them
+        if (!m_ui.UseDeferredShading)
+            m_ForwardIDPass->PrepareLights(forwardOpaqueContext, opaqueList, forwardLights, m_AmbientTop, m_AmbientBottom, lightProbes);
+        if (m_ui.EnableTranslucency)
+            m_ForwardPass->PrepareLights(forwardTransparentContext, transparentList, forwardLights, m_AmbientTop, m_AmbientBottom, lightProbes);
+
+        // The opaque pass writes MaterialIDs as well, except for the visibility buffer
         if (m_ui.UseDeferredShading)
         {
-            GBufferFillPass::Context gbufferContext;
+            // Replaces the GBuffer fill and writes a GBuffer of its own
+            bool visibilityBuffer = m_ui.EnableVisibilityBuffer && m_VisibilityBufferPass && m_SceneSupportsVisibilityBuffer;
+            if (visibilityBuffer)
+            {
+                nvrhi::ITimerQuery* visibilityQuery = m_GpuProfiler->ReservePass("VisibilityBuffer");
+                nvrhi::IDescriptorTable* descriptorTable = m_DescriptorTable->GetDescriptorTable();
+                recordAsync([&, visibilityQuery, descriptorTable]
+                {
+                    CPU_PROFILE_SCOPE("VisibilityBuffer");
 
-            RenderCompositeView(m_CommandList,
-                m_View.get(), m_ViewPrevious.get(),
-                *m_RenderTargets->GBufferFramebuffer,
-                m_Scene->GetSceneGraph()->GetRootNode(),
-                *m_OpaqueDrawStrategy,
-                *m_GBufferPass,
-                gbufferContext,
-                "GBufferFill");
+                    if (visibilityQuery)
+                        opaqueList->beginTimerQuery(visibilityQuery);
+
+                    m_VisibilityBufferPass->Render(opaqueList, *m_View->GetChildView(ViewType::PLANAR, 0), *m_Scene,
+                        GetDrawStrategy(SceneList_Opaque, false), descriptorTable);
+
+                    if (visibilityQuery)
+                        opaqueList->endTimerQuery(visibilityQuery);
+                });
+            }
+            else
+            {
+                nvrhi::ITimerQuery* gbufferQuery = m_GpuProfiler->ReservePass("GBufferFill");
+                recordAsync([&, gbufferQuery]
+                {
+                    recordView(SceneList_Opaque, gbufferQuery, m_View.get(), m_ViewPrevious.get(), *m_RenderTargets->GBufferFramebuffer,
+                        false, *m_GBufferPass, gbufferContext, "GBufferFill");
+                });
+            }
 
             nvrhi::ITexture* ambientOcclusionTarget = nullptr;
-            if (m_ui.EnableSsao && m_SsaoPass)
+            if (enableSsao && m_SsaoPass)
             {
-                m_SsaoPass->Render(m_CommandList, m_ui.SsaoParams, *m_View);
+                // SSAO is bound to the GBuffer normals
+                if (visibilityBuffer)
+                    lightingList->copyTexture(m_RenderTargets->GBufferNormals, nvrhi::TextureSlice(), m_VisibilityBufferPass->GetNormals(), nvrhi::TextureSlice());
+
+                GpuProfiler::Scope gpuScope(*m_GpuProfiler, lightingList, "SSAO");
+                m_SsaoPass->Render(lightingList, m_ui.SsaoParams, *m_View);
                 ambientOcclusionTarget = m_RenderTargets->AmbientOcclusion;
             }
 
             DeferredLightingPass::Inputs deferredInputs;
             deferredInputs.SetGBuffer(*m_RenderTargets);
-            deferredInputs.ambientOcclusion = m_ui.EnableSsao ? m_RenderTargets->AmbientOcclusion : nullptr;
+            deferredInputs.ambientOcclusion = ambientOcclusionTarget;
             deferredInputs.ambientColorTop = m_AmbientTop;
             deferredInputs.ambientColorBottom = m_AmbientBottom;
-            deferredInputs.lights = &m_Scene->GetSceneGraph()->GetLights();
-            deferredInputs.lightProbes = m_ui.EnableLightProbe ? &m_LightProbes : nullptr;
+            deferredInputs.lights = clusteredLighting ? &deferredLights : &sceneLights;
+            deferredInputs.lightProbes = enableLightProbe ? &m_LightProbes : nullptr;
             deferredInputs.output = m_RenderTargets->HdrColor;
+            if (visibilityBuffer)
+                m_VisibilityBufferPass->FillDeferredInputs(deferredInputs);
+
+            {
+                GpuProfiler::Scope gpuScope(*m_GpuProfiler, lightingList, "DeferredLighting");
+                m_DeferredLightingPass->Render(lightingList, *m_View, deferredInputs);
+            }
 
-            m_DeferredLightingPass->Render(m_CommandList, *m_View, deferredInputs);
+            if (clusteredLighting)
+            {
+                GpuProfiler::Scope gpuScope(*m_GpuProfiler, lightingList, "ClusteredLighting");
+                m_ClusteredLightingPass->Render(lightingList, *m_View, deferredInputs, sceneLights);
+            }
+            m_ui.ClusteredLights = clusteredLighting ? m_ClusteredLightingPass->GetStats().lights : 0;
         }
         else
         {
-            RenderCompositeView(m_CommandList,
-                m_View.get(), m_ViewPrevious.get(),
-                *m_RenderTargets->ForwardFramebuffer,
-                m_Scene->GetSceneGraph()->GetRootNode(),
-                *m_OpaqueDrawStrategy,
-                *m_ForwardPass,
-                forwardContext,
-                "ForwardOpaque");
+            nvrhi::ITimerQuery* forwardOpaqueQuery = m_GpuProfiler->ReservePass("ForwardOpaque");
+            recordAsync([&, forwardOpaqueQuery]
+            {
+                recordView(SceneList_Opaque, forwardOpaqueQuery, m_View.get(), m_ViewPrevious.get(), *m_RenderTargets->ForwardIDFramebuffer,
+                    false, *m_ForwardIDPass, forwardOpaqueContext, "ForwardOpaque");
+            });
         }
 
+        // The standalone pass is only needed for the IDs of translucent surfaces, which the geometry passes
+        // above do not write
+        if (m_ui.EnableMaterialIDPass)
         {
-            m_CommandList->clearTextureUInt(m_RenderTargets->MaterialIDs, nvrhi::AllSubresources, 0xffff);
-
-            MaterialIDPass::Context materialIdContext;
-
-            RenderCompositeView(m_CommandList,
-                m_View.get(), m_ViewPrevious.get(),
-                *m_RenderTargets->MaterialIDFramebuffer,
-                m_Scene->GetSceneGraph()->GetRootNode(),
-                *m_OpaqueDrawStrategy,
-                *m_MaterialIDPass,
-                materialIdContext,
-                "MaterialID");
+            nvrhi::ITimerQuery* materialIdQuery = m_GpuProfiler->ReservePass("MaterialID");
+            nvrhi::ITimerQuery* materialIdTranslucentQuery = m_ui.EnableTranslucency
+                ? m_GpuProfiler->ReservePass("MaterialID - Translucent") : nullptr;
+            bool translucency = m_ui.EnableTranslucency;
 
-            if (m_ui.EnableTranslucency)
+            recordAsync([&, materialIdQuery, materialIdTranslucentQuery, translucency]
             {
-                RenderCompositeView(m_CommandList,
-                    m_View.get(), m_ViewPrevious.get(),
-                    *m_RenderTargets->MaterialIDFramebuffer,
-                    m_Scene->GetSceneGraph()->GetRootNode(),
-                    *m_TransparentDrawStrategy,
-                    *m_MaterialIDPass,
-                    materialIdContext,
-                    "MaterialID - Translucent");
-            }
+                recordView(SceneList_MaterialID, materialIdQuery, m_View.get(), m_ViewPrevious.get(), *m_RenderTargets->MaterialIDFramebuffer,
+                    false, *m_MaterialIDPass, materialIdContext, "MaterialID");
+
+                if (translucency)
+                {
+                    recordView(SceneList_MaterialID, materialIdTranslucentQuery, m_View.get(), m_ViewPrevious.get(), *m_RenderTargets->MaterialIDFramebuffer,
+                        true, *m_MaterialIDPass, materialIdContext, "MaterialID - Translucent");
+                }
+            });
         }
 
         if (m_ui.EnableProceduralSky)
-            m_SkyPass->Render(m_CommandList, *m_View, *m_SunLight, m_ui.SkyParams);
+        {
+            GpuProfiler::Scope gpuScope(*m_GpuProfiler, skyList, "Sky");
+            m_SkyPass->Render(skyList, *m_View, *m_SunLight, m_ui.SkyParams);
+        }
 
         if (m_ui.EnableTranslucency)
         {
-            RenderCompositeView(m_CommandList,
-                m_View.get(), m_ViewPrevious.get(),
-                *m_RenderTargets->ForwardFramebuffer,
-                m_Scene->GetSceneGraph()->GetRootNode(),
-                *m_TransparentDrawStrategy,
-                *m_ForwardPass,
-                forwardContext,
-                "ForwardTransparent");
+            nvrhi::ITimerQuery* forwardTransparentQuery = m_GpuProfiler->ReservePass("ForwardTransparent");
+            recordAsync([&, forwardTransparentQuery]
+            {
+                recordView(SceneList_Transparent, forwardTransparentQuery, m_View.get(), m_ViewPrevious.get(), *m_RenderTargets->ForwardFramebuffer,
+                    true, *m_ForwardPass, forwardTransparentContext, "ForwardTransparent");
+            });
         }
 
         nvrhi::ITexture* finalHdrColor = m_RenderTargets->HdrColor;
@@ -726,41 +1503,87 @@ public:
         if (m_RenderTargets->GetSampleCount() > 1)
         {
             auto subresources = nvrhi::TextureSubresourceSet(0, 1, 0, 1);
-            m_CommandList->resolveTexture(m_RenderTargets->ResolvedColor, subresources, m_RenderTargets->HdrColor, subresources);
+            postList->resolveTexture(m_RenderTargets->ResolvedColor, subresources, m_RenderTargets->HdrColor, subresources);
             finalHdrColor = m_RenderTargets->ResolvedColor;
             finalHdrFramebuffer = m_RenderTargets->ResolvedFramebuffer;
         }
 
-        if (m_ui.EnableFXAA)
+        // The temporal resolve upscales to the display size, everything after it uses m_UpscaledView
+        bool temporalAntiAliasing = m_ui.EnableTAA && m_TemporalAntiAliasingPass;
+        if (temporalAntiAliasing)
         {
-            m_FXAAPass->Render(
-                m_CommandList,
-                finalHdrFramebuffer,
-                *m_View,
-                finalHdrColor
-            );
+            GpuProfiler::Scope gpuScope(*m_GpuProfiler, postList, "TAA");
+            if (m_PreviousViewsValid)
+                m_TemporalAntiAliasingPass->RenderMotionVectors(postList, *m_View, *m_ViewPrevious);
+
+            m_TemporalAntiAliasingPass->TemporalResolve(postList, m_ui.TemporalAntiAliasingParams, m_PreviousViewsValid, *m_View, *m_UpscaledView);
+            m_TemporalAntiAliasingPass->AdvanceFrame();
+
+            finalHdrColor = m_RenderTargets->ResolvedColor;
+            finalHdrFramebuffer = m_RenderTargets->ResolvedFramebuffer;
         }
 
-        if (m_ui.EnableBloom)
+        // TAA already anti-aliases the image
+        bool enableFXAA = m_ui.EnableFXAA && !temporalAntiAliasing;
+
+        // Without TAA a scaled down image is stretched over the window by the output pass
+        const PlanarView& postView = temporalAntiAliasing ? *m_UpscaledView : *m_View;
+        uint2 postSize = temporalAntiAliasing ? m_RenderTargets->GetDisplaySize() : m_RenderTargets->GetRenderSize();
+
+        if (enableBloom)
         {
-            m_BloomPass->Render(m_CommandList, finalHdrFramebuffer, *m_View, finalHdrColor, m_ui.BloomSigma, m_ui.BloomAlpha);
+            GpuProfiler::Scope gpuScope(*m_GpuProfiler, postList, "Bloom");
+            m_BloomPass->Render(postList, finalHdrFramebuffer, postView, finalHdrColor, m_ui.BloomSigma, m_ui.BloomAlpha);
         }
 
-        m_PreviousViewsValid = false;
-
         auto toneMappingParams = m_ui.ToneMappingParams;
         if (exposureResetRequired)
         {
             toneMappingParams.eyeAdaptationSpeedUp = 0.f;
             toneMappingParams.eyeAdaptationSpeedDown = 0.f;
         }
-        m_ToneMappingPass->SimpleRender(m_CommandList, toneMappingParams, *m_View, finalHdrColor);
 
-        m_CommonPasses->BlitTexture(m_CommandList, framebuffer, m_RenderTargets->LdrColor, m_BindingCache.get());
+        // The fused pass has no color LUT, a set LUT takes the ToneMappingPass chain
+        bool fusedPostProcess = m_ui.EnableFusedPostProcess && !toneMappingParams.colorLUT;
+        if (fusedPostProcess)
+        {
+            // Only the exposure is computed by ToneMappingPass; tone mapping, FXAA and the output to the
+            // window happen in one pass without going through LdrColor
+            {
+                GpuProfiler::Scope gpuScope(*m_GpuProfiler, postList, "Exposure");
+                m_ToneMappingPass->ResetHistogram(postList);
+                m_ToneMappingPass->AddFrameToHistogram(postList, postView, finalHdrColor);
+                m_ToneMappingPass->ComputeExposure(postList, toneMappingParams);
+            }
+
+            {
+                GpuProfiler::Scope gpuScope(*m_GpuProfiler, postList, "PostProcess");
+                m_PostProcessPass->Render(postList, framebuffer, finalHdrColor, postSize,
+                    m_ToneMappingPass->GetExposureBuffer(), toneMappingParams, enableFXAA);
+            }
+        }
+        else
+        {
+            {
+                GpuProfiler::Scope gpuScope(*m_GpuProfiler, postList, "ToneMapping");
+                m_ToneMappingPass->SimpleRender(postList, toneMappingParams, postView, finalHdrColor);
+            }
+
+            // FXAA runs on the tone mapped image and its output is blitted instead of LdrColor
+            nvrhi::ITexture* ldrOutput = m_RenderTargets->LdrColor;
+            if (enableFXAA)
+            {
+                GpuProfiler::Scope gpuScope(*m_GpuProfiler, postList, "FXAA");
+                ldrOutput = m_FXAAPass->Render(postList, postView, m_RenderTargets->LdrColor);
+            }
+
+            GpuProfiler::Scope gpuScope(*m_GpuProfiler, postList, "Blit");
+            BlitToWindow(postList, framebuffer, ldrOutput, postSize);
+        }
 
         if (m_ui.DisplayShadowMap)
         {
-            for (int cascade = 0; cascade < 4; cascade++)
+            for (int cascade = 0; cascade < m_ShadowMap->GetNumberOfCascades(); cascade++)
             {
                 nvrhi::Viewport viewport = nvrhi::Viewport(
                     10.f + 266.f * cascade,
@@ -774,16 +1597,29 @@ public:
                 blitParams.targetViewport = viewport;
                 blitParams.sourceTexture = m_ShadowMap->GetTexture();
                 blitParams.sourceArraySlice = cascade;
-                m_CommonPasses->BlitTexture(m_CommandList, blitParams, m_BindingCache.get());
+                m_CommonPasses->BlitTexture(postList, blitParams, m_BindingCache.get());
             }
         }
 
-        m_CommandList->close();
-        GetDevice()->executeCommandList(m_CommandList);
+        m_GpuProfiler->EndPass(postList);
+
+        for (const auto& recording : recordings)
+            recording->Wait();
+
+        std::vector<nvrhi::ICommandList*> commandLists = { m_CommandList };
+        for (SceneCommandList& list : m_SceneCommandLists)
+        {
+            list.commandList->close();
+            commandLists.push_back(list.commandList);
+        }
+        GetDevice()->executeCommandLists(commandLists.data(), commandLists.size());
 
         std::swap(m_View, m_ViewPrevious);
+        m_PreviousViewsValid = true;
 
         GetDeviceManager()->SetVsyncEnabled(m_ui.EnableVsync);
+
+        m_CpuFrameTime = m_AnimateCpuTime + std::chrono::duration<float>(std::chrono::steady_clock::now() - renderStart).count();
     }
 
     std::shared_ptr<Scene>& GetScene()
@@ -844,22 +1680,23 @@ public:
     {
         nvrhi::DeviceHandle device = GetDeviceManager()->GetDevice();
 
-        uint32_t diffuseMapSize = 256;
-        uint32_t diffuseMapMipLevels = 1;
+        // Expanded from L2 SH, which holds no detail that a larger map would show
+        uint32_t diffuseMapSize = 8;
         uint32_t specularMapSize = 512;
         uint32_t specularMapMipLevels = 8;
 
         nvrhi::TextureDesc cubemapDesc;
 
+        // The probes are only ever written by LightProbeCache: the diffuse maps by LightProbeSHPass, the
+        // specular maps with uploads of compressed data
         cubemapDesc.arraySize = 6 * numProbes;
         cubemapDesc.dimension = nvrhi::TextureDimension::TextureCubeArray;
-        cubemapDesc.isRenderTarget = true;
-        cubemapDesc.keepInitialState = true;
 
         cubemapDesc.width = diffuseMapSize;
         cubemapDesc.height = diffuseMapSize;
-        cubemapDesc.mipLevels = diffuseMapMipLevels;
+        cubemapDesc.mipLevels = 1;
         cubemapDesc.format = nvrhi::Format::RGBA16_FLOAT;
+        cubemapDesc.isUAV = true;
         cubemapDesc.initialState = nvrhi::ResourceStates::ShaderResource;
         cubemapDesc.keepInitialState = true;
 
@@ -868,7 +1705,8 @@ public:
         cubemapDesc.width = specularMapSize;
         cubemapDesc.height = specularMapSize;
         cubemapDesc.mipLevels = specularMapMipLevels;
-        cubemapDesc.format = nvrhi::Format::RGBA16_FLOAT;
+        cubemapDesc.format = nvrhi::Format::BC6H_UFLOAT;
+        cubemapDesc.isUAV = false;
         cubemapDesc.initialState = nvrhi::ResourceStates::ShaderResource;
         cubemapDesc.keepInitialState = true;
 
@@ -892,136 +1730,18 @@ public:
         }
     }
 
-    void RenderLightProbe(LightProbe& probe)
+    // Next to the executable, the scenes themselves are read from an archive
+    std::filesystem::path GetLightProbeCacheFile() const
     {
-        nvrhi::DeviceHandle device = GetDeviceManager()->GetDevice();
-
-        uint32_t environmentMapSize = 1024;
-        uint32_t environmentMapMipLevels = 8;
-
-        nvrhi::TextureDesc cubemapDesc;
-        cubemapDesc.arraySize = 6;
-        cubemapDesc.width = environmentMapSize;
-        cubemapDesc.height = environmentMapSize;
-        cubemapDesc.mipLevels = environmentMapMipLevels;
-        cubemapDesc.dimension = nvrhi::TextureDimension::TextureCube;
-        cubemapDesc.isRenderTarget = true;
-        cubemapDesc.format = nvrhi::Format::RGBA16_FLOAT;
-        cubemapDesc.initialState = nvrhi::ResourceStates::RenderTarget;
-        cubemapDesc.keepInitialState = true;
-        cubemapDesc.clearValue = nvrhi::Color(0.f);
-        cubemapDesc.useClearValue = true;
-
-        nvrhi::TextureHandle colorTexture = device->createTexture(cubemapDesc);
-
-        const nvrhi::Format depthFormats[] = {
-            nvrhi::Format::D24S8,
-            nvrhi::Format::D32,
-            nvrhi::Format::D16,
-            nvrhi::Format::D32S8 };
-
-        const nvrhi::FormatSupport depthFeatures =
-            nvrhi::FormatSupport::Texture |
-            nvrhi::FormatSupport::DepthStencil |
-            nvrhi::FormatSupport::ShaderLoad;
-
-        cubemapDesc.mipLevels = 1;
-        cubemapDesc.format = nvrhi::utils::ChooseFormat(GetDevice(), depthFeatures, depthFormats, std::size(depthFormats));
-        cubemapDesc.isTypeless = true;
-        cubemapDesc.initialState = nvrhi::ResourceStates::DepthWrite;
-
-        nvrhi::TextureHandle depthTexture = device->createTexture(cubemapDesc);
-
-        std::shared_ptr<FramebufferFactory> framebuffer = std::make_shared<FramebufferFactory>(device);
-        framebuffer->RenderTargets = { colorTexture };
-        framebuffer->DepthTarget = depthTexture;
+        std::string sceneName = std::filesystem::path(m_CurrentSceneName).stem().generic_string();
+        return app::GetDirectoryWithExecutable() / "ProbeCache" / (sceneName + ".yprobe");
+    }
 
-        CubemapView view;
-        view.SetArrayViewports(environmentMapSize, 0);
-        const float nearPlane = 0.1f;
-        const float cullDistance = 100.f;
+    void RenderLightProbe(const std::shared_ptr<LightProbe>& probe)
+    {
+        // Captured around the camera; the bake itself runs over the next frames
         float3 probePosition = m_Camera.GetWorldToViewMatrix().m_translation;
-
-        view.SetTransform(dm::translation(-probePosition), nearPlane, cullDistance);
-        view.UpdateCache();
-
-        std::shared_ptr<SkyPass> skyPass = std::make_shared<SkyPass>(device, m_ShaderFactory, m_CommonPasses, framebuffer, view);
-
-        ForwardShadingPass::CreateParameters ForwardParams;
-        ForwardParams.singlePassCubemap = GetDevice()->queryFeatureSupport(nvrhi::Feature::FastGeometryShader);
-        std::shared_ptr<ForwardShadingPass> forwardPass = std::make_shared<ForwardShadingPass>(device, m_CommonPasses);
-        forwardPass->Init(*m_ShaderFactory, ForwardParams);
-
-        nvrhi::CommandListHandle commandList = device->createCommandList();
-        commandList->open();
-        commandList->clearTextureFloat(colorTexture, nvrhi::AllSubresources, nvrhi::Color(0.f));
-
-        const nvrhi::FormatInfo& depthFormatInfo = nvrhi::getFormatInfo(depthTexture->getDesc().format);
-        commandList->clearDepthStencilTexture(depthTexture, nvrhi::AllSubresources, true, 0.f, depthFormatInfo.hasStencil, 0);
-
-        box3 sceneBounds = m_Scene->GetSceneGraph()->GetRootNode()->GetGlobalBoundingBox();
-        float zRange = length(sceneBounds.diagonal()) * 0.5f;
-        m_ShadowMap->SetupForCubemapView(*m_SunLight, view.GetViewOrigin(), cullDistance, zRange, zRange, m_ui.CsmExponent);
-        m_ShadowMap->Clear(commandList);
-
-        DepthPass::Context shadowContext;
-
-        RenderCompositeView(commandList,
-            &m_ShadowMap->GetView(), nullptr,
-            *m_ShadowFramebuffer,
-            m_Scene->GetSceneGraph()->GetRootNode(),
-            *m_OpaqueDrawStrategy,
-            *m_ShadowDepthPass,
-            shadowContext,
-            "ShadowMap");
-
-        ForwardShadingPass::Context forwardContext;
-
-        std::vector<std::shared_ptr<LightProbe>> lightProbes;
-        forwardPass->PrepareLights(forwardContext, commandList, m_Scene->GetSceneGraph()->GetLights(), m_AmbientTop, m_AmbientBottom, lightProbes);
-
-        RenderCompositeView(commandList,
-            &view, nullptr,
-            *framebuffer,
-            m_Scene->GetSceneGraph()->GetRootNode(),
-            *m_OpaqueDrawStrategy,
-            *forwardPass,
-            forwardContext,
-            "ForwardOpaque");
-
-        skyPass->Render(commandList, view, *m_SunLight, m_ui.SkyParams);
-
-        RenderCompositeView(commandList,
-            &view, nullptr,
-            *framebuffer,
-            m_Scene->GetSceneGraph()->GetRootNode(),
-            *m_TransparentDrawStrategy,
-            *forwardPass,
-            forwardContext,
-            "ForwardTransparent");
-
-        m_LightProbePass->GenerateCubemapMips(commandList, colorTexture, 0, 0, environmentMapMipLevels - 1);
-
-        m_LightProbePass->RenderDiffuseMap(commandList, colorTexture, nvrhi::AllSubresources, probe.diffuseMap, probe.diffuseArrayIndex * 6, 0);
-
-        uint32_t specularMapMipLevels = probe.specularMap->getDesc().mipLevels;
-        for (uint32_t mipLevel = 0; mipLevel < specularMapMipLevels; mipLevel++)
-        {
-            float roughness = powf(float(mipLevel) / float(specularMapMipLevels - 1), 2.0f);
-            m_LightProbePass->RenderSpecularMap(commandList, roughness, colorTexture, nvrhi::AllSubresources, probe.specularMap, probe.specularArrayIndex * 6, mipLevel);
-        }
-
-        m_LightProbePass->RenderEnvironmentBrdfTexture(commandList);
-
-        commandList->close();
-        device->executeCommandList(commandList);
-        device->waitForIdle();
-        device->runGarbageCollection();
-
-        probe.environmentBrdf = m_LightProbePass->GetEnvironmentBrdfTexture();
-        box3 bounds = box3(probePosition, probePosition).grow(10.f);
-        probe.bounds = frustum::fromBox(bounds);
-        probe.enabled = true;
+        m_LightProbeBaker->RequestBake(probe, probePosition);
     }
 };
 
@@ -1040,6 +1760,8 @@ int main(int __argc, const char** __argv)
     deviceParams.enableDebugRuntime = true;
     deviceParams.enableNvrhiValidationLayer = true;
 #endif
+    // Lets the single-pass shadow map select the cascade in the vertex shader
+    deviceParams.optionalVulkanDeviceExtensions.push_back("VK_EXT_shader_viewport_index_layer");
 
     if (!deviceManager->CreateWindowDeviceAndSwapChain(deviceParams, g_WindowTitle))
     {
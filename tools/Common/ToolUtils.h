@@ -0,0 +1,64 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Small helpers shared by the offline build tools (packer, cooker).
+
+// Runs func(index) for every index in [0, count) on up to threadCount threads, including the calling one.
+template<typename Func>
+void ParallelFor(size_t count, unsigned threadCount, Func&& func)
+{
+    std::atomic<size_t> next = 0;
+    auto worker = [&]()
+    {
+        for (size_t index = next++; index < count; index = next++)
+            func(index);
+    };
+
+    unsigned numThreads = std::max(1u, unsigned(std::min<size_t>(threadCount, count)));
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < numThreads; i++)
+        threads.emplace_back(worker);
+    worker();
+    for (auto& thread : threads)
+        thread.join();
+}
+
+inline bool ReadWholeFile(const std::filesystem::path& path, std::vector<uint8_t>& data)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+        return false;
+
+    data.resize(size_t(file.tellg()));
+    file.seekg(0);
+    return bool(file.read(reinterpret_cast<char*>(data.data()), std::streamsize(data.size())));
+}
+
+inline bool WriteWholeFile(const std::filesystem::path& path, const void* data, size_t size)
+{
+    std::error_code ec;
+    if (path.has_parent_path())
+        std::filesystem::create_directories(path.parent_path(), ec);
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+        return false;
+
+    file.write(static_cast<const char*>(data), std::streamsize(size));
+    return bool(file);
+}
+
+inline std::string ToLower(std::string s)
+{
+    std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+    return s;
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+
+// Streaming implementation of the 64-bit xxHash (https://github.com/Cyan4973/xxHash).
+// Used by the build tools to detect changed assets; not suitable for anything security related.
+class XXHash64
+{
+public:
+    explicit XXHash64(uint64_t seed = 0)
+    {
+        Reset(seed);
+    }
+
+    void Reset(uint64_t seed = 0)
+    {
+        m_State[0] = seed + Prime1 + Prime2;
+        m_State[1] = seed + Prime2;
+        m_State[2] = seed;
+        m_State[3] = seed - Prime1;
+        m_Seed = seed;
+        m_BufferSize = 0;
+        m_TotalLength = 0;
+    }
+
+    void Update(const void* data, size_t size)
+    {
+        const uint8_t* input = static_cast<const uint8_t*>(data);
+        const uint8_t* end = input + size;
+        m_TotalLength += size;
+
+        if (m_BufferSize + size < StripeSize)
+        {
+            memcpy(m_Buffer + m_BufferSize, input, size);
+            m_BufferSize += size;
+            return;
+        }
+
+        if (m_BufferSize > 0)
+        {
+            size_t fill = StripeSize - m_BufferSize;
+            memcpy(m_Buffer + m_BufferSize, input, fill);
+            input += fill;
+            ProcessStripe(m_Buffer);
+            m_BufferSize = 0;
+        }
+
+        while (input + StripeSize <= end)
+        {
+            ProcessStripe(input);
+            input += StripeSize;
+        }
+
+        m_BufferSize = size_t(end - input);
+        if (m_BufferSize > 0)
+            memcpy(m_Buffer, input, m_BufferSize);
+    }
+
+    [[nodiscard]] uint64_t Digest() const
+    {
+        uint64_t result;
+
+        if (m_TotalLength >= StripeSize)
+        {
+            result = RotateLeft(m_State[0], 1) + RotateLeft(m_State[1], 7) + RotateLeft(m_State[2], 12) + RotateLeft(m_State[3], 18);
+            for (uint64_t lane : m_State)
+                result = MergeRound(result, lane);
+        }
+        else
+        {
+            result = m_Seed + Prime5;
+        }
+
+        result += m_TotalLength;
+
+        const uint8_t* input = m_Buffer;
+        const uint8_t* end = m_Buffer + m_BufferSize;
+
+        while (input + 8 <= end)
+        {
+            result ^= Round(0, Read64(input));
+            result = RotateLeft(result, 27) * Prime1 + Prime4;
+            input += 8;
+        }
+
+        if (input + 4 <= end)
+        {
+            result ^= uint64_t(Read32(input)) * Prime1;
+            result = RotateLeft(result, 23) * Prime2 + Prime3;
+            input += 4;
+        }
+
+        while (input < end)
+        {
+            result ^= uint64_t(*input) * Prime5;
+            result = RotateLeft(result, 11) * Prime1;
+            ++input;
+        }
+
+        result ^= result >> 33;
+        result *= Prime2;
+        result ^= result >> 29;
+        result *= Prime3;
+        result ^= result >> 32;
+        return result;
+    }
+
+    static uint64_t Hash(const void* data, size_t size, uint64_t seed = 0)
+    {
+        XXHash64 hasher(seed);
+        hasher.Update(data, size);
+        return hasher.Digest();
+    }
+
+private:
+    static constexpr uint64_t Prime1 = 11400714785074694791ULL;
+    static constexpr uint64_t Prime2 = 14029467366897019727ULL;
+    static constexpr uint64_t Prime3 = 1609587929392839161ULL;
+    static constexpr uint64_t Prime4 = 9650029242287828579ULL;
+    static constexpr uint64_t Prime5 = 2870177450012600261ULL;
+    static constexpr size_t StripeSize = 32;
+
+    uint64_t m_State[4];
+    uint64_t m_Seed;
+    uint8_t m_Buffer[StripeSize];
+    size_t m_BufferSize;
+    uint64_t m_TotalLength;
+
+    static uint64_t RotateLeft(uint64_t x, int bits)
+    {
+        return (x << bits) | (x >> (64 - bits));
+    }
+
+    static uint64_t Read64(const uint8_t* p)
+    {
+        uint64_t value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    static uint32_t Read32(const uint8_t* p)
+    {
+        uint32_t value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    static uint64_t Round(uint64_t acc, uint64_t input)
+    {
+        acc += input * Prime2;
+        acc = RotateLeft(acc, 31);
+        return acc * Prime1;
+    }
+
+    static uint64_t MergeRound(uint64_t acc, uint64_t lane)
+    {
+        acc ^= Round(0, lane);
+        return acc * Prime1 + Prime4;
+    }
+
+    void ProcessStripe(const uint8_t* stripe)
+    {
+        m_State[0] = Round(m_State[0], Read64(stripe));
+        m_State[1] = Round(m_State[1], Read64(stripe + 8));
+        m_State[2] = Round(m_State[2], Read64(stripe + 16));
+        m_State[3] = Round(m_State[3], Read64(stripe + 24));
+    }
+};
@@ -0,0 +1,519 @@
+#include "BlockCompression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define YUP_COOKER_SSE2 1
+#endif
+
+namespace BlockCompression
+{
+    // Block pixels in structure-of-arrays layout, which is what the index search wants.
+    struct BlockSoA
+    {
+        alignas(16) float channel[4][16];
+    };
+
+    static void LoadBlock(const uint8_t* rgba, int channels, BlockSoA& block)
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            for (int c = 0; c < 4; c++)
+                block.channel[c][i] = c < channels ? float(rgba[i * 4 + c]) : 0.f;
+        }
+    }
+
+    static void ComputePrincipalAxis(const BlockSoA& block, int channels, float mean[4], float axis[4])
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            float sum = 0.f;
+            for (int i = 0; i < 16; i++)
+                sum += block.channel[c][i];
+            mean[c] = c < channels ? sum / 16.f : 0.f;
+        }
+
+        float covariance[4][4] = {};
+        for (int i = 0; i < 16; i++)
+        {
+            float d[4];
+            for (int c = 0; c < 4; c++)
+                d[c] = block.channel[c][i] - mean[c];
+
+            for (int a = 0; a < channels; a++)
+                for (int b = 0; b < channels; b++)
+                    covariance[a][b] += d[a] * d[b];
+        }
+
+        // Power iteration, seeded with the diagonal of the bounding box
+        float minValue[4], maxValue[4];
+        for (int c = 0; c < 4; c++)
+        {
+            minValue[c] = *std::min_element(block.channel[c], block.channel[c] + 16);
+            maxValue[c] = *std::max_element(block.channel[c], block.channel[c] + 16);
+            axis[c] = c < channels ? maxValue[c] - minValue[c] : 0.f;
+        }
+
+        for (int iteration = 0; iteration < 8; iteration++)
+        {
+            float next[4] = {};
+            for (int a = 0; a < channels; a++)
+                for (int b = 0; b < channels; b++)
+                    next[a] += covariance[a][b] * axis[b];
+
+            float length = 0.f;
+            for (int c = 0; c < channels; c++)
+                length = std::max(length, std::abs(next[c]));
+
+            if (length < 1e-6f)
+                break;
+
+            for (int c = 0; c < 4; c++)
+                axis[c] = next[c] / length;
+        }
+
+        float length = 0.f;
+        for (int c = 0; c < channels; c++)
+            length += axis[c] * axis[c];
+
+        if (length < 1e-12f)
+        {
+            for (int c = 0; c < 4; c++)
+                axis[c] = c < channels ? 1.f : 0.f;
+            length = float(channels);
+        }
+
+        float invLength = 1.f / std::sqrt(length);
+        for (int c = 0; c < 4; c++)
+            axis[c] *= invLength;
+    }
+
+    // Fits the two endpoints to the extents of the block along its principal axis.
+    static void FitEndpoints(const BlockSoA& block, int channels, float endpoint0[4], float endpoint1[4])
+    {
+        float mean[4], axis[4];
+        ComputePrincipalAxis(block, channels, mean, axis);
+
+        float minT = std::numeric_limits<float>::max();
+        float maxT = -std::numeric_limits<float>::max();
+        for (int i = 0; i < 16; i++)
+        {
+            float t = 0.f;
+            for (int c = 0; c < channels; c++)
+                t += (block.channel[c][i] - mean[c]) * axis[c];
+            minT = std::min(minT, t);
+            maxT = std::max(maxT, t);
+        }
+
+        for (int c = 0; c < 4; c++)
+        {
+            endpoint0[c] = std::clamp(mean[c] + axis[c] * maxT, 0.f, 255.f);
+            endpoint1[c] = std::clamp(mean[c] + axis[c] * minT, 0.f, 255.f);
+        }
+    }
+
+    // Picks the closest palette entry for every pixel, returns the total squared error.
+    static float SelectIndices(const BlockSoA& block, const float palette[][4], int paletteSize, uint8_t indices[16])
+    {
+#ifdef YUP_COOKER_SSE2
+        __m128 totalError = _mm_setzero_ps();
+
+        for (int i = 0; i < 16; i += 4)
+        {
+            __m128 r = _mm_load_ps(block.channel[0] + i);
+            __m128 g = _mm_load_ps(block.channel[1] + i);
+            __m128 b = _mm_load_ps(block.channel[2] + i);
+            __m128 a = _mm_load_ps(block.channel[3] + i);
+
+            __m128 bestError = _mm_set1_ps(std::numeric_limits<float>::max());
+            __m128i bestIndex = _mm_setzero_si128();
+
+            for (int p = 0; p < paletteSize; p++)
+            {
+                __m128 dr = _mm_sub_ps(r, _mm_set1_ps(palette[p][0]));
+                __m128 dg = _mm_sub_ps(g, _mm_set1_ps(palette[p][1]));
+                __m128 db = _mm_sub_ps(b, _mm_set1_ps(palette[p][2]));
+                __m128 da = _mm_sub_ps(a, _mm_set1_ps(palette[p][3]));
+                __m128 error = _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)),
+                    _mm_add_ps(_mm_mul_ps(db, db), _mm_mul_ps(da, da)));
+
+                __m128i better = _mm_castps_si128(_mm_cmplt_ps(error, bestError));
+                bestError = _mm_min_ps(error, bestError);
+                bestIndex = _mm_or_si128(_mm_and_si128(better, _mm_set1_epi32(p)), _mm_andnot_si128(better, bestIndex));
+            }
+
+            alignas(16) int32_t lanes[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(lanes), bestIndex);
+            for (int lane = 0; lane < 4; lane++)
+                indices[i + lane] = uint8_t(lanes[lane]);
+
+            totalError = _mm_add_ps(totalError, bestError);
+        }
+
+        alignas(16) float sums[4];
+        _mm_store_ps(sums, totalError);
+        return sums[0] + sums[1] + sums[2] + sums[3];
+#else
+        float totalError = 0.f;
+
+        for (int i = 0; i < 16; i++)
+        {
+            float bestError = std::numeric_limits<float>::max();
+            int bestIndex = 0;
+
+            for (int p = 0; p < paletteSize; p++)
+            {
+                float error = 0.f;
+                for (int c = 0; c < 4; c++)
+                {
+                    float d = block.channel[c][i] - palette[p][c];
+                    error += d * d;
+                }
+
+                if (error < bestError)
+                {
+                    bestError = error;
+                    bestIndex = p;
+                }
+            }
+
+            indices[i] = uint8_t(bestIndex);
+            totalError += bestError;
+        }
+
+        return totalError;
+#endif
+    }
+
+    // Least squares refit of both endpoints given the current indices and the weight of endpoint 0 per index.
+    static bool RefitEndpoints(const BlockSoA& block, int channels, const uint8_t indices[16], const float* weights, float endpoint0[4], float endpoint1[4])
+    {
+        float aa = 0.f, ab = 0.f, bb = 0.f;
+        float ax[4] = {}, bx[4] = {};
+
+        for (int i = 0; i < 16; i++)
+        {
+            float w0 = weights[indices[i]];
+            float w1 = 1.f - w0;
+            aa += w0 * w0;
+            ab += w0 * w1;
+            bb += w1 * w1;
+            for (int c = 0; c < channels; c++)
+            {
+                ax[c] += w0 * block.channel[c][i];
+                bx[c] += w1 * block.channel[c][i];
+            }
+        }
+
+        float det = aa * bb - ab * ab;
+        if (std::abs(det) < 1e-6f)
+            return false;
+
+        float invDet = 1.f / det;
+        for (int c = 0; c < channels; c++)
+        {
+            endpoint0[c] = std::clamp((bb * ax[c] - ab * bx[c]) * invDet, 0.f, 255.f);
+            endpoint1[c] = std::clamp((aa * bx[c] - ab * ax[c]) * invDet, 0.f, 255.f);
+        }
+
+        return true;
+    }
+
+    class BitWriter
+    {
+    public:
+        explicit BitWriter(uint8_t* output)
+            : m_Output(output)
+        {
+            memset(m_Output, 0, 16);
+        }
+
+        void Write(uint32_t value, int bits)
+        {
+            for (int i = 0; i < bits; i++, m_Position++)
+            {
+                if (value & (1u << i))
+                    m_Output[m_Position >> 3] |= uint8_t(1u << (m_Position & 7));
+            }
+        }
+
+    private:
+        uint8_t* m_Output;
+        int m_Position = 0;
+    };
+
+    // BC1 -----------------------------------------------------------------------------------------
+
+    static uint16_t Quantize565(const float color[4])
+    {
+        uint32_t r = uint32_t(color[0] * 31.f / 255.f + 0.5f);
+        uint32_t g = uint32_t(color[1] * 63.f / 255.f + 0.5f);
+        uint32_t b = uint32_t(color[2] * 31.f / 255.f + 0.5f);
+        return uint16_t((std::min(r, 31u) << 11) | (std::min(g, 63u) << 5) | std::min(b, 31u));
+    }
+
+    static void Dequantize565(uint16_t packed, float color[4])
+    {
+        uint32_t r = (packed >> 11) & 31;
+        uint32_t g = (packed >> 5) & 63;
+        uint32_t b = packed & 31;
+        color[0] = float((r << 3) | (r >> 2));
+        color[1] = float((g << 2) | (g >> 4));
+        color[2] = float((b << 3) | (b >> 2));
+        color[3] = 0.f;
+    }
+
+    static float EvaluateBC1(const BlockSoA& block, uint16_t c0, uint16_t c1, uint8_t indices[16])
+    {
+        float palette[4][4];
+        Dequantize565(c0, palette[0]);
+        Dequantize565(c1, palette[1]);
+        for (int c = 0; c < 4; c++)
+        {
+            palette[2][c] = (2.f * palette[0][c] + palette[1][c]) / 3.f;
+            palette[3][c] = (palette[0][c] + 2.f * palette[1][c]) / 3.f;
+        }
+
+        return SelectIndices(block, palette, c0 == c1 ? 1 : 4, indices);
+    }
+
+    static void EncodeColorBlock(const BlockSoA& block, uint8_t* output)
+    {
+        static const float weights[4] = { 1.f, 0.f, 2.f / 3.f, 1.f / 3.f };
+
+        float endpoint0[4], endpoint1[4];
+        FitEndpoints(block, 3, endpoint0, endpoint1);
+
+        uint16_t c0 = Quantize565(endpoint0);
+        uint16_t c1 = Quantize565(endpoint1);
+        uint8_t indices[16];
+        float error = EvaluateBC1(block, c0, c1, indices);
+
+        for (int iteration = 0; iteration < 2 && error > 0.f; iteration++)
+        {
+            if (!RefitEndpoints(block, 3, indices, weights, endpoint0, endpoint1))
+                break;
+
+            uint16_t r0 = Quantize565(endpoint0);
+            uint16_t r1 = Quantize565(endpoint1);
+            uint8_t refitIndices[16];
+            float refitError = EvaluateBC1(block, r0, r1, refitIndices);
+            if (refitError >= error)
+                break;
+
+            c0 = r0;
+            c1 = r1;
+            error = refitError;
+            memcpy(indices, refitIndices, sizeof(indices));
+        }
+
+        // Four color mode requires c0 > c1
+        if (c0 < c1)
+        {
+            std::swap(c0, c1);
+            static const uint8_t remap[4] = { 1, 0, 3, 2 };
+            for (uint8_t& index : indices)
+                index = remap[index];
+        }
+        else if (c0 == c1)
+        {
+            memset(indices, 0, sizeof(indices));
+        }
+
+        uint32_t packedIndices = 0;
+        for (int i = 0; i < 16; i++)
+            packedIndices |= uint32_t(indices[i]) << (i * 2);
+
+        output[0] = uint8_t(c0);
+        output[1] = uint8_t(c0 >> 8);
+        output[2] = uint8_t(c1);
+        output[3] = uint8_t(c1 >> 8);
+        memcpy(output + 4, &packedIndices, 4);
+    }
+
+    // BC4 - single channel block, also used for BC3 alpha and the two BC5 channels -----------------
+
+    static void EncodeSingleChannel(const uint8_t* rgba, int channel, uint8_t* output)
+    {
+        uint8_t values[16];
+        for (int i = 0; i < 16; i++)
+            values[i] = rgba[i * 4 + channel];
+
+        uint8_t maxValue = *std::max_element(values, values + 16);
+        uint8_t minValue = *std::min_element(values, values + 16);
+
+        output[0] = maxValue;
+        output[1] = minValue;
+
+        uint64_t packedIndices = 0;
+        if (maxValue != minValue)
+        {
+            // Eight value mode: index 0 = max, 1 = min, 2..7 interpolate from max towards min
+            float scale = 7.f / float(maxValue - minValue);
+            for (int i = 0; i < 16; i++)
+            {
+                int t = int(float(maxValue - values[i]) * scale + 0.5f);
+                uint64_t index = t == 0 ? 0 : (t == 7 ? 1 : uint64_t(t + 1));
+                packedIndices |= index << (i * 3);
+            }
+        }
+
+        for (int i = 0; i < 6; i++)
+            output[2 + i] = uint8_t(packedIndices >> (i * 8));
+    }
+
+    // BC7 mode 6 -----------------------------------------------------------------------------------
+
+    static const int g_Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    struct Mode6Endpoints
+    {
+        uint8_t color[2][4];    // 7 bit per channel
+        uint8_t pbit[2];
+    };
+
+    static void QuantizeMode6Endpoint(const float endpoint[4], uint8_t color[4], uint8_t& pbit)
+    {
+        float bestError = std::numeric_limits<float>::max();
+
+        for (int p = 0; p < 2; p++)
+        {
+            uint8_t candidate[4];
+            float error = 0.f;
+            for (int c = 0; c < 4; c++)
+            {
+                int q = std::clamp(int((endpoint[c] - float(p)) * 0.5f + 0.5f), 0, 127);
+                candidate[c] = uint8_t(q);
+                float d = float((q << 1) | p) - endpoint[c];
+                error += d * d;
+            }
+
+            if (error < bestError)
+            {
+                bestError = error;
+                pbit = uint8_t(p);
+                memcpy(color, candidate, 4);
+            }
+        }
+    }
+
+    static float EvaluateMode6(const BlockSoA& block, const Mode6Endpoints& endpoints, uint8_t indices[16])
+    {
+        float palette[16][4];
+        for (int c = 0; c < 4; c++)
+        {
+            int e0 = (endpoints.color[0][c] << 1) | endpoints.pbit[0];
+            int e1 = (endpoints.color[1][c] << 1) | endpoints.pbit[1];
+            for (int i = 0; i < 16; i++)
+                palette[i][c] = float(((64 - g_Weights4[i]) * e0 + g_Weights4[i] * e1 + 32) >> 6);
+        }
+
+        return SelectIndices(block, palette, 16, indices);
+    }
+
+    void EncodeBC1(const uint8_t* rgba, uint8_t* output)
+    {
+        BlockSoA block;
+        LoadBlock(rgba, 3, block);
+        EncodeColorBlock(block, output);
+    }
+
+    void EncodeBC3(const uint8_t* rgba, uint8_t* output)
+    {
+        EncodeSingleChannel(rgba, 3, output);
+
+        BlockSoA block;
+        LoadBlock(rgba, 3, block);
+        EncodeColorBlock(block, output + 8);
+    }
+
+    void EncodeBC5(const uint8_t* rgba, uint8_t* output)
+    {
+        EncodeSingleChannel(rgba, 0, output);
+        EncodeSingleChannel(rgba, 1, output + 8);
+    }
+
+    void EncodeBC7(const uint8_t* rgba, uint8_t* output)
+    {
+        // Weight of endpoint 0 for every index
+        static const float weights[16] = {
+            64.f / 64.f, 60.f / 64.f, 55.f / 64.f, 51.f / 64.f, 47.f / 64.f, 43.f / 64.f, 38.f / 64.f, 34.f / 64.f,
+            30.f / 64.f, 26.f / 64.f, 21.f / 64.f, 17.f / 64.f, 13.f / 64.f, 9.f / 64.f, 4.f / 64.f, 0.f / 64.f
+        };
+
+        BlockSoA block;
+        LoadBlock(rgba, 4, block);
+
+        float endpoint0[4], endpoint1[4];
+        FitEndpoints(block, 4, endpoint0, endpoint1);
+
+        Mode6Endpoints endpoints;
+        QuantizeMode6Endpoint(endpoint0, endpoints.color[0], endpoints.pbit[0]);
+        QuantizeMode6Endpoint(endpoint1, endpoints.color[1], endpoints.pbit[1]);
+
+        uint8_t indices[16];
+        float error = EvaluateMode6(block, endpoints, indices);
+
+        for (int iteration = 0; iteration < 2 && error > 0.f; iteration++)
+        {
+            if (!RefitEndpoints(block, 4, indices, weights, endpoint0, endpoint1))
+                break;
+
+            Mode6Endpoints refit;
+            QuantizeMode6Endpoint(endpoint0, refit.color[0], refit.pbit[0]);
+            QuantizeMode6Endpoint(endpoint1, refit.color[1], refit.pbit[1]);
+
+            uint8_t refitIndices[16];
+            float refitError = EvaluateMode6(block, refit, refitIndices);
+            if (refitError >= error)
+                break;
+
+            endpoints = refit;
+            error = refitError;
+            memcpy(indices, refitIndices, sizeof(indices));
+        }
+
+        // The anchor index (pixel 0) is stored with an implicit zero MSB
+        if (indices[0] & 8)
+        {
+            std::swap(endpoints.color[0], endpoints.color[1]);
+            std::swap(endpoints.pbit[0], endpoints.pbit[1]);
+            for (uint8_t& index : indices)
+                index = uint8_t(15 - index);
+        }
+
+        BitWriter writer(output);
+        writer.Write(1u << 6, 7);
+        for (int c = 0; c < 4; c++)
+        {
+            writer.Write(endpoints.color[0][c], 7);
+            writer.Write(endpoints.color[1][c], 7);
+        }
+        writer.Write(endpoints.pbit[0], 1);
+        writer.Write(endpoints.pbit[1], 1);
+        writer.Write(indices[0], 3);
+        for (int i = 1; i < 16; i++)
+            writer.Write(indices[i], 4);
+    }
+
+    uint32_t GetBlockSize(Format format)
+    {
+        return format == Format::BC1 ? 8 : 16;
+    }
+
+    void EncodeBlock(Format format, const uint8_t* rgba, uint8_t* output)
+    {
+        switch (format)
+        {
+        case Format::BC1: EncodeBC1(rgba, output); break;
+        case Format::BC3: EncodeBC3(rgba, output); break;
+        case Format::BC5: EncodeBC5(rgba, output); break;
+        case Format::BC7: EncodeBC7(rgba, output); break;
+        }
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+
+// CPU block compressors used by the texture cooker. All encoders take a 4x4 block of RGBA8 pixels
+// (row-major, 64 bytes) and write one compressed block. They are reentrant and can be called from
+// any number of threads.
+namespace BlockCompression
+{
+    enum class Format
+    {
+        BC1,    // RGB, 1-bit alpha unused, 8 bytes per block
+        BC3,    // RGBA, interpolated alpha, 16 bytes per block
+        BC5,    // Two channels (RG), 16 bytes per block
+        BC7     // RGBA, mode 6 only, 16 bytes per block
+    };
+
+    uint32_t GetBlockSize(Format format);
+
+    void EncodeBC1(const uint8_t* rgba, uint8_t* output);
+    void EncodeBC3(const uint8_t* rgba, uint8_t* output);
+    void EncodeBC5(const uint8_t* rgba, uint8_t* output);
+    void EncodeBC7(const uint8_t* rgba, uint8_t* output);
+
+    void EncodeBlock(Format format, const uint8_t* rgba, uint8_t* output);
+}
@@ -0,0 +1,1057 @@
+#include "MeshCooker.h"
+#include "../Common/ToolUtils.h"
+#include "../Common/XXHash64.h"
+#include "../../src/UriUtils.h"
+#include "../../src/YMeshFormat.h"
+
+#include <json/json.h>
+
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <set>
+
+namespace fs = std::filesystem;
+
+struct Float3
+{
+    float x = 0.f, y = 0.f, z = 0.f;
+};
+
+static bool DecodeBase64(const std::string& text, std::vector<uint8_t>& output)
+{
+    auto decodeChar = [](char c) -> int
+    {
+        if (c >= 'A' && c <= 'Z') return c - 'A';
+        if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+        if (c >= '0' && c <= '9') return c - '0' + 52;
+        if (c == '+') return 62;
+        if (c == '/') return 63;
+        return -1;
+    };
+
+    uint32_t accumulator = 0;
+    int bits = 0;
+    for (char c : text)
+    {
+        if (c == '=')
+            break;
+        int value = decodeChar(c);
+        if (value < 0)
+            return false;
+        accumulator = (accumulator << 6) | uint32_t(value);
+        bits += 6;
+        if (bits >= 8)
+        {
+            bits -= 8;
+            output.push_back(uint8_t(accumulator >> bits));
+        }
+    }
+    return true;
+}
+
+// Matches donut::math::vectorToSnorm8, which is how donut's glTF importer stores normals and tangents
+static uint32_t VectorToSnorm8(float x, float y, float z, float w)
+{
+    auto pack = [](float v) { return uint32_t(int(std::round(std::clamp(v, -1.f, 1.f) * 127.f))) & 0xff; };
+    return pack(x) | (pack(y) << 8) | (pack(z) << 16) | (pack(w) << 24);
+}
+
+class SceneCooker
+{
+public:
+    SceneCooker(const fs::path& gltfPath, const fs::path& bufferDir)
+        : m_GltfPath(gltfPath)
+        , m_BufferDir(bufferDir)
+    { }
+
+    bool Load();
+    bool Cook(std::vector<uint8_t>& output);
+
+    [[nodiscard]] const std::string& GetError() const { return m_Error; }
+    [[nodiscard]] uint64_t GetSourceHash() const { return m_SourceHash; }
+
+private:
+    fs::path m_GltfPath;
+    fs::path m_BufferDir;
+    Json::Value m_Root;
+    std::vector<std::vector<uint8_t>> m_Buffers;
+    uint64_t m_SourceHash = 0;
+    std::string m_Error;
+
+    std::string m_Strings;
+    std::map<std::string, uint32_t> m_StringOffsets;
+    std::map<std::pair<std::string, bool>, uint32_t> m_TextureIndices;
+
+    std::vector<ymesh::TextureRecord> m_Textures;
+    std::vector<ymesh::MaterialRecord> m_Materials;
+    std::vector<ymesh::MeshRecord> m_Meshes;
+    std::vector<ymesh::GeometryRecord> m_Geometries;
+    std::vector<ymesh::NodeRecord> m_Nodes;
+    std::vector<ymesh::LightRecord> m_Lights;
+    std::vector<ymesh::CameraRecord> m_Cameras;
+    std::vector<ymesh::AnimationRecord> m_Animations;
+    std::vector<ymesh::ChannelRecord> m_Channels;
+    std::vector<ymesh::KeyframeRecord> m_Keyframes;
+    std::map<uint32_t, uint32_t> m_NodeRemap;
+    uint32_t m_DefaultMaterial = ymesh::c_InvalidIndex;
+
+    std::vector<uint32_t> m_Indices;
+    std::vector<Float3> m_Positions;
+    std::vector<uint32_t> m_Normals;
+    std::vector<uint32_t> m_Tangents;
+    std::vector<float> m_TexCoords1;
+    std::vector<float> m_TexCoords2;
+    bool m_HasNormals = false;
+    bool m_HasTangents = false;
+    bool m_HasTexCoord1 = false;
+    bool m_HasTexCoord2 = false;
+
+    bool Fail(const std::string& message)
+    {
+        m_Error = message;
+        return false;
+    }
+
+    uint32_t AddString(const std::string& s);
+    uint32_t AddTexture(const Json::Value& textureInfo, bool sRGB);
+    bool ReadAccessor(const Json::Value& accessorIndex, uint32_t components, std::vector<float>& values, uint32_t& count);
+    bool ReadIndices(const Json::Value& accessorIndex, std::vector<uint32_t>& indices);
+    bool CookMaterials();
+    bool CookMeshes();
+    bool CookPrimitive(const Json::Value& primitive, uint32_t meshVertexOffset, uint32_t meshIndexOffset);
+    bool CookNodes();
+    bool CookNode(uint32_t gltfIndex, uint32_t parent);
+    bool CookAnimations();
+    void Write(std::vector<uint8_t>& output);
+};
+
+bool SceneCooker::Load()
+{
+    std::vector<uint8_t> gltfText;
+    if (!ReadWholeFile(m_GltfPath, gltfText))
+        return Fail("cannot read the file");
+
+    Json::CharReaderBuilder builder;
+    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+    std::string errors;
+    const char* begin = reinterpret_cast<const char*>(gltfText.data());
+    if (!reader->parse(begin, begin + gltfText.size(), &m_Root, &errors))
+        return Fail(errors);
+
+    XXHash64 hasher;
+    uint32_t version = ymesh::c_Version;
+    hasher.Update(&version, sizeof(version));
+    hasher.Update(gltfText.data(), gltfText.size());
+
+    for (const Json::Value& buffer : m_Root["buffers"])
+    {
+        std::vector<uint8_t>& data = m_Buffers.emplace_back();
+        std::string uri = buffer["uri"].asString();
+
+        if (uri.rfind("data:", 0) == 0)
+        {
+            size_t comma = uri.find(";base64,");
+            if (comma == std::string::npos || !DecodeBase64(uri.substr(comma + 8), data))
+                return Fail("unsupported data URI in a buffer");
+        }
+        else if (uri.empty() || !ReadWholeFile(m_BufferDir / DecodeUri(uri), data))
+            return Fail("cannot read buffer '" + uri + "'");
+
+        hasher.Update(data.data(), data.size());
+    }
+
+    m_SourceHash = hasher.Digest();
+    return true;
+}
+
+uint32_t SceneCooker::AddString(const std::string& s)
+{
+    auto it = m_StringOffsets.find(s);
+    if (it != m_StringOffsets.end())
+        return it->second;
+
+    uint32_t offset = uint32_t(m_Strings.size());
+    m_Strings.append(s);
+    m_Strings.push_back('\0');
+    m_StringOffsets[s] = offset;
+    return offset;
+}
+
+uint32_t SceneCooker::AddTexture(const Json::Value& textureInfo, bool sRGB)
+{
+    if (!textureInfo.isObject() || !textureInfo["index"].isUInt())
+        return ymesh::c_InvalidIndex;
+
+    const Json::Value& texture = m_Root["textures"][textureInfo["index"].asUInt()];
+    if (!texture["source"].isUInt())
+        return ymesh::c_InvalidIndex;
+
+    const Json::Value& image = m_Root["images"][texture["source"].asUInt()];
+    std::string uri = image["uri"].asString();
+    if (uri.empty() || uri.rfind("data:", 0) == 0)
+    {
+        m_Error = "embedded images are not supported";
+        return ymesh::c_InvalidIndex;
+    }
+
+    std::string path = DecodeUri(uri);
+    auto key = std::make_pair(path, sRGB);
+    auto it = m_TextureIndices.find(key);
+    if (it != m_TextureIndices.end())
+        return it->second;
+
+    uint32_t index = uint32_t(m_Textures.size());
+    m_Textures.push_back({ AddString(path), sRGB ? 1u : 0u });
+    m_TextureIndices[key] = index;
+    return index;
+}
+
+bool SceneCooker::ReadAccessor(const Json::Value& accessorIndex, uint32_t components, std::vector<float>& values, uint32_t& count)
+{
+    const Json::Value& accessor = m_Root["accessors"][accessorIndex.asUInt()];
+    if (accessor.isMember("sparse"))
+        return Fail("sparse accessors are not supported");
+
+    static const std::map<std::string, uint32_t> typeComponents = {
+        { "SCALAR", 1 }, { "VEC2", 2 }, { "VEC3", 3 }, { "VEC4", 4 }
+    };
+
+    auto type = typeComponents.find(accessor["type"].asString());
+    if (type == typeComponents.end() || type->second < components)
+        return Fail("unexpected accessor type " + accessor["type"].asString());
+
+    uint32_t componentType = accessor["componentType"].asUInt();
+    uint32_t componentSize = (componentType == 5120 || componentType == 5121) ? 1 : (componentType == 5122 || componentType == 5123) ? 2 : 4;
+    bool normalized = accessor["normalized"].asBool();
+
+    count = accessor["count"].asUInt();
+    values.assign(size_t(count) * components, 0.f);
+
+    if (!accessor.isMember("bufferView"))
+        return true;
+
+    const Json::Value& view = m_Root["bufferViews"][accessor["bufferView"].asUInt()];
+    uint32_t bufferIndex = view["buffer"].asUInt();
+    if (bufferIndex >= m_Buffers.size())
+        return Fail("invalid buffer index");
+
+    const std::vector<uint8_t>& buffer = m_Buffers[bufferIndex];
+    size_t elementSize = size_t(componentSize) * type->second;
+    size_t stride = view["byteStride"].asUInt() ? view["byteStride"].asUInt() : elementSize;
+    size_t start = size_t(view["byteOffset"].asUInt64()) + size_t(accessor["byteOffset"].asUInt64());
+
+    if (count > 0 && start + stride * (count - 1) + elementSize > buffer.size())
+        return Fail("accessor out of buffer bounds");
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const uint8_t* element = buffer.data() + start + stride * i;
+        for (uint32_t c = 0; c < components; c++)
+        {
+            const uint8_t* src = element + componentSize * c;
+            float value = 0.f;
+            switch (componentType)
+            {
+            case 5120: { int8_t v; memcpy(&v, src, 1); value = normalized ? std::max(float(v) / 127.f, -1.f) : float(v); break; }
+            case 5121: { uint8_t v = *src; value = normalized ? float(v) / 255.f : float(v); break; }
+            case 5122: { int16_t v; memcpy(&v, src, 2); value = normalized ? std::max(float(v) / 32767.f, -1.f) : float(v); break; }
+            case 5123: { uint16_t v; memcpy(&v, src, 2); value = normalized ? float(v) / 65535.f : float(v); break; }
+            case 5125: { uint32_t v; memcpy(&v, src, 4); value = float(v); break; }
+            case 5126: { memcpy(&value, src, 4); break; }
+            default: return Fail("unsupported component type");
+            }
+            values[size_t(i) * components + c] = value;
+        }
+    }
+
+    return true;
+}
+
+bool SceneCooker::ReadIndices(const Json::Value& accessorIndex, std::vector<uint32_t>& indices)
+{
+    const Json::Value& accessor = m_Root["accessors"][accessorIndex.asUInt()];
+    const Json::Value& view = m_Root["bufferViews"][accessor["bufferView"].asUInt()];
+    uint32_t bufferIndex = view["buffer"].asUInt();
+    if (!accessor.isMember("bufferView") || bufferIndex >= m_Buffers.size())
+        return Fail("invalid index accessor");
+
+    uint32_t componentType = accessor["componentType"].asUInt();
+    uint32_t componentSize = componentType == 5121 ? 1 : componentType == 5123 ? 2 : 4;
+    uint32_t count = accessor["count"].asUInt();
+    size_t stride = view["byteStride"].asUInt() ? view["byteStride"].asUInt() : componentSize;
+    size_t start = size_t(view["byteOffset"].asUInt64()) + size_t(accessor["byteOffset"].asUInt64());
+
+    const std::vector<uint8_t>& buffer = m_Buffers[bufferIndex];
+    if (count > 0 && start + stride * (count - 1) + componentSize > buffer.size())
+        return Fail("index accessor out of buffer bounds");
+
+    indices.resize(count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const uint8_t* src = buffer.data() + start + stride * i;
+        uint32_t value = 0;
+        memcpy(&value, src, componentSize);
+        indices[i] = value;
+    }
+    return true;
+}
+
+bool SceneCooker::CookMaterials()
+{
+    for (const Json::Value& material : m_Root["materials"])
+    {
+        ymesh::MaterialRecord record{};
+        record.name = AddString(material["name"].asString());
+        record.opacity = 1.f;
+        record.baseOrDiffuseColor[0] = record.baseOrDiffuseColor[1] = record.baseOrDiffuseColor[2] = 1.f;
+        record.metalness = 1.f;
+        record.roughness = 1.f;
+        record.emissiveIntensity = 1.f;
+        record.normalTextureScale = material["normalTexture"].get("scale", 1.0).asFloat();
+        record.occlusionStrength = material["occlusionTexture"].get("strength", 1.0).asFloat();
+        record.alphaCutoff = material.get("alphaCutoff", 0.5).asFloat();
+
+        std::string alphaMode = material.get("alphaMode", "OPAQUE").asString();
+        record.domain = alphaMode == "MASK" ? ymesh::MaterialDomain::AlphaTested
+            : alphaMode == "BLEND" ? ymesh::MaterialDomain::AlphaBlended
+            : ymesh::MaterialDomain::Opaque;
+
+        if (material["doubleSided"].asBool())
+            record.flags |= ymesh::MaterialFlag_DoubleSided;
+
+        const Json::Value& specGloss = material["extensions"]["KHR_materials_pbrSpecularGlossiness"];
+        if (specGloss.isObject())
+        {
+            record.flags |= ymesh::MaterialFlag_SpecularGlossiness;
+
+            const Json::Value& diffuse = specGloss["diffuseFactor"];
+            for (int c = 0; c < 3; c++)
+            {
+                record.baseOrDiffuseColor[c] = diffuse.isArray() ? diffuse[c].asFloat() : 1.f;
+                record.specularColor[c] = specGloss["specularFactor"].isArray() ? specGloss["specularFactor"][c].asFloat() : 1.f;
+            }
+            record.opacity = diffuse.isArray() ? diffuse[3].asFloat() : 1.f;
+            record.roughness = 1.f - specGloss.get("glossinessFactor", 1.0).asFloat();
+            record.baseOrDiffuseTexture = AddTexture(specGloss["diffuseTexture"], true);
+            record.metalRoughOrSpecularTexture = AddTexture(specGloss["specularGlossinessTexture"], true);
+        }
+        else
+        {
+            const Json::Value& pbr = material["pbrMetallicRoughness"];
+            const Json::Value& baseColor = pbr["baseColorFactor"];
+            for (int c = 0; c < 3; c++)
+                record.baseOrDiffuseColor[c] = baseColor.isArray() ? baseColor[c].asFloat() : 1.f;
+            record.opacity = baseColor.isArray() ? baseColor[3].asFloat() : 1.f;
+            record.metalness = pbr.get("metallicFactor", 1.0).asFloat();
+            record.roughness = pbr.get("roughnessFactor", 1.0).asFloat();
+            record.baseOrDiffuseTexture = AddTexture(pbr["baseColorTexture"], true);
+            record.metalRoughOrSpecularTexture = AddTexture(pbr["metallicRoughnessTexture"], false);
+        }
+
+        const Json::Value& emissive = material["emissiveFactor"];
+        for (int c = 0; c < 3; c++)
+            record.emissiveColor[c] = emissive.isArray() ? emissive[c].asFloat() : 0.f;
+        record.emissiveIntensity = material["extensions"]["KHR_materials_emissive_strength"].get("emissiveStrength", 1.0).asFloat();
+
+        record.normalTexture = AddTexture(material["normalTexture"], false);
+        record.occlusionTexture = AddTexture(material["occlusionTexture"], false);
+        record.emissiveTexture = AddTexture(material["emissiveTexture"], true);
+
+        if (!m_Error.empty())
+            return false;
+
+        m_Materials.push_back(record);
+    }
+
+    return true;
+}
+
+bool SceneCooker::CookMeshes()
+{
+    // Vertex streams are shared by the whole file, so an attribute present in any primitive is stored for all of them
+    for (const Json::Value& mesh : m_Root["meshes"])
+    {
+        for (const Json::Value& primitive : mesh["primitives"])
+        {
+            if (primitive.isMember("targets"))
+                return Fail("morph targets are not supported");
+            if (primitive["extensions"].isMember("KHR_draco_mesh_compression"))
+                return Fail("compressed geometry is not supported");
+
+            const Json::Value& attributes = primitive["attributes"];
+            m_HasNormals |= attributes.isMember("NORMAL");
+            m_HasTexCoord1 |= attributes.isMember("TEXCOORD_0");
+            m_HasTexCoord2 |= attributes.isMember("TEXCOORD_1");
+            m_HasTangents |= attributes.isMember("TANGENT") || (attributes.isMember("NORMAL") && attributes.isMember("TEXCOORD_0"));
+        }
+    }
+
+    for (const Json::Value& mesh : m_Root["meshes"])
+    {
+        ymesh::MeshRecord record{};
+        record.name = AddString(mesh["name"].asString());
+        record.firstGeometry = uint32_t(m_Geometries.size());
+        record.indexOffset = uint32_t(m_Indices.size());
+        record.vertexOffset = uint32_t(m_Positions.size());
+        for (int c = 0; c < 3; c++)
+        {
+            record.boundsMin[c] = FLT_MAX;
+            record.boundsMax[c] = -FLT_MAX;
+        }
+
+        for (const Json::Value& primitive : mesh["primitives"])
+        {
+            if (primitive.get("mode", 4).asUInt() != 4)
+            {
+                fprintf(stderr, "YupCooker: %s: skipping a non-triangle primitive in mesh '%s'\n",
+                    m_GltfPath.generic_string().c_str(), mesh["name"].asString().c_str());
+                continue;
+            }
+
+            if (!CookPrimitive(primitive, record.vertexOffset, record.indexOffset))
+                return false;
+
+            const ymesh::GeometryRecord& geometry = m_Geometries.back();
+            for (int c = 0; c < 3; c++)
+            {
+                record.boundsMin[c] = std::min(record.boundsMin[c], geometry.boundsMin[c]);
+                record.boundsMax[c] = std::max(record.boundsMax[c], geometry.boundsMax[c]);
+            }
+        }
+
+        record.numGeometries = uint32_t(m_Geometries.size()) - record.firstGeometry;
+        record.totalIndices = uint32_t(m_Indices.size()) - record.indexOffset;
+        record.totalVertices = uint32_t(m_Positions.size()) - record.vertexOffset;
+        m_Meshes.push_back(record);
+    }
+
+    return true;
+}
+
+bool SceneCooker::CookPrimitive(const Json::Value& primitive, uint32_t meshVertexOffset, uint32_t meshIndexOffset)
+{
+    const Json::Value& attributes = primitive["attributes"];
+    if (!attributes.isMember("POSITION"))
+        return Fail("primitive without positions");
+
+    std::vector<float> positions, normals, tangents, texCoords1, texCoords2;
+    uint32_t numVertices = 0, count = 0;
+
+    if (!ReadAccessor(attributes["POSITION"], 3, positions, numVertices))
+        return false;
+    if (attributes.isMember("NORMAL") && (!ReadAccessor(attributes["NORMAL"], 3, normals, count) || count != numVertices))
+        return Fail(m_Error.empty() ? "normal count mismatch" : m_Error);
+    if (attributes.isMember("TANGENT") && (!ReadAccessor(attributes["TANGENT"], 4, tangents, count) || count != numVertices))
+        return Fail(m_Error.empty() ? "tangent count mismatch" : m_Error);
+    if (attributes.isMember("TEXCOORD_0") && (!ReadAccessor(attributes["TEXCOORD_0"], 2, texCoords1, count) || count != numVertices))
+        return Fail(m_Error.empty() ? "texcoord count mismatch" : m_Error);
+    if (attributes.isMember("TEXCOORD_1") && (!ReadAccessor(attributes["TEXCOORD_1"], 2, texCoords2, count) || count != numVertices))
+        return Fail(m_Error.empty() ? "texcoord count mismatch" : m_Error);
+
+    std::vector<uint32_t> indices;
+    if (primitive.isMember("indices"))
+    {
+        if (!ReadIndices(primitive["indices"], indices))
+            return false;
+    }
+    else
+    {
+        indices.resize(numVertices);
+        for (uint32_t i = 0; i < numVertices; i++)
+            indices[i] = i;
+    }
+
+    for (uint32_t index : indices)
+    {
+        if (index >= numVertices)
+            return Fail("index out of range");
+    }
+
+    // Same tangent reconstruction as donut's glTF importer for primitives that come without tangents
+    if (tangents.empty() && !normals.empty() && !texCoords1.empty())
+    {
+        std::vector<float> accumulatedTangents(size_t(numVertices) * 3, 0.f);
+        std::vector<float> accumulatedBitangents(size_t(numVertices) * 3, 0.f);
+
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+            const float* p0 = &positions[a * 3];
+            const float* p1 = &positions[b * 3];
+            const float* p2 = &positions[c * 3];
+            const float* t0 = &texCoords1[a * 2];
+            const float* t1 = &texCoords1[b * 2];
+            const float* t2 = &texCoords1[c * 2];
+
+            float dPds[3], dPdt[3];
+            float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            float s1 = t1[0] - t0[0], t1v = t1[1] - t0[1];
+            float s2 = t2[0] - t0[0], t2v = t2[1] - t0[1];
+            float r = s1 * t2v - s2 * t1v;
+            if (std::abs(r) < 1e-12f)
+                continue;
+            r = 1.f / r;
+
+            for (int k = 0; k < 3; k++)
+            {
+                dPds[k] = (e1[k] * t2v - e2[k] * t1v) * r;
+                dPdt[k] = (e2[k] * s1 - e1[k] * s2) * r;
+            }
+
+            for (uint32_t v : { a, b, c })
+            {
+                for (int k = 0; k < 3; k++)
+                {
+                    accumulatedTangents[v * 3 + k] += dPds[k];
+                    accumulatedBitangents[v * 3 + k] += dPdt[k];
+                }
+            }
+        }
+
+        tangents.resize(size_t(numVertices) * 4);
+        for (uint32_t v = 0; v < numVertices; v++)
+        {
+            const float* n = &normals[v * 3];
+            float* t = &accumulatedTangents[v * 3];
+            const float* b = &accumulatedBitangents[v * 3];
+
+            float d = n[0] * t[0] + n[1] * t[1] + n[2] * t[2];
+            float o[3] = { t[0] - n[0] * d, t[1] - n[1] * d, t[2] - n[2] * d };
+            float length = std::sqrt(o[0] * o[0] + o[1] * o[1] + o[2] * o[2]);
+            if (length > 0.f)
+                for (float& x : o) x /= length;
+
+            float cross[3] = { n[1] * o[2] - n[2] * o[1], n[2] * o[0] - n[0] * o[2], n[0] * o[1] - n[1] * o[0] };
+            float handedness = (cross[0] * b[0] + cross[1] * b[1] + cross[2] * b[2]) < 0.f ? -1.f : 1.f;
+
+            tangents[v * 4 + 0] = o[0];
+            tangents[v * 4 + 1] = o[1];
+            tangents[v * 4 + 2] = o[2];
+            tangents[v * 4 + 3] = handedness;
+        }
+    }
+
+    ymesh::GeometryRecord geometry{};
+    geometry.indexOffsetInMesh = uint32_t(m_Indices.size()) - meshIndexOffset;
+    geometry.vertexOffsetInMesh = uint32_t(m_Positions.size()) - meshVertexOffset;
+    geometry.numIndices = uint32_t(indices.size());
+    geometry.numVertices = numVertices;
+
+    if (primitive["material"].isUInt())
+        geometry.material = primitive["material"].asUInt();
+    else
+    {
+        if (m_DefaultMaterial == ymesh::c_InvalidIndex)
+        {
+            ymesh::MaterialRecord material{};
+            material.name = AddString("default");
+            material.baseOrDiffuseColor[0] = material.baseOrDiffuseColor[1] = material.baseOrDiffuseColor[2] = 1.f;
+            material.opacity = 1.f;
+            material.metalness = 1.f;
+            material.roughness = 1.f;
+            material.emissiveIntensity = 1.f;
+            material.normalTextureScale = 1.f;
+            material.occlusionStrength = 1.f;
+            material.alphaCutoff = 0.5f;
+            material.baseOrDiffuseTexture = material.metalRoughOrSpecularTexture = material.normalTexture =
+                material.occlusionTexture = material.emissiveTexture = ymesh::c_InvalidIndex;
+            m_DefaultMaterial = uint32_t(m_Materials.size());
+            m_Materials.push_back(material);
+        }
+        geometry.material = m_DefaultMaterial;
+    }
+
+    for (int c = 0; c < 3; c++)
+    {
+        geometry.boundsMin[c] = FLT_MAX;
+        geometry.boundsMax[c] = -FLT_MAX;
+    }
+
+    for (uint32_t v = 0; v < numVertices; v++)
+    {
+        Float3 p = { positions[v * 3], positions[v * 3 + 1], positions[v * 3 + 2] };
+        m_Positions.push_back(p);
+        geometry.boundsMin[0] = std::min(geometry.boundsMin[0], p.x);
+        geometry.boundsMin[1] = std::min(geometry.boundsMin[1], p.y);
+        geometry.boundsMin[2] = std::min(geometry.boundsMin[2], p.z);
+        geometry.boundsMax[0] = std::max(geometry.boundsMax[0], p.x);
+        geometry.boundsMax[1] = std::max(geometry.boundsMax[1], p.y);
+        geometry.boundsMax[2] = std::max(geometry.boundsMax[2], p.z);
+
+        if (m_HasNormals)
+            m_Normals.push_back(normals.empty() ? 0 : VectorToSnorm8(normals[v * 3], normals[v * 3 + 1], normals[v * 3 + 2], 0.f));
+        if (m_HasTangents)
+            m_Tangents.push_back(tangents.empty() ? 0 : VectorToSnorm8(tangents[v * 4], tangents[v * 4 + 1], tangents[v * 4 + 2], tangents[v * 4 + 3]));
+        if (m_HasTexCoord1)
+        {
+            m_TexCoords1.push_back(texCoords1.empty() ? 0.f : texCoords1[v * 2]);
+            m_TexCoords1.push_back(texCoords1.empty() ? 0.f : texCoords1[v * 2 + 1]);
+        }
+        if (m_HasTexCoord2)
+        {
+            m_TexCoords2.push_back(texCoords2.empty() ? 0.f : texCoords2[v * 2]);
+            m_TexCoords2.push_back(texCoords2.empty() ? 0.f : texCoords2[v * 2 + 1]);
+        }
+    }
+
+    m_Indices.insert(m_Indices.end(), indices.begin(), indices.end());
+    m_Geometries.push_back(geometry);
+    return true;
+}
+
+static void DecomposeMatrix(const Json::Value& m, ymesh::NodeRecord& node)
+{
+    double columns[3][3];
+    for (int c = 0; c < 3; c++)
+    {
+        for (int r = 0; r < 3; r++)
+            columns[c][r] = m[c * 4 + r].asDouble();
+        node.translation[c] = m[12 + c].asDouble();
+    }
+
+    double determinant =
+        columns[0][0] * (columns[1][1] * columns[2][2] - columns[2][1] * columns[1][2]) -
+        columns[1][0] * (columns[0][1] * columns[2][2] - columns[2][1] * columns[0][2]) +
+        columns[2][0] * (columns[0][1] * columns[1][2] - columns[1][1] * columns[0][2]);
+
+    for (int c = 0; c < 3; c++)
+    {
+        double length = std::sqrt(columns[c][0] * columns[c][0] + columns[c][1] * columns[c][1] + columns[c][2] * columns[c][2]);
+        node.scaling[c] = (c == 0 && determinant < 0.0) ? -length : length;
+        if (node.scaling[c] != 0.0)
+            for (int r = 0; r < 3; r++)
+                columns[c][r] /= node.scaling[c];
+    }
+
+    // Rotation matrix to quaternion, R(row, col) = columns[col][row]
+    double trace = columns[0][0] + columns[1][1] + columns[2][2];
+    double* q = node.rotation;
+    if (trace > 0.0)
+    {
+        double s = std::sqrt(trace + 1.0) * 2.0;
+        q[3] = 0.25 * s;
+        q[0] = (columns[1][2] - columns[2][1]) / s;
+        q[1] = (columns[2][0] - columns[0][2]) / s;
+        q[2] = (columns[0][1] - columns[1][0]) / s;
+    }
+    else if (columns[0][0] > columns[1][1] && columns[0][0] > columns[2][2])
+    {
+        double s = std::sqrt(1.0 + columns[0][0] - columns[1][1] - columns[2][2]) * 2.0;
+        q[3] = (columns[1][2] - columns[2][1]) / s;
+        q[0] = 0.25 * s;
+        q[1] = (columns[1][0] + columns[0][1]) / s;
+        q[2] = (columns[2][0] + columns[0][2]) / s;
+    }
+    else if (columns[1][1] > columns[2][2])
+    {
+        double s = std::sqrt(1.0 + columns[1][1] - columns[0][0] - columns[2][2]) * 2.0;
+        q[3] = (columns[2][0] - columns[0][2]) / s;
+        q[0] = (columns[1][0] + columns[0][1]) / s;
+        q[1] = 0.25 * s;
+        q[2] = (columns[2][1] + columns[1][2]) / s;
+    }
+    else
+    {
+        double s = std::sqrt(1.0 + columns[2][2] - columns[0][0] - columns[1][1]) * 2.0;
+        q[3] = (columns[0][1] - columns[1][0]) / s;
+        q[0] = (columns[2][0] + columns[0][2]) / s;
+        q[1] = (columns[2][1] + columns[1][2]) / s;
+        q[2] = 0.25 * s;
+    }
+}
+
+bool SceneCooker::CookNode(uint32_t gltfIndex, uint32_t parent)
+{
+    const Json::Value& nodes = m_Root["nodes"];
+    if (gltfIndex >= nodes.size() || m_NodeRemap.count(gltfIndex))
+        return Fail("invalid node hierarchy");
+
+    const Json::Value& node = nodes[gltfIndex];
+    if (node.isMember("skin"))
+        return Fail("skinned meshes are not supported");
+
+    ymesh::NodeRecord record{};
+    record.name = AddString(node["name"].asString());
+    record.parent = parent;
+    record.leafIndex = ymesh::c_InvalidIndex;
+    record.rotation[3] = 1.0;
+    record.scaling[0] = record.scaling[1] = record.scaling[2] = 1.0;
+
+    if (node["matrix"].isArray() && node["matrix"].size() == 16)
+        DecomposeMatrix(node["matrix"], record);
+    else
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            if (node["translation"].isArray()) record.translation[c] = node["translation"][c].asDouble();
+            if (node["scale"].isArray()) record.scaling[c] = node["scale"][c].asDouble();
+        }
+        if (node["rotation"].isArray())
+            for (int c = 0; c < 4; c++)
+                record.rotation[c] = node["rotation"][c].asDouble();
+    }
+
+    // A donut scene graph node holds a single leaf, extra leaves go to child nodes with an identity transform
+    std::vector<std::pair<ymesh::LeafType, uint32_t>> leaves;
+
+    if (node["mesh"].isUInt())
+    {
+        if (node["mesh"].asUInt() >= m_Meshes.size())
+            return Fail("invalid mesh index");
+        leaves.emplace_back(ymesh::LeafType::Mesh, node["mesh"].asUInt());
+    }
+
+    if (node["camera"].isUInt())
+    {
+        const Json::Value& camera = m_Root["cameras"][node["camera"].asUInt()];
+        ymesh::CameraRecord cameraRecord{};
+        if (camera["type"].asString() == "orthographic")
+        {
+            const Json::Value& ortho = camera["orthographic"];
+            cameraRecord.type = ymesh::CameraType::Orthographic;
+            cameraRecord.params[0] = ortho["xmag"].asFloat();
+            cameraRecord.params[1] = ortho["ymag"].asFloat();
+            cameraRecord.zNear = ortho["znear"].asFloat();
+            cameraRecord.zFar = ortho["zfar"].asFloat();
+        }
+        else
+        {
+            const Json::Value& perspective = camera["perspective"];
+            cameraRecord.type = ymesh::CameraType::Perspective;
+            cameraRecord.params[0] = perspective["yfov"].asFloat();
+            cameraRecord.params[1] = perspective.get("aspectRatio", 0.0).asFloat();
+            cameraRecord.zNear = perspective["znear"].asFloat();
+            cameraRecord.zFar = perspective.get("zfar", 0.0).asFloat();
+        }
+        leaves.emplace_back(ymesh::LeafType::Camera, uint32_t(m_Cameras.size()));
+        m_Cameras.push_back(cameraRecord);
+    }
+
+    const Json::Value& lightRef = node["extensions"]["KHR_lights_punctual"]["light"];
+    if (lightRef.isUInt())
+    {
+        const Json::Value& light = m_Root["extensions"]["KHR_lights_punctual"]["lights"][lightRef.asUInt()];
+        ymesh::LightRecord lightRecord{};
+        std::string type = light["type"].asString();
+        lightRecord.type = type == "directional" ? ymesh::LightType::Directional
+            : type == "spot" ? ymesh::LightType::Spot
+            : ymesh::LightType::Point;
+        for (int c = 0; c < 3; c++)
+            lightRecord.color[c] = light["color"].isArray() ? light["color"][c].asFloat() : 1.f;
+        lightRecord.intensity = light.get("intensity", 1.0).asFloat();
+        lightRecord.range = light.get("range", 0.0).asFloat();
+
+        const float radiansToDegrees = 180.f / 3.14159265f;
+        lightRecord.innerAngle = light["spot"].get("innerConeAngle", 0.0).asFloat() * radiansToDegrees;
+        lightRecord.outerAngle = light["spot"].get("outerConeAngle", 3.14159265 / 4.0).asFloat() * radiansToDegrees;
+
+        leaves.emplace_back(ymesh::LeafType::Light, uint32_t(m_Lights.size()));
+        m_Lights.push_back(lightRecord);
+    }
+
+    uint32_t nodeIndex = uint32_t(m_Nodes.size());
+    m_NodeRemap[gltfIndex] = nodeIndex;
+
+    if (!leaves.empty())
+    {
+        record.leafType = leaves[0].first;
+        record.leafIndex = leaves[0].second;
+    }
+    m_Nodes.push_back(record);
+
+    for (size_t i = 1; i < leaves.size(); i++)
+    {
+        ymesh::NodeRecord child{};
+        child.name = record.name;
+        child.parent = nodeIndex;
+        child.leafType = leaves[i].first;
+        child.leafIndex = leaves[i].second;
+        child.rotation[3] = 1.0;
+        child.scaling[0] = child.scaling[1] = child.scaling[2] = 1.0;
+        m_Nodes.push_back(child);
+    }
+
+    for (const Json::Value& child : node["children"])
+    {
+        if (!CookNode(child.asUInt(), nodeIndex))
+            return false;
+    }
+
+    return true;
+}
+
+bool SceneCooker::CookNodes()
+{
+    const Json::Value& scenes = m_Root["scenes"];
+    if (scenes.empty())
+        return true;
+
+    const Json::Value& scene = scenes[m_Root.get("scene", 0).asUInt()];
+    for (const Json::Value& node : scene["nodes"])
+    {
+        if (!CookNode(node.asUInt(), ymesh::c_InvalidIndex))
+            return false;
+    }
+    return true;
+}
+
+bool SceneCooker::CookAnimations()
+{
+    for (const Json::Value& animation : m_Root["animations"])
+    {
+        ymesh::AnimationRecord record{};
+        record.name = AddString(animation["name"].asString());
+        record.firstChannel = uint32_t(m_Channels.size());
+
+        for (const Json::Value& channel : animation["channels"])
+        {
+            const Json::Value& target = channel["target"];
+            std::string path = target["path"].asString();
+            if (path == "weights")
+                return Fail("morph target animations are not supported");
+
+            auto node = m_NodeRemap.find(target["node"].asUInt());
+            if (!target["node"].isUInt() || node == m_NodeRemap.end())
+                continue;
+
+            const Json::Value& sampler = animation["samplers"][channel["sampler"].asUInt()];
+
+            ymesh::ChannelRecord channelRecord{};
+            channelRecord.node = node->second;
+            channelRecord.path = path == "translation" ? ymesh::AnimationPath::Translation
+                : path == "rotation" ? ymesh::AnimationPath::Rotation
+                : ymesh::AnimationPath::Scaling;
+
+            std::string interpolation = sampler.get("interpolation", "LINEAR").asString();
+            channelRecord.interpolation = interpolation == "STEP" ? ymesh::Interpolation::Step
+                : interpolation == "CUBICSPLINE" ? ymesh::Interpolation::CubicSpline
+                : ymesh::Interpolation::Linear;
+
+            uint32_t components = channelRecord.path == ymesh::AnimationPath::Rotation ? 4 : 3;
+            std::vector<float> times, values;
+            uint32_t numTimes = 0, numValues = 0;
+            if (!ReadAccessor(sampler["input"], 1, times, numTimes) || !ReadAccessor(sampler["output"], components, values, numValues))
+                return false;
+
+            bool cubic = channelRecord.interpolation == ymesh::Interpolation::CubicSpline;
+            if (numValues != numTimes * (cubic ? 3 : 1))
+                return Fail("animation sampler input and output counts do not match");
+
+            channelRecord.firstKeyframe = uint32_t(m_Keyframes.size());
+            channelRecord.numKeyframes = numTimes;
+
+            for (uint32_t k = 0; k < numTimes; k++)
+            {
+                ymesh::KeyframeRecord keyframe{};
+                keyframe.time = times[k];
+                for (uint32_t c = 0; c < components; c++)
+                {
+                    if (cubic)
+                    {
+                        keyframe.inTangent[c] = values[(k * 3 + 0) * components + c];
+                        keyframe.value[c] = values[(k * 3 + 1) * components + c];
+                        keyframe.outTangent[c] = values[(k * 3 + 2) * components + c];
+                    }
+                    else
+                        keyframe.value[c] = values[k * components + c];
+                }
+                m_Keyframes.push_back(keyframe);
+            }
+
+            m_Channels.push_back(channelRecord);
+        }
+
+        record.numChannels = uint32_t(m_Channels.size()) - record.firstChannel;
+        if (record.numChannels)
+            m_Animations.push_back(record);
+    }
+
+    return true;
+}
+
+template<typename T>
+static ymesh::Range AppendSection(std::vector<uint8_t>& output, const T* data, size_t count)
+{
+    output.resize((output.size() + ymesh::c_SectionAlignment - 1) & ~size_t(ymesh::c_SectionAlignment - 1), 0);
+
+    ymesh::Range range = { output.size(), count * sizeof(T) };
+    if (count)
+    {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+        output.insert(output.end(), bytes, bytes + range.size);
+    }
+    return range;
+}
+
+template<typename T>
+static ymesh::Range AppendSection(std::vector<uint8_t>& output, const std::vector<T>& data)
+{
+    return AppendSection(output, data.data(), data.size());
+}
+
+void SceneCooker::Write(std::vector<uint8_t>& output)
+{
+    using ymesh::SectionId;
+    using ymesh::VertexStream;
+
+    ymesh::FileHeader header{};
+    header.magic = ymesh::c_Magic;
+    header.version = ymesh::c_Version;
+    header.sourceHash = m_SourceHash;
+
+    output.assign(sizeof(header), 0);
+
+    auto section = [&header](SectionId id) -> ymesh::Range& { return header.sections[uint32_t(id)]; };
+
+    section(SectionId::Strings) = AppendSection(output, m_Strings.data(), m_Strings.size());
+    section(SectionId::Textures) = AppendSection(output, m_Textures);
+    section(SectionId::Materials) = AppendSection(output, m_Materials);
+    section(SectionId::Meshes) = AppendSection(output, m_Meshes);
+    section(SectionId::Geometries) = AppendSection(output, m_Geometries);
+    section(SectionId::Nodes) = AppendSection(output, m_Nodes);
+    section(SectionId::Lights) = AppendSection(output, m_Lights);
+    section(SectionId::Cameras) = AppendSection(output, m_Cameras);
+    section(SectionId::Animations) = AppendSection(output, m_Animations);
+    section(SectionId::Channels) = AppendSection(output, m_Channels);
+    section(SectionId::Keyframes) = AppendSection(output, m_Keyframes);
+    section(SectionId::IndexData) = AppendSection(output, m_Indices);
+
+    // The vertex data section is the vertex buffer itself: one 16-byte aligned range per attribute
+    ymesh::Range& vertexData = section(SectionId::VertexData);
+    vertexData = AppendSection(output, m_Positions);
+    header.vertexStreams[uint32_t(VertexStream::Position)] = { 0, vertexData.size };
+
+    auto appendStream = [&](VertexStream stream, const auto& data)
+    {
+        ymesh::Range range = AppendSection(output, data);
+        header.vertexStreams[uint32_t(stream)] = { range.size ? range.offset - vertexData.offset : 0, range.size };
+        if (range.size)
+            vertexData.size = range.offset + range.size - vertexData.offset;
+    };
+
+    appendStream(VertexStream::Normal, m_Normals);
+    appendStream(VertexStream::Tangent, m_Tangents);
+    appendStream(VertexStream::TexCoord1, m_TexCoords1);
+    appendStream(VertexStream::TexCoord2, m_TexCoords2);
+
+    memcpy(output.data(), &header, sizeof(header));
+}
+
+bool SceneCooker::Cook(std::vector<uint8_t>& output)
+{
+    const Json::Value& extensionsRequired = m_Root["extensionsRequired"];
+    for (const Json::Value& extension : extensionsRequired)
+    {
+        std::string name = extension.asString();
+        if (name != "KHR_lights_punctual" && name != "KHR_materials_pbrSpecularGlossiness" && name != "KHR_materials_emissive_strength")
+            return Fail("required extension " + name + " is not supported");
+    }
+
+    if (!CookMaterials() || !CookMeshes() || !CookNodes() || !CookAnimations())
+        return false;
+
+    Write(output);
+    return true;
+}
+
+static bool IsUpToDate(const fs::path& path, uint64_t sourceHash)
+{
+    std::ifstream file(path, std::ios::binary);
+    ymesh::FileHeader header{};
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+        return false;
+    return header.magic == ymesh::c_Magic && header.version == ymesh::c_Version && header.sourceHash == sourceHash;
+}
+
+int CookMeshes(const MeshCookerOptions& options)
+{
+    using namespace std::chrono;
+    auto startTime = steady_clock::now();
+
+    std::vector<fs::path> scenes;
+    for (const auto& it : fs::recursive_directory_iterator(options.sourceDir))
+    {
+        if (it.is_regular_file() && ToLower(it.path().extension().generic_string()) == ".gltf")
+            scenes.push_back(fs::relative(it.path(), options.sourceDir));
+    }
+
+    std::atomic<uint32_t> numCooked = 0, numSkipped = 0, numFailed = 0;
+    std::mutex producedMutex;
+    std::set<std::string> producedFiles;
+
+    ParallelFor(scenes.size(), std::max(1u, options.threads), [&](size_t index)
+    {
+        const fs::path& relativePath = scenes[index];
+
+        // Prefer the copy rewritten by the texture cooker, buffers always come from the source directory
+        fs::path gltfPath = options.outputDir / relativePath;
+        std::error_code ec;
+        if (!fs::exists(gltfPath, ec))
+            gltfPath = options.sourceDir / relativePath;
+
+        fs::path outputName = relativePath;
+        outputName.replace_extension(".ymesh");
+        fs::path outputPath = options.outputDir / outputName;
+
+        SceneCooker cooker(gltfPath, (options.sourceDir / relativePath).parent_path());
+        if (!cooker.Load())
+        {
+            fprintf(stderr, "YupCooker: %s: %s\n", relativePath.generic_string().c_str(), cooker.GetError().c_str());
+            numFailed++;
+            return;
+        }
+
+        if (IsUpToDate(outputPath, cooker.GetSourceHash()))
+        {
+            std::lock_guard lock(producedMutex);
+            producedFiles.insert(outputName.generic_string());
+            return;
+        }
+
+        std::vector<uint8_t> output;
+        if (!cooker.Cook(output))
+        {
+            printf("YupCooker: %s stays on glTF: %s\n", relativePath.generic_string().c_str(), cooker.GetError().c_str());
+            numSkipped++;
+            return;
+        }
+
+        if (!WriteWholeFile(outputPath, output.data(), output.size()))
+        {
+            fprintf(stderr, "YupCooker: cannot write %s\n", outputPath.generic_string().c_str());
+            numFailed++;
+            return;
+        }
+
+        printf("YupCooker: %s -> %s (%.1f KB)\n", relativePath.generic_string().c_str(), outputName.generic_string().c_str(), double(output.size()) / 1024.0);
+        numCooked++;
+
+        std::lock_guard lock(producedMutex);
+        producedFiles.insert(outputName.generic_string());
+    });
+
+    // Remove binary scenes whose glTF source is gone or can no longer be cooked
+    std::vector<fs::path> staleFiles;
+    std::error_code ec;
+    for (const auto& it : fs::recursive_directory_iterator(options.outputDir, ec))
+    {
+        if (it.is_regular_file() && it.path().extension() == ".ymesh" &&
+            !producedFiles.count(fs::relative(it.path(), options.outputDir).generic_string()))
+            staleFiles.push_back(it.path());
+    }
+    for (const fs::path& path : staleFiles)
+        fs::remove(path, ec);
+
+    auto duration = duration_cast<milliseconds>(steady_clock::now() - startTime).count();
+    printf("YupCooker: %zu scenes, %u cooked, %zu up to date, %u kept on glTF, %u failed in %lld ms\n",
+        scenes.size(), numCooked.load(), producedFiles.size() - numCooked, numSkipped.load(), numFailed.load(), (long long)duration);
+
+    return numFailed == 0 ? 0 : 1;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <filesystem>
+
+struct MeshCookerOptions
+{
+    std::filesystem::path sourceDir;
+    std::filesystem::path outputDir;
+    unsigned threads = 0;
+};
+
+// Converts every glTF scene under sourceDir into an engine-native .ymesh file in outputDir (see src/YMeshFormat.h).
+// When outputDir already holds a glTF copy written by the texture cooker, the material texture references
+// are taken from it so the binary scene points at the cooked textures. Scenes using features the binary
+// format does not cover (skinning, morph targets, compressed geometry) are skipped and keep loading from glTF.
+// Returns the process exit code.
+int CookMeshes(const MeshCookerOptions& options);
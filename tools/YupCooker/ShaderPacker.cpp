@@ -0,0 +1,153 @@
+#include "ShaderPacker.h"
+#include "../Common/ToolUtils.h"
+#include "../Common/XXHash64.h"
+#include "../../src/ShaderArchiveFormat.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+struct ShaderFile
+{
+    std::string name;
+    std::vector<uint8_t> data;
+    uint64_t hash = 0;
+};
+
+static size_t AlignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static std::vector<uint8_t> BuildArchive(const std::vector<ShaderFile>& files)
+{
+    std::string strings;
+    for (const ShaderFile& file : files)
+        strings += file.name;
+
+    shaderpak::FileHeader header{};
+    header.magic = shaderpak::c_Magic;
+    header.version = shaderpak::c_Version;
+    header.numEntries = uint32_t(files.size());
+    header.stringsSize = uint32_t(strings.size());
+    header.entriesOffset = sizeof(header);
+    header.stringsOffset = header.entriesOffset + files.size() * sizeof(shaderpak::Entry);
+
+    std::vector<shaderpak::Entry> entries(files.size());
+    size_t offset = AlignUp(size_t(header.stringsOffset) + strings.size(), shaderpak::c_DataAlignment);
+    uint32_t nameOffset = 0;
+
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        shaderpak::Entry& entry = entries[i];
+        entry.nameOffset = nameOffset;
+        entry.nameSize = uint32_t(files[i].name.size());
+        entry.dataOffset = offset;
+        entry.dataSize = files[i].data.size();
+        entry.hash = files[i].hash;
+
+        nameOffset += entry.nameSize;
+        offset = AlignUp(offset + files[i].data.size(), shaderpak::c_DataAlignment);
+    }
+
+    std::vector<uint8_t> archive(offset, 0);
+    memcpy(archive.data(), &header, sizeof(header));
+    if (!entries.empty())
+        memcpy(archive.data() + header.entriesOffset, entries.data(), entries.size() * sizeof(shaderpak::Entry));
+    if (!strings.empty())
+        memcpy(archive.data() + header.stringsOffset, strings.data(), strings.size());
+
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        if (!files[i].data.empty())
+            memcpy(archive.data() + entries[i].dataOffset, files[i].data.data(), files[i].data.size());
+    }
+
+    return archive;
+}
+
+static bool PackDirectory(const fs::path& shaderDir, const fs::path& archivePath)
+{
+    std::vector<ShaderFile> files;
+    std::error_code ec;
+
+    for (const auto& item : fs::recursive_directory_iterator(shaderDir, ec))
+    {
+        if (!item.is_regular_file())
+            continue;
+
+        ShaderFile file;
+        file.name = fs::relative(item.path(), shaderDir).generic_string();
+        if (!ReadWholeFile(item.path(), file.data))
+        {
+            fprintf(stderr, "YupCooker: cannot read %s\n", item.path().generic_string().c_str());
+            return false;
+        }
+        file.hash = XXHash64::Hash(file.data.data(), file.data.size());
+        files.push_back(std::move(file));
+    }
+
+    // Sorted so that the engine can binary search the entry table
+    std::sort(files.begin(), files.end(), [](const ShaderFile& a, const ShaderFile& b) { return a.name < b.name; });
+
+    std::vector<uint8_t> archive = BuildArchive(files);
+
+    std::vector<uint8_t> existing;
+    if (ReadWholeFile(archivePath, existing) && existing == archive)
+    {
+        fs::last_write_time(archivePath, fs::file_time_type::clock::now(), ec);
+        printf("YupCooker: %s is up to date (%zu shaders)\n", archivePath.generic_string().c_str(), files.size());
+        return true;
+    }
+
+    // A running engine keeps the archive mapped, which prevents replacing it on some platforms. The engine
+    // notices that the shader files are newer than the archive and reads them directly in that case.
+    fs::path tempPath = archivePath;
+    tempPath += ".tmp";
+    if (!WriteWholeFile(tempPath, archive.data(), archive.size()))
+    {
+        fprintf(stderr, "YupCooker: warning: cannot write %s\n", tempPath.generic_string().c_str());
+        return true;
+    }
+
+    fs::rename(tempPath, archivePath, ec);
+    if (ec)
+    {
+        fprintf(stderr, "YupCooker: warning: cannot replace %s: %s\n", archivePath.generic_string().c_str(), ec.message().c_str());
+        fs::remove(tempPath, ec);
+        return true;
+    }
+
+    printf("YupCooker: %s -> %s (%zu shaders, %.1f KB)\n", shaderDir.generic_string().c_str(),
+        archivePath.generic_string().c_str(), files.size(), double(archive.size()) / 1024.0);
+    return true;
+}
+
+int PackShaders(const ShaderPackerOptions& options)
+{
+    std::error_code ec;
+    if (!fs::is_directory(options.shadersDir, ec))
+    {
+        fprintf(stderr, "YupCooker: %s is not a directory\n", options.shadersDir.generic_string().c_str());
+        return 1;
+    }
+
+    int failed = 0;
+    for (const auto& item : fs::directory_iterator(options.shadersDir, ec))
+    {
+        if (!item.is_directory())
+            continue;
+
+        fs::path archivePath = options.outputDir / item.path().filename();
+        archivePath += ".pak";
+
+        if (!PackDirectory(item.path(), archivePath))
+            failed++;
+    }
+
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <filesystem>
+
+struct ShaderPackerOptions
+{
+    std::filesystem::path shadersDir;
+    std::filesystem::path outputDir;
+};
+
+// Packs every compiled shader directory under shadersDir (one per graphics API, e.g. dxil or spirv) into
+// a <name>.pak archive in outputDir that the engine memory-maps instead of reading the files one by one
+// (see src/ShaderArchiveFormat.h). An archive whose contents would not change is only touched, so that
+// the engine still sees it as newer than the shader files.
+// Returns the process exit code.
+int PackShaders(const ShaderPackerOptions& options);
@@ -0,0 +1,570 @@
+#include "TextureCooker.h"
+#include "BlockCompression.h"
+#include "../Common/ToolUtils.h"
+#include "../Common/XXHash64.h"
+#include "../../src/UriUtils.h"
+
+#include <json/json.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+using BlockCompression::Format;
+
+// Bump whenever the cooked output changes so that stale cache entries are cooked again.
+static constexpr uint32_t g_TextureCookerVersion = 1;
+
+// Ordered by priority: when one image is used in several material slots, the highest usage wins.
+enum class TextureUsage
+{
+    Linear,         // metallic-roughness, occlusion
+    Color,          // sRGB base color / emissive
+    ColorWithAlpha, // sRGB base color of blended or alpha tested materials
+    Normal          // tangent space normal map
+};
+
+struct CookImage
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint8_t> rgba;
+};
+
+struct CookJob
+{
+    fs::path sourcePath;
+    std::string sourceName;     // relative to the source directory
+    std::string outputName;     // relative to the output directory
+    TextureUsage usage = TextureUsage::Linear;
+    Format format = Format::BC1;
+    bool sRGB = false;
+    uint64_t key = 0;
+    bool upToDate = false;
+    bool failed = false;
+    uint64_t sourceBytes = 0;
+    uint64_t cookedBytes = 0;
+};
+
+struct GltfImageRef
+{
+    uint32_t imageIndex;
+    std::string newUri;
+};
+
+struct GltfFile
+{
+    fs::path relativePath;
+    Json::Value root;
+    std::vector<GltfImageRef> images;
+};
+
+static std::string ReplaceExtension(const std::string& uri, const char* extension)
+{
+    size_t dot = uri.find_last_of('.');
+    size_t slash = uri.find_last_of('/');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return uri + extension;
+    return uri.substr(0, dot) + extension;
+}
+
+static void ClassifyImages(const Json::Value& root, std::map<uint32_t, TextureUsage>& usages)
+{
+    const Json::Value& textures = root["textures"];
+
+    auto markTexture = [&](const Json::Value& textureInfo, TextureUsage usage)
+    {
+        if (!textureInfo.isObject() || !textureInfo["index"].isUInt())
+            return;
+
+        uint32_t textureIndex = textureInfo["index"].asUInt();
+        if (textureIndex >= textures.size() || !textures[textureIndex]["source"].isUInt())
+            return;
+
+        uint32_t imageIndex = textures[textureIndex]["source"].asUInt();
+        auto it = usages.find(imageIndex);
+        if (it == usages.end() || int(usage) > int(it->second))
+            usages[imageIndex] = usage;
+    };
+
+    for (const Json::Value& material : root["materials"])
+    {
+        bool hasAlpha = material.isMember("alphaMode") && material["alphaMode"].asString() != "OPAQUE";
+        TextureUsage colorUsage = hasAlpha ? TextureUsage::ColorWithAlpha : TextureUsage::Color;
+
+        const Json::Value& pbr = material["pbrMetallicRoughness"];
+        markTexture(pbr["baseColorTexture"], colorUsage);
+        markTexture(pbr["metallicRoughnessTexture"], TextureUsage::Linear);
+        markTexture(material["normalTexture"], TextureUsage::Normal);
+        markTexture(material["occlusionTexture"], TextureUsage::Linear);
+        markTexture(material["emissiveTexture"], TextureUsage::Color);
+
+        const Json::Value& specGloss = material["extensions"]["KHR_materials_pbrSpecularGlossiness"];
+        markTexture(specGloss["diffuseTexture"], colorUsage);
+        // Glossiness is in alpha
+        markTexture(specGloss["specularGlossinessTexture"], TextureUsage::ColorWithAlpha);
+    }
+}
+
+static void ChooseFormat(CookJob& job, bool useBC7)
+{
+    switch (job.usage)
+    {
+    case TextureUsage::Normal:
+        // Keeps Z: the Donut material shaders sample all three channels and do not reconstruct it
+        job.format = useBC7 ? Format::BC7 : Format::BC1;
+        job.sRGB = false;
+        break;
+    case TextureUsage::ColorWithAlpha:
+        job.format = useBC7 ? Format::BC7 : Format::BC3;
+        job.sRGB = true;
+        break;
+    case TextureUsage::Color:
+        job.format = useBC7 ? Format::BC7 : Format::BC1;
+        job.sRGB = true;
+        break;
+    case TextureUsage::Linear:
+        job.format = useBC7 ? Format::BC7 : Format::BC1;
+        job.sRGB = false;
+        break;
+    }
+}
+
+// Mip generation ----------------------------------------------------------------------------------
+
+static float SrgbToLinear(float v)
+{
+    return v <= 0.04045f ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f);
+}
+
+static uint8_t LinearToSrgb8(float v)
+{
+    v = std::clamp(v, 0.f, 1.f);
+    float s = v <= 0.0031308f ? v * 12.92f : 1.055f * std::pow(v, 1.f / 2.4f) - 0.055f;
+    return uint8_t(s * 255.f + 0.5f);
+}
+
+static CookImage Downsample(const CookImage& source, TextureUsage usage)
+{
+    static const auto srgbTable = []
+    {
+        std::array<float, 256> table;
+        for (int i = 0; i < 256; i++)
+            table[i] = SrgbToLinear(float(i) / 255.f);
+        return table;
+    }();
+
+    CookImage result;
+    result.width = std::max(1u, source.width / 2);
+    result.height = std::max(1u, source.height / 2);
+    result.rgba.resize(size_t(result.width) * result.height * 4);
+
+    for (uint32_t y = 0; y < result.height; y++)
+    {
+        uint32_t y0 = std::min(y * 2, source.height - 1);
+        uint32_t y1 = std::min(y * 2 + 1, source.height - 1);
+
+        for (uint32_t x = 0; x < result.width; x++)
+        {
+            uint32_t x0 = std::min(x * 2, source.width - 1);
+            uint32_t x1 = std::min(x * 2 + 1, source.width - 1);
+
+            const uint8_t* taps[4] = {
+                &source.rgba[(size_t(y0) * source.width + x0) * 4],
+                &source.rgba[(size_t(y0) * source.width + x1) * 4],
+                &source.rgba[(size_t(y1) * source.width + x0) * 4],
+                &source.rgba[(size_t(y1) * source.width + x1) * 4]
+            };
+
+            uint8_t* out = &result.rgba[(size_t(y) * result.width + x) * 4];
+
+            if (usage == TextureUsage::Normal)
+            {
+                float n[3] = {};
+                for (const uint8_t* tap : taps)
+                    for (int c = 0; c < 3; c++)
+                        n[c] += float(tap[c]) / 127.5f - 1.f;
+
+                float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                if (length < 1e-6f)
+                {
+                    n[0] = n[1] = 0.f;
+                    n[2] = length = 1.f;
+                }
+
+                for (int c = 0; c < 3; c++)
+                    out[c] = uint8_t(std::clamp((n[c] / length * 0.5f + 0.5f) * 255.f + 0.5f, 0.f, 255.f));
+                out[3] = 255;
+            }
+            else if (usage == TextureUsage::Color || usage == TextureUsage::ColorWithAlpha)
+            {
+                for (int c = 0; c < 3; c++)
+                {
+                    float sum = 0.f;
+                    for (const uint8_t* tap : taps)
+                        sum += srgbTable[tap[c]];
+                    out[c] = LinearToSrgb8(sum * 0.25f);
+                }
+                out[3] = uint8_t((uint32_t(taps[0][3]) + taps[1][3] + taps[2][3] + taps[3][3] + 2) / 4);
+            }
+            else
+            {
+                for (int c = 0; c < 4; c++)
+                    out[c] = uint8_t((uint32_t(taps[0][c]) + taps[1][c] + taps[2][c] + taps[3][c] + 2) / 4);
+            }
+        }
+    }
+
+    return result;
+}
+
+static void CompressImage(const CookImage& image, Format format, unsigned threads, std::vector<uint8_t>& output)
+{
+    uint32_t blocksX = (image.width + 3) / 4;
+    uint32_t blocksY = (image.height + 3) / 4;
+    uint32_t blockSize = BlockCompression::GetBlockSize(format);
+
+    size_t offset = output.size();
+    output.resize(offset + size_t(blocksX) * blocksY * blockSize);
+    uint8_t* base = output.data() + offset;
+
+    ParallelFor(blocksY, threads, [&](size_t by)
+    {
+        uint8_t block[64];
+        for (uint32_t bx = 0; bx < blocksX; bx++)
+        {
+            // Edge blocks of textures that are not a multiple of 4 replicate the last row / column
+            for (uint32_t py = 0; py < 4; py++)
+            {
+                uint32_t y = std::min(uint32_t(by) * 4 + py, image.height - 1);
+                for (uint32_t px = 0; px < 4; px++)
+                {
+                    uint32_t x = std::min(bx * 4 + px, image.width - 1);
+                    memcpy(block + (py * 4 + px) * 4, &image.rgba[(size_t(y) * image.width + x) * 4], 4);
+                }
+            }
+
+            BlockCompression::EncodeBlock(format, block, base + (by * blocksX + bx) * blockSize);
+        }
+    });
+}
+
+// DDS output --------------------------------------------------------------------------------------
+
+static uint32_t GetDxgiFormat(Format format, bool sRGB)
+{
+    switch (format)
+    {
+    case Format::BC1: return sRGB ? 72 : 71;   // DXGI_FORMAT_BC1_UNORM(_SRGB)
+    case Format::BC3: return sRGB ? 78 : 77;   // DXGI_FORMAT_BC3_UNORM(_SRGB)
+    case Format::BC5: return 83;               // DXGI_FORMAT_BC5_UNORM
+    case Format::BC7: return sRGB ? 99 : 98;   // DXGI_FORMAT_BC7_UNORM(_SRGB)
+    }
+    return 0;
+}
+
+static std::vector<uint8_t> MakeDdsHeader(uint32_t width, uint32_t height, uint32_t mipLevels, Format format, bool sRGB)
+{
+    uint32_t header[1 + 31 + 5] = {};
+
+    header[0] = 0x20534444;                                     // "DDS "
+    header[1] = 124;                                            // dwSize
+    header[2] = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000;   // CAPS | HEIGHT | WIDTH | PIXELFORMAT | MIPMAPCOUNT | LINEARSIZE
+    header[3] = height;
+    header[4] = width;
+    header[5] = ((width + 3) / 4) * ((height + 3) / 4) * BlockCompression::GetBlockSize(format);
+    header[7] = mipLevels;
+    header[19] = 32;                                            // ddspf.dwSize
+    header[20] = 0x4;                                           // DDPF_FOURCC
+    header[21] = 0x30315844;                                    // "DX10"
+    header[27] = 0x1000 | 0x8 | 0x400000;                       // TEXTURE | COMPLEX | MIPMAP
+
+    header[32] = GetDxgiFormat(format, sRGB);
+    header[33] = 3;                                             // D3D10_RESOURCE_DIMENSION_TEXTURE2D
+    header[35] = 1;                                             // arraySize
+
+    std::vector<uint8_t> bytes(sizeof(header));
+    memcpy(bytes.data(), header, sizeof(header));
+    return bytes;
+}
+
+static bool CookTexture(CookJob& job, const fs::path& outputDir, unsigned threads)
+{
+    std::vector<uint8_t> fileData;
+    if (!ReadWholeFile(job.sourcePath, fileData))
+    {
+        fprintf(stderr, "YupCooker: cannot read %s\n", job.sourcePath.generic_string().c_str());
+        return false;
+    }
+
+    int width = 0, height = 0, channels = 0;
+    stbi_uc* pixels = stbi_load_from_memory(fileData.data(), int(fileData.size()), &width, &height, &channels, 4);
+    if (!pixels)
+    {
+        fprintf(stderr, "YupCooker: cannot decode %s: %s\n", job.sourcePath.generic_string().c_str(), stbi_failure_reason());
+        return false;
+    }
+
+    CookImage image;
+    image.width = uint32_t(width);
+    image.height = uint32_t(height);
+    image.rgba.assign(pixels, pixels + size_t(width) * height * 4);
+    stbi_image_free(pixels);
+
+    uint32_t mipLevels = 1;
+    for (uint32_t size = std::max(image.width, image.height); size > 1; size >>= 1)
+        mipLevels++;
+
+    std::vector<uint8_t> output = MakeDdsHeader(image.width, image.height, mipLevels, job.format, job.sRGB);
+
+    for (uint32_t mip = 0; mip < mipLevels; mip++)
+    {
+        CompressImage(image, job.format, threads, output);
+
+        if (mip + 1 < mipLevels)
+            image = Downsample(image, job.usage);
+    }
+
+    if (!WriteWholeFile(outputDir / job.outputName, output.data(), output.size()))
+    {
+        fprintf(stderr, "YupCooker: cannot write %s\n", (outputDir / job.outputName).generic_string().c_str());
+        return false;
+    }
+
+    job.sourceBytes = uint64_t(width) * height * 4 * 4 / 3;
+    job.cookedBytes = output.size();
+    return true;
+}
+
+// Cook cache --------------------------------------------------------------------------------------
+
+static std::unordered_map<std::string, uint64_t> LoadCookCache(const fs::path& path)
+{
+    std::unordered_map<std::string, uint64_t> cache;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line))
+    {
+        size_t tab = line.find('\t');
+        if (tab == std::string::npos)
+            continue;
+        cache[line.substr(tab + 1)] = std::stoull(line.substr(0, tab), nullptr, 16);
+    }
+    return cache;
+}
+
+static void SaveCookCache(const fs::path& path, const std::vector<CookJob>& jobs)
+{
+    std::ofstream file(path, std::ios::trunc);
+    for (const CookJob& job : jobs)
+    {
+        if (!job.failed)
+            file << std::hex << job.key << std::dec << '\t' << job.outputName << '\n';
+    }
+}
+
+static uint64_t ComputeCookKey(const CookJob& job, const std::vector<uint8_t>& sourceData)
+{
+    XXHash64 hasher;
+    uint32_t settings[3] = { g_TextureCookerVersion, uint32_t(job.format), uint32_t(job.sRGB) };
+    hasher.Update(settings, sizeof(settings));
+    hasher.Update(sourceData.data(), sourceData.size());
+    return hasher.Digest();
+}
+
+int CookTextures(const TextureCookerOptions& inputOptions)
+{
+    using namespace std::chrono;
+    auto startTime = steady_clock::now();
+
+    TextureCookerOptions options = inputOptions;
+    if (options.cacheFile.empty())
+        options.cacheFile = fs::path(options.outputDir.generic_string() + ".cache");
+    if (options.excludeListFile.empty())
+        options.excludeListFile = fs::path(options.outputDir.generic_string() + ".exclude");
+
+    std::error_code ec;
+    fs::create_directories(options.outputDir, ec);
+
+    std::vector<GltfFile> gltfFiles;
+    std::vector<CookJob> jobs;
+    std::unordered_map<std::string, size_t> jobByOutput;
+
+    for (const auto& it : fs::recursive_directory_iterator(options.sourceDir))
+    {
+        if (!it.is_regular_file() || ToLower(it.path().extension().generic_string()) != ".gltf")
+            continue;
+
+        GltfFile gltf;
+        gltf.relativePath = fs::relative(it.path(), options.sourceDir);
+
+        std::ifstream file(it.path());
+        Json::CharReaderBuilder builder;
+        std::string errors;
+        if (!Json::parseFromStream(builder, file, &gltf.root, &errors))
+        {
+            fprintf(stderr, "YupCooker: cannot parse %s: %s\n", it.path().generic_string().c_str(), errors.c_str());
+            return 1;
+        }
+
+        std::map<uint32_t, TextureUsage> usages;
+        ClassifyImages(gltf.root, usages);
+
+        const Json::Value& images = gltf.root["images"];
+        for (const auto& [imageIndex, usage] : usages)
+        {
+            if (imageIndex >= images.size() || !images[imageIndex]["uri"].isString())
+                continue;
+
+            std::string uri = images[imageIndex]["uri"].asString();
+            if (uri.rfind("data:", 0) == 0 || ToLower(fs::path(uri).extension().generic_string()) == ".dds")
+                continue;
+
+            fs::path sourceRelative = gltf.relativePath.parent_path() / DecodeUri(uri);
+            std::string outputName = ReplaceExtension(sourceRelative.lexically_normal().generic_string(), ".dds");
+
+            gltf.images.push_back({ imageIndex, ReplaceExtension(uri, ".dds") });
+
+            auto existing = jobByOutput.find(outputName);
+            if (existing != jobByOutput.end())
+            {
+                CookJob& job = jobs[existing->second];
+                if (int(usage) > int(job.usage))
+                    job.usage = usage;
+                continue;
+            }
+
+            CookJob job;
+            job.sourcePath = options.sourceDir / sourceRelative;
+            job.sourceName = sourceRelative.lexically_normal().generic_string();
+            job.outputName = outputName;
+            job.usage = usage;
+            jobByOutput[outputName] = jobs.size();
+            jobs.push_back(std::move(job));
+        }
+
+        gltfFiles.push_back(std::move(gltf));
+    }
+
+    std::unordered_map<std::string, uint64_t> cache = LoadCookCache(options.cacheFile);
+
+    // Hash sources and find out what actually needs cooking
+    ParallelFor(jobs.size(), options.threads, [&](size_t index)
+    {
+        CookJob& job = jobs[index];
+        ChooseFormat(job, options.useBC7);
+
+        std::vector<uint8_t> sourceData;
+        if (!ReadWholeFile(job.sourcePath, sourceData))
+        {
+            fprintf(stderr, "YupCooker: cannot read %s\n", job.sourcePath.generic_string().c_str());
+            job.failed = true;
+            return;
+        }
+
+        job.key = ComputeCookKey(job, sourceData);
+
+        auto cached = cache.find(job.outputName);
+        std::error_code existsError;
+        job.upToDate = cached != cache.end() && cached->second == job.key && fs::exists(options.outputDir / job.outputName, existsError);
+    });
+
+    std::vector<CookJob*> pending;
+    for (CookJob& job : jobs)
+    {
+        if (!job.failed && !job.upToDate)
+            pending.push_back(&job);
+    }
+
+    // Images are cooked in parallel; with fewer images than cores the block rows of each image are split too.
+    unsigned innerThreads = std::max(1u, options.threads / unsigned(std::max<size_t>(1, pending.size())));
+    ParallelFor(pending.size(), options.threads, [&](size_t index)
+    {
+        CookJob& job = *pending[index];
+        job.failed = !CookTexture(job, options.outputDir, innerThreads);
+        if (!job.failed)
+        {
+            printf("YupCooker: %s -> %s (%.1f KB -> %.1f KB)\n", job.sourceName.c_str(), job.outputName.c_str(),
+                double(job.sourceBytes) / 1024.0, double(job.cookedBytes) / 1024.0);
+        }
+    });
+
+    std::set<std::string> producedFiles;
+    std::set<std::string> excludedSources;
+    for (const CookJob& job : jobs)
+    {
+        if (job.failed)
+            continue;
+        producedFiles.insert(job.outputName);
+        excludedSources.insert(job.sourceName);
+    }
+
+    // Rewrite the image references of every scene to the cooked files
+    for (GltfFile& gltf : gltfFiles)
+    {
+        if (gltf.images.empty())
+            continue;
+
+        Json::Value& images = gltf.root["images"];
+        for (const GltfImageRef& ref : gltf.images)
+        {
+            fs::path sourceRelative = gltf.relativePath.parent_path() / DecodeUri(images[ref.imageIndex]["uri"].asString());
+            auto job = jobByOutput.find(ReplaceExtension(sourceRelative.lexically_normal().generic_string(), ".dds"));
+            if (job == jobByOutput.end() || jobs[job->second].failed)
+                continue;
+
+            images[ref.imageIndex]["uri"] = ref.newUri;
+            images[ref.imageIndex].removeMember("mimeType");
+        }
+
+        Json::StreamWriterBuilder writer;
+        writer["indentation"] = "  ";
+        std::string text = Json::writeString(writer, gltf.root);
+
+        std::string outputName = gltf.relativePath.generic_string();
+        if (!WriteWholeFile(options.outputDir / outputName, text.data(), text.size()))
+        {
+            fprintf(stderr, "YupCooker: cannot write %s\n", outputName.c_str());
+            return 1;
+        }
+        producedFiles.insert(outputName);
+    }
+
+    // Remove cooked files whose sources are gone, so they do not end up in the archive
+    std::vector<fs::path> staleFiles;
+    for (const auto& it : fs::recursive_directory_iterator(options.outputDir))
+    {
+        std::string extension = ToLower(it.path().extension().generic_string());
+        if (it.is_regular_file() && (extension == ".dds" || extension == ".gltf") &&
+            !producedFiles.count(fs::relative(it.path(), options.outputDir).generic_string()))
+            staleFiles.push_back(it.path());
+    }
+    for (const fs::path& path : staleFiles)
+        fs::remove(path, ec);
+
+    SaveCookCache(options.cacheFile, jobs);
+
+    {
+        std::ofstream excludeList(options.excludeListFile, std::ios::trunc);
+        for (const std::string& name : excludedSources)
+            excludeList << name << '\n';
+    }
+
+    size_t numFailed = std::count_if(jobs.begin(), jobs.end(), [](const CookJob& job) { return job.failed; });
+    auto duration = duration_cast<milliseconds>(steady_clock::now() - startTime).count();
+    printf("YupCooker: %zu textures, %zu cooked, %zu up to date, %zu failed in %lld ms\n",
+        jobs.size(), pending.size() - numFailed, jobs.size() - pending.size(), numFailed, (long long)duration);
+
+    return numFailed == 0 ? 0 : 1;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+
+struct TextureCookerOptions
+{
+    std::filesystem::path sourceDir;
+    std::filesystem::path outputDir;
+    std::filesystem::path cacheFile;        // defaults to <outputDir>.cache
+    std::filesystem::path excludeListFile;  // defaults to <outputDir>.exclude
+    unsigned threads = 0;
+    bool useBC7 = false;                    // BC7 instead of BC1/BC3 for color and packed channel maps
+};
+
+// Converts every image referenced by the glTF scenes under sourceDir into a block-compressed DDS with
+// a full mip chain, and writes copies of the glTF files that point at the cooked images into outputDir.
+// Source images that were replaced are listed in the exclude list so the packer can leave them out.
+// Returns the process exit code.
+int CookTextures(const TextureCookerOptions& options);
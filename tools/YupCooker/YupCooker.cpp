@@ -0,0 +1,107 @@
+// YupCooker - offline asset cooker.
+//
+// Usage: YupCooker textures <sourceDir> <outputDir> [-bc7] [-threads N] [-cache file] [-exclude file]
+//        YupCooker meshes <sourceDir> <outputDir> [-threads N]
+//        YupCooker shaders <shadersDir> <outputDir>
+//
+// The output directory is meant to be packed as an overlay on top of the source directory, see YupPacker.
+// Run the texture step first, the mesh step picks up the glTF copies that point at the cooked textures.
+
+#include "TextureCooker.h"
+#include "MeshCooker.h"
+#include "ShaderPacker.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+static void PrintUsage()
+{
+    fprintf(stderr, "Usage: YupCooker textures <sourceDir> <outputDir> [-bc7] [-threads N] [-cache file] [-exclude file]\n");
+    fprintf(stderr, "       YupCooker meshes <sourceDir> <outputDir> [-threads N]\n");
+    fprintf(stderr, "       YupCooker shaders <shadersDir> <outputDir>\n");
+}
+
+int main(int argc, const char** argv)
+{
+    if (argc < 4)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    std::string command = argv[1];
+
+    if (command == "textures")
+    {
+        TextureCookerOptions options;
+        options.sourceDir = argv[2];
+        options.outputDir = argv[3];
+
+        for (int i = 4; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            if (arg == "-bc7")
+                options.useBC7 = true;
+            else if (arg == "-threads" && i + 1 < argc)
+                options.threads = unsigned(std::max(1, atoi(argv[++i])));
+            else if (arg == "-cache" && i + 1 < argc)
+                options.cacheFile = argv[++i];
+            else if (arg == "-exclude" && i + 1 < argc)
+                options.excludeListFile = argv[++i];
+            else
+            {
+                PrintUsage();
+                return 1;
+            }
+        }
+
+        if (options.threads == 0)
+            options.threads = std::max(1u, std::thread::hardware_concurrency());
+
+        return CookTextures(options);
+    }
+
+    if (command == "meshes")
+    {
+        MeshCookerOptions options;
+        options.sourceDir = argv[2];
+        options.outputDir = argv[3];
+
+        for (int i = 4; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            if (arg == "-threads" && i + 1 < argc)
+                options.threads = unsigned(std::max(1, atoi(argv[++i])));
+            else
+            {
+                PrintUsage();
+                return 1;
+            }
+        }
+
+        if (options.threads == 0)
+            options.threads = std::max(1u, std::thread::hardware_concurrency());
+
+        return CookMeshes(options);
+    }
+
+    if (command == "shaders")
+    {
+        if (argc != 4)
+        {
+            PrintUsage();
+            return 1;
+        }
+
+        ShaderPackerOptions options;
+        options.shadersDir = argv[2];
+        options.outputDir = argv[3];
+        return PackShaders(options);
+    }
+
+    PrintUsage();
+    return 1;
+}
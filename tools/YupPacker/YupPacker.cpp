@@ -0,0 +1,676 @@
+// YupPacker - incremental, content-addressed packer for the Assets archive.
+//
+// Usage: YupPacker <archive.zip> <sourceDir> [<overlayDir>...] [-level N] [-threads N] [-store ext,ext] [-exclude listFile] [-full]
+//
+// Files from later directories override files with the same relative path from earlier ones.
+// A manifest (<archive>.manifest) remembers size, timestamp, content hash and archive location of
+// every entry. On the next run only files whose content hash changed are recompressed; they are
+// appended after the old central directory, which stays in place until the new one is written, and
+// unchanged entries are left where they are. An interrupted run leaves the archive longer than the
+// manifest says, so the next run rebuilds it. The archive is compacted (raw copy, no recompression)
+// once dead space gets too large.
+// Files listed in an exclude list (one relative path per line, e.g. source images superseded by
+// cooked ones) are left out of the archive.
+
+#include "../Common/ToolUtils.h"
+#include "../Common/XXHash64.h"
+
+#include <miniz.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static constexpr const char* g_ManifestMagic = "YUPPACK";
+static constexpr int g_ManifestVersion = 1;
+
+// Entries with more dead bytes than this fraction of the live bytes trigger a compaction.
+static constexpr double g_MaxDeadSpaceRatio = 0.5;
+
+// Changed files are read and compressed in batches of about this many source bytes right before they are
+// written, so memory use does not grow with the size of the asset tree.
+static constexpr uint64_t g_MaxBatchBytes = 256ull << 20;
+
+struct ManifestEntry
+{
+    uint64_t hash = 0;
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    uint64_t headerOffset = 0;
+    uint64_t compressedSize = 0;
+    uint32_t crc = 0;
+    uint16_t method = 0;
+};
+
+struct Manifest
+{
+    uint64_t archiveSize = 0;
+    uint64_t centralDirectoryOffset = 0;
+    int compressionLevel = -1;
+    std::map<std::string, ManifestEntry> entries;
+};
+
+struct SourceFile
+{
+    std::string name;
+    fs::path path;
+    uint64_t size = 0;
+    int64_t mtime = 0;
+
+    uint64_t hash = 0;
+    bool changed = true;
+};
+
+// Entry data of a changed file, only held while its batch is written
+struct PackedFile
+{
+    std::vector<uint8_t> data;
+    uint32_t crc = 0;
+    uint16_t method = 0;
+};
+
+struct Options
+{
+    fs::path archive;
+    std::vector<fs::path> sourceDirs;
+    int level = 9;
+    unsigned threads = 0;
+    std::unordered_set<std::string> storedExtensions = { ".ogg", ".mkv", ".mp4", ".ymesh" };
+    std::unordered_set<std::string> excludedFiles;
+    bool forceFull = false;
+};
+
+static int64_t GetModificationTime(const fs::path& path)
+{
+    std::error_code ec;
+    auto time = fs::last_write_time(path, ec);
+    if (ec)
+        return 0;
+    return int64_t(time.time_since_epoch().count());
+}
+
+static bool LoadManifest(const fs::path& path, Manifest& manifest)
+{
+    std::ifstream file(path);
+    if (!file)
+        return false;
+
+    std::string magic;
+    int version = 0;
+    file >> magic >> version >> manifest.archiveSize >> manifest.centralDirectoryOffset >> manifest.compressionLevel;
+    if (magic != g_ManifestMagic || version != g_ManifestVersion)
+        return false;
+
+    std::string line;
+    std::getline(file, line);
+    while (std::getline(file, line))
+    {
+        // hash size mtime offset csize crc method \t name
+        size_t tab = line.find('\t');
+        if (tab == std::string::npos)
+            continue;
+
+        ManifestEntry entry;
+        std::istringstream fields(line.substr(0, tab));
+        fields >> std::hex >> entry.hash >> std::dec >> entry.size >> entry.mtime >> entry.headerOffset
+            >> entry.compressedSize >> std::hex >> entry.crc >> std::dec >> entry.method;
+        if (!fields)
+            return false;
+
+        manifest.entries[line.substr(tab + 1)] = entry;
+    }
+
+    return true;
+}
+
+static bool SaveManifest(const fs::path& path, const Manifest& manifest)
+{
+    std::ofstream file(path, std::ios::trunc);
+    if (!file)
+        return false;
+
+    file << g_ManifestMagic << ' ' << g_ManifestVersion << ' ' << manifest.archiveSize << ' '
+        << manifest.centralDirectoryOffset << ' ' << manifest.compressionLevel << '\n';
+
+    for (const auto& [name, entry] : manifest.entries)
+    {
+        file << std::hex << entry.hash << std::dec << ' ' << entry.size << ' ' << entry.mtime << ' '
+            << entry.headerOffset << ' ' << entry.compressedSize << ' ' << std::hex << entry.crc << std::dec << ' '
+            << entry.method << '\t' << name << '\n';
+    }
+
+    return bool(file);
+}
+
+static std::vector<SourceFile> GatherSourceFiles(const std::vector<fs::path>& sourceDirs, const std::unordered_set<std::string>& excludedFiles)
+{
+    std::map<std::string, SourceFile> files;
+
+    for (const fs::path& root : sourceDirs)
+    {
+        std::error_code ec;
+        if (!fs::is_directory(root, ec))
+        {
+            fprintf(stderr, "YupPacker: skipping missing directory %s\n", root.generic_string().c_str());
+            continue;
+        }
+
+        for (const auto& it : fs::recursive_directory_iterator(root))
+        {
+            if (!it.is_regular_file())
+                continue;
+
+            SourceFile file;
+            file.path = it.path();
+            file.name = fs::relative(it.path(), root).generic_string();
+            if (excludedFiles.count(file.name))
+                continue;
+
+            file.size = it.file_size();
+            file.mtime = GetModificationTime(it.path());
+            files[file.name] = std::move(file);
+        }
+    }
+
+    std::vector<SourceFile> result;
+    result.reserve(files.size());
+    for (auto& [name, file] : files)
+        result.push_back(std::move(file));
+    return result;
+}
+
+// Zip record writers. All values are little-endian, no zip64 support.
+
+class ByteWriter
+{
+public:
+    std::vector<uint8_t> bytes;
+
+    void U16(uint16_t v) { bytes.push_back(uint8_t(v)); bytes.push_back(uint8_t(v >> 8)); }
+    void U32(uint32_t v) { U16(uint16_t(v)); U16(uint16_t(v >> 16)); }
+    void Str(const std::string& s) { bytes.insert(bytes.end(), s.begin(), s.end()); }
+};
+
+// Fixed DOS timestamp (1980-01-01 00:00) keeps archives byte-identical across machines.
+static constexpr uint16_t g_DosTime = 0;
+static constexpr uint16_t g_DosDate = (1 << 5) | 1;
+static constexpr uint16_t g_FlagUtf8 = 1 << 11;
+
+static size_t LocalHeaderSize(const std::string& name)
+{
+    return 30 + name.size();
+}
+
+static std::vector<uint8_t> MakeLocalHeader(const std::string& name, const ManifestEntry& entry)
+{
+    ByteWriter w;
+    w.U32(0x04034b50);
+    w.U16(20);
+    w.U16(g_FlagUtf8);
+    w.U16(entry.method);
+    w.U16(g_DosTime);
+    w.U16(g_DosDate);
+    w.U32(entry.crc);
+    w.U32(uint32_t(entry.compressedSize));
+    w.U32(uint32_t(entry.size));
+    w.U16(uint16_t(name.size()));
+    w.U16(0);
+    w.Str(name);
+    return std::move(w.bytes);
+}
+
+static std::vector<uint8_t> MakeCentralDirectory(const std::map<std::string, ManifestEntry>& entries, uint64_t offset)
+{
+    ByteWriter w;
+    for (const auto& [name, entry] : entries)
+    {
+        w.U32(0x02014b50);
+        w.U16(20);
+        w.U16(20);
+        w.U16(g_FlagUtf8);
+        w.U16(entry.method);
+        w.U16(g_DosTime);
+        w.U16(g_DosDate);
+        w.U32(entry.crc);
+        w.U32(uint32_t(entry.compressedSize));
+        w.U32(uint32_t(entry.size));
+        w.U16(uint16_t(name.size()));
+        w.U16(0);
+        w.U16(0);
+        w.U16(0);
+        w.U16(0);
+        w.U32(0);
+        w.U32(uint32_t(entry.headerOffset));
+        w.Str(name);
+    }
+
+    uint32_t directorySize = uint32_t(w.bytes.size());
+
+    w.U32(0x06054b50);
+    w.U16(0);
+    w.U16(0);
+    w.U16(uint16_t(entries.size()));
+    w.U16(uint16_t(entries.size()));
+    w.U32(directorySize);
+    w.U32(uint32_t(offset));
+    w.U16(0);
+    return std::move(w.bytes);
+}
+
+static uint64_t CentralDirectorySize(const std::vector<SourceFile>& files)
+{
+    uint64_t size = 22;
+    for (const SourceFile& file : files)
+        size += 46 + file.name.size();
+    return size;
+}
+
+static void CompressFile(const SourceFile& file, std::vector<uint8_t> input, const Options& options, PackedFile& packed)
+{
+    packed.crc = uint32_t(mz_crc32(MZ_CRC32_INIT, input.data(), input.size()));
+    packed.method = 0;
+
+    std::string extension = ToLower(fs::path(file.name).extension().generic_string());
+    if (options.level > 0 && !input.empty() && !options.storedExtensions.count(extension))
+    {
+        int flags = int(tdefl_create_comp_flags_from_zip_params(options.level, -MZ_DEFAULT_WINDOW_BITS, MZ_DEFAULT_STRATEGY));
+        size_t compressedSize = 0;
+        void* compressed = tdefl_compress_mem_to_heap(input.data(), input.size(), &compressedSize, flags);
+
+        if (compressed && compressedSize < input.size())
+        {
+            const uint8_t* bytes = static_cast<const uint8_t*>(compressed);
+            packed.data.assign(bytes, bytes + compressedSize);
+            packed.method = MZ_DEFLATED;
+        }
+
+        mz_free(compressed);
+    }
+
+    if (packed.method == 0)
+        packed.data = std::move(input);
+}
+
+static bool CopyRange(std::ifstream& source, std::ofstream& dest, uint64_t offset, uint64_t size)
+{
+    std::vector<char> buffer(1 << 20);
+    source.seekg(std::streamoff(offset));
+    while (size > 0)
+    {
+        size_t chunk = size_t(std::min<uint64_t>(size, buffer.size()));
+        if (!source.read(buffer.data(), std::streamsize(chunk)))
+            return false;
+        dest.write(buffer.data(), std::streamsize(chunk));
+        size -= chunk;
+    }
+    return bool(dest);
+}
+
+// Reads, compresses and writes the changed files at writeOffset, one batch at a time. A batch that would take
+// the archive and its central directory past the 32-bit zip offsets is not written.
+static bool WriteChangedFiles(std::ostream& output, const std::vector<SourceFile*>& changedFiles, uint64_t directorySize,
+    const Options& options, uint64_t& writeOffset, Manifest& manifest)
+{
+    std::vector<PackedFile> batch;
+    size_t batchStart = 0;
+    while (batchStart < changedFiles.size())
+    {
+        size_t batchEnd = batchStart + 1;
+        uint64_t batchBytes = changedFiles[batchStart]->size;
+        while (batchEnd < changedFiles.size() && batchBytes + changedFiles[batchEnd]->size <= g_MaxBatchBytes)
+            batchBytes += changedFiles[batchEnd++]->size;
+
+        batch.clear();
+        batch.resize(batchEnd - batchStart);
+
+        std::atomic<bool> readFailed = false;
+        ParallelFor(batch.size(), options.threads, [&](size_t index)
+        {
+            SourceFile& file = *changedFiles[batchStart + index];
+            std::vector<uint8_t> input;
+            if (!ReadWholeFile(file.path, input))
+            {
+                fprintf(stderr, "YupPacker: cannot read %s\n", file.path.generic_string().c_str());
+                readFailed = true;
+                return;
+            }
+
+            // The file may have been edited since it was hashed, the manifest describes what is written
+            file.size = input.size();
+            file.hash = XXHash64::Hash(input.data(), input.size());
+            CompressFile(file, std::move(input), options, batch[index]);
+        });
+
+        if (readFailed)
+            return false;
+
+        uint64_t batchEndOffset = writeOffset;
+        for (size_t i = 0; i < batch.size(); i++)
+            batchEndOffset += LocalHeaderSize(changedFiles[batchStart + i]->name) + batch[i].data.size();
+
+        if (batchEndOffset + directorySize > 0xffffffffull)
+        {
+            fprintf(stderr, "YupPacker: archive would exceed 4 GB, zip64 is not supported\n");
+            return false;
+        }
+
+        for (size_t i = 0; i < batch.size(); i++)
+        {
+            const SourceFile& file = *changedFiles[batchStart + i];
+            const PackedFile& packed = batch[i];
+
+            ManifestEntry entry;
+            entry.hash = file.hash;
+            entry.size = file.size;
+            entry.mtime = file.mtime;
+            entry.headerOffset = writeOffset;
+            entry.compressedSize = packed.data.size();
+            entry.crc = packed.crc;
+            entry.method = packed.method;
+
+            std::vector<uint8_t> header = MakeLocalHeader(file.name, entry);
+            output.write(reinterpret_cast<const char*>(header.data()), std::streamsize(header.size()));
+            output.write(reinterpret_cast<const char*>(packed.data.data()), std::streamsize(packed.data.size()));
+            writeOffset += header.size() + packed.data.size();
+            manifest.entries[file.name] = entry;
+        }
+
+        batchStart = batchEnd;
+    }
+
+    return bool(output);
+}
+
+static bool ParseCommandLine(int argc, const char** argv, Options& options)
+{
+    std::vector<std::string> positional;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "-level" && i + 1 < argc)
+            options.level = std::clamp(atoi(argv[++i]), 0, 10);
+        else if (arg == "-threads" && i + 1 < argc)
+            options.threads = unsigned(std::max(1, atoi(argv[++i])));
+        else if (arg == "-store" && i + 1 < argc)
+        {
+            std::istringstream list(argv[++i]);
+            std::string extension;
+            while (std::getline(list, extension, ','))
+            {
+                if (extension.empty() || extension == ".")
+                {
+                    fprintf(stderr, "YupPacker: empty extension in -store list\n");
+                    return false;
+                }
+                options.storedExtensions.insert(ToLower(extension[0] == '.' ? extension : "." + extension));
+            }
+        }
+        else if (arg == "-exclude" && i + 1 < argc)
+        {
+            std::ifstream list(argv[++i]);
+            std::string name;
+            while (std::getline(list, name))
+            {
+                if (!name.empty())
+                    options.excludedFiles.insert(name);
+            }
+        }
+        else if (arg == "-full")
+            options.forceFull = true;
+        else if (!arg.empty() && arg[0] == '-')
+            return false;
+        else
+            positional.push_back(arg);
+    }
+
+    if (positional.size() < 2)
+        return false;
+
+    options.archive = positional[0];
+    for (size_t i = 1; i < positional.size(); i++)
+        options.sourceDirs.push_back(positional[i]);
+
+    if (options.threads == 0)
+        options.threads = std::max(1u, std::thread::hardware_concurrency());
+
+    return true;
+}
+
+int main(int argc, const char** argv)
+{
+    using namespace std::chrono;
+    auto startTime = steady_clock::now();
+
+    Options options;
+    if (!ParseCommandLine(argc, argv, options))
+    {
+        fprintf(stderr, "Usage: YupPacker <archive.zip> <sourceDir> [<overlayDir>...] [-level N] [-threads N] [-store ext,ext] [-exclude listFile] [-full]\n");
+        return 1;
+    }
+
+    fs::path manifestPath = options.archive;
+    manifestPath += ".manifest";
+
+    Manifest oldManifest;
+    bool incremental = !options.forceFull && LoadManifest(manifestPath, oldManifest);
+
+    std::error_code ec;
+    if (incremental)
+    {
+        // The manifest is only trusted if it describes the archive that is actually on disk.
+        uint64_t archiveSize = fs::exists(options.archive, ec) ? fs::file_size(options.archive, ec) : 0;
+        if (archiveSize != oldManifest.archiveSize || oldManifest.compressionLevel != options.level)
+            incremental = false;
+    }
+    if (!incremental)
+        oldManifest = Manifest();
+
+    std::vector<SourceFile> files = GatherSourceFiles(options.sourceDirs, options.excludedFiles);
+    if (files.size() > 0xffff)
+    {
+        fprintf(stderr, "YupPacker: too many files for a non-zip64 archive (%zu)\n", files.size());
+        return 1;
+    }
+
+    // Hash everything that may have changed. Files whose size and timestamp match the manifest are trusted as is.
+    // The contents are dropped after hashing and read again when the changed entries are written.
+    std::atomic<uint64_t> bytesHashed = 0;
+    std::atomic<bool> readFailed = false;
+    ParallelFor(files.size(), options.threads, [&](size_t index)
+    {
+        SourceFile& file = files[index];
+        auto old = oldManifest.entries.find(file.name);
+        if (old != oldManifest.entries.end() && old->second.size == file.size && old->second.mtime == file.mtime)
+        {
+            file.hash = old->second.hash;
+            file.changed = false;
+            return;
+        }
+
+        std::vector<uint8_t> data;
+        if (!ReadWholeFile(file.path, data))
+        {
+            fprintf(stderr, "YupPacker: cannot read %s\n", file.path.generic_string().c_str());
+            readFailed = true;
+            return;
+        }
+
+        file.hash = XXHash64::Hash(data.data(), data.size());
+        file.changed = old == oldManifest.entries.end() || old->second.hash != file.hash || old->second.size != file.size;
+        bytesHashed += file.size;
+    });
+
+    if (readFailed)
+        return 1;
+
+    Manifest newManifest;
+    newManifest.compressionLevel = options.level;
+
+    size_t numChanged = 0;
+    uint64_t liveBytes = 0;
+    std::unordered_set<std::string> presentNames;
+    for (const SourceFile& file : files)
+    {
+        presentNames.insert(file.name);
+        if (file.changed)
+            numChanged++;
+        else
+        {
+            ManifestEntry entry = oldManifest.entries[file.name];
+            entry.mtime = file.mtime;
+            newManifest.entries[file.name] = entry;
+            liveBytes += LocalHeaderSize(file.name) + entry.compressedSize;
+        }
+    }
+
+    size_t numRemoved = 0;
+    for (const auto& [name, entry] : oldManifest.entries)
+    {
+        if (!presentNames.count(name))
+            numRemoved++;
+    }
+
+    if (incremental && numChanged == 0 && numRemoved == 0)
+    {
+        // Timestamps may still have been refreshed
+        newManifest.archiveSize = oldManifest.archiveSize;
+        newManifest.centralDirectoryOffset = oldManifest.centralDirectoryOffset;
+        SaveManifest(manifestPath, newManifest);
+        printf("YupPacker: %s is up to date (%zu entries)\n", options.archive.generic_string().c_str(), files.size());
+        return 0;
+    }
+
+    std::vector<SourceFile*> changedFiles;
+    for (SourceFile& file : files)
+    {
+        if (file.changed)
+            changedFiles.push_back(&file);
+    }
+
+    // Everything before the old central directory that is not referenced anymore is dead space.
+    uint64_t deadBytes = oldManifest.centralDirectoryOffset > liveBytes ? oldManifest.centralDirectoryOffset - liveBytes : 0;
+    bool compact = !incremental || double(deadBytes) > double(liveBytes) * g_MaxDeadSpaceRatio;
+
+    // The offsets are 32 bits; WriteChangedFiles checks every batch against this before writing it
+    uint64_t directorySize = CentralDirectorySize(files);
+    uint64_t writeOffset = 0;
+
+    if (compact)
+    {
+        fs::path tempPath = options.archive;
+        tempPath += ".tmp";
+
+        std::ofstream output(tempPath, std::ios::binary | std::ios::trunc);
+        if (!output)
+        {
+            fprintf(stderr, "YupPacker: cannot create %s\n", tempPath.generic_string().c_str());
+            return 1;
+        }
+
+        if (incremental)
+        {
+            std::ifstream input(options.archive, std::ios::binary);
+            for (auto& [name, entry] : newManifest.entries)
+            {
+                uint64_t recordSize = LocalHeaderSize(name) + entry.compressedSize;
+                if (!CopyRange(input, output, entry.headerOffset, recordSize))
+                {
+                    fprintf(stderr, "YupPacker: cannot copy %s from the old archive\n", name.c_str());
+                    return 1;
+                }
+                entry.headerOffset = writeOffset;
+                writeOffset += recordSize;
+            }
+        }
+        else
+        {
+            newManifest.entries.clear();
+        }
+
+        if (!WriteChangedFiles(output, changedFiles, directorySize, options, writeOffset, newManifest))
+        {
+            output.close();
+            fs::remove(tempPath, ec);
+            return 1;
+        }
+
+        std::vector<uint8_t> directory = MakeCentralDirectory(newManifest.entries, writeOffset);
+        output.write(reinterpret_cast<const char*>(directory.data()), std::streamsize(directory.size()));
+        output.close();
+
+        if (!output)
+        {
+            fprintf(stderr, "YupPacker: failed writing %s\n", tempPath.generic_string().c_str());
+            return 1;
+        }
+
+        fs::rename(tempPath, options.archive, ec);
+        if (ec)
+        {
+            fprintf(stderr, "YupPacker: cannot replace %s: %s\n", options.archive.generic_string().c_str(), ec.message().c_str());
+            return 1;
+        }
+
+        newManifest.centralDirectoryOffset = writeOffset;
+        newManifest.archiveSize = writeOffset + directory.size();
+    }
+    else
+    {
+        // Append the changed entries and a new central directory after the old one. The old directory stays
+        // valid until the new one is complete; it becomes dead space like the replaced entries.
+        std::fstream output(options.archive, std::ios::binary | std::ios::in | std::ios::out);
+        if (!output)
+        {
+            fprintf(stderr, "YupPacker: cannot open %s for patching\n", options.archive.generic_string().c_str());
+            return 1;
+        }
+
+        writeOffset = oldManifest.archiveSize;
+        output.seekp(std::streamoff(writeOffset));
+
+        bool written = WriteChangedFiles(output, changedFiles, directorySize, options, writeOffset, newManifest);
+
+        std::vector<uint8_t> directory = MakeCentralDirectory(newManifest.entries, writeOffset);
+        if (written)
+            output.write(reinterpret_cast<const char*>(directory.data()), std::streamsize(directory.size()));
+        output.close();
+
+        if (!written || !output)
+        {
+            // Cut the partial entries off again, which leaves the old archive as it was
+            fprintf(stderr, "YupPacker: failed patching %s\n", options.archive.generic_string().c_str());
+            fs::resize_file(options.archive, oldManifest.archiveSize, ec);
+            return 1;
+        }
+
+        newManifest.centralDirectoryOffset = writeOffset;
+        newManifest.archiveSize = writeOffset + directory.size();
+    }
+
+    if (!SaveManifest(manifestPath, newManifest))
+    {
+        fprintf(stderr, "YupPacker: cannot write %s\n", manifestPath.generic_string().c_str());
+        return 1;
+    }
+
+    auto duration = duration_cast<milliseconds>(steady_clock::now() - startTime).count();
+    printf("YupPacker: %s %s - %zu changed, %zu removed, %zu total, %.1f MB hashed in %lld ms\n",
+        options.archive.generic_string().c_str(),
+        compact ? (incremental ? "compacted" : "rebuilt") : "patched",
+        numChanged, numRemoved, files.size(), double(bytesHashed) / (1024.0 * 1024.0), (long long)duration);
+
+    return 0;
+}